@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include <assertmacros.h>
 
@@ -26,6 +27,12 @@
  */
 typedef unsigned char byte;
 
+// Numero di client che accodano contemporaneamente allo stesso blocco nel test 5, deve corrispondere a quelli lanciati da test.sh
+#define APPENDERS 2
+// Numero di aggiunte di ciascun client e loro dimensione
+#define APPEND_COUNT 50
+#define APPEND_CHUNK 1000
+
 /**
  * @brief Crea un array di bytes grande size
  * 
@@ -101,6 +108,34 @@ static int compare_data (char* name, byte* array, int size) {
     return 0;
 }
 
+/**
+ * @brief Elenca gli oggetti dell'utente a pagine di 8 nomi e verifica che siano i 20 blocchi memorizzati, in ordine
+ * 
+ * @return int Se l'elenco è corretto restituisce 0. Se c'è un errore restituisce un codice di errore.
+ */
+static int list_data () {
+    // Nome atteso e ultimo nome ricevuto, da cui riprende la pagina successiva
+    char expected[2] = "A";
+    char last[2] = "";
+    int total = 0;
+    int count;
+    // Chiede pagine finché il server non ne restituisce una incompleta
+    do {
+        char** names = os_list(NULL, last, 8);
+        ASSERT_RETURN(names != NULL, errno);
+        for (count = 0; names[count] != NULL; count++) {
+            ASSERT(EQUALS(names[count], expected), free(names); return EILSEQ);
+            expected[0]++;
+        }
+        if (count > 0) strcpy(last, names[count - 1]);
+        total += count;
+        free(names);
+    } while (count == 8);
+    ASSERT_RETURN(total == 20, EILSEQ);
+
+    return 0;
+}
+
 /**
  * @brief Recupera 20 blocchi di dati da 100B a 100KB e verifica che siano una sequenza di interi consecutivi
  * 
@@ -115,6 +150,9 @@ static int retrieve_data () {
     char name[2] = "A";
     // Dimensione della risorsa
     int size = 100;
+    // Chiede di portare in memoria i primi blocchi, i successivi vengono letti in anticipo dal server riconoscendo la sequenza
+    char* first_names[] = {"A", "B"};
+    ASSERT(os_prefetch(first_names, 2) == 1, free(array); return errno);
     for (int i = 0; i < 19; i++) {
         ASSERT(compare_data(name, array, size) == 0, free(array); return errno);
         // Incrementa la dimensione del prossimo blocco
@@ -126,7 +164,7 @@ static int retrieve_data () {
     // Libera la memoria occupata dall'array di prova
     free(array);
     
-    return 0;
+    return list_data();
 }
 
 /**
@@ -147,6 +185,161 @@ static int delete_data () {
     return 0;
 }
 
+/**
+ * @brief Cancella un blocco se esiste, così che i test che lo ricreano possano essere ripetuti
+ * 
+ * @param name Nome del blocco
+ * @return int Se il blocco non esiste più restituisce 1. Se c'è un errore restituisce 0 e setta errno.
+ */
+static int delete_if_exists (char* name) {
+    return (os_delete(name) == 1) || (errno == ENOENT);
+}
+
+/**
+ * @brief Accoda 10 pezzi da 100B a un blocco che non esiste, verificando con os_stat e os_retrieve che il risultato
+ * sia la loro concatenazione. Cancella anche il blocco su cui accodano i test concorrenti.
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce un codice di errore.
+ */
+static int append_data () {
+    ASSERT_RETURN(delete_if_exists("log") && delete_if_exists("shared"), errno);
+    byte* array = create_test_array(100000);
+    ASSERT_RETURN(array != NULL, errno);
+    // La prima aggiunta crea il blocco
+    os_stat_t stat;
+    ASSERT(os_append("log", array, 100) == 1, free(array); return errno);
+    ASSERT(os_stat("log", &stat) == 1, free(array); return errno);
+    ASSERT(stat.size == 100, free(array); return EILSEQ);
+    // Le successive lo estendono nell'ordine in cui vengono fatte
+    for (int i = 1; i < 10; i++)
+        ASSERT(os_append("log", array + 100 * i, 100) == 1, free(array); return errno);
+    ASSERT(os_stat("log", &stat) == 1, free(array); return errno);
+    ASSERT(stat.size == 1000, free(array); return EILSEQ);
+    int error = compare_data("log", array, 1000);
+    free(array);
+    ASSERT_RETURN(error == 0, EILSEQ);
+
+    return 0;
+}
+
+/**
+ * @brief Accoda APPEND_COUNT pezzi da APPEND_CHUNK byte al blocco condiviso, ciascuno riempito con lo stesso byte.
+ * Viene eseguito da APPENDERS client contemporaneamente.
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce un codice di errore.
+ */
+static int append_concurrently () {
+    byte chunk[APPEND_CHUNK];
+    memset(chunk, (byte) getpid(), APPEND_CHUNK);
+    for (int i = 0; i < APPEND_COUNT; i++)
+        ASSERT_RETURN(os_append("shared", chunk, APPEND_CHUNK) == 1, errno);
+
+    return 0;
+}
+
+/**
+ * @brief Verifica che il blocco condiviso sia lungo quanto la somma delle aggiunte dei client concorrenti
+ * e che nessuna aggiunta si sia mescolata con un'altra.
+ * 
+ * @return int Se il blocco è corretto restituisce 0. Se c'è un errore restituisce un codice di errore.
+ */
+static int check_appended () {
+    os_stat_t stat;
+    ASSERT_RETURN(os_stat("shared", &stat) == 1, errno);
+    ASSERT_RETURN(stat.size == APPENDERS * APPEND_COUNT * APPEND_CHUNK, EILSEQ);
+    byte* data = os_retrieve("shared");
+    ASSERT_RETURN(data != NULL, errno);
+    // Ogni pezzo deve essere contiguo, quindi formato da un solo byte ripetuto
+    for (size_t i = 0; i < stat.size; i++)
+        ASSERT(data[i] == data[i - i % APPEND_CHUNK], free(data); return EILSEQ);
+    free(data);
+
+    return 0;
+}
+
+/**
+ * @brief Recupera 10 blocchi da 1KB a 10KB scritti direttamente nel layout piatto dallo script di test,
+ * prima e dopo la loro migrazione al layout a fanout.
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce un codice di errore.
+ */
+static int retrieve_migrated () {
+    byte* array = create_test_array(100000);
+    ASSERT_RETURN(array != NULL, errno);
+    char name[3] = "F0";
+    for (int i = 0; i < 10; i++) {
+        os_stat_t stat;
+        ASSERT(os_stat(name, &stat) == 1, free(array); return errno);
+        ASSERT(stat.size == 1000 * (i + 1), free(array); return EILSEQ);
+        ASSERT(compare_data(name, array, stat.size) == 0, free(array); return EILSEQ);
+        name[1]++;
+    }
+    free(array);
+
+    return 0;
+}
+
+/**
+ * @brief Verifica le richieste condizionali: la creazione esclusiva, la memorizzazione solo se la versione è quella attesa
+ * e il recupero solo se la versione è cambiata. Alla fine memorizza nel blocco "tag" il tag dell'ultima versione,
+ * che check_persisted confronta dopo il riavvio del server.
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce un codice di errore.
+ */
+static int conditional_data () {
+    ASSERT_RETURN(delete_if_exists("versioned"), errno);
+    byte* array = create_test_array(100000);
+    ASSERT_RETURN(array != NULL, errno);
+    // Solo la prima creazione esclusiva riesce
+    ASSERT(os_store_if_match("versioned", array, 100, OS_TAG_ABSENT) == 1, free(array); return errno);
+    ASSERT(os_store_if_match("versioned", array, 100, OS_TAG_ABSENT) == 0 && errno == ECANCELED, free(array); return EILSEQ);
+    os_stat_t first;
+    ASSERT(os_stat("versioned", &first) == 1, free(array); return errno);
+    ASSERT(first.size == 100, free(array); return EILSEQ);
+    // La versione posseduta è quella attuale
+    char tag[TAG_LENGTH + 1];
+    size_t size;
+    strcpy(tag, first.tag);
+    ASSERT(os_retrieve_if_none_match("versioned", tag, &size) == NULL && errno == EALREADY, free(array); return EILSEQ);
+    // La memorizzazione con il tag attuale riesce e cambia versione, quella con il tag vecchio no
+    ASSERT(os_store_if_match("versioned", array, 200, first.tag) == 1, free(array); return errno);
+    ASSERT(os_store_if_match("versioned", array, 300, first.tag) == 0 && errno == ECANCELED, free(array); return EILSEQ);
+    os_stat_t second;
+    ASSERT(os_stat("versioned", &second) == 1, free(array); return errno);
+    ASSERT(second.size == 200 && !EQUALS(second.tag, first.tag), free(array); return EILSEQ);
+    // Con il tag vecchio riceve la nuova versione e il suo tag
+    byte* data = os_retrieve_if_none_match("versioned", tag, &size);
+    ASSERT(data != NULL, free(array); return errno);
+    int equals = (size == 200) && data_corresponding(data, array, size) && EQUALS(tag, second.tag);
+    free(data);
+    free(array);
+    ASSERT_RETURN(equals, EILSEQ);
+    ASSERT_RETURN(os_store("tag", second.tag, TAG_LENGTH) == 1, errno);
+
+    return 0;
+}
+
+/**
+ * @brief Dopo il riavvio del server verifica che il blocco "versioned" abbia ancora la dimensione e il tag
+ * memorizzati da conditional_data.
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce un codice di errore.
+ */
+static int check_persisted () {
+    os_stat_t stat;
+    ASSERT_RETURN(os_stat("versioned", &stat) == 1, errno);
+    ASSERT_RETURN(stat.size == 200, EILSEQ);
+    char* tag = os_retrieve("tag");
+    ASSERT_RETURN(tag != NULL, errno);
+    int equals = strncmp(tag, stat.tag, TAG_LENGTH) == 0;
+    free(tag);
+    ASSERT_RETURN(equals, EILSEQ);
+    size_t size;
+    ASSERT_RETURN(os_retrieve_if_none_match("versioned", stat.tag, &size) == NULL && errno == EALREADY, EILSEQ);
+
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     // Controlla che sia stato passato il corretto numero di argomenti
     if (argc != 3) {
@@ -158,8 +351,8 @@ int main(int argc, char *argv[]) {
     // Numero di test da effettuare
     int test_number = strtol(argv[2], NULL, 10);
     // Controlla che il numero sia corretto
-    if ((test_number < 1) || (test_number > 3)) {
-        fprintf(stderr, "Test number must be between 1 and 3\n");
+    if ((test_number < 1) || (test_number > 9)) {
+        fprintf(stderr, "Test number must be between 1 and 9\n");
         exit(1);
     }
     // Si connette al server con il nome scelto
@@ -172,6 +365,18 @@ int main(int argc, char *argv[]) {
         error = retrieve_data();
     else if (test_number == 3)
         error = delete_data();
+    else if (test_number == 4)
+        error = append_data();
+    else if (test_number == 5)
+        error = append_concurrently();
+    else if (test_number == 6)
+        error = check_appended();
+    else if (test_number == 7)
+        error = retrieve_migrated();
+    else if (test_number == 8)
+        error = conditional_data();
+    else if (test_number == 9)
+        error = check_persisted();
     // Se l'operazione si è conclusa con successo lo stampa
     if (!error)
         printf("[%s] Test %d: Success\n", name, test_number);
@@ -0,0 +1,150 @@
+/**
+ * @file arena.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria che implementa un allocatore ad arena.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <assertmacros.h>
+
+#include <arena/arena.h>
+#include <pool/pool.h>
+
+// Arrotonda n al multiplo successivo dell'allineamento a, potenza di due
+#define ALIGN(n, a) (((n) + (a) - 1) & ~((uintptr_t) (a) - 1))
+
+/**
+ * @brief Crea un blocco di memoria, prendendo i dati in prestito dal pool di buffer
+ * 
+ * @param capacity Capacità minima del blocco, arrotondata alla classe del pool
+ * @return struct arena_chunk* Blocco appena creato. Se c'è un errore restituisce NULL e setta errno.
+ */
+static struct arena_chunk* create_chunk (size_t capacity) {
+    struct arena_chunk* chunk = (struct arena_chunk*) malloc(sizeof(struct arena_chunk));
+    ASSERT_ERRNO_RETURN(chunk != NULL, ENOMEM, NULL);
+    chunk->capacity = pool_capacity(capacity);
+    chunk->data = (char*) pool_acquire(chunk->capacity);
+    ASSERT(chunk->data != NULL, free(chunk); return NULL);
+    chunk->used = 0;
+    chunk->next = NULL;
+    return chunk;
+}
+
+/**
+ * @brief Crea un'arena con un primo blocco della capacità data
+ * 
+ * @param capacity Capacità del primo blocco
+ * @return arena_t* Arena appena creata. Se c'è un errore restituisce NULL e setta errno.
+ */
+arena_t* create_arena (size_t capacity) {
+    ASSERT_ERRNO_RETURN(capacity > 0, EINVAL, NULL);
+    arena_t* arena = (arena_t*) malloc(sizeof(arena_t));
+    ASSERT_ERRNO_RETURN(arena != NULL, ENOMEM, NULL);
+    arena->chunks = create_chunk(capacity);
+    ASSERT(arena->chunks != NULL, free(arena); return NULL);
+    arena->initial_capacity = capacity;
+    return arena;
+}
+
+/**
+ * @brief Alloca size byte allineati ad ARENA_ALIGNMENT
+ * 
+ * @param arena Arena da cui allocare
+ * @param size Numero di byte
+ * @return void* Memoria allocata, valida fino al prossimo azzeramento. Se c'è un errore restituisce NULL e setta errno.
+ */
+void* arena_alloc (arena_t* arena, size_t size) {
+    return arena_alloc_aligned(arena, size, ARENA_ALIGNMENT);
+}
+
+/**
+ * @brief Alloca size byte con l'allineamento dato
+ * 
+ * @param arena Arena da cui allocare
+ * @param size Numero di byte
+ * @param alignment Allineamento, potenza di due
+ * @return void* Memoria allocata, valida fino al prossimo azzeramento. Se c'è un errore restituisce NULL e setta errno.
+ */
+void* arena_alloc_aligned (arena_t* arena, size_t size, size_t alignment) {
+    ASSERT_ERRNO_RETURN((arena != NULL) && (size > 0) && (alignment > 0) && ((alignment & (alignment - 1)) == 0), EINVAL, NULL);
+    // Una richiesta che sommata all'allineamento supera SIZE_MAX non può essere soddisfatta
+    ASSERT_ERRNO_RETURN(size <= SIZE_MAX - alignment, ENOMEM, NULL);
+    // Prova a spostare il puntatore nel blocco principale, confrontando lo spazio rimasto senza sommare a size
+    struct arena_chunk* chunk = arena->chunks;
+    uintptr_t start = ALIGN((uintptr_t) chunk->data + chunk->used, alignment);
+    uintptr_t end = (uintptr_t) chunk->data + chunk->capacity;
+    if ((start <= end) && (size <= end - start)) {
+        chunk->used = start + size - (uintptr_t) chunk->data;
+        return (void*) start;
+    }
+    // Le allocazioni troppo grandi per essere conservate ricevono un blocco dedicato, inserito dopo quello principale
+    if (size + alignment > ARENA_MAX_CHUNK_SIZE) {
+        struct arena_chunk* dedicated = create_chunk(size + alignment);
+        ASSERT_RETURN(dedicated != NULL, NULL);
+        dedicated->next = chunk->next;
+        chunk->next = dedicated;
+        dedicated->used = dedicated->capacity;
+        return (void*) ALIGN((uintptr_t) dedicated->data, alignment);
+    }
+    // Altrimenti crea un nuovo blocco principale almeno doppio del precedente
+    size_t capacity = chunk->capacity * 2;
+    while (capacity < size + alignment) capacity *= 2;
+    if (capacity > ARENA_MAX_CHUNK_SIZE) capacity = ARENA_MAX_CHUNK_SIZE;
+    struct arena_chunk* bigger = create_chunk(capacity);
+    ASSERT_RETURN(bigger != NULL, NULL);
+    bigger->next = chunk;
+    arena->chunks = bigger;
+    start = ALIGN((uintptr_t) bigger->data, alignment);
+    bigger->used = start + size - (uintptr_t) bigger->data;
+    return (void*) start;
+}
+
+/**
+ * @brief Libera in un colpo solo tutta la memoria allocata dall'arena. Conserva il blocco principale se non supera
+ * ARENA_MAX_RETAINED, così le richieste piccole successive non allocano; uno più grande torna al pool.
+ * 
+ * @param arena Arena da azzerare
+ */
+void reset_arena (arena_t* arena) {
+    if (arena == NULL) return;
+    // Un blocco principale cresciuto oltre ARENA_MAX_RETAINED viene sostituito da uno piccolo e liberato con gli altri.
+    // Se il blocco piccolo non si riesce a creare conserva quello grande
+    if (arena->chunks->capacity > ARENA_MAX_RETAINED) {
+        struct arena_chunk* small = create_chunk(arena->initial_capacity);
+        if (small != NULL) {
+            small->next = arena->chunks;
+            arena->chunks = small;
+        }
+    }
+    // Libera tutti i blocchi tranne quello principale
+    struct arena_chunk* chunk = arena->chunks->next;
+    while (chunk) {
+        struct arena_chunk* next = chunk->next;
+        pool_release(chunk->data, chunk->capacity);
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks->next = NULL;
+    arena->chunks->used = 0;
+}
+
+/**
+ * @brief Libera l'arena e tutti i suoi blocchi
+ * 
+ * @param arena Arena da distruggere
+ */
+void destroy_arena (arena_t* arena) {
+    if (arena == NULL) return;
+    reset_arena(arena);
+    pool_release(arena->chunks->data, arena->chunks->capacity);
+    free(arena->chunks);
+    free(arena);
+}
@@ -0,0 +1,93 @@
+/**
+ * @file arena.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria che implementa un allocatore ad arena: la memoria viene assegnata spostando un puntatore
+ * all'interno di un blocco preallocato e viene liberata tutta insieme. Il server ne usa una per connessione,
+ * azzerata dopo ogni richiesta, così a regime una richiesta non chiama mai malloc e free.
+ * La libreria non è thread-safe: ogni arena va usata da un solo thread.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_ARENA)
+#define _ARENA
+
+#include <stddef.h>
+
+// Dimensione del primo blocco di un'arena, sufficiente per un header e un oggetto piccolo
+#define ARENA_CHUNK_SIZE (8 * 1024)
+
+// Dimensione massima del blocco principale, che cresce durante una richiesta: le allocazioni più grandi ricevono
+// un blocco dedicato, restituito al pool di buffer all'azzeramento
+#define ARENA_MAX_CHUNK_SIZE (4 * 1024 * 1024)
+
+// Dimensione massima del blocco principale conservato tra una richiesta e l'altra: uno più grande viene restituito
+// al pool all'azzeramento e sostituito da uno della capacità iniziale, così una connessione inattiva occupa poca memoria
+#define ARENA_MAX_RETAINED (64 * 1024)
+
+// Allineamento predefinito delle allocazioni, sufficiente per qualunque tipo di dato
+#define ARENA_ALIGNMENT 16
+
+/**
+ * @brief Blocco di memoria di un'arena, con capacità, byte occupati e puntatore al blocco successivo.
+ */
+struct arena_chunk {
+    struct arena_chunk* next;
+    size_t capacity;
+    size_t used;
+    char* data;
+};
+
+/**
+ * @brief Arena: lista di blocchi in cui il primo è quello da cui si alloca.
+ */
+typedef struct arena {
+    struct arena_chunk* chunks;
+    // Capacità del primo blocco, ripristinata all'azzeramento se il blocco principale è cresciuto troppo
+    size_t initial_capacity;
+} arena_t;
+
+/**
+ * @brief Crea un'arena con un primo blocco della capacità data
+ * 
+ * @param capacity Capacità del primo blocco
+ * @return arena_t* Arena appena creata. Se c'è un errore restituisce NULL e setta errno.
+ */
+arena_t* create_arena (size_t capacity);
+
+/**
+ * @brief Alloca size byte allineati ad ARENA_ALIGNMENT
+ * 
+ * @param arena Arena da cui allocare
+ * @param size Numero di byte
+ * @return void* Memoria allocata, valida fino al prossimo azzeramento. Se c'è un errore restituisce NULL e setta errno.
+ */
+void* arena_alloc (arena_t* arena, size_t size);
+
+/**
+ * @brief Alloca size byte con l'allineamento dato
+ * 
+ * @param arena Arena da cui allocare
+ * @param size Numero di byte
+ * @param alignment Allineamento, potenza di due
+ * @return void* Memoria allocata, valida fino al prossimo azzeramento. Se c'è un errore restituisce NULL e setta errno.
+ */
+void* arena_alloc_aligned (arena_t* arena, size_t size, size_t alignment);
+
+/**
+ * @brief Libera in un colpo solo tutta la memoria allocata dall'arena. Conserva il blocco principale se non supera
+ * ARENA_MAX_RETAINED, così le richieste piccole successive non allocano; uno più grande torna al pool.
+ * 
+ * @param arena Arena da azzerare
+ */
+void reset_arena (arena_t* arena);
+
+/**
+ * @brief Libera l'arena e tutti i suoi blocchi
+ * 
+ * @param arena Arena da distruggere
+ */
+void destroy_arena (arena_t* arena);
+
+#endif // _ARENA
@@ -0,0 +1,207 @@
+/**
+ * @file epoch.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria di recupero della memoria basato su epoche. Ogni thread lettore ha un record,
+ * grande una linea di cache, in cui scrive l'epoca in cui è entrato: l'ingresso e l'uscita non prendono lock e non
+ * scrivono memoria condivisa con gli altri lettori. Gli oggetti staccati vanno in una di tre liste secondo l'epoca del
+ * distacco, e la lista dell'epoca e-2 viene liberata quando l'epoca globale passa da e a e+1.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <assertmacros.h>
+#include <mutexmacros.h>
+
+#include <hashtable/epoch.h>
+
+#define CACHE_LINE 64
+
+/**
+ * @brief Record di un thread lettore. state vale 0 fuori da una sezione di lettura, altrimenti (epoca << 1) | 1.
+ */
+struct epoch_record {
+    unsigned long state;
+    int in_use;
+    struct epoch_record* next;
+    char padding[CACHE_LINE - sizeof(unsigned long) - sizeof(int) - sizeof(struct epoch_record*)];
+};
+
+/**
+ * @brief Oggetto in attesa di essere liberato
+ */
+struct retired {
+    void* ptr;
+    epoch_destructor_t destructor;
+    struct retired* next;
+};
+
+// Epoca globale, avanzata solo con la lock degli scrittori
+static unsigned long global_epoch = 0;
+
+// Lista dei record, a cui si aggiungono record ma da cui non se ne tolgono
+static struct epoch_record* records = NULL;
+
+// Oggetti staccati, divisi per epoca modulo 3
+static struct retired* limbo[3] = { NULL, NULL, NULL };
+
+// Lock degli scrittori, che protegge le liste di oggetti staccati e l'avanzamento dell'epoca
+static pthread_mutex_t retire_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Chiave che associa ad ogni thread il suo record
+static pthread_key_t record_key;
+
+// Garantisce che la chiave venga creata una sola volta
+static pthread_once_t epoch_once = PTHREAD_ONCE_INIT;
+
+// Esito della creazione della chiave
+static int epoch_ready = 0;
+
+/**
+ * @brief Rende riusabile il record di un thread che termina
+ * 
+ * @param ptr Record del thread
+ */
+static void release_record (void* ptr) {
+    struct epoch_record* record = (struct epoch_record*) ptr;
+    __atomic_store_n(&record->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->in_use, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Crea la chiave dei record
+ */
+static void init_epoch () {
+    if (pthread_key_create(&record_key, release_record) == 0) epoch_ready = 1;
+}
+
+/**
+ * @brief Restituisce il record del thread corrente, riusando quello di un thread terminato o aggiungendone uno nuovo
+ * 
+ * @return struct epoch_record* Record del thread. Se c'è un errore restituisce NULL e setta errno.
+ */
+static struct epoch_record* get_record () {
+    pthread_once(&epoch_once, init_epoch);
+    ASSERT_ERRNO_RETURN(epoch_ready, EAGAIN, NULL);
+    struct epoch_record* record = (struct epoch_record*) pthread_getspecific(record_key);
+    if (record != NULL) return record;
+    // Cerca un record libero
+    for (record = __atomic_load_n(&records, __ATOMIC_ACQUIRE); record != NULL; record = record->next)
+        if (__sync_bool_compare_and_swap(&record->in_use, 0, 1)) break;
+    // Se non ce ne sono ne aggiunge uno in testa alla lista
+    if (record == NULL) {
+        void* memory;
+        ASSERT_ERRNO_RETURN(posix_memalign(&memory, CACHE_LINE, sizeof(struct epoch_record)) == 0, ENOMEM, NULL);
+        record = (struct epoch_record*) memory;
+        record->state = 0;
+        record->in_use = 1;
+        do record->next = __atomic_load_n(&records, __ATOMIC_ACQUIRE);
+        while (!__sync_bool_compare_and_swap(&records, record->next, record));
+    }
+    ASSERT(pthread_setspecific(record_key, record) == 0, release_record(record); errno = ENOMEM; return NULL);
+    return record;
+}
+
+/**
+ * @brief Libera gli oggetti di una lista
+ * 
+ * @param list Testa della lista
+ */
+static void free_retired (struct retired* list) {
+    while (list != NULL) {
+        struct retired* next = list->next;
+        list->destructor(list->ptr);
+        free(list);
+        list = next;
+    }
+}
+
+/**
+ * @brief Avanza l'epoca globale se tutti i lettori attivi l'hanno già vista, liberando gli oggetti staccati due epoche prima.
+ * Va chiamata con la lock degli scrittori.
+ * 
+ * @return int Se l'epoca è avanzata restituisce 1, altrimenti 0.
+ */
+static int try_advance () {
+    unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+    // Il fence ordina i distacchi già fatti prima della lettura degli stati dei lettori
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (struct epoch_record* record = __atomic_load_n(&records, __ATOMIC_ACQUIRE); record != NULL; record = record->next) {
+        unsigned long state = __atomic_load_n(&record->state, __ATOMIC_ACQUIRE);
+        if ((state & 1) && ((state >> 1) != epoch)) return 0;
+    }
+    // La lista di indice (epoca + 1) mod 3 contiene gli oggetti staccati nell'epoca - 2
+    free_retired(limbo[(epoch + 1) % 3]);
+    limbo[(epoch + 1) % 3] = NULL;
+    __atomic_store_n(&global_epoch, epoch + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/**
+ * @brief Entra in una sezione di lettura: fino a epoch_exit la memoria raggiungibile in questo momento non viene liberata.
+ * Le sezioni di lettura non possono essere annidate.
+ * 
+ * @return int Se l'ingresso è avvenuto correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int epoch_enter () {
+    struct epoch_record* record = get_record();
+    ASSERT_RETURN(record != NULL, -1);
+    unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&record->state, (epoch << 1) | 1, __ATOMIC_RELAXED);
+    // Il fence rende visibile l'ingresso agli scrittori prima di qualunque lettura della struttura dati
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return 0;
+}
+
+/**
+ * @brief Esce dalla sezione di lettura del thread corrente
+ */
+void epoch_exit () {
+    struct epoch_record* record = (struct epoch_record*) pthread_getspecific(record_key);
+    if (record != NULL) __atomic_store_n(&record->state, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Affida un oggetto già staccato dalla struttura dati alla libreria, che lo libera quando nessun lettore può più vederlo.
+ * Non si blocca mai, così che possa essere chiamata da uno scrittore mentre il contatore di sequenza è dispari e i lettori
+ * lo aspettano: se la libreria non riesce a memorizzarlo l'oggetto non viene mai liberato e viene stampato un messaggio.
+ * 
+ * @param ptr Oggetto da liberare
+ * @param destructor Funzione che libera l'oggetto
+ */
+void epoch_retire (void* ptr, epoch_destructor_t destructor) {
+    if (ptr == NULL) return;
+    // Aspettare i lettori qui li bloccherebbe per sempre, perché possono essere fermi sul contatore di sequenza
+    // dello scrittore che sta chiamando: senza memoria per ricordarlo, l'oggetto viene lasciato allocato
+    struct retired* entry = (struct retired*) malloc(sizeof(struct retired));
+    ASSERT_MESSAGE_ERRNO(entry != NULL, "[epoch] Retiring object, leaking it", ENOMEM, return);
+    entry->ptr = ptr;
+    entry->destructor = destructor;
+    LOCK_ACQUIRE(&retire_mutex, perror("[epoch] Retiring object, leaking it"); free(entry); return);
+    unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+    entry->next = limbo[epoch % 3];
+    limbo[epoch % 3] = entry;
+    // Prova ad avanzare l'epoca, così che gli oggetti vengano liberati man mano che gli scrittori lavorano
+    try_advance();
+    LOCK_RELEASE(&retire_mutex, return);
+}
+
+/**
+ * @brief Aspetta che i lettori attivi escano e libera tutti gli oggetti affidati alla libreria
+ */
+void epoch_synchronize () {
+    LOCK_ACQUIRE(&retire_mutex, return);
+    // Tre avanzamenti svuotano tutte le liste
+    for (int advanced = 0; advanced < 3; )
+        if (try_advance()) advanced++;
+        else sched_yield();
+    LOCK_RELEASE(&retire_mutex, return);
+}
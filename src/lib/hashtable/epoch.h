@@ -0,0 +1,96 @@
+/**
+ * @file epoch.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria di recupero della memoria basato su epoche, usata dalle tabelle hash per permettere
+ * letture senza lock. Un lettore annuncia l'epoca globale in cui entra; la memoria staccata da uno scrittore viene
+ * liberata solo quando tutti i lettori attivi hanno visto l'epoca successiva a quella del distacco. Le epoche rendono sicuro
+ * l'accesso alla memoria; la coerenza di quello che il lettore ha visto è garantita da un contatore di sequenza.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_EPOCH)
+#define _EPOCH
+
+#include <sched.h>
+
+/**
+ * @brief Funzione che libera un oggetto staccato
+ */
+typedef void (*epoch_destructor_t) (void* ptr);
+
+/**
+ * @brief Entra in una sezione di lettura: fino a epoch_exit la memoria raggiungibile in questo momento non viene liberata.
+ * Le sezioni di lettura non possono essere annidate.
+ * 
+ * @return int Se l'ingresso è avvenuto correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int epoch_enter ();
+
+/**
+ * @brief Esce dalla sezione di lettura del thread corrente
+ */
+void epoch_exit ();
+
+/**
+ * @brief Affida un oggetto già staccato dalla struttura dati alla libreria, che lo libera quando nessun lettore può più vederlo.
+ * Non si blocca mai, così che possa essere chiamata da uno scrittore mentre il contatore di sequenza è dispari e i lettori
+ * lo aspettano: se la libreria non riesce a memorizzarlo l'oggetto non viene mai liberato e viene stampato un messaggio.
+ * 
+ * @param ptr Oggetto da liberare
+ * @param destructor Funzione che libera l'oggetto
+ */
+void epoch_retire (void* ptr, epoch_destructor_t destructor);
+
+/**
+ * @brief Aspetta che i lettori attivi escano e libera tutti gli oggetti affidati alla libreria
+ */
+void epoch_synchronize ();
+
+/**
+ * @brief Apre una scrittura protetta dal contatore di sequenza, che diventa dispari. Gli scrittori devono essere già in mutua esclusione.
+ * 
+ * @param sequence Contatore di sequenza della struttura dati
+ */
+static inline void sequence_write_begin (unsigned long* sequence) {
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Chiude una scrittura protetta dal contatore di sequenza, che torna pari
+ * 
+ * @param sequence Contatore di sequenza della struttura dati
+ */
+static inline void sequence_write_end (unsigned long* sequence) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Inizia una lettura senza lock, aspettando che non ci siano scritture in corso
+ * 
+ * @param sequence Contatore di sequenza della struttura dati
+ * @return unsigned long Valore del contatore da passare a sequence_read_retry
+ */
+static inline unsigned long sequence_read_begin (unsigned long* sequence) {
+    unsigned long value;
+    while ((value = __atomic_load_n(sequence, __ATOMIC_ACQUIRE)) & 1)
+        sched_yield();
+    return value;
+}
+
+/**
+ * @brief Controlla se la lettura iniziata con sequence_read_begin si è sovrapposta a una scrittura e va quindi ripetuta
+ * 
+ * @param sequence Contatore di sequenza della struttura dati
+ * @param value Valore restituito da sequence_read_begin
+ * @return int 1 se la lettura va ripetuta, 0 se è valida
+ */
+static inline int sequence_read_retry (unsigned long* sequence, unsigned long value) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(sequence, __ATOMIC_RELAXED) != value;
+}
+
+#endif // _EPOCH
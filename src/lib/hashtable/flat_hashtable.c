@@ -0,0 +1,383 @@
+/**
+ * @file flat_hashtable.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione a indirizzamento aperto della tabella hash di coppie (intero, stringa). Gli slot sono divisi in gruppi
+ * di 16, visitati con sondaggio triangolare: in ogni gruppo i byte di controllo uguali ai 7 bit alti dell'hash indicano gli
+ * unici slot di cui confrontare la chiave, e la presenza di uno slot vuoto indica che la chiave non è nella tabella.
+ * Come nella tabella a liste gli scrittori sono in mutua esclusione e i lettori non prendono lock: un lettore ripete la
+ * ricerca se il contatore di sequenza è cambiato, e valori e array sostituiti vengono liberati con le epoche.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <assertmacros.h>
+#include <mutexmacros.h>
+
+#include <hashtable/epoch.h>
+#include <hashtable/flat_hashtable.h>
+
+// La tabella viene ricostruita quando gli slot occupati o liberati superano i 7/8 della capacità
+#define FLAT_MAX_LOAD_NUM 7
+#define FLAT_MAX_LOAD_DEN 8
+
+/**
+ * @brief Array della tabella: capacità (potenza di 2), slot e byte di controllo, allocati insieme così che un lettore
+ * non possa vedere la capacità di un array e gli slot di un altro
+ */
+struct flat_array {
+    unsigned int capacity;
+    signed char* ctrl;
+    struct flat_slot slots[];
+};
+
+/**
+ * @brief Tabella a indirizzamento aperto con numero di elementi e di slot liberati, array corrente, contatore di sequenza
+ * e lock degli scrittori
+ */
+struct hashtable {
+    int elements;
+    unsigned int deleted;
+    struct flat_array* array;
+    unsigned long sequence;
+    pthread_mutex_t mutex;
+};
+
+/**
+ * @brief Funzione hash che mescola tutti i bit della chiave (finalizzatore di MurmurHash3)
+ * 
+ * @param key Chiave di cui calcolare l'hash
+ * @return unsigned int Hash della chiave
+ */
+static unsigned int hash_function (int key) {
+    unsigned int hash = (unsigned int) key;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/**
+ * @brief Calcola la maschera dei byte di un gruppo uguali a value: il bit i è acceso se ctrl[i] == value.
+ * 
+ * @param group Primo byte di controllo del gruppo
+ * @param value Valore da cercare
+ * @return unsigned int Maschera di 16 bit degli slot che corrispondono
+ */
+static inline unsigned int match_group (const signed char* group, signed char value) {
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+    return (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+    unsigned int mask = 0;
+    for (int i = 0; i < FLAT_GROUP_SIZE; i++)
+        if (group[i] == value) mask |= 1U << i;
+    return mask;
+#endif
+}
+
+/**
+ * @brief Calcola la maschera degli slot liberi di un gruppo, cioè vuoti o liberati (gli unici con il bit alto acceso)
+ * 
+ * @param group Primo byte di controllo del gruppo
+ * @return unsigned int Maschera di 16 bit degli slot liberi
+ */
+static inline unsigned int match_free (const signed char* group) {
+#if defined(__SSE2__)
+    return (unsigned int) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+#else
+    unsigned int mask = 0;
+    for (int i = 0; i < FLAT_GROUP_SIZE; i++)
+        if (group[i] < 0) mask |= 1U << i;
+    return mask;
+#endif
+}
+
+/**
+ * @brief Cerca lo slot che contiene la chiave. Va chiamata con la lock della tabella, oppure senza in una sezione di lettura
+ * delle epoche: in questo caso il risultato è valido solo se la lettura non si è sovrapposta a una scrittura.
+ * 
+ * @param array Array in cui cercare
+ * @param key Chiave da cercare
+ * @param hash Hash della chiave
+ * @return long Indice dello slot della chiave. Se la chiave non è presente restituisce -1.
+ */
+static long find_slot (struct flat_array* array, int key, unsigned int hash) {
+    unsigned int groups = array->capacity / FLAT_GROUP_SIZE;
+    unsigned int group = hash & (groups - 1);
+    signed char tag = (signed char) (hash >> 25);
+    // Il sondaggio triangolare visita tutti i gruppi, dato che il loro numero è una potenza di 2
+    for (unsigned int probe = 1; probe <= groups; probe++) {
+        const signed char* ctrl = array->ctrl + group * FLAT_GROUP_SIZE;
+        unsigned int mask = match_group(ctrl, tag);
+        // Gli slot vengono scritti prima del loro byte di controllo, quindi vanno letti dopo
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        while (mask) {
+            unsigned int index = group * FLAT_GROUP_SIZE + __builtin_ctz(mask);
+            if (array->slots[index].key == key) return index;
+            mask &= mask - 1;
+        }
+        // Se il gruppo ha uno slot vuoto la chiave non è stata inserita più avanti
+        if (match_group(ctrl, FLAT_CTRL_EMPTY)) return -1;
+        group = (group + probe) & (groups - 1);
+    }
+    return -1;
+}
+
+/**
+ * @brief Cerca il primo slot libero nella sequenza di sondaggio dell'hash. Va chiamata con la lock della tabella,
+ * che deve avere almeno uno slot libero.
+ * 
+ * @param ctrl Byte di controllo della tabella
+ * @param capacity Capacità della tabella
+ * @param hash Hash della chiave da inserire
+ * @return unsigned int Indice dello slot libero
+ */
+static unsigned int find_free (const signed char* ctrl, unsigned int capacity, unsigned int hash) {
+    unsigned int groups = capacity / FLAT_GROUP_SIZE;
+    unsigned int group = hash & (groups - 1);
+    for (unsigned int probe = 1; ; probe++) {
+        unsigned int mask = match_free(ctrl + group * FLAT_GROUP_SIZE);
+        if (mask) return group * FLAT_GROUP_SIZE + __builtin_ctz(mask);
+        group = (group + probe) & (groups - 1);
+    }
+}
+
+/**
+ * @brief Alloca un array con tutti gli slot vuoti
+ * 
+ * @param capacity Capacità dell'array (potenza di 2, multiplo di FLAT_GROUP_SIZE)
+ * @return struct flat_array* Array appena creato. Se c'è un errore restituisce NULL e setta errno.
+ */
+static struct flat_array* create_array (unsigned int capacity) {
+    // I byte di controllo sono allocati subito dopo gli slot
+    struct flat_array* array = (struct flat_array*) malloc(sizeof(struct flat_array) + capacity * (sizeof(struct flat_slot) + 1));
+    ASSERT_ERRNO_RETURN(array != NULL, ENOMEM, NULL);
+    array->capacity = capacity;
+    array->ctrl = (signed char*) (array->slots + capacity);
+    memset(array->ctrl, FLAT_CTRL_EMPTY, capacity);
+    return array;
+}
+
+/**
+ * @brief Ricostruisce la tabella con la capacità indicata, eliminando gli slot liberati. Il nuovo array viene pubblicato
+ * solo quando è completo, e il vecchio viene liberato quando nessun lettore lo sta più leggendo. Va chiamata con la lock della tabella.
+ * 
+ * @param table Tabella da ricostruire
+ * @param capacity Nuova capacità, sufficiente a contenere tutti gli elementi
+ * @return int Se la tabella è stata ricostruita restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int resize (hashtable_t* table, unsigned int capacity) {
+    struct flat_array* old = table->array;
+    struct flat_array* array = create_array(capacity);
+    ASSERT_RETURN(array != NULL, -1);
+    // Reinserisce gli elementi, che sono tutti distinti
+    for (unsigned int i = 0; i < old->capacity; i++) {
+        if (old->ctrl[i] < 0) continue;
+        unsigned int hash = hash_function(old->slots[i].key);
+        unsigned int index = find_free(array->ctrl, capacity, hash);
+        array->ctrl[index] = (signed char) (hash >> 25);
+        array->slots[index] = old->slots[i];
+    }
+    // Sostituisce il vecchio array
+    __atomic_store_n(&table->array, array, __ATOMIC_RELEASE);
+    table->deleted = 0;
+    epoch_retire(old, free);
+    return 0;
+}
+
+/**
+ * @brief Crea una tabella hash
+ * 
+ * @return hashtable_t* Tabella appena creata. Se c'è un errore restituisce NULL e setta errno.
+ */
+hashtable_t* create_hashtable () {
+    // Inizializza la struttura dati della tabella
+    hashtable_t* table = (hashtable_t*) calloc(1, sizeof(hashtable_t));
+    ASSERT_ERRNO_RETURN(table != NULL, ENOMEM, NULL);
+    // Alloca l'array con tutti gli slot vuoti
+    table->array = create_array(FLAT_MIN_CAPACITY);
+    ASSERT(table->array != NULL, free(table); return NULL);
+    // Inizializza la lock degli scrittori
+    int success = pthread_mutex_init(&(table->mutex), NULL);
+    ASSERT_ERRNO(success == 0, success, free(table->array); free(table); return NULL);
+    // Restituisce la tabella
+    return table;
+}
+
+/**
+ * @brief Libera la memoria occupata dalla tabella passata. Non ci devono essere operazioni in corso sulla tabella.
+ * 
+ * @param table Tabella da eliminare
+ * @return int Se l'eliminazione è avvenuta correttamente restituisce 1. Se c'è un errore restituisce -1 e setta errno.
+ */
+int destroy_hashtable (hashtable_t* table) {
+    // Controlla che la tabella esista
+    ASSERT_ERRNO_RETURN(table != NULL, EINVAL, -1);
+    // Libera i valori degli slot occupati e l'array
+    struct flat_array* array = table->array;
+    for (unsigned int i = 0; i < array->capacity; i++)
+        if (array->ctrl[i] >= 0) free(array->slots[i].value);
+    free(array);
+    // Libera quello che la tabella aveva già staccato
+    epoch_synchronize();
+    // Elimina la lock
+    int success = pthread_mutex_destroy(&(table->mutex));
+    ASSERT_ERRNO_RETURN(success == 0, success, -1);
+    // Libera tutta la struttura dati
+    free(table);
+    // Restituisce il successo
+    return 1;
+}
+
+/**
+ * @brief Inserisce in mutua esclusione un nuovo elemento nella tabella hash
+ * 
+ * @param table Tabella in cui inserire l'elemento
+ * @param key Chiave che identifica l'elemento
+ * @param value Valore associato all'elemento
+ * @return int Se l'elemento è stato inserito con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno (EALREADY se un elemento con la stessa chiave esiste già).
+ */
+int insert_hashtable (hashtable_t* table, int key, char* value) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((table != NULL) && (key > -1) && (value != NULL), EINVAL, -1)
+    unsigned int hash = hash_function(key);
+    // Copia il valore fuori dalla sezione critica
+    char* copy = strdup(value);
+    ASSERT_ERRNO_RETURN(copy != NULL, ENOMEM, -1);
+    // Prende la lock degli scrittori e apre la scrittura per i lettori
+    LOCK_ACQUIRE(&(table->mutex), free(copy); return -1);
+    sequence_write_begin(&table->sequence);
+    int success = 0;
+    if (find_slot(table->array, key, hash) != -1) {
+        // Come nella tabella a liste, una chiave già presente è un errore
+        errno = EALREADY;
+        success = -1;
+    }
+    else if ((table->elements + table->deleted + 1) * FLAT_MAX_LOAD_DEN > table->array->capacity * FLAT_MAX_LOAD_NUM) {
+        // Se gli slot liberati sono molti basta ricostruire la tabella della stessa capacità, altrimenti la raddoppia
+        unsigned int capacity = table->array->capacity;
+        if ((table->elements + 1) * 2 * FLAT_MAX_LOAD_DEN > capacity * FLAT_MAX_LOAD_NUM) capacity *= 2;
+        success = resize(table, capacity);
+    }
+    if (success == 0) {
+        struct flat_array* array = table->array;
+        unsigned int index = find_free(array->ctrl, array->capacity, hash);
+        if (array->ctrl[index] == FLAT_CTRL_DELETED) table->deleted--;
+        // Scrive lo slot prima di pubblicarlo con il byte di controllo
+        array->slots[index].key = key;
+        array->slots[index].value = copy;
+        __atomic_store_n(&array->ctrl[index], (signed char) (hash >> 25), __ATOMIC_RELEASE);
+        table->elements++;
+    }
+    // Chiude la scrittura e rilascia la lock senza perdere l'eventuale errore dell'operazione
+    sequence_write_end(&table->sequence);
+    int error = errno;
+    LOCK_RELEASE(&(table->mutex), return -1);
+    errno = error;
+    if (success == -1) free(copy);
+    // Restituisce il successo dell'operazione
+    return success;
+}
+
+/**
+ * @brief Rimuove in mutua esclusione un elemento dalla tabella
+ * 
+ * @param table Tabella da cui rimuovere l'elemento
+ * @param key Chiave che identifica l'elemento
+ * @return int Se la rimozione è avvenuta con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int remove_hashtable (hashtable_t* table, int key) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((table != NULL) && (key > -1), EINVAL, -1);
+    unsigned int hash = hash_function(key);
+    // Prende la lock degli scrittori e apre la scrittura per i lettori
+    LOCK_ACQUIRE(&(table->mutex), return -1);
+    sequence_write_begin(&table->sequence);
+    struct flat_array* array = table->array;
+    long index = find_slot(array, key, hash);
+    if (index != -1) {
+        // Il valore può essere ancora letto da un lettore
+        epoch_retire(array->slots[index].value, free);
+        // Se il gruppo ha ancora uno slot vuoto nessuna ricerca lo ha mai attraversato, quindi lo slot torna vuoto
+        const signed char* group = array->ctrl + (index & ~(long) (FLAT_GROUP_SIZE - 1));
+        if (match_group(group, FLAT_CTRL_EMPTY)) array->ctrl[index] = FLAT_CTRL_EMPTY;
+        else {
+            array->ctrl[index] = FLAT_CTRL_DELETED;
+            table->deleted++;
+        }
+        table->elements--;
+    }
+    // Chiude la scrittura e rilascia la lock
+    sequence_write_end(&table->sequence);
+    LOCK_RELEASE(&(table->mutex), return -1);
+    // Restituisce il successo dell'operazione
+    ASSERT_ERRNO_RETURN(index != -1, ENOKEY, -1);
+    return 0;
+}
+
+/**
+ * @brief Copia nel buffer il valore associato alla chiave nella tabella. La lettura non prende lock: se si sovrappone
+ * a una scrittura viene ripetuta.
+ * 
+ * @param table Tabella da cui recuperare l'elemento
+ * @param key Chiave che identifica l'elemento
+ * @param buffer Buffer in cui copiare il valore, terminato da \0
+ * @param size Dimensione del buffer
+ * @return int Se il valore è stato copiato restituisce 0. Se c'è un errore restituisce -1 e setta errno (ENOKEY se la chiave non è presente, ERANGE se il buffer è troppo piccolo).
+ */
+int retrieve_hashtable (hashtable_t* table, int key, char* buffer, size_t size) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((table != NULL) && (key > -1) && (buffer != NULL), EINVAL, -1);
+    unsigned int hash = hash_function(key);
+    // Entra in una sezione di lettura, così che niente di quello che legge venga liberato
+    ASSERT_RETURN(epoch_enter() == 0, -1);
+    int result;
+    unsigned long sequence;
+    do {
+        sequence = sequence_read_begin(&table->sequence);
+        struct flat_array* array = __atomic_load_n(&table->array, __ATOMIC_ACQUIRE);
+        long index = find_slot(array, key, hash);
+        result = ENOKEY;
+        if (index != -1) {
+            // Copia il valore, che non viene mai modificato dopo l'inserimento
+            const char* value = array->slots[index].value;
+            result = ERANGE;
+            for (size_t i = 0; i < size; i++)
+                if ((buffer[i] = value[i]) == '\0') {
+                    result = 0;
+                    break;
+                }
+        }
+    } while (sequence_read_retry(&table->sequence, sequence));
+    epoch_exit();
+    // Restituisce l'esito della ricerca
+    ASSERT_ERRNO_RETURN(result == 0, result, -1);
+    return 0;
+}
+
+/**
+ * @brief Restituisce il numero di elementi nella tabella
+ * 
+ * @param table Tabella di cui contare gli elementi
+ * @return int Numero di elementi nella tabella. Se c'è un errore restituisce -1 e setta errno.
+ */
+int size_hashtable (hashtable_t* table) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN(table != NULL, EINVAL, -1);
+    // Il contatore è modificato solo dagli scrittori, basta leggerlo atomicamente
+    return __atomic_load_n(&table->elements, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,39 @@
+/**
+ * @file flat_hashtable.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header dell'implementazione a indirizzamento aperto della tabella hash di hashtable.h, nello stile delle Swiss table.
+ * Le coppie (chiave, valore) sono memorizzate direttamente in un array di slot, affiancato da un array di byte di controllo
+ * che vengono confrontati 16 alla volta (con SSE2 se disponibile) per trovare gli slot candidati senza leggere le chiavi.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_FLAT_HASHTABLE)
+#define _FLAT_HASHTABLE
+
+#include <hashtable/hashtable.h>
+
+// Numero di slot di un gruppo, cioè di byte di controllo confrontati insieme
+#define FLAT_GROUP_SIZE 16
+
+// Numero minimo di slot della tabella (potenza di 2, multiplo di FLAT_GROUP_SIZE)
+#define FLAT_MIN_CAPACITY 16
+
+// Byte di controllo di uno slot mai usato: ferma la ricerca di una chiave
+#define FLAT_CTRL_EMPTY ((signed char) -128)
+
+// Byte di controllo di uno slot liberato: la ricerca di una chiave deve proseguire oltre
+#define FLAT_CTRL_DELETED ((signed char) -2)
+
+// Gli slot occupati hanno come byte di controllo i 7 bit alti dell'hash (tra 0 e 127)
+
+/**
+ * @brief Slot della tabella, con la chiave e il valore memorizzati direttamente nell'array
+ */
+struct flat_slot {
+    int key;
+    char* value;
+};
+
+#endif // _FLAT_HASHTABLE
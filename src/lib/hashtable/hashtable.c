@@ -2,7 +2,10 @@
  * @file hashtable.c
  * @author Giacomo Mariani, Matricola 545519, Corso B
  * @brief Implementazione della libreria di creazione e gestione di una tabella hash di coppie (stringa, intero),
- * memorizzata con liste di trabocco.
+ * memorizzata con liste di trabocco. La tabella cresce e si restringe in base al fattore di carico, spostando le liste
+ * nel nuovo array poche alla volta ad ogni scrittura. Gli scrittori sono in mutua esclusione e incrementano il contatore
+ * di sequenza della tabella; i lettori non prendono lock e ripetono la ricerca se si è sovrapposta a una scrittura.
+ * Nodi, liste e array staccati vengono liberati con le epoche, quando nessun lettore può più raggiungerli.
  * 
  * Si dichiara che tutto il codice è stato realizzato dallo studente.
  * 
@@ -16,23 +19,245 @@
 #include <mutexmacros.h>
 
 #include <hashtable/pair_list.h>
+#include <hashtable/epoch.h>
 
 #include <hashtable/hashtable.h>
 
-#define HASHTABLE_SIZE 100
-#define MUTEX_NUMBER 16
+/**
+ * @brief Array di liste di trabocco, allocato insieme alla sua dimensione così che un lettore non possa vedere
+ * la dimensione di un array e le caselle di un altro
+ */
+struct bucket_array {
+    unsigned int size;
+    pair_list_t* buckets[];
+};
+
+/**
+ * @brief Tabella hash con numero di elementi e due array di liste di trabocco: arrays[0] è l'array corrente, arrays[1] quello
+ * in cui si stanno spostando le liste durante un ridimensionamento. Le caselle di arrays[0] con indice minore di rehash_index sono
+ * già state spostate; se rehash_index vale -1 non c'è un ridimensionamento in corso.
+ */
+struct hashtable {
+    int elements;
+    struct bucket_array* arrays[2];
+    long rehash_index;
+    unsigned long sequence;
+    pthread_mutex_t mutex;
+};
 
-// Array di lock che partizionano l'accesso alla tabella
-static pthread_mutex_t mutexes[MUTEX_NUMBER];
+// Numero minimo di caselle della tabella (potenza di 2)
+#define HASHTABLE_MIN_SIZE 16
+// La tabella raddoppia quando ha più elementi che caselle
+#define HASHTABLE_MAX_LOAD 1
+// La tabella si dimezza quando ha meno di un elemento ogni 8 caselle
+#define HASHTABLE_MIN_LOAD_INVERSE 8
+// Numero di caselle non vuote spostate nel nuovo array ad ogni scrittura
+#define REHASH_STEPS 4
+// Numero massimo di caselle vuote visitate per ogni casella da spostare
+#define REHASH_EMPTY_VISITS 10
 
 /**
- * @brief Semplice funzione hash
+ * @brief Funzione hash che mescola tutti i bit della chiave (finalizzatore di MurmurHash3), così che le chiavi consecutive
+ * come i file descriptor si distribuiscano anche usando solo i bit bassi dell'hash.
  * 
  * @param key Chiave di cui calcolare l'hash
- * @return int Hash della chiave
+ * @return unsigned int Hash della chiave
+ */
+static unsigned int hash_function (int key) {
+    unsigned int hash = (unsigned int) key;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/**
+ * @brief Alloca un array di caselle vuote
+ * 
+ * @param size Numero di caselle (potenza di 2)
+ * @return struct bucket_array* Array appena creato. Se c'è un errore restituisce NULL e setta errno.
+ */
+static struct bucket_array* create_array (unsigned int size) {
+    // Le liste vengono create solo quando servono
+    struct bucket_array* array = (struct bucket_array*) calloc(1, sizeof(struct bucket_array) + size * sizeof(pair_list_t*));
+    ASSERT_ERRNO_RETURN(array != NULL, ENOMEM, NULL);
+    array->size = size;
+    return array;
+}
+
+/**
+ * @brief Distruttore per le epoche di una lista staccata dalla tabella
+ * 
+ * @param ptr Lista da distruggere
+ */
+static void retired_list_destructor (void* ptr) {
+    destroy_list((pair_list_t*) ptr);
+}
+
+/**
+ * @brief Distruttore per le epoche di un nodo staccato dalla tabella
+ * 
+ * @param ptr Nodo da distruggere
  */
-static int hash_function (int key) {
-    return (key * 31 + 11) % HASHTABLE_SIZE;
+static void retired_node_destructor (void* ptr) {
+    destroy_node((struct node*) ptr);
+}
+
+/**
+ * @brief Trova la casella che contiene la chiave, guardando nel nuovo array se la casella del vecchio è già stata spostata.
+ * Va chiamata con la lock della tabella.
+ * 
+ * @param table Tabella in cui cercare
+ * @param key Chiave da cercare
+ * @return pair_list_t** Puntatore alla casella della chiave, che può contenere NULL se la lista non è ancora stata creata
+ */
+static pair_list_t** get_bucket (hashtable_t* table, int key) {
+    unsigned int hash = hash_function(key);
+    unsigned int index = hash & (table->arrays[0]->size - 1);
+    if ((table->rehash_index != -1) && (index < table->rehash_index))
+        return &(table->arrays[1]->buckets[hash & (table->arrays[1]->size - 1)]);
+    return &(table->arrays[0]->buckets[index]);
+}
+
+/**
+ * @brief Restituisce la lista della casella, creandola e pubblicandola per i lettori se non esiste. Va chiamata con la lock della tabella.
+ * 
+ * @param bucket Casella della lista
+ * @return pair_list_t* Lista della casella. Se c'è un errore restituisce NULL e setta errno.
+ */
+static pair_list_t* get_or_create_list (pair_list_t** bucket) {
+    if (*bucket == NULL) {
+        pair_list_t* list = create_list();
+        ASSERT_RETURN(list != NULL, NULL);
+        __atomic_store_n(bucket, list, __ATOMIC_RELEASE);
+    }
+    return *bucket;
+}
+
+/**
+ * @brief Inizia lo spostamento delle liste in un nuovo array della dimensione indicata. Va chiamata con la lock della tabella.
+ * 
+ * @param table Tabella da ridimensionare
+ * @param size Nuova dimensione (potenza di 2)
+ * @return int Se il ridimensionamento è iniziato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int start_rehash (hashtable_t* table, unsigned int size) {
+    struct bucket_array* array = create_array(size);
+    ASSERT_RETURN(array != NULL, -1);
+    __atomic_store_n(&table->arrays[1], array, __ATOMIC_RELEASE);
+    __atomic_store_n(&table->rehash_index, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief Sposta una casella del vecchio array nel nuovo. Le liste di destinazione vengono create prima di spostare i nodi, così
+ * che in caso di errore la casella rimanga intatta. Va chiamata con la lock della tabella.
+ * 
+ * @param table Tabella in ridimensionamento
+ * @param list Lista da spostare
+ * @return int Se la casella è stata spostata restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int move_bucket (hashtable_t* table, pair_list_t* list) {
+    struct bucket_array* target = table->arrays[1];
+    unsigned int mask = target->size - 1;
+    // Crea le liste di destinazione mancanti
+    for (struct node* current = list->head; current != NULL; current = current->next)
+        ASSERT_RETURN(get_or_create_list(&(target->buckets[hash_function(current->key) & mask])) != NULL, -1);
+    // Sposta i nodi senza copiarli
+    struct node* current;
+    while ((current = remove_head(list)) != NULL)
+        push_node(target->buckets[hash_function(current->key) & mask], current);
+    return 0;
+}
+
+/**
+ * @brief Esegue un passo del ridimensionamento spostando al più REHASH_STEPS caselle non vuote, e se ha spostato l'ultima
+ * sostituisce il vecchio array con il nuovo. Va chiamata con la lock della tabella e dentro una scrittura.
+ * 
+ * @param table Tabella da ridimensionare
+ */
+static void rehash_step (hashtable_t* table) {
+    if (table->rehash_index == -1) return;
+    struct bucket_array* old = table->arrays[0];
+    int steps = REHASH_STEPS;
+    int empty_visits = REHASH_STEPS * REHASH_EMPTY_VISITS;
+    while ((steps > 0) && (table->rehash_index < old->size)) {
+        pair_list_t** bucket = &(old->buckets[table->rehash_index]);
+        if ((*bucket != NULL) && ((*bucket)->elements > 0)) {
+            // In caso di errore riprova al prossimo passo
+            ASSERT(move_bucket(table, *bucket) == 0, return);
+            steps--;
+        }
+        else if (--empty_visits == 0) steps = 0;
+        // La lista ormai vuota può essere ancora attraversata da un lettore
+        epoch_retire(*bucket, retired_list_destructor);
+        *bucket = NULL;
+        __atomic_store_n(&table->rehash_index, table->rehash_index + 1, __ATOMIC_RELEASE);
+    }
+    // Se ha finito di spostare le caselle il nuovo array prende il posto del vecchio
+    if (table->rehash_index == old->size) {
+        __atomic_store_n(&table->arrays[0], table->arrays[1], __ATOMIC_RELEASE);
+        __atomic_store_n(&table->rehash_index, -1, __ATOMIC_RELEASE);
+        __atomic_store_n(&table->arrays[1], NULL, __ATOMIC_RELEASE);
+        epoch_retire(old, free);
+    }
+}
+
+/**
+ * @brief Avvia, se serve, un ridimensionamento in base al fattore di carico. Va chiamata con la lock della tabella.
+ * 
+ * @param table Tabella da controllare
+ */
+static void check_load (hashtable_t* table) {
+    if (table->rehash_index != -1) return;
+    unsigned int size = table->arrays[0]->size;
+    // Se la memoria non basta la tabella rimane della dimensione corrente
+    if (table->elements > size * HASHTABLE_MAX_LOAD)
+        start_rehash(table, size * 2);
+    else if ((size > HASHTABLE_MIN_SIZE) && (table->elements < size / HASHTABLE_MIN_LOAD_INVERSE))
+        start_rehash(table, size / 2);
+}
+
+/**
+ * @brief Cerca la chiave e ne copia il valore senza prendere lock. Va chiamata in una sezione di lettura delle epoche:
+ * il risultato è valido solo se la lettura non si è sovrapposta a una scrittura.
+ * 
+ * @param table Tabella in cui cercare
+ * @param key Chiave da cercare
+ * @param buffer Buffer in cui copiare il valore
+ * @param size Dimensione del buffer
+ * @return int 0 se ha copiato il valore, ENOKEY se la chiave non è presente, ERANGE se il buffer è troppo piccolo,
+ * EAGAIN se la lettura va ripetuta
+ */
+static int lookup_copy (hashtable_t* table, int key, char* buffer, size_t size) {
+    unsigned int hash = hash_function(key);
+    // Gli array letti possono essere incoerenti tra loro, ma sono tutti ancora allocati
+    struct bucket_array* array = __atomic_load_n(&table->arrays[0], __ATOMIC_ACQUIRE);
+    long rehash_index = __atomic_load_n(&table->rehash_index, __ATOMIC_ACQUIRE);
+    struct bucket_array* target = __atomic_load_n(&table->arrays[1], __ATOMIC_ACQUIRE);
+    unsigned int index = hash & (array->size - 1);
+    if ((rehash_index != -1) && (index < rehash_index) && (target != NULL)) {
+        array = target;
+        index = hash & (array->size - 1);
+    }
+    pair_list_t* list = __atomic_load_n(&(array->buckets[index]), __ATOMIC_ACQUIRE);
+    if (list == NULL) return ENOKEY;
+    // Scorre la lista fino alla chiave. Se una scrittura sposta i nodi il percorso può allungarsi: quando supera il numero
+    // di elementi la lettura è sicuramente da ripetere
+    int visited = 0;
+    struct node* current = __atomic_load_n(&list->head, __ATOMIC_ACQUIRE);
+    for (; current != NULL; current = __atomic_load_n(&current->next, __ATOMIC_ACQUIRE)) {
+        if (++visited > __atomic_load_n(&table->elements, __ATOMIC_RELAXED) + 1) return EAGAIN;
+        if (current->key != key) continue;
+        // Copia il valore, che non viene mai modificato dopo l'inserimento
+        const char* value = current->value;
+        for (size_t i = 0; i < size; i++)
+            if ((buffer[i] = value[i]) == '\0') return 0;
+        return ERANGE;
+    }
+    return ENOKEY;
 }
 
 /**
@@ -44,19 +269,15 @@ hashtable_t* create_hashtable () {
     // Inizializza la struttura dati della tabella
     hashtable_t* table = (hashtable_t*) malloc(sizeof(hashtable_t));
     ASSERT_RETURN(table != NULL, NULL);
-    // Inizializza l'array delle liste di trabocco
-    table->entries = (pair_list_t**) calloc(HASHTABLE_SIZE, sizeof(pair_list_t*));
-    ASSERT_ERRNO(table->entries != NULL, ENOMEM, free(table); return NULL);
-    for (int i = 0; i < HASHTABLE_SIZE; i++) {
-        table->entries[i] = create_list();
-        ASSERT(table->entries[i] != NULL, free(table); return NULL);
-    }
-    // Inizializza le variabili di condizione
-    int success;
-    for (int i = 0; i < MUTEX_NUMBER; i++) {
-        success = pthread_mutex_init(&mutexes[i], NULL);
-        ASSERT_ERRNO(success == 0, success, destroy_hashtable(table); return NULL);
-    }
+    // Inizializza l'array delle liste di trabocco, le cui liste vengono create solo quando servono
+    table->arrays[0] = create_array(HASHTABLE_MIN_SIZE);
+    ASSERT(table->arrays[0] != NULL, free(table); return NULL);
+    table->arrays[1] = NULL;
+    table->rehash_index = -1;
+    table->sequence = 0;
+    // Inizializza la lock degli scrittori
+    int success = pthread_mutex_init(&(table->mutex), NULL);
+    ASSERT_ERRNO(success == 0, success, free(table->arrays[0]); free(table); return NULL);
     // Inizializza i campi della tabella
     table->elements = 0;
     // Restituisce la tabella
@@ -64,7 +285,7 @@ hashtable_t* create_hashtable () {
 }
 
 /**
- * @brief Libera la memoria occupata dalla tabella passata
+ * @brief Libera la memoria occupata dalla tabella passata. Non ci devono essere operazioni in corso sulla tabella.
  * 
  * @param table Tabella da eliminare
  * @return int Se l'eliminazione è avvenuta correttamente restituisce 1. Se c'è un errore restituisce -1 e setta errno.
@@ -72,19 +293,22 @@ hashtable_t* create_hashtable () {
 int destroy_hashtable (hashtable_t* table) {
     // Controlla che la tabella esista
     ASSERT_ERRNO_RETURN(table != NULL, EINVAL, -1);
-    // Elimina tutte le liste di trabocco
+    // Elimina tutte le liste di trabocco di entrambi gli array
     int success;
-    for (int i = 0; i < HASHTABLE_SIZE; i++)
-        if (table->entries[i]) {
-            success = destroy_list(table->entries[i]);
-            ASSERT_RETURN(success != -1, -1);
-        }
-    free(table->entries);
-    // Elimina le vaiabili di condizione
-    for (int i = 0; i < 16; i++) {
-        success = pthread_mutex_destroy(&mutexes[i]);
-        ASSERT_ERRNO_RETURN(success == 0, success, -1);
+    for (int t = 0; t < 2; t++) {
+        if (table->arrays[t] == NULL) continue;
+        for (unsigned int i = 0; i < table->arrays[t]->size; i++)
+            if (table->arrays[t]->buckets[i]) {
+                success = destroy_list(table->arrays[t]->buckets[i]);
+                ASSERT_RETURN(success != -1, -1);
+            }
+        free(table->arrays[t]);
     }
+    // Libera quello che la tabella aveva già staccato
+    epoch_synchronize();
+    // Elimina la lock
+    success = pthread_mutex_destroy(&(table->mutex));
+    ASSERT_ERRNO_RETURN(success == 0, success, -1);
     // Libera tutta la struttura dati
     free(table);
     // Restituisce il successo
@@ -97,22 +321,31 @@ int destroy_hashtable (hashtable_t* table) {
  * @param table Tabella in cui inserire l'elemento
  * @param key Chiave che identifica l'elemento
  * @param value Valore associato all'elemento
- * @return int Se l'elemento è stato inserito con successo restituisce 0. Se un elemento con la stessa chiave esiste già restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ * @return int Se l'elemento è stato inserito con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno (EALREADY se un elemento con la stessa chiave esiste già).
  */
 int insert_hashtable (hashtable_t* table, int key, char* value) {
     // Controlla la correttezza dei parametri
     ASSERT_ERRNO_RETURN((table != NULL) && (key > -1) && (value != NULL), EINVAL, -1)
-    // Calcola l'hash dell'elemento
-    int hash = hash_function(key);
-    // Prende la lock associata all'elemento
-    pthread_mutex_t mutex = mutexes[hash / MUTEX_NUMBER];
-    LOCK_ACQUIRE(&mutex, return -1);
-    // Inserisce, se esiste, l'elemento nella tabella
-    int success = insert_list(table->entries[hash], key, value);
-    // Incrementa il numero di elementi nella tabella
-    if (success == 0) table->elements++;
-    // Rilascia la lock
-    LOCK_RELEASE(&mutex, return -1);
+    // Prende la lock degli scrittori e apre la scrittura per i lettori
+    LOCK_ACQUIRE(&(table->mutex), return -1);
+    sequence_write_begin(&table->sequence);
+    // Porta avanti l'eventuale ridimensionamento in corso
+    rehash_step(table);
+    // Crea, se non esiste, la lista in cui inserire l'elemento
+    pair_list_t* list = get_or_create_list(get_bucket(table, key));
+    int success = -1;
+    if (list != NULL)
+        success = insert_list(list, key, value);
+    // Incrementa il numero di elementi nella tabella e controlla se deve crescere
+    if (success == 0) {
+        table->elements++;
+        check_load(table);
+    }
+    // Chiude la scrittura e rilascia la lock senza perdere l'eventuale errore dell'operazione
+    sequence_write_end(&table->sequence);
+    int error = errno;
+    LOCK_RELEASE(&(table->mutex), return -1);
+    errno = error;
     // Restituisce il successo dell'operazione
     return success;
 }
@@ -127,40 +360,68 @@ int insert_hashtable (hashtable_t* table, int key, char* value) {
 int remove_hashtable (hashtable_t* table, int key) {
     // Controlla la correttezza dei parametri
     ASSERT_ERRNO_RETURN((table != NULL) && (key > -1), EINVAL, -1);
-    // Calcola l'hash della chiave come indice della tabella
-    int hash = hash_function(key);
-    // Prende la lock associata all'elemento
-    pthread_mutex_t mutex = mutexes[hash / MUTEX_NUMBER];
-    LOCK_ACQUIRE(&mutex, return -1);
-    // Rimuove l'elemento nella lista
-    int success = remove_list(&(table->entries[hash]), key);
-    // Decrementa il numero di elementi nella tabella
-    if (success == 0) table->elements--;
-    // Rilascia la lock associata all'elemento
-    LOCK_RELEASE(&mutex, return -1);
-    // Restituisce il valore associato alla chiave nella lista
-    return success;
+    // Prende la lock degli scrittori e apre la scrittura per i lettori
+    LOCK_ACQUIRE(&(table->mutex), return -1);
+    sequence_write_begin(&table->sequence);
+    // Porta avanti l'eventuale ridimensionamento in corso
+    rehash_step(table);
+    // Stacca il nodo dalla lista, se questa esiste
+    pair_list_t* list = *get_bucket(table, key);
+    struct node* found = NULL;
+    errno = ENOKEY;
+    if (list != NULL)
+        found = detach_node(list, key);
+    // Il nodo può essere ancora attraversato da un lettore
+    if (found != NULL) {
+        epoch_retire(found, retired_node_destructor);
+        table->elements--;
+        check_load(table);
+    }
+    // Chiude la scrittura e rilascia la lock senza perdere l'eventuale errore dell'operazione
+    sequence_write_end(&table->sequence);
+    int error = errno;
+    LOCK_RELEASE(&(table->mutex), return -1);
+    errno = error;
+    // Restituisce il successo dell'operazione
+    return (found != NULL) ? 0 : -1;
 }
 
 /**
- * @brief Prende il valore associato alla chiave nella tabella.
+ * @brief Copia nel buffer il valore associato alla chiave nella tabella. La lettura non prende lock: se si sovrappone
+ * a una scrittura viene ripetuta.
  * 
  * @param table Tabella da cui recuperare l'elemento
  * @param key Chiave che identifica l'elemento
- * @return char* Valore associato alla chiave nella tabella. Se c'è un errore restituisce NULL e setta errno.
+ * @param buffer Buffer in cui copiare il valore, terminato da \0
+ * @param size Dimensione del buffer
+ * @return int Se il valore è stato copiato restituisce 0. Se c'è un errore restituisce -1 e setta errno (ENOKEY se la chiave non è presente, ERANGE se il buffer è troppo piccolo).
  */
-char* retrieve_hashtable (hashtable_t* table, int key) {
+int retrieve_hashtable (hashtable_t* table, int key, char* buffer, size_t size) {
     // Controlla la correttezza dei parametri
-    ASSERT_ERRNO_RETURN((table != NULL) && (key > -1), EINVAL, NULL);
-    // Calcola l'hash della chiave
-    int hash = hash_function(key);
-    // Recupera la lock associata alla lista
-    pthread_mutex_t mutex = mutexes[hash / MUTEX_NUMBER];
-    LOCK_ACQUIRE(&mutex, return NULL);
-    // Recupera l'elemento
-    char* value = get_value_list(table->entries[hash], key);
-    // Rilascia la lock
-    LOCK_RELEASE(&mutex, return NULL);
-    // Restituisce l'elemento, se esiste
-    return value;
-}
\ No newline at end of file
+    ASSERT_ERRNO_RETURN((table != NULL) && (key > -1) && (buffer != NULL), EINVAL, -1);
+    // Entra in una sezione di lettura, così che niente di quello che legge venga liberato
+    ASSERT_RETURN(epoch_enter() == 0, -1);
+    int result;
+    unsigned long sequence;
+    do {
+        sequence = sequence_read_begin(&table->sequence);
+        result = lookup_copy(table, key, buffer, size);
+    } while (sequence_read_retry(&table->sequence, sequence));
+    epoch_exit();
+    // Restituisce l'esito della ricerca
+    ASSERT_ERRNO_RETURN(result == 0, result, -1);
+    return 0;
+}
+
+/**
+ * @brief Restituisce il numero di elementi nella tabella
+ * 
+ * @param table Tabella di cui contare gli elementi
+ * @return int Numero di elementi nella tabella. Se c'è un errore restituisce -1 e setta errno.
+ */
+int size_hashtable (hashtable_t* table) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN(table != NULL, EINVAL, -1);
+    // Il contatore è modificato solo dagli scrittori, basta leggerlo atomicamente
+    return __atomic_load_n(&table->elements, __ATOMIC_RELAXED);
+}
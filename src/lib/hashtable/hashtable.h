@@ -1,8 +1,10 @@
 /**
  * @file hashtable.h
  * @author Giacomo Mariani, Matricola 545519, Corso B
- * @brief Header della libreria di creazione e gestione di una tabella hash di coppie (intero, stringa) memorizzata con liste di trabocco.
- * La libreria usa 16 lock per partizionare la tabella e garantire l'accesso in mutua esclusione alla tabella.
+ * @brief Header della libreria di creazione e gestione di una tabella hash di coppie (intero, stringa).
+ * L'implementazione di default è memorizzata con liste di trabocco; compilando con "make FLATHASH=1" si usa invece una tabella
+ * a indirizzamento aperto con chiavi e valori nello stesso array. In entrambe gli scrittori sono in mutua esclusione,
+ * mentre i lettori non prendono lock e la memoria staccata viene liberata con le epoche di epoch.h.
  * 
  * Si dichiara che tutto il codice è stato realizzato dallo studente.
  * 
@@ -12,15 +14,13 @@
 #if !defined(_HASHTABLE)
 #define _HASHTABLE
 
-#include <hashtable/pair_list.h>
+#include <stddef.h>
 
 /**
- * @brief Tabella hash con dimensione della tabella, numero di entries piene e array di liste di trabocco.
+ * @brief Tabella hash di coppie (intero, stringa). La struttura è definita dall'implementazione scelta in compilazione:
+ * quella con liste di trabocco (hashtable.c) o quella a indirizzamento aperto (flat_hashtable.c, con "make FLATHASH=1").
  */
-typedef struct hashtable {
-    int elements;
-    pair_list_t** entries;
-} hashtable_t;
+typedef struct hashtable hashtable_t;
 
 /**
  * @brief Crea una tabella hash
@@ -43,7 +43,7 @@ int destroy_hashtable (hashtable_t* table);
  * @param table Tabella in cui inserire l'elemento
  * @param key Chiave che identifica l'elemento
  * @param value Valore associato all'elemento
- * @return int Se l'elemento è stato inserito con successo restituisce 0. Se un elemento con la stessa chiave esiste già restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ * @return int Se l'elemento è stato inserito con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno (EALREADY se un elemento con la stessa chiave esiste già).
  */
 int insert_hashtable (hashtable_t* table, int key, char* value);
 
@@ -57,12 +57,23 @@ int insert_hashtable (hashtable_t* table, int key, char* value);
 int remove_hashtable (hashtable_t* table, int key);
 
 /**
- * @brief Prende il valore associato alla chiave nella tabella.
+ * @brief Copia nel buffer il valore associato alla chiave nella tabella. La lettura non prende lock: se si sovrappone
+ * a una scrittura viene ripetuta.
  * 
  * @param table Tabella da cui recuperare l'elemento
  * @param key Chiave che identifica l'elemento
- * @return char* Valore associato alla chiave nella tabella. Se c'è un errore restituisce NULL e setta errno.
+ * @param buffer Buffer in cui copiare il valore, terminato da \0
+ * @param size Dimensione del buffer
+ * @return int Se il valore è stato copiato restituisce 0. Se c'è un errore restituisce -1 e setta errno (ENOKEY se la chiave non è presente, ERANGE se il buffer è troppo piccolo).
  */
-char* retrieve_hashtable (hashtable_t* table, int key);
+int retrieve_hashtable (hashtable_t* table, int key, char* buffer, size_t size);
+
+/**
+ * @brief Restituisce il numero di elementi nella tabella
+ * 
+ * @param table Tabella di cui contare gli elementi
+ * @return int Numero di elementi nella tabella. Se c'è un errore restituisce -1 e setta errno.
+ */
+int size_hashtable (hashtable_t* table);
 
 #endif // _HASHTABLE
@@ -146,11 +146,11 @@ int insert_list (pair_list_t* list, int key, char* value) {
     // Crea un nuovo elemento
     struct node* new = create_node(key, value);
     ASSERT_RETURN(new != NULL, -1);
-    // Mette l'elemento in testa alla lista
+    // Mette l'elemento in testa alla lista, pubblicandolo solo dopo averlo inizializzato per i lettori senza lock
     new->next = list->head;
     if (list->head)
         list->head->prev = new;
-    list->head = new;
+    __atomic_store_n(&list->head, new, __ATOMIC_RELEASE);
     // Incrementa il contatore
     list->elements++;
     // Restituisce il successo
@@ -158,31 +158,103 @@ int insert_list (pair_list_t* list, int key, char* value) {
 }
 
 /**
- * @brief Rimuove il nodo identificato dalla chiave
+ * @brief Stacca dalla lista il nodo identificato dalla chiave senza liberarlo
  * 
- * @param list Puntatore alla testa della lista
+ * @param list Lista da cui staccare il nodo
  * @param key Chiave che identifica la coppia
- * @return int Se la rimozione è avvenuta con successo restituisce 0. Se c'è un errore restituisce NULL e setta errno.
+ * @return struct node* Nodo staccato. Se c'è un errore restituisce NULL e setta errno (ENOKEY se la chiave non è presente).
  */
-int remove_list (pair_list_t** list, int key) {
+struct node* detach_node (pair_list_t* list, int key) {
     // Controlla la correttezza dei parametri
-    ASSERT_ERRNO_RETURN(((*list) != NULL) && (key > -1), EINVAL, -1);
+    ASSERT_ERRNO_RETURN((list != NULL) && (key > -1), EINVAL, NULL);
     // Se la dimensione è 0 non c'è niente da rimuovere
-    ASSERT_ERRNO_RETURN((*list)->elements > 0, ENOKEY, -1);
+    ASSERT_ERRNO_RETURN(list->elements > 0, ENOKEY, NULL);
     // Cerca il nodo da rimuovere
-    struct node* found = get_node((*list)->head, key);
-    ASSERT_RETURN(found != NULL, 0);
+    struct node* found = get_node(list->head, key);
+    ASSERT_ERRNO_RETURN(found != NULL, ENOKEY, NULL);
     // Rimuove il nodo dalla coda
     if (found->prev) found->prev->next = found->next;
-    else (*list)->head = found->next;
+    else list->head = found->next;
     if (found->next) found->next->prev = found->prev;
     found->prev = found->next = NULL;
-    // Libera la memoria del nodo
-    destroy_nodes(found);
     // Decrementa il numero totale di nodi
-    (*list)->elements--;
+    list->elements--;
     // Se non ci sono più nodi invalida il riferimento alla lista
-    if ((*list)->elements == 0) (*list)->head = NULL;
+    if (list->elements == 0) list->head = NULL;
+    // Restituisce il nodo
+    return found;
+}
+
+/**
+ * @brief Libera un nodo staccato dalla lista e il suo valore
+ * 
+ * @param node Nodo da liberare
+ */
+void destroy_node (struct node* node) {
+    if (node == NULL) return;
+    free(node->value);
+    free(node);
+}
+
+/**
+ * @brief Rimuove il nodo identificato dalla chiave
+ * 
+ * @param list Puntatore alla testa della lista
+ * @param key Chiave che identifica la coppia
+ * @return int Se la rimozione è avvenuta con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno (ENOKEY se la chiave non è presente).
+ */
+int remove_list (pair_list_t** list, int key) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN(list != NULL, EINVAL, -1);
+    // Stacca il nodo dalla lista
+    struct node* found = detach_node(*list, key);
+    ASSERT_RETURN(found != NULL, -1);
+    // Libera la memoria del nodo
+    destroy_node(found);
     // Restituisce il successo dell'operazione
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Rimuove il nodo di testa della lista
+ * 
+ * @param list Lista da cui rimuovere la testa
+ * @return struct node* Nodo di testa della lista. Se c'è un errore restituisce NULL e setta errno.
+ */
+struct node* remove_head (pair_list_t* list) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN(list != NULL, EINVAL, NULL);
+    // Se la lista è vuota non c'è niente da rimuovere
+    ASSERT_ERRNO_RETURN(list->head != NULL, ENOKEY, NULL);
+    // Stacca la testa dal resto della lista
+    struct node* head = list->head;
+    list->head = head->next;
+    if (list->head) list->head->prev = NULL;
+    head->prev = head->next = NULL;
+    // Decrementa il numero totale di nodi
+    list->elements--;
+    // Restituisce il nodo staccato
+    return head;
+}
+
+/**
+ * @brief Inserisce in testa alla lista un nodo già allocato, senza copiarne il valore
+ * 
+ * @param list Lista in cui inserire il nodo
+ * @param node Nodo da inserire, staccato da qualunque altra lista
+ * @return int Se il nodo è stato inserito correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int push_node (pair_list_t* list, struct node* node) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((list != NULL) && (node != NULL), EINVAL, -1);
+    // Mette il nodo in testa alla lista
+    node->prev = NULL;
+    node->next = list->head;
+    if (list->head)
+        list->head->prev = node;
+    __atomic_store_n(&list->head, node, __ATOMIC_RELEASE);
+    // Incrementa il contatore
+    list->elements++;
+    // Restituisce il successo
+    return 0;
+}
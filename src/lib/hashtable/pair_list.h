@@ -60,12 +60,28 @@ char* get_value_list (pair_list_t* list, int key);
  */
 int insert_list (pair_list_t* list, int key, char* value);
 
+/**
+ * @brief Stacca dalla lista il nodo identificato dalla chiave senza liberarlo
+ * 
+ * @param list Lista da cui staccare il nodo
+ * @param key Chiave che identifica la coppia
+ * @return struct node* Nodo staccato. Se c'è un errore restituisce NULL e setta errno (ENOKEY se la chiave non è presente).
+ */
+struct node* detach_node (pair_list_t* list, int key);
+
+/**
+ * @brief Libera un nodo staccato dalla lista e il suo valore
+ * 
+ * @param node Nodo da liberare
+ */
+void destroy_node (struct node* node);
+
 /**
  * @brief Rimuove il nodo identificato dalla chiave
  * 
  * @param list Puntatore alla testa della lista
  * @param key Chiave che identifica la coppia
- * @return int Se la rimozione è avvenuta con successo restituisce 0. Se c'è un errore restituisce NULL e setta errno.
+ * @return int Se la rimozione è avvenuta con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno (ENOKEY se la chiave non è presente).
  */
 int remove_list (pair_list_t** list, int key);
 
@@ -77,4 +93,13 @@ int remove_list (pair_list_t** list, int key);
  */
 struct node* remove_head (pair_list_t* list);
 
+/**
+ * @brief Inserisce in testa alla lista un nodo già allocato, senza copiarne il valore
+ * 
+ * @param list Lista in cui inserire il nodo
+ * @param node Nodo da inserire, staccato da qualunque altra lista
+ * @return int Se il nodo è stato inserito correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int push_node (pair_list_t* list, struct node* node);
+
 #endif // _LIST
@@ -0,0 +1,202 @@
+/**
+ * @file typed_hashtable.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Tabella hash generata in compilazione per tipi di chiave e valore qualsiasi. La macro TYPED_HASHTABLE definisce
+ * il tipo della tabella e le sue funzioni come static inline, con funzione hash e confronto delle chiavi chiamati
+ * direttamente, così che il compilatore li possa espandere. Le coppie sono memorizzate direttamente in un array
+ * a indirizzamento aperto con scansione lineare, insieme all'hash della chiave; la cancellazione sposta indietro
+ * gli elementi successivi invece di lasciare slot liberati. La tabella non è thread-safe: l'accesso concorrente va
+ * protetto dal chiamante. La tabella non possiede chiavi e valori: se sono puntatori la memoria è del chiamante.
+ * 
+ * Esempio, per una tabella di nome users da stringa a user_index_t*:
+ * 
+ *     TYPED_HASHTABLE(users, const char*, user_index_t*, string_hash, string_equals)
+ * 
+ * definisce users_t, users_create, users_destroy, users_find, users_insert, users_remove.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_TYPED_HASHTABLE)
+#define _TYPED_HASHTABLE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// Numero minimo di slot di una tabella (potenza di 2)
+#define TYPED_HASHTABLE_MIN_CAPACITY 16
+
+/**
+ * @brief Funzione hash FNV-1a a 32 bit su una stringa terminata da \0
+ * 
+ * @param key Stringa di cui calcolare l'hash
+ * @return unsigned int Hash della stringa
+ */
+static inline unsigned int string_hash (const char* key) {
+    unsigned int hash = 2166136261U;
+    for (; *key; key++) {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * @brief Confronta due stringhe terminate da \0
+ * 
+ * @return int 1 se sono uguali, 0 altrimenti
+ */
+static inline int string_equals (const char* a, const char* b) {
+    return strcmp(a, b) == 0;
+}
+
+/**
+ * @brief Funzione hash che mescola tutti i bit di un intero (finalizzatore di MurmurHash3)
+ * 
+ * @param key Intero di cui calcolare l'hash
+ * @return unsigned int Hash dell'intero
+ */
+static inline unsigned int int_hash (int key) {
+    unsigned int hash = (unsigned int) key;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/**
+ * @brief Confronta due interi
+ * 
+ * @return int 1 se sono uguali, 0 altrimenti
+ */
+static inline int int_equals (int a, int b) {
+    return a == b;
+}
+
+/**
+ * @brief Definisce una tabella hash specializzata.
+ * 
+ * @param name Prefisso del tipo name_t e delle funzioni generate
+ * @param key_type Tipo della chiave
+ * @param value_type Tipo del valore
+ * @param hash_function Funzione (o macro) unsigned int hash_function(key_type)
+ * @param equals_function Funzione (o macro) int equals_function(key_type, key_type), diversa da 0 se le chiavi sono uguali
+ * 
+ * Le funzioni generate sono:
+ * - name_t* name_create (): crea una tabella vuota. Se c'è un errore restituisce NULL e setta errno.
+ * - void name_destroy (name_t* table): libera la tabella, ma non chiavi e valori.
+ * - value_type* name_find (name_t* table, key_type key): restituisce il puntatore al valore della chiave, valido fino alla
+ *   prossima modifica della tabella, oppure NULL se la chiave non è presente.
+ * - int name_insert (name_t* table, key_type key, value_type value): inserisce la coppia e restituisce 0. Se la chiave esiste
+ *   già restituisce -1 e setta errno a EALREADY; se manca memoria restituisce -1 e setta errno a ENOMEM.
+ * - int name_remove (name_t* table, key_type key, value_type* value_ptr): rimuove la coppia, copiandone il valore in value_ptr
+ *   se non è NULL, e restituisce 0. Se la chiave non è presente restituisce -1 e setta errno a ENOKEY.
+ * - name->elements: numero di coppie nella tabella.
+ */
+#define TYPED_HASHTABLE(name, key_type, value_type, hash_function, equals_function) \
+    \
+    /* Slot della tabella: hash 0 indica uno slot vuoto, gli slot occupati hanno sempre il bit alto acceso */ \
+    struct name##_slot { \
+        unsigned int hash; \
+        key_type key; \
+        value_type value; \
+    }; \
+    \
+    typedef struct name { \
+        unsigned int capacity; \
+        unsigned int elements; \
+        struct name##_slot* slots; \
+    } name##_t; \
+    \
+    static inline unsigned int name##_slot_hash (key_type key) { \
+        return hash_function(key) | 0x80000000U; \
+    } \
+    \
+    static inline name##_t* name##_create () { \
+        name##_t* table = (name##_t*) malloc(sizeof(name##_t)); \
+        if (table == NULL) { errno = ENOMEM; return NULL; } \
+        table->slots = (struct name##_slot*) calloc(TYPED_HASHTABLE_MIN_CAPACITY, sizeof(struct name##_slot)); \
+        if (table->slots == NULL) { free(table); errno = ENOMEM; return NULL; } \
+        table->capacity = TYPED_HASHTABLE_MIN_CAPACITY; \
+        table->elements = 0; \
+        return table; \
+    } \
+    \
+    static inline void name##_destroy (name##_t* table) { \
+        if (table == NULL) return; \
+        free(table->slots); \
+        free(table); \
+    } \
+    \
+    /* Restituisce l'indice dello slot della chiave, -1 se non è presente */ \
+    static inline long name##_find_index (name##_t* table, key_type key) { \
+        unsigned int hash = name##_slot_hash(key); \
+        unsigned int mask = table->capacity - 1; \
+        for (unsigned int i = hash & mask; table->slots[i].hash != 0; i = (i + 1) & mask) \
+            if ((table->slots[i].hash == hash) && equals_function(table->slots[i].key, key)) \
+                return i; \
+        return -1; \
+    } \
+    \
+    static inline value_type* name##_find (name##_t* table, key_type key) { \
+        long index = name##_find_index(table, key); \
+        return (index == -1) ? NULL : &(table->slots[index].value); \
+    } \
+    \
+    /* Raddoppia la tabella reinserendo gli slot occupati con l'hash già calcolato */ \
+    static inline int name##_grow (name##_t* table) { \
+        unsigned int capacity = table->capacity * 2; \
+        struct name##_slot* slots = (struct name##_slot*) calloc(capacity, sizeof(struct name##_slot)); \
+        if (slots == NULL) { errno = ENOMEM; return -1; } \
+        for (unsigned int j = 0; j < table->capacity; j++) { \
+            if (table->slots[j].hash == 0) continue; \
+            unsigned int i = table->slots[j].hash & (capacity - 1); \
+            while (slots[i].hash != 0) i = (i + 1) & (capacity - 1); \
+            slots[i] = table->slots[j]; \
+        } \
+        free(table->slots); \
+        table->slots = slots; \
+        table->capacity = capacity; \
+        return 0; \
+    } \
+    \
+    static inline int name##_insert (name##_t* table, key_type key, value_type value) { \
+        if (name##_find_index(table, key) != -1) { errno = EALREADY; return -1; } \
+        /* Con la scansione lineare la tabella cresce quando è piena per tre quarti */ \
+        if ((table->elements + 1) * 4 > table->capacity * 3) \
+            if (name##_grow(table) == -1) return -1; \
+        unsigned int hash = name##_slot_hash(key); \
+        unsigned int mask = table->capacity - 1; \
+        unsigned int i = hash & mask; \
+        while (table->slots[i].hash != 0) i = (i + 1) & mask; \
+        table->slots[i].hash = hash; \
+        table->slots[i].key = key; \
+        table->slots[i].value = value; \
+        table->elements++; \
+        return 0; \
+    } \
+    \
+    static inline int name##_remove (name##_t* table, key_type key, value_type* value_ptr) { \
+        long index = name##_find_index(table, key); \
+        if (index == -1) { errno = ENOKEY; return -1; } \
+        if (value_ptr != NULL) *value_ptr = table->slots[index].value; \
+        unsigned int mask = table->capacity - 1; \
+        unsigned int hole = (unsigned int) index; \
+        /* Sposta indietro gli elementi successivi che possono occupare il buco senza uscire dalla loro sequenza */ \
+        for (unsigned int i = (hole + 1) & mask; table->slots[i].hash != 0; i = (i + 1) & mask) { \
+            unsigned int home = table->slots[i].hash & mask; \
+            if (((i - home) & mask) >= ((i - hole) & mask)) { \
+                table->slots[hole] = table->slots[i]; \
+                hole = i; \
+            } \
+        } \
+        table->slots[hole].hash = 0; \
+        table->elements--; \
+        return 0; \
+    }
+
+#endif // _TYPED_HASHTABLE
@@ -0,0 +1,61 @@
+/**
+ * @file histogram.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria degli istogrammi di latenza.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#include <string.h>
+
+#include "histogram.h"
+
+/**
+ * @brief Restituisce il valore più grande che cade nella casella index
+ */
+static unsigned long highest_value (int index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) return (unsigned long) index;
+    int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    unsigned long lowest = (unsigned long) (HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) << shift;
+    return lowest + (1UL << shift) - 1;
+}
+
+void histogram_reset (histogram_t* histogram) {
+    memset(histogram, 0, sizeof(histogram_t));
+}
+
+void histogram_merge (histogram_t* destination, histogram_t* source) {
+    // Il numero di valori viene ricalcolato dalle caselle lette, così che resti coerente con esse
+    unsigned long count = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        unsigned long bucket = __atomic_load_n(&source->buckets[i], __ATOMIC_RELAXED);
+        destination->buckets[i] += bucket;
+        count += bucket;
+    }
+    destination->count += count;
+    destination->sum += __atomic_load_n(&source->sum, __ATOMIC_RELAXED);
+    unsigned long max = __atomic_load_n(&source->max, __ATOMIC_RELAXED);
+    if (max > destination->max) destination->max = max;
+}
+
+unsigned long histogram_percentile (histogram_t* histogram, double p) {
+    if (histogram->count == 0) return 0;
+    // Posizione del valore cercato nella sequenza ordinata, contando da 1
+    unsigned long rank = (unsigned long) (p / 100.0 * histogram->count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > histogram->count) rank = histogram->count;
+    unsigned long seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            unsigned long value = highest_value(i);
+            return (value < histogram->max) ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+double histogram_mean (histogram_t* histogram) {
+    return (histogram->count > 0) ? (double) histogram->sum / histogram->count : 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file histogram.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria degli istogrammi di latenza, nello stile di HdrHistogram. I valori sono divisi in gruppi
+ * potenza di due, ciascuno diviso in HISTOGRAM_SUB_BUCKETS caselle lineari, quindi l'errore relativo di un percentile è
+ * al più 1/HISTOGRAM_SUB_BUCKETS qualunque sia l'ordine di grandezza, e un istogramma occupa una dimensione fissa.
+ * Un istogramma ha un solo scrittore, che registra senza lock né istruzioni atomiche di lettura-modifica-scrittura;
+ * altri thread possono leggerlo o sommarlo ad un altro mentre viene scritto.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_HISTOGRAM)
+#define _HISTOGRAM
+
+// Bit di precisione di ogni gruppo: 32 caselle per potenza di due, errore relativo al più del 3%
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+// Bit del valore più grande distinto; i valori maggiori, oltre 18 minuti se espressi in nanosecondi, finiscono nell'ultima casella
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_MAX_VALUE ((1UL << HISTOGRAM_MAX_BITS) - 1)
+
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * @brief Istogramma dei valori registrati
+ */
+typedef struct histogram {
+    // Numero di valori, loro somma e valore massimo
+    unsigned long count;
+    unsigned long sum;
+    unsigned long max;
+    unsigned long buckets[HISTOGRAM_BUCKETS];
+} histogram_t;
+
+/**
+ * @brief Restituisce la casella di un valore
+ */
+static inline int histogram_index (unsigned long value) {
+    if (value > HISTOGRAM_MAX_VALUE) value = HISTOGRAM_MAX_VALUE;
+    if (value < HISTOGRAM_SUB_BUCKETS) return (int) value;
+    int msb = 63 - __builtin_clzl(value);
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int) ((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+/**
+ * @brief Registra un valore. Va chiamata solo dal thread proprietario dell'istogramma: i campi vengono scritti con store
+ * atomici rilassati, così che un lettore concorrente veda sempre valori interi.
+ * 
+ * @param histogram Istogramma
+ * @param value Valore da registrare
+ */
+static inline void histogram_record (histogram_t* histogram, unsigned long value) {
+    int index = histogram_index(value);
+    __atomic_store_n(&histogram->buckets[index], histogram->buckets[index] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->sum, histogram->sum + value, __ATOMIC_RELAXED);
+    if (value > histogram->max) __atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Svuota un istogramma. Non va chiamata mentre il proprietario registra.
+ * 
+ * @param histogram Istogramma
+ */
+void histogram_reset (histogram_t* histogram);
+
+/**
+ * @brief Somma un istogramma ad un altro. L'istogramma sommato può essere in scrittura da parte del suo proprietario: in quel
+ * caso il risultato contiene una parte dei valori registrati durante la somma.
+ * 
+ * @param destination Istogramma a cui sommare, posseduto dal chiamante
+ * @param source Istogramma da sommare
+ */
+void histogram_merge (histogram_t* destination, histogram_t* source);
+
+/**
+ * @brief Restituisce il percentile p dei valori registrati, come il valore più grande della casella in cui cade
+ * (senza superare il massimo registrato)
+ * 
+ * @param histogram Istogramma, da non modificare durante la chiamata
+ * @param p Percentile tra 0 e 100
+ * @return unsigned long Valore del percentile, 0 se l'istogramma è vuoto
+ */
+unsigned long histogram_percentile (histogram_t* histogram, double p);
+
+/**
+ * @brief Restituisce la media dei valori registrati
+ * 
+ * @param histogram Istogramma
+ * @return double Media, 0 se l'istogramma è vuoto
+ */
+double histogram_mean (histogram_t* histogram);
+
+#endif // _HISTOGRAM
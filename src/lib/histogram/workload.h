@@ -0,0 +1,84 @@
+/**
+ * @file workload.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Funzioni comuni ai programmi di misura (loadgen e testhash) per generare il carico: orologio in nanosecondi,
+ * generatore pseudocasuale con stato per thread e distribuzione zipf degli indici. Sono definite nell'header, così che
+ * le estrazioni nei cicli cronometrati possano essere espanse inline; chi lo include deve linkare la libreria matematica.
+ *
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ *
+ */
+
+#if !defined(_WORKLOAD)
+#define _WORKLOAD
+
+#include <math.h>
+#include <time.h>
+
+// Esponente della distribuzione zipf, lo stesso usato da YCSB
+#define ZIPF_THETA 0.99
+
+/**
+ * @brief Generatore di indici in [0, n) con distribuzione zipf (metodo di Gray et al., usato da YCSB)
+ */
+typedef struct zipf {
+    long n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+} zipf_t;
+
+/**
+ * @brief Restituisce l'istante corrente in nanosecondi
+ */
+static inline unsigned long now_ns () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long) ts.tv_sec * 1000000000UL + (unsigned long) ts.tv_nsec;
+}
+
+/**
+ * @brief Generatore pseudocasuale xorshift64*, con stato per thread
+ */
+static inline unsigned long next_random (unsigned long* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717UL;
+}
+
+/**
+ * @brief Restituisce un numero pseudocasuale uniforme in [0, 1)
+ */
+static inline double next_double (unsigned long* state) {
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Prepara un generatore zipf su n indici, calcolando la costante di normalizzazione in O(n)
+ */
+static inline void init_zipf (zipf_t* zipf, long n, double theta) {
+    double zeta2 = 1.0 + pow(0.5, theta);
+    zipf->zetan = 0;
+    for (long i = 1; i <= n; i++)
+        zipf->zetan += 1.0 / pow((double) i, theta);
+    zipf->n = n;
+    zipf->theta = theta;
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zipf->zetan);
+}
+
+/**
+ * @brief Estrae un indice in [0, n), in cui i primi sono i più probabili
+ */
+static inline long next_zipf (zipf_t* zipf, unsigned long* state) {
+    double u = next_double(state);
+    double uz = u * zipf->zetan;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + pow(0.5, zipf->theta)) return 1;
+    long index = (long) (zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return (index < zipf->n) ? index : zipf->n - 1;
+}
+
+#endif
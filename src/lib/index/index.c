@@ -0,0 +1,729 @@
+/**
+ * @file index.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria che mantiene in memoria l'indice degli oggetti di ogni utente e lo rende persistente.
+ * 
+ * Lo snapshot è composto da un header seguito, per ogni utente, da un record utente e dai record dei suoi oggetti.
+ * Il journal è composto da un header seguito da un record per ogni memorizzazione o cancellazione.
+ * Tutti i record sono allineati a 8 bytes, in modo che lo snapshot possa essere letto direttamente dalla memoria mappata.
+ * Snapshot e journal riportano una generazione: un journal con una generazione diversa da quella dello snapshot è
+ * già contenuto nello snapshot e viene ignorato. Quando il journal supera la soglia viene compattato anche a server
+ * avviato: le modifiche prendono in lettura il lock di compattazione, che la compattazione prende in scrittura.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <ftw.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <assertmacros.h>
+#include <mutexmacros.h>
+#include <shared.h>
+
+#include <skiplist/skiplist.h>
+#include <hashtable/typed_hashtable.h>
+#include <index/index.h>
+
+// Numeri magici di snapshot, journal e record del journal
+#define SNAPSHOT_MAGIC 0x5849534fu
+#define JOURNAL_MAGIC 0x484a534fu
+#define RECORD_MAGIC 0x524a534fu
+
+// Versione del formato di snapshot e journal
+#define INDEX_FORMAT 1
+
+// Operazioni registrate nel journal
+#define OP_STORE 1
+#define OP_DELETE 2
+
+// Arrotonda n al multiplo di 8 successivo
+#define PAD8(n) (((n) + 7) & ~((size_t) 7))
+
+/**
+ * @brief Header dello snapshot
+ */
+struct snapshot_header {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t generation;
+    uint64_t users;
+    uint64_t objects;
+};
+
+/**
+ * @brief Record di un utente nello snapshot, seguito dal nome e dai record dei suoi oggetti
+ */
+struct snapshot_user {
+    uint16_t name_length;
+    uint16_t reserved;
+    uint32_t reserved2;
+    uint64_t objects;
+    uint64_t next_version;
+};
+
+/**
+ * @brief Record di un oggetto nello snapshot, seguito dal nome
+ */
+struct snapshot_object {
+    uint16_t name_length;
+    uint16_t reserved;
+    uint32_t reserved2;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t version;
+};
+
+/**
+ * @brief Header del journal
+ */
+struct journal_header {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t generation;
+};
+
+/**
+ * @brief Record del journal, seguito dal nome dell'utente e dal nome dell'oggetto
+ */
+struct journal_record {
+    uint32_t magic;
+    uint16_t user_length;
+    uint16_t name_length;
+    uint32_t op;
+    uint32_t reserved;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t version;
+};
+
+// File descriptor della cartella dati
+static int index_data_fd = -1;
+// File descriptor del journal, aperto in append
+static int journal_fd = -1;
+// Generazione dello snapshot corrente
+static uint64_t generation = 0;
+// Record accodati al journal dall'ultimo snapshot e oggetti contenuti nello snapshot, che decidono la compattazione
+static unsigned long journal_records = 0;
+static unsigned long snapshot_objects = 0;
+// Lock preso in lettura dalle modifiche dell'indice e in scrittura dalla compattazione a server avviato
+static pthread_rwlock_t compaction_lock = PTHREAD_RWLOCK_INITIALIZER;
+// Vale 1 mentre un thread compatta, così che gli altri non si mettano in coda per farlo
+static int compacting = 0;
+// Tabella che associa al nome di un utente il suo indice, specializzata in compilazione
+TYPED_HASHTABLE(user_map, const char*, user_index_t*, string_hash, string_equals)
+
+// Lista degli indici degli utenti, tabella per cercarli per nome e lock che le protegge
+static user_index_t* users = NULL;
+static user_map_t* users_by_name = NULL;
+static pthread_mutex_t users_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Utente della cartella in corso di scansione, necessario perché nftw non passa dati alla callback
+static user_index_t* scanned_user = NULL;
+
+/**
+ * @brief Inserisce o aggiorna un oggetto nell'indice dell'utente, aggiornando la dimensione totale. Va chiamata con il lock in scrittura.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @param info Metadati dell'oggetto
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int put_object (user_index_t* user, char* name, object_info_t info) {
+    object_info_t* old = get_skiplist(user->objects, name);
+    size_t old_size = old ? old->size : 0;
+    ASSERT_RETURN(put_skiplist(user->objects, name, info) != -1, -1);
+    user->bytes = user->bytes - old_size + info.size;
+    if (info.version >= user->next_version) user->next_version = info.version + 1;
+    return 0;
+}
+
+/**
+ * @brief Rimuove un oggetto dall'indice dell'utente, aggiornando la dimensione totale. Va chiamata con il lock in scrittura.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se l'oggetto è stato rimosso restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int remove_object (user_index_t* user, char* name) {
+    object_info_t old;
+    ASSERT_RETURN(remove_skiplist(user->objects, name, &old) != -1, -1);
+    user->bytes -= old.size;
+    return 0;
+}
+
+/**
+ * @brief Accoda un record al journal con una sola scrittura, in modo che record concorrenti non si mescolino.
+ * 
+ * @param op Operazione da registrare
+ * @param user Nome dell'utente
+ * @param name Nome dell'oggetto
+ * @param info Metadati dell'oggetto
+ * @return int Se la scrittura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int append_journal (uint32_t op, char* user, char* name, object_info_t info) {
+    // Buffer grande abbastanza per il record e due nomi POSIX
+    char buffer[sizeof(struct journal_record) + 2 * 256 + 8] = {0};
+    struct journal_record record = {RECORD_MAGIC, strlen(user), strlen(name), op, 0, info.size, info.mtime, info.version};
+    size_t length = PAD8(sizeof(record) + record.user_length + record.name_length);
+    ASSERT_ERRNO_RETURN(length <= sizeof(buffer), ENAMETOOLONG, -1);
+    memcpy(buffer, &record, sizeof(record));
+    memcpy(buffer + sizeof(record), user, record.user_length);
+    memcpy(buffer + sizeof(record) + record.user_length, name, record.name_length);
+    ssize_t written = write(journal_fd, buffer, length);
+    ASSERT_RETURN(written != -1, -1);
+    ASSERT_ERRNO_RETURN(written == length, EIO, -1);
+    __atomic_add_fetch(&journal_records, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief Legge lo snapshot mappandolo in memoria e ricostruisce gli indici degli utenti.
+ * 
+ * @param snapshot_fd File descriptor dello snapshot
+ * @return int Se il caricamento è andato a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int load_snapshot (int snapshot_fd) {
+    struct stat sb;
+    ASSERT_RETURN(fstat(snapshot_fd, &sb) != -1, -1);
+    ASSERT_ERRNO_RETURN(sb.st_size >= sizeof(struct snapshot_header), EILSEQ, -1);
+    char* map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, snapshot_fd, 0);
+    ASSERT_RETURN(map != MAP_FAILED, -1);
+    char* end = map + sb.st_size;
+    // Verifica l'header
+    struct snapshot_header* header = (struct snapshot_header*) map;
+    ASSERT_ERRNO((header->magic == SNAPSHOT_MAGIC) && (header->format == INDEX_FORMAT), EILSEQ, munmap(map, sb.st_size); return -1);
+    generation = header->generation;
+    char* ptr = map + sizeof(struct snapshot_header);
+    char name[256];
+    for (uint64_t i = 0; i < header->users; i++) {
+        // Legge il record dell'utente
+        struct snapshot_user* user_record = (struct snapshot_user*) ptr;
+        ASSERT_ERRNO((ptr + sizeof(*user_record) <= end) && (ptr + sizeof(*user_record) + user_record->name_length <= end), EILSEQ, munmap(map, sb.st_size); return -1);
+        ASSERT_ERRNO(user_record->name_length < 256, EILSEQ, munmap(map, sb.st_size); return -1);
+        memcpy(name, ptr + sizeof(*user_record), user_record->name_length);
+        name[user_record->name_length] = '\0';
+        ptr += PAD8(sizeof(*user_record) + user_record->name_length);
+        user_index_t* user = get_user_index(name);
+        ASSERT(user != NULL, munmap(map, sb.st_size); return -1);
+        user->next_version = user_record->next_version;
+        // Legge i record dei suoi oggetti
+        for (uint64_t j = 0; j < user_record->objects; j++) {
+            struct snapshot_object* object = (struct snapshot_object*) ptr;
+            ASSERT_ERRNO((ptr + sizeof(*object) <= end) && (ptr + sizeof(*object) + object->name_length <= end), EILSEQ, munmap(map, sb.st_size); return -1);
+            ASSERT_ERRNO(object->name_length < 256, EILSEQ, munmap(map, sb.st_size); return -1);
+            memcpy(name, ptr + sizeof(*object), object->name_length);
+            name[object->name_length] = '\0';
+            ptr += PAD8(sizeof(*object) + object->name_length);
+            object_info_t info = {object->size, object->mtime, object->version};
+            ASSERT(put_object(user, name, info) != -1, munmap(map, sb.st_size); return -1);
+        }
+    }
+    return munmap(map, sb.st_size);
+}
+
+/**
+ * @brief Riapplica i record del journal con la generazione corrente. Un eventuale record finale incompleto,
+ * lasciato da una scrittura interrotta, viene troncato in modo che i nuovi record siano accodati a quelli validi.
+ * 
+ * @param fd File descriptor del journal, aperto in lettura e scrittura
+ * @param current_ptr Puntatore settato a 1 se il journal appartiene alla generazione corrente, 0 altrimenti
+ * @return int Numero di record riapplicati. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int replay_journal (int fd, int* current_ptr) {
+    FILE* journal = fdopen(fd, "r");
+    ASSERT(journal != NULL, close(fd); return -1);
+    struct journal_header header;
+    // Un journal vuoto o di un'altra generazione è già contenuto nello snapshot
+    *current_ptr = (fread(&header, sizeof(header), 1, journal) == 1) && (header.magic == JOURNAL_MAGIC) && (header.generation == generation);
+    if (!*current_ptr) {
+        fclose(journal);
+        return 0;
+    }
+    int records = 0;
+    long valid_end = ftell(journal);
+    struct journal_record record;
+    char buffer[2 * 256 + 8];
+    char user_name[256];
+    char name[256];
+    while (fread(&record, sizeof(record), 1, journal) == 1) {
+        // Un record non valido indica una scrittura interrotta
+        if ((record.magic != RECORD_MAGIC) || (record.user_length >= 256) || (record.name_length >= 256)) break;
+        size_t length = PAD8(sizeof(record) + record.user_length + record.name_length) - sizeof(record);
+        if (fread(buffer, length, 1, journal) != 1) break;
+        memcpy(user_name, buffer, record.user_length);
+        user_name[record.user_length] = '\0';
+        memcpy(name, buffer + record.user_length, record.name_length);
+        name[record.name_length] = '\0';
+        // Applica l'operazione
+        user_index_t* user = get_user_index(user_name);
+        ASSERT(user != NULL, fclose(journal); return -1);
+        object_info_t info = {record.size, record.mtime, record.version};
+        if (record.op == OP_STORE)
+            ASSERT(put_object(user, name, info) != -1, fclose(journal); return -1);
+        if (record.op == OP_DELETE) {
+            remove_object(user, name);
+            if (info.version >= user->next_version) user->next_version = info.version + 1;
+        }
+        records++;
+        valid_end = ftell(journal);
+    }
+    // Elimina la coda non valida
+    int success = ftruncate(fd, valid_end);
+    fclose(journal);
+    ASSERT_RETURN(success != -1, -1);
+    return records;
+}
+
+/**
+ * @brief Callback di nftw che aggiunge all'indice dell'utente in scansione ogni file regolare trovato.
+ */
+static int scan_object (const char* path, const struct stat* sb, int typeflag, struct FTW* ftwbuf) {
+    if (typeflag != FTW_F) return 0;
+    object_info_t info = {sb->st_size, sb->st_mtime, scanned_user->next_version};
+    return put_object(scanned_user, (char*) path + ftwbuf->base, info);
+}
+
+/**
+ * @brief Costruisce l'indice scandendo le cartelle degli utenti. Usata solo al primo avvio.
+ * 
+ * @return int Se la scansione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int scan_data_directory () {
+    DIR* dir = opendir(DATA_DIRECTORY);
+    ASSERT_RETURN(dir != NULL, -1);
+    struct dirent* entry;
+    char path[sizeof(DATA_DIRECTORY) + 257];
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat sb;
+        // Considera solo le cartelle degli utenti
+        if (entry->d_name[0] == '.') continue;
+        if ((fstatat(index_data_fd, entry->d_name, &sb, 0) == -1) || !S_ISDIR(sb.st_mode)) continue;
+        scanned_user = get_user_index(entry->d_name);
+        ASSERT(scanned_user != NULL, closedir(dir); return -1);
+        sprintf(path, "%s/%s", DATA_DIRECTORY, entry->d_name);
+        ASSERT(nftw(path, scan_object, 16, FTW_PHYS) != -1, closedir(dir); return -1);
+    }
+    closedir(dir);
+    return 0;
+}
+
+/**
+ * @brief Scrive con una sola scrittura bufferizzata tutto l'indice in uno snapshot della generazione data.
+ * 
+ * @param file File su cui scrivere
+ * @param snapshot_generation Generazione dello snapshot
+ * @return int Se la scrittura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int write_snapshot (FILE* file, uint64_t snapshot_generation) {
+    static const char padding[8] = {0};
+    struct snapshot_header header = {SNAPSHOT_MAGIC, INDEX_FORMAT, snapshot_generation, 0, 0};
+    for (user_index_t* user = users; user; user = user->next) {
+        header.users++;
+        header.objects += user->objects->elements;
+    }
+    ASSERT_RETURN(fwrite(&header, sizeof(header), 1, file) == 1, -1);
+    for (user_index_t* user = users; user; user = user->next) {
+        struct snapshot_user user_record = {strlen(user->name), 0, 0, user->objects->elements, user->next_version};
+        size_t padded = PAD8(sizeof(user_record) + user_record.name_length) - sizeof(user_record) - user_record.name_length;
+        ASSERT_RETURN(fwrite(&user_record, sizeof(user_record), 1, file) == 1, -1);
+        ASSERT_RETURN(fwrite(user->name, 1, user_record.name_length, file) == user_record.name_length, -1);
+        ASSERT_RETURN(fwrite(padding, 1, padded, file) == padded, -1);
+        for (struct skip_node* node = user->objects->head->next[0]; node; node = node->next[0]) {
+            struct snapshot_object object = {strlen(node->key), 0, 0, node->info.size, node->info.mtime, node->info.version};
+            padded = PAD8(sizeof(object) + object.name_length) - sizeof(object) - object.name_length;
+            ASSERT_RETURN(fwrite(&object, sizeof(object), 1, file) == 1, -1);
+            ASSERT_RETURN(fwrite(node->key, 1, object.name_length, file) == object.name_length, -1);
+            ASSERT_RETURN(fwrite(padding, 1, padded, file) == padded, -1);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Crea in modo atomico un file nella cartella dati: lo scrive con un nome temporaneo, lo sincronizza e lo rinomina.
+ * 
+ * @param name Nome del file
+ * @param new_generation Generazione da scrivere nel file
+ * @param is_snapshot 1 per scrivere lo snapshot, 0 per scrivere un journal vuoto
+ * @return int Se il file è stato creato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int replace_file (char* name, uint64_t new_generation, int is_snapshot) {
+    char temp_name[32];
+    sprintf(temp_name, "%s.tmp", name);
+    int fd = openat(index_data_fd, temp_name, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0666);
+    ASSERT_RETURN(fd != -1, -1);
+    FILE* file = fdopen(fd, "w");
+    ASSERT(file != NULL, close(fd); return -1);
+    int success;
+    if (is_snapshot) success = write_snapshot(file, new_generation);
+    else {
+        struct journal_header header = {JOURNAL_MAGIC, INDEX_FORMAT, new_generation};
+        success = (fwrite(&header, sizeof(header), 1, file) == 1) ? 0 : -1;
+    }
+    // Il file deve essere su disco prima di sostituire il precedente
+    if (success != -1) success = fflush(file);
+    if (success != -1) success = fsync(fd);
+    ASSERT(fclose(file) == 0, success = -1);
+    ASSERT_RETURN(success != -1, -1);
+    ASSERT_RETURN(renameat(index_data_fd, temp_name, index_data_fd, name) != -1, -1);
+    return fsync(index_data_fd);
+}
+
+/**
+ * @brief Scrive uno snapshot della generazione successiva e apre un journal vuoto della stessa generazione.
+ * Se il processo si interrompe tra le due scritture il vecchio journal viene ignorato perché di un'altra generazione,
+ * ed è corretto ignorarlo perché il suo contenuto è già nello snapshot.
+ * Va chiamata con il lock di compattazione in scrittura e la mutex degli utenti, oppure quando nessun altro thread usa l'indice.
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int compact_index () {
+    ASSERT_RETURN(replace_file(INDEX_SNAPSHOT, generation + 1, 1) != -1, -1);
+    // Da qui il vecchio journal viene ignorato: finché il nuovo non è aperto le modifiche falliscono, invece di finire
+    // in un journal che non verrebbe riapplicato
+    generation++;
+    if (journal_fd != -1) close(journal_fd);
+    journal_fd = -1;
+    ASSERT_RETURN(replace_file(INDEX_JOURNAL, generation, 0) != -1, -1);
+    // Riapre il journal in append
+    journal_fd = openat(index_data_fd, INDEX_JOURNAL, O_WRONLY | O_APPEND | O_CLOEXEC);
+    ASSERT_RETURN(journal_fd != -1, -1);
+    unsigned long objects = 0;
+    for (user_index_t* user = users; user; user = user->next)
+        objects += user->objects->elements;
+    __atomic_store_n(&snapshot_objects, objects, __ATOMIC_RELAXED);
+    __atomic_store_n(&journal_records, 0, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief Indica se il journal va compattato: se ha almeno INDEX_COMPACT_RECORDS record e almeno tanti quanti oggetti ha
+ * lo snapshot, così che il costo di scrivere lo snapshot sia ripartito sulle modifiche accumulate, oppure se il journal
+ * non è aperto perché una compattazione precedente si è interrotta.
+ */
+static int journal_full () {
+    unsigned long records = __atomic_load_n(&journal_records, __ATOMIC_RELAXED);
+    return ((records >= INDEX_COMPACT_RECORDS) && (records >= __atomic_load_n(&snapshot_objects, __ATOMIC_RELAXED)))
+        || (__atomic_load_n(&journal_fd, __ATOMIC_RELAXED) == -1);
+}
+
+/**
+ * @brief Compatta il journal se ha superato la soglia, bloccando le modifiche dell'indice mentre scrive lo snapshot.
+ * Va chiamata senza lock dell'indice. Un solo thread alla volta compatta, gli altri proseguono senza aspettare.
+ * Non modifica errno.
+ */
+static void compact_if_full () {
+    if (!journal_full() || !__sync_bool_compare_and_swap(&compacting, 0, 1)) return;
+    int saved_errno = errno;
+    if (pthread_rwlock_wrlock(&compaction_lock) == 0) {
+        // La lista degli utenti può crescere anche durante la compattazione, quindi va letta con la sua mutex
+        if (journal_full() && (pthread_mutex_lock(&users_mutex) == 0)) {
+            // Se fallisce ritenta dopo altri INDEX_COMPACT_RECORDS record, invece che ad ogni modifica
+            if (compact_index() == -1) {
+                perror("[index] Compacting journal");
+                __atomic_store_n(&journal_records, 0, __ATOMIC_RELAXED);
+            }
+            pthread_mutex_unlock(&users_mutex);
+        }
+        pthread_rwlock_unlock(&compaction_lock);
+    }
+    __atomic_store_n(&compacting, 0, __ATOMIC_RELEASE);
+    errno = saved_errno;
+}
+
+/**
+ * @brief Carica l'indice dallo snapshot e dal journal contenuti nella cartella dati. Se lo snapshot non esiste
+ * (primo avvio) costruisce l'indice scandendo la cartella dati e scrive il primo snapshot.
+ * 
+ * @param data_fd File descriptor della cartella dati
+ * @return int Se il caricamento è andato a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int init_index (int data_fd) {
+    ASSERT_ERRNO_RETURN(data_fd > 0, EINVAL, -1);
+    index_data_fd = data_fd;
+    // Carica lo snapshot, se esiste
+    int replayed = 0;
+    int snapshot_fd = openat(data_fd, INDEX_SNAPSHOT, O_RDONLY | O_CLOEXEC);
+    ASSERT_RETURN((snapshot_fd != -1) || (errno == ENOENT), -1);
+    if (snapshot_fd != -1) {
+        int success = load_snapshot(snapshot_fd);
+        close(snapshot_fd);
+        ASSERT_RETURN(success != -1, -1);
+        // Riapplica le modifiche successive allo snapshot
+        int current = 0;
+        int fd = openat(data_fd, INDEX_JOURNAL, O_RDWR | O_CLOEXEC);
+        ASSERT_RETURN((fd != -1) || (errno == ENOENT), -1);
+        if (fd != -1) replayed = replay_journal(fd, &current);
+        ASSERT_RETURN(replayed != -1, -1);
+        // Se il journal è della generazione corrente continua ad accodarvi le modifiche
+        if (current) {
+            journal_fd = openat(data_fd, INDEX_JOURNAL, O_WRONLY | O_APPEND | O_CLOEXEC);
+            ASSERT_RETURN(journal_fd != -1, -1);
+            journal_records = replayed;
+            snapshot_objects = 0;
+            for (user_index_t* user = users; user; user = user->next)
+                snapshot_objects += user->objects->elements;
+        }
+    }
+    // Al primo avvio non c'è altro modo che scandire la cartella dati
+    else ASSERT_RETURN(scan_data_directory() != -1, -1);
+    // Se il journal manca, è obsoleto o è troppo lungo scrive subito un nuovo snapshot
+    if ((journal_fd == -1) || (replayed >= INDEX_COMPACT_RECORDS))
+        ASSERT_RETURN(compact_index() != -1, -1);
+    return 0;
+}
+
+/**
+ * @brief Scrive un nuovo snapshot, azzera il journal e libera la memoria occupata dall'indice.
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int stop_index () {
+    int success = compact_index();
+    int saved_errno = errno;
+    close(journal_fd);
+    journal_fd = -1;
+    // Libera la tabella e gli indici degli utenti
+    user_map_destroy(users_by_name);
+    users_by_name = NULL;
+    while (users) {
+        user_index_t* next = users->next;
+        destroy_skiplist(users->objects);
+        pthread_rwlock_destroy(&users->lock);
+        free(users->name);
+        free(users);
+        users = next;
+    }
+    errno = saved_errno;
+    return success;
+}
+
+/**
+ * @brief Restituisce l'indice dell'utente, creandolo se non esiste.
+ * 
+ * @param name Nome dell'utente
+ * @return user_index_t* Indice dell'utente. Se c'è un errore restituisce NULL e setta errno.
+ */
+user_index_t* get_user_index (char* name) {
+    ASSERT_ERRNO_RETURN(name != NULL, EINVAL, NULL);
+    LOCK_ACQUIRE(&users_mutex, return NULL);
+    // Crea la tabella degli utenti al primo accesso
+    if (users_by_name == NULL) {
+        users_by_name = user_map_create();
+        ASSERT(users_by_name != NULL, pthread_mutex_unlock(&users_mutex); return NULL);
+    }
+    // Cerca l'utente nella tabella
+    user_index_t** found = user_map_find(users_by_name, name);
+    user_index_t* user = (found != NULL) ? *found : NULL;
+    // Se non esiste lo crea, lo inserisce nella tabella e lo mette in testa alla lista
+    if (user == NULL) {
+        user = (user_index_t*) calloc(1, sizeof(user_index_t));
+        ASSERT_ERRNO(user != NULL, ENOMEM, pthread_mutex_unlock(&users_mutex); return NULL);
+        user->name = strdup(name);
+        user->objects = create_skiplist();
+        user->next_version = 1;
+        ASSERT_ERRNO((user->name != NULL) && (user->objects != NULL), ENOMEM,
+            free(user->name); free(user); pthread_mutex_unlock(&users_mutex); return NULL);
+        // La chiave è il nome memorizzato nell'indice, che vive quanto l'indice stesso
+        ASSERT(user_map_insert(users_by_name, user->name, user) != -1,
+            destroy_skiplist(user->objects); free(user->name); free(user); pthread_mutex_unlock(&users_mutex); return NULL);
+        pthread_rwlock_init(&user->lock, NULL);
+        user->next = users;
+        users = user;
+    }
+    LOCK_RELEASE(&users_mutex, return NULL);
+    return user;
+}
+
+/**
+ * @brief Implementazione comune di index_store e index_insert.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @param size Dimensione dell'oggetto
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati dell'oggetto
+ * @param if_absent 1 per lasciare invariato un oggetto già presente, restituendone i metadati
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int store_object (user_index_t* user, char* name, size_t size, object_info_t* info_ptr, int if_absent) {
+    ASSERT_ERRNO_RETURN((user != NULL) && (name != NULL), EINVAL, -1);
+    ASSERT_RETURN((errno = pthread_rwlock_rdlock(&compaction_lock)) == 0, -1);
+    ASSERT((errno = pthread_rwlock_wrlock(&user->lock)) == 0, pthread_rwlock_unlock(&compaction_lock); return -1);
+    // Il controllo avviene sotto lo stesso lock dell'inserimento, così che un solo thread assegni la versione
+    object_info_t* existing = if_absent ? get_skiplist(user->objects, name) : NULL;
+    if (existing != NULL) {
+        object_info_t info = *existing;
+        pthread_rwlock_unlock(&user->lock);
+        pthread_rwlock_unlock(&compaction_lock);
+        if (info_ptr) *info_ptr = info;
+        return 0;
+    }
+    object_info_t info = {size, time(NULL), user->next_version};
+    // Il journal viene scritto sotto lock, così l'ordine dei record rispetta quello delle modifiche, e prima dell'indice
+    // in memoria, così se la scrittura fallisce l'indice non contiene una modifica che il journal non ha
+    int success = append_journal(OP_STORE, user->name, name, info);
+    if (success != -1) {
+        // La versione è consumata anche se l'inserimento fallisce, dato che il journal la contiene già
+        user->next_version = info.version + 1;
+        success = put_object(user, name, info);
+    }
+    pthread_rwlock_unlock(&user->lock);
+    pthread_rwlock_unlock(&compaction_lock);
+    compact_if_full();
+    if ((success != -1) && info_ptr) *info_ptr = info;
+    return success;
+}
+
+/**
+ * @brief Registra nell'indice e nel journal la memorizzazione di un oggetto, assegnandogli una nuova versione.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @param size Dimensione dell'oggetto
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati assegnati all'oggetto
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int index_store (user_index_t* user, char* name, size_t size, object_info_t* info_ptr) {
+    return store_object(user, name, size, info_ptr, 0);
+}
+
+/**
+ * @brief Come index_store, ma solo se l'oggetto non è già nell'indice: in quel caso ne restituisce i metadati attuali
+ * senza assegnare una nuova versione. Serve a riparare l'indice da più lettori concorrenti, che devono vedere tutti
+ * la stessa versione.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @param size Dimensione dell'oggetto
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati dell'oggetto
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int index_insert (user_index_t* user, char* name, size_t size, object_info_t* info_ptr) {
+    return store_object(user, name, size, info_ptr, 1);
+}
+
+
+/**
+ * @brief Registra nell'indice e nel journal la cancellazione di un oggetto.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int index_delete (user_index_t* user, char* name) {
+    ASSERT_ERRNO_RETURN((user != NULL) && (name != NULL), EINVAL, -1);
+    ASSERT_RETURN((errno = pthread_rwlock_rdlock(&compaction_lock)) == 0, -1);
+    ASSERT((errno = pthread_rwlock_wrlock(&user->lock)) == 0, pthread_rwlock_unlock(&compaction_lock); return -1);
+    object_info_t info = {0, time(NULL), user->next_version};
+    // Come in store_object l'indice in memoria viene modificato solo dopo la scrittura del journal
+    int success = append_journal(OP_DELETE, user->name, name, info);
+    if (success != -1) {
+        user->next_version++;
+        // L'oggetto potrebbe non essere nell'indice se era stato scritto prima di un crash
+        remove_object(user, name);
+    }
+    pthread_rwlock_unlock(&user->lock);
+    pthread_rwlock_unlock(&compaction_lock);
+    compact_if_full();
+    return success;
+}
+
+/**
+ * @brief Recupera i metadati di un oggetto dall'indice.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @param info_ptr Puntatore in cui copiare i metadati
+ * @return int Se l'oggetto esiste restituisce 0. Se c'è un errore restituisce -1 e setta errno (ENOENT se l'oggetto non esiste).
+ */
+int index_lookup (user_index_t* user, char* name, object_info_t* info_ptr) {
+    ASSERT_ERRNO_RETURN((user != NULL) && (name != NULL) && (info_ptr != NULL), EINVAL, -1);
+    ASSERT_RETURN((errno = pthread_rwlock_rdlock(&user->lock)) == 0, -1);
+    object_info_t* info = get_skiplist(user->objects, name);
+    if (info) *info_ptr = *info;
+    int saved_errno = errno;
+    pthread_rwlock_unlock(&user->lock);
+    errno = saved_errno;
+    return info ? 0 : -1;
+}
+
+/**
+ * @brief Elenca in ordine i nomi degli oggetti di un utente che iniziano con prefix e seguono start_after,
+ * senza leggere la cartella dell'utente.
+ * 
+ * @param user Indice dell'utente
+ * @param prefix Prefisso dei nomi da elencare, stringa vuota per tutti gli oggetti
+ * @param start_after Se non è vuoto vengono elencati solo i nomi strettamente maggiori, per riprendere una pagina precedente
+ * @param limit Numero massimo di nomi da elencare
+ * @param length_ptr Puntatore in cui scrivere la lunghezza dell'elenco
+ * @return char* Elenco dei nomi, ognuno terminato da '\n', da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+char* index_list (user_index_t* user, char* prefix, char* start_after, int limit, size_t* length_ptr) {
+    ASSERT_ERRNO_RETURN((user != NULL) && (prefix != NULL) && (start_after != NULL) && (limit > 0) && (length_ptr != NULL), EINVAL, NULL);
+    size_t prefix_length = strlen(prefix);
+    // Il buffer cresce raddoppiando, partendo da una dimensione adatta a una pagina piccola
+    size_t capacity = 4096;
+    size_t length = 0;
+    char* list = (char*) malloc(capacity);
+    ASSERT_ERRNO_RETURN(list != NULL, ENOMEM, NULL);
+    ASSERT((errno = pthread_rwlock_rdlock(&user->lock)) == 0, free(list); return NULL);
+    // Parte dal nome più grande tra il prefisso e quello da cui riprendere, saltando quest'ultimo
+    int resume = (start_after[0] != '\0') && (strcmp(start_after, prefix) >= 0);
+    struct skip_node* node = seek_skiplist(user->objects, resume ? start_after : prefix);
+    if (resume && node && EQUALS(node->key, start_after)) node = node->next[0];
+    // Scorre i nomi in ordine finché condividono il prefisso
+    for (int count = 0; node && (count < limit) && (strncmp(node->key, prefix, prefix_length) == 0); node = node->next[0], count++) {
+        size_t key_length = strlen(node->key);
+        if (length + key_length + 2 > capacity) {
+            capacity *= 2;
+            char* bigger = (char*) realloc(list, capacity);
+            ASSERT_ERRNO(bigger != NULL, ENOMEM, pthread_rwlock_unlock(&user->lock); free(list); return NULL);
+            list = bigger;
+        }
+        memcpy(list + length, node->key, key_length);
+        length += key_length;
+        list[length++] = '\n';
+    }
+    pthread_rwlock_unlock(&user->lock);
+    list[length] = '\0';
+    *length_ptr = length;
+    return list;
+}
+
+/**
+ * @brief Scrive sui puntatori passati il numero di utenti, il numero di oggetti e la dimensione totale dello store.
+ * 
+ * @param users_ptr Puntatore al numero di utenti
+ * @param objects_ptr Puntatore al numero di oggetti
+ * @param size_ptr Puntatore alla dimensione totale
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int index_totals (int* users_ptr, int* objects_ptr, size_t* size_ptr) {
+    ASSERT_ERRNO_RETURN((users_ptr != NULL) && (objects_ptr != NULL) && (size_ptr != NULL), EINVAL, -1);
+    *users_ptr = *objects_ptr = 0;
+    *size_ptr = 0;
+    LOCK_ACQUIRE(&users_mutex, return -1);
+    for (user_index_t* user = users; user; user = user->next) {
+        pthread_rwlock_rdlock(&user->lock);
+        (*users_ptr)++;
+        *objects_ptr += user->objects->elements;
+        *size_ptr += user->bytes;
+        pthread_rwlock_unlock(&user->lock);
+    }
+    LOCK_RELEASE(&users_mutex, return -1);
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file index.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria che mantiene in memoria l'indice degli oggetti di ogni utente e lo rende persistente
+ * con uno snapshot compatto, mappabile in memoria, più un journal delle modifiche a cui si accodano le operazioni.
+ * All'avvio lo snapshot viene caricato e il journal riapplicato, senza scandire la cartella dati.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_INDEX)
+#define _INDEX
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include <skiplist/skiplist.h>
+
+// Nome dello snapshot dell'indice all'interno della cartella dati
+#define INDEX_SNAPSHOT ".index"
+
+// Nome del journal delle modifiche all'interno della cartella dati
+#define INDEX_JOURNAL ".journal"
+
+// Numero minimo di record del journal oltre il quale viene scritto un nuovo snapshot, all'avvio o a server avviato
+// quando il journal ha anche almeno tanti record quanti oggetti ha lo snapshot
+#define INDEX_COMPACT_RECORDS 100000
+
+/**
+ * @brief Indice degli oggetti di un utente: skiplist ordinata per nome, dimensione totale, prossima versione da assegnare
+ * e lock in lettura/scrittura che protegge tutti i campi. Gli indici degli utenti formano una lista concatenata.
+ */
+typedef struct user_index {
+    char* name;
+    skiplist_t* objects;
+    size_t bytes;
+    unsigned long next_version;
+    pthread_rwlock_t lock;
+    struct user_index* next;
+} user_index_t;
+
+/**
+ * @brief Carica l'indice dallo snapshot e dal journal contenuti nella cartella dati. Se lo snapshot non esiste
+ * (primo avvio) costruisce l'indice scandendo la cartella dati e scrive il primo snapshot.
+ * 
+ * @param data_fd File descriptor della cartella dati
+ * @return int Se il caricamento è andato a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int init_index (int data_fd);
+
+/**
+ * @brief Scrive un nuovo snapshot, azzera il journal e libera la memoria occupata dall'indice.
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int stop_index ();
+
+/**
+ * @brief Restituisce l'indice dell'utente, creandolo se non esiste.
+ * 
+ * @param name Nome dell'utente
+ * @return user_index_t* Indice dell'utente. Se c'è un errore restituisce NULL e setta errno.
+ */
+user_index_t* get_user_index (char* name);
+
+/**
+ * @brief Registra nell'indice e nel journal la memorizzazione di un oggetto, assegnandogli una nuova versione.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @param size Dimensione dell'oggetto
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati assegnati all'oggetto
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int index_store (user_index_t* user, char* name, size_t size, object_info_t* info_ptr);
+
+/**
+ * @brief Come index_store, ma solo se l'oggetto non è già nell'indice: in quel caso ne restituisce i metadati attuali
+ * senza assegnare una nuova versione. Serve a riparare l'indice da più lettori concorrenti, che devono vedere tutti
+ * la stessa versione.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @param size Dimensione dell'oggetto
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati dell'oggetto
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int index_insert (user_index_t* user, char* name, size_t size, object_info_t* info_ptr);
+
+/**
+ * @brief Registra nell'indice e nel journal la cancellazione di un oggetto.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int index_delete (user_index_t* user, char* name);
+
+/**
+ * @brief Recupera i metadati di un oggetto dall'indice.
+ * 
+ * @param user Indice dell'utente
+ * @param name Nome dell'oggetto
+ * @param info_ptr Puntatore in cui copiare i metadati
+ * @return int Se l'oggetto esiste restituisce 0. Se c'è un errore restituisce -1 e setta errno (ENOENT se l'oggetto non esiste).
+ */
+int index_lookup (user_index_t* user, char* name, object_info_t* info_ptr);
+
+/**
+ * @brief Elenca in ordine i nomi degli oggetti di un utente che iniziano con prefix e seguono start_after,
+ * senza leggere la cartella dell'utente.
+ * 
+ * @param user Indice dell'utente
+ * @param prefix Prefisso dei nomi da elencare, stringa vuota per tutti gli oggetti
+ * @param start_after Se non è vuoto vengono elencati solo i nomi strettamente maggiori, per riprendere una pagina precedente
+ * @param limit Numero massimo di nomi da elencare
+ * @param length_ptr Puntatore in cui scrivere la lunghezza dell'elenco
+ * @return char* Elenco dei nomi, ognuno terminato da '\n', da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+char* index_list (user_index_t* user, char* prefix, char* start_after, int limit, size_t* length_ptr);
+
+/**
+ * @brief Scrive sui puntatori passati il numero di utenti, il numero di oggetti e la dimensione totale dello store.
+ * 
+ * @param users_ptr Puntatore al numero di utenti
+ * @param objects_ptr Puntatore al numero di oggetti
+ * @param size_ptr Puntatore alla dimensione totale
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int index_totals (int* users_ptr, int* objects_ptr, size_t* size_ptr);
+
+#endif // _INDEX
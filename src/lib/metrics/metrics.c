@@ -0,0 +1,221 @@
+/**
+ * @file metrics.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria che misura le richieste servite dal server.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "metrics.h"
+
+// Aggiunge value ad un contatore scritto solo dal proprietario, con uno store che un lettore concorrente vede per intero
+#define COUNTER_ADD(counter, value) __atomic_store_n(&(counter), (counter) + (value), __ATOMIC_RELAXED)
+
+static const char* verb_names[] = {
+    "REGISTER", "STORE", "APPEND", "RETRIEVE", "STAT", "LIST", "PREFETCH",
+    "INITIATE", "PART", "COMPLETE", "ABORT", "DELETE", "LEAVE", "STATS", "OTHER"
+};
+
+static const char* phase_names[] = { "total", "queueing", "disk", "network" };
+
+/**
+ * @brief Record di un thread. Solo il proprietario lo scrive; le misure dei verbi vengono allocate al primo uso
+ * e pubblicate con uno store di rilascio, così che metrics_collect le legga senza lock.
+ */
+struct metrics_record {
+    int in_use;
+    verb_metrics_t* verbs[METRICS_VERBS];
+    // Richiesta in corso: istante di arrivo dell'header, di inizio della gestione e tempo accumulato per fase
+    int active;
+    unsigned long arrival;
+    unsigned long start;
+    unsigned long phases[METRICS_PHASES];
+    size_t bytes_in;
+    size_t bytes_out;
+    int failed;
+    struct metrics_record* next;
+};
+
+// Lista dei record, a cui si aggiungono record ma da cui non se ne tolgono
+static struct metrics_record* records = NULL;
+
+// Chiave che associa ad ogni thread il suo record
+static pthread_key_t record_key;
+
+// Garantisce che la chiave venga creata una sola volta
+static pthread_once_t metrics_once = PTHREAD_ONCE_INIT;
+
+// Esito della creazione della chiave
+static int metrics_ready = 0;
+
+/**
+ * @brief Rende riusabile il record di un thread che termina, con le misure accumulate
+ * 
+ * @param ptr Record del thread
+ */
+static void release_record (void* ptr) {
+    struct metrics_record* record = (struct metrics_record*) ptr;
+    __atomic_store_n(&record->active, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&record->in_use, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Crea la chiave dei record
+ */
+static void init_metrics () {
+    if (pthread_key_create(&record_key, release_record) == 0) metrics_ready = 1;
+}
+
+/**
+ * @brief Restituisce il record del thread corrente, riusando quello di un thread terminato o aggiungendone uno nuovo
+ * 
+ * @return struct metrics_record* Record del thread, NULL se non è stato possibile ottenerlo
+ */
+static struct metrics_record* get_record () {
+    pthread_once(&metrics_once, init_metrics);
+    if (!metrics_ready) return NULL;
+    struct metrics_record* record = (struct metrics_record*) pthread_getspecific(record_key);
+    if (record != NULL) return record;
+    // Le misure non devono modificare l'errno delle operazioni misurate
+    int saved_errno = errno;
+    // Cerca un record libero
+    for (record = __atomic_load_n(&records, __ATOMIC_ACQUIRE); record != NULL; record = record->next)
+        if (__sync_bool_compare_and_swap(&record->in_use, 0, 1)) break;
+    // Se non ce ne sono ne aggiunge uno in testa alla lista
+    if (record == NULL) {
+        record = (struct metrics_record*) calloc(1, sizeof(struct metrics_record));
+        errno = saved_errno;
+        if (record == NULL) return NULL;
+        record->in_use = 1;
+        do record->next = __atomic_load_n(&records, __ATOMIC_ACQUIRE);
+        while (!__sync_bool_compare_and_swap(&records, record->next, record));
+    }
+    if (pthread_setspecific(record_key, record) != 0) {
+        release_record(record);
+        record = NULL;
+    }
+    errno = saved_errno;
+    return record;
+}
+
+const char* metrics_verb_name (metrics_verb_t verb) {
+    return verb_names[verb];
+}
+
+const char* metrics_phase_name (metrics_phase_t phase) {
+    return phase_names[phase];
+}
+
+metrics_verb_t metrics_verb (char* header) {
+    size_t length = strcspn(header, " \n");
+    for (int verb = 0; verb < METRICS_OTHER; verb++)
+        if ((strlen(verb_names[verb]) == length) && (strncmp(header, verb_names[verb], length) == 0))
+            return (metrics_verb_t) verb;
+    return METRICS_OTHER;
+}
+
+unsigned long metrics_clock () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long) ts.tv_sec * 1000000000UL + (unsigned long) ts.tv_nsec;
+}
+
+void metrics_request_begin (unsigned long arrival) {
+    struct metrics_record* record = get_record();
+    if (record == NULL) return;
+    unsigned long now = metrics_clock();
+    record->start = now;
+    record->arrival = ((arrival > 0) && (arrival <= now)) ? arrival : now;
+    memset(record->phases, 0, sizeof(record->phases));
+    record->bytes_in = 0;
+    record->bytes_out = 0;
+    record->failed = 0;
+    __atomic_store_n(&record->active, 1, __ATOMIC_RELAXED);
+}
+
+void metrics_phase (metrics_phase_t phase, unsigned long start) {
+    struct metrics_record* record = get_record();
+    if ((record == NULL) || !record->active) return;
+    record->phases[phase] += metrics_clock() - start;
+}
+
+void metrics_bytes (size_t bytes_in, size_t bytes_out) {
+    struct metrics_record* record = get_record();
+    if ((record == NULL) || !record->active) return;
+    record->bytes_in += bytes_in;
+    record->bytes_out += bytes_out;
+}
+
+void metrics_error () {
+    struct metrics_record* record = get_record();
+    if ((record == NULL) || !record->active) return;
+    record->failed = 1;
+}
+
+void metrics_request_end (metrics_verb_t verb) {
+    struct metrics_record* record = get_record();
+    if ((record == NULL) || !record->active) return;
+    unsigned long now = metrics_clock();
+    __atomic_store_n(&record->active, 0, __ATOMIC_RELAXED);
+    verb_metrics_t* metrics = record->verbs[verb];
+    if (metrics == NULL) {
+        // Se la memoria non basta la richiesta non viene misurata
+        int saved_errno = errno;
+        metrics = (verb_metrics_t*) calloc(1, sizeof(verb_metrics_t));
+        errno = saved_errno;
+        if (metrics == NULL) return;
+        __atomic_store_n(&record->verbs[verb], metrics, __ATOMIC_RELEASE);
+    }
+    COUNTER_ADD(metrics->requests, 1);
+    COUNTER_ADD(metrics->errors, record->failed);
+    COUNTER_ADD(metrics->bytes_in, record->bytes_in);
+    COUNTER_ADD(metrics->bytes_out, record->bytes_out);
+    histogram_record(&metrics->latency[METRICS_TOTAL], now - record->arrival);
+    histogram_record(&metrics->latency[METRICS_QUEUEING], record->start - record->arrival);
+    histogram_record(&metrics->latency[METRICS_DISK], record->phases[METRICS_DISK]);
+    histogram_record(&metrics->latency[METRICS_NETWORK], record->phases[METRICS_NETWORK]);
+}
+
+verb_metrics_t* metrics_collect () {
+    verb_metrics_t* sum = (verb_metrics_t*) calloc(METRICS_VERBS, sizeof(verb_metrics_t));
+    if (sum == NULL) return NULL;
+    for (struct metrics_record* record = __atomic_load_n(&records, __ATOMIC_ACQUIRE); record != NULL; record = record->next)
+        for (int verb = 0; verb < METRICS_VERBS; verb++) {
+            verb_metrics_t* metrics = __atomic_load_n(&record->verbs[verb], __ATOMIC_ACQUIRE);
+            if (metrics == NULL) continue;
+            sum[verb].requests += __atomic_load_n(&metrics->requests, __ATOMIC_RELAXED);
+            sum[verb].errors += __atomic_load_n(&metrics->errors, __ATOMIC_RELAXED);
+            sum[verb].bytes_in += __atomic_load_n(&metrics->bytes_in, __ATOMIC_RELAXED);
+            sum[verb].bytes_out += __atomic_load_n(&metrics->bytes_out, __ATOMIC_RELAXED);
+            for (int phase = 0; phase < METRICS_PHASES; phase++)
+                histogram_merge(&sum[verb].latency[phase], &metrics->latency[phase]);
+        }
+    return sum;
+}
+
+int metrics_in_flight () {
+    int count = 0;
+    for (struct metrics_record* record = __atomic_load_n(&records, __ATOMIC_ACQUIRE); record != NULL; record = record->next)
+        count += __atomic_load_n(&record->active, __ATOMIC_RELAXED);
+    return count;
+}
+
+void metrics_destroy () {
+    struct metrics_record* record = __atomic_exchange_n(&records, NULL, __ATOMIC_ACQ_REL);
+    while (record != NULL) {
+        struct metrics_record* next = record->next;
+        for (int verb = 0; verb < METRICS_VERBS; verb++)
+            free(record->verbs[verb]);
+        free(record);
+        record = next;
+    }
+}
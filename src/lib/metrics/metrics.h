@@ -0,0 +1,128 @@
+/**
+ * @file metrics.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria che misura le richieste servite dal server. Ogni thread di connessione scrive in un record
+ * suo, senza lock: per ogni verbo conta richieste, errori e byte ricevuti e inviati, e registra in istogrammi la latenza
+ * totale e quella delle sue fasi (attesa nel buffer della connessione, lavoro dei workers, invio e ricezione sul socket).
+ * I record dei thread terminati vengono riusati e mai liberati, quindi i contatori sono cumulativi dall'avvio del server;
+ * metrics_collect li somma mentre vengono scritti.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_METRICS)
+#define _METRICS
+
+#include <stddef.h>
+
+#include <histogram/histogram.h>
+
+/**
+ * @brief Verbi del protocollo misurati, più METRICS_OTHER per le richieste non riconosciute
+ */
+typedef enum {
+    METRICS_REGISTER, METRICS_STORE, METRICS_APPEND, METRICS_RETRIEVE, METRICS_STAT, METRICS_LIST, METRICS_PREFETCH,
+    METRICS_INITIATE, METRICS_PART, METRICS_COMPLETE, METRICS_ABORT, METRICS_DELETE, METRICS_LEAVE, METRICS_STATS, METRICS_OTHER,
+    METRICS_VERBS
+} metrics_verb_t;
+
+/**
+ * @brief Fasi di una richiesta. La latenza totale va dall'arrivo dell'header alla fine della risposta; l'attesa è il tempo
+ * passato dall'header nel buffer della connessione dietro alle richieste precedenti; il disco è il tempo passato nelle
+ * funzioni dei workers (lock dell'oggetto, indice e file); la rete è il tempo di ricezione dei dati e di invio della risposta.
+ */
+typedef enum { METRICS_TOTAL, METRICS_QUEUEING, METRICS_DISK, METRICS_NETWORK, METRICS_PHASES } metrics_phase_t;
+
+/**
+ * @brief Misure di un verbo
+ */
+typedef struct verb_metrics {
+    unsigned long requests;
+    // Richieste a cui è stato risposto con un errore
+    unsigned long errors;
+    // Byte ricevuti e inviati, compresi header e risposte
+    unsigned long bytes_in;
+    unsigned long bytes_out;
+    // Latenze in nanosecondi per fase
+    histogram_t latency[METRICS_PHASES];
+} verb_metrics_t;
+
+/**
+ * @brief Restituisce il nome di un verbo
+ */
+const char* metrics_verb_name (metrics_verb_t verb);
+
+/**
+ * @brief Restituisce il nome di una fase, in minuscolo
+ */
+const char* metrics_phase_name (metrics_phase_t phase);
+
+/**
+ * @brief Riconosce il verbo all'inizio di un header
+ * 
+ * @param header Header inviato dal client
+ * @return metrics_verb_t Verbo dell'header, METRICS_OTHER se non è riconosciuto
+ */
+metrics_verb_t metrics_verb (char* header);
+
+/**
+ * @brief Restituisce l'istante corrente in nanosecondi, da passare come inizio di una fase
+ */
+unsigned long metrics_clock ();
+
+/**
+ * @brief Inizia la misura di una richiesta del thread corrente
+ * 
+ * @param arrival Istante in cui l'header era disponibile, 0 se coincide con l'istante corrente
+ */
+void metrics_request_begin (unsigned long arrival);
+
+/**
+ * @brief Aggiunge alla fase della richiesta corrente il tempo passato da start
+ * 
+ * @param phase METRICS_DISK o METRICS_NETWORK
+ * @param start Istante di inizio ottenuto con metrics_clock
+ */
+void metrics_phase (metrics_phase_t phase, unsigned long start);
+
+/**
+ * @brief Conta dei byte ricevuti o inviati nella richiesta corrente
+ * 
+ * @param bytes_in Byte ricevuti
+ * @param bytes_out Byte inviati
+ */
+void metrics_bytes (size_t bytes_in, size_t bytes_out);
+
+/**
+ * @brief Segna come fallita la richiesta corrente
+ */
+void metrics_error ();
+
+/**
+ * @brief Termina la misura della richiesta corrente registrandola sotto il suo verbo
+ * 
+ * @param verb Verbo della richiesta
+ */
+void metrics_request_end (metrics_verb_t verb);
+
+/**
+ * @brief Somma le misure di tutti i thread
+ * 
+ * @return verb_metrics_t* Array di METRICS_VERBS elementi da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+verb_metrics_t* metrics_collect ();
+
+/**
+ * @brief Conta le richieste in corso in tutti i thread, leggendo solo un intero per record
+ * 
+ * @return int Numero di richieste iniziate e non ancora terminate
+ */
+int metrics_in_flight ();
+
+/**
+ * @brief Libera tutti i record. Va chiamata quando nessun thread misura più richieste.
+ */
+void metrics_destroy ();
+
+#endif // _METRICS
@@ -0,0 +1,511 @@
+/**
+ * @file os_async.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione dell'interfaccia asincrona della libreria client. Le richieste vengono scritte in un buffer di uscita
+ * e messe in una coda; le risposte, che il server invia nello stesso ordine, vengono lette man mano che arrivano e associate
+ * alla richiesta in testa alla coda. Ogni tipo di richiesta ha una risposta di dimensione nota (seguita dai dati per RETRIEVE),
+ * quindi basta sapere quanti byte aspettare.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <socket/socket.h>
+
+#include <os_client/os_async.h>
+
+#include <assertmacros.h>
+
+#include <shared.h>
+
+// Dimensione del buffer in cui vengono lette le risposte
+#define ASYNC_READ_SIZE (64 * 1024)
+
+// Dimensione iniziale del buffer di uscita
+#define ASYNC_WRITE_SIZE (16 * 1024)
+
+/**
+ * @brief Richiesta in attesa di risposta
+ */
+struct async_request {
+    // 1 per RETRIEVE, la cui risposta è "DATA <size> <tag> \n " seguita dai dati, 0 per le risposte "OK \n"
+    int with_data;
+    os_async_callback_t callback;
+    void* arg;
+    // Dati in ricezione per RETRIEVE
+    char* data;
+    size_t size;
+    size_t received;
+    struct async_request* next;
+};
+
+struct os_async {
+    int server_fd;
+    // Settato quando la connessione si interrompe
+    int broken;
+    // Numero di callback in esecuzione e richiesta di chiusura arrivata da una di esse, eseguita quando terminano
+    int dispatching;
+    int destroyed;
+    // Coda delle richieste in volo, nell'ordine di invio
+    struct async_request* head;
+    struct async_request* tail;
+    int pending;
+    // Header della risposta della richiesta in testa, ricevuto finora
+    char header[MAX_DATA_LENGTH];
+    size_t header_received;
+    // Buffer di uscita: i byte tra sent e length sono ancora da inviare
+    char* output;
+    size_t output_sent;
+    size_t output_length;
+    size_t output_capacity;
+    // Buffer di ingresso: i byte tra input_start e input_end sono ancora da consumare
+    char input[ASYNC_READ_SIZE];
+    size_t input_start;
+    size_t input_end;
+};
+
+/**
+ * @brief Riserva length byte in fondo al buffer di uscita, recuperando lo spazio già inviato o allargandolo se serve
+ * 
+ * @return char* Inizio dello spazio riservato, che il chiamante deve riempire. Se c'è un errore restituisce NULL e setta errno.
+ */
+static char* reserve_output (os_async_t* async, size_t length) {
+    // Sposta in testa i byte ancora da inviare
+    if (async->output_sent > 0) {
+        memmove(async->output, async->output + async->output_sent, async->output_length - async->output_sent);
+        async->output_length -= async->output_sent;
+        async->output_sent = 0;
+    }
+    size_t capacity = async->output_capacity;
+    while (async->output_length + length > capacity) capacity *= 2;
+    if (capacity != async->output_capacity) {
+        char* output = (char*) realloc(async->output, capacity);
+        ASSERT_ERRNO_RETURN(output != NULL, ENOMEM, NULL);
+        async->output = output;
+        async->output_capacity = capacity;
+    }
+    char* space = async->output + async->output_length;
+    async->output_length += length;
+    return space;
+}
+
+/**
+ * @brief Accoda una richiesta: scrive header e dati nel buffer di uscita e la mette in fondo alla coda
+ * 
+ * @return int 1 se la richiesta è stata accodata. Se c'è un errore restituisce 0 e setta errno.
+ */
+static int submit (os_async_t* async, char* header, void* block, size_t len, int with_data, os_async_callback_t callback, void* arg) {
+    ASSERT_ERRNO_RETURN(!async->broken && !async->destroyed, ENOTCONN, 0);
+    struct async_request* request = (struct async_request*) calloc(1, sizeof(struct async_request));
+    ASSERT_ERRNO_RETURN(request != NULL, ENOMEM, 0);
+    request->with_data = with_data;
+    request->callback = callback;
+    request->arg = arg;
+    // Header e dati vengono riservati insieme, così che non resti mai un header senza i suoi dati
+    char* space = reserve_output(async, MAX_HEADER_LENGTH + len);
+    ASSERT(space != NULL, free(request); return 0);
+    memcpy(space, header, MAX_HEADER_LENGTH);
+    if (len > 0) memcpy(space + MAX_HEADER_LENGTH, block, len);
+    if (async->tail != NULL) async->tail->next = request;
+    else async->head = request;
+    async->tail = request;
+    async->pending++;
+    return 1;
+}
+
+/**
+ * @brief Toglie la richiesta in testa alla coda e chiama la sua callback
+ */
+static void complete_head (os_async_t* async, int error, void* data, size_t size) {
+    struct async_request* request = async->head;
+    async->head = request->next;
+    if (async->head == NULL) async->tail = NULL;
+    async->pending--;
+    async->header_received = 0;
+    // La richiesta è già fuori dalla coda, quindi la callback può accodarne di nuove
+    async->dispatching++;
+    if (request->callback != NULL) request->callback(request->arg, error, data, size);
+    else free(data);
+    async->dispatching--;
+    free(request);
+}
+
+/**
+ * @brief Completa tutte le richieste in volo con un errore
+ */
+static void fail_all (os_async_t* async, int error) {
+    while (async->head != NULL) {
+        free(async->head->data);
+        async->head->data = NULL;
+        complete_head(async, error, NULL, 0);
+    }
+}
+
+/**
+ * @brief Segna la connessione come interrotta e completa le richieste in volo con l'errore
+ * 
+ * @return int -1, con errno settato all'errore.
+ */
+static int break_connection (os_async_t* async, int error) {
+    async->broken = 1;
+    fail_all(async, error);
+    errno = error;
+    return -1;
+}
+
+/**
+ * @brief Interpreta l'header completo della risposta in testa. Le risposte senza dati completano subito la richiesta,
+ * quelle con dati preparano il buffer in cui riceverli.
+ * 
+ * @return int 1 se la richiesta è stata completata, 0 se restano dati da ricevere. Se la risposta non è valida restituisce -1 e setta errno.
+ */
+static int parse_header (os_async_t* async) {
+    struct async_request* request = async->head;
+    size_t header_size = request->with_data ? MAX_DATA_LENGTH : MAX_RESPONSE_LENGTH;
+    async->header[header_size - 1] = '\0';
+    int code = 0;
+    if (sscanf(async->header, "KO %d", &code) == 1) {
+        complete_head(async, (code > 0) ? code : EPROTO, NULL, 0);
+        return 1;
+    }
+    if (!request->with_data) {
+        ASSERT_ERRNO_RETURN(strcmp(async->header, "OK \n") == 0, EPROTO, -1);
+        complete_head(async, 0, NULL, 0);
+        return 1;
+    }
+    size_t size = 0;
+    ASSERT_ERRNO_RETURN(sscanf(async->header, "DATA %zu", &size) == 1, EPROTO, -1);
+    request->data = (char*) malloc(size + 1);
+    ASSERT_ERRNO_RETURN(request->data != NULL, ENOMEM, -1);
+    request->data[size] = '\0';
+    request->size = size;
+    request->received = 0;
+    // Un oggetto vuoto non è valido, come per os_retrieve
+    if (size == 0) {
+        free(request->data);
+        request->data = NULL;
+        complete_head(async, ENODATA, NULL, 0);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Consuma i byte presenti nel buffer di ingresso, completando le richieste di cui è arrivata tutta la risposta
+ * 
+ * @return int Numero di richieste completate. Se la risposta non è valida restituisce -1 e setta errno.
+ */
+static int consume_input (os_async_t* async) {
+    int completed = 0;
+    while ((async->head != NULL) && (async->input_start < async->input_end) && !async->destroyed) {
+        struct async_request* request = async->head;
+        size_t available = async->input_end - async->input_start;
+        char* bytes = async->input + async->input_start;
+        // Riceve i dati di una RETRIEVE il cui header è già stato interpretato
+        if (request->data != NULL) {
+            size_t chunk = request->size - request->received;
+            if (chunk > available) chunk = available;
+            memcpy(request->data + request->received, bytes, chunk);
+            request->received += chunk;
+            async->input_start += chunk;
+            if (request->received == request->size) {
+                char* data = request->data;
+                request->data = NULL;
+                complete_head(async, 0, data, request->size);
+                completed++;
+            }
+            continue;
+        }
+        // Altrimenti riceve l'header della risposta
+        size_t header_size = request->with_data ? MAX_DATA_LENGTH : MAX_RESPONSE_LENGTH;
+        size_t chunk = header_size - async->header_received;
+        if (chunk > available) chunk = available;
+        memcpy(async->header + async->header_received, bytes, chunk);
+        async->header_received += chunk;
+        async->input_start += chunk;
+        if (async->header_received < header_size) break;
+        int result = parse_header(async);
+        ASSERT_RETURN(result != -1, -1);
+        completed += result;
+    }
+    // Se una callback ha chiuso la connessione il resto dell'ingresso non serve più
+    if (async->destroyed) return completed;
+    // Il server non invia niente che non sia stato chiesto
+    ASSERT_ERRNO_RETURN(async->input_start == async->input_end, EPROTO, -1);
+    async->input_start = async->input_end = 0;
+    return completed;
+}
+
+/**
+ * @brief Apre una connessione asincrona e vi registra l'utente. La registrazione è sincrona, poi il socket diventa non bloccante.
+ * 
+ * @param name Nome dell'utente da connettere
+ * @return os_async_t* Connessione aperta. Se c'è un errore restituisce NULL e setta errno.
+ */
+os_async_t* os_async_create (char* name) {
+    ASSERT_ERRNO_RETURN(name != NULL, EINVAL, NULL);
+    os_async_t* async = (os_async_t*) calloc(1, sizeof(os_async_t));
+    ASSERT_ERRNO_RETURN(async != NULL, ENOMEM, NULL);
+    async->output = (char*) malloc(ASYNC_WRITE_SIZE);
+    ASSERT_ERRNO(async->output != NULL, ENOMEM, free(async); return NULL);
+    async->output_capacity = ASYNC_WRITE_SIZE;
+    // Si collega al server e si registra
+    async->server_fd = create_client_socket(SOCKET_NAME);
+    ASSERT(async->server_fd != -1, free(async->output); free(async); return NULL);
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    snprintf(header, MAX_HEADER_LENGTH, "REGISTER %s \n", name);
+    char response[MAX_RESPONSE_LENGTH];
+    int success = send_message(async->server_fd, header, MAX_HEADER_LENGTH);
+    if (success != -1) success = receive_message_into(async->server_fd, response, MAX_RESPONSE_LENGTH);
+    if (success != -1) {
+        response[MAX_RESPONSE_LENGTH - 1] = '\0';
+        int code = 0;
+        if (strcmp(response, "OK \n") != 0) {
+            errno = ((sscanf(response, "KO %d", &code) == 1) && (code > 0)) ? code : EPROTO;
+            success = -1;
+        }
+    }
+    // Da qui in poi il socket non blocca mai il chiamante
+    if (success != -1) {
+        int flags = fcntl(async->server_fd, F_GETFL);
+        success = ((flags != -1) && (fcntl(async->server_fd, F_SETFL, flags | O_NONBLOCK) != -1)) ? 0 : -1;
+    }
+    if (success == -1) {
+        int error = errno;
+        close_socket(async->server_fd);
+        free(async->output);
+        free(async);
+        errno = error;
+        return NULL;
+    }
+    return async;
+}
+
+/**
+ * @brief Chiude la connessione e libera la memoria, completando con ECANCELED le richieste ancora in volo.
+ * Le callback che chiamano os_async_destroy durante la chiusura non hanno effetto.
+ * 
+ * @return int 1 se la disconnessione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
+ */
+static int close_async (os_async_t* async) {
+    async->destroyed = 1;
+    fail_all(async, ECANCELED);
+    int success = 0;
+    if (!async->broken) {
+        // Il LEAVE viene inviato solo se il buffer di uscita è vuoto, altrimenti arriverebbe in mezzo a una richiesta
+        if (async->output_sent == async->output_length) {
+            char leave_string[MAX_HEADER_LENGTH] = "LEAVE \n";
+            success = (send(async->server_fd, leave_string, MAX_HEADER_LENGTH, MSG_NOSIGNAL) == MAX_HEADER_LENGTH) ? 0 : -1;
+        }
+    }
+    if (close_socket(async->server_fd) != 0) success = -1;
+    free(async->output);
+    free(async);
+    return (success == 0);
+}
+
+/**
+ * @brief Chiude la connessione se una callback lo ha chiesto e nessuna callback è più in esecuzione.
+ * 
+ * @return int 1 se la connessione è stata chiusa e async non è più valido, altrimenti 0.
+ */
+static int close_if_destroyed (os_async_t* async) {
+    if (!async->destroyed || (async->dispatching > 0)) return 0;
+    int error = errno;
+    close_async(async);
+    errno = error;
+    return 1;
+}
+
+/**
+ * @brief Chiude la connessione. Le richieste ancora in volo vengono completate con l'errore ECANCELED.
+ * Se viene chiamata da una callback la chiusura è rimandata al ritorno di os_async_process o os_async_wait,
+ * che non chiamano altre callback se non quelle delle richieste cancellate; la connessione non va più usata.
+ * 
+ * @param async Connessione da chiudere
+ * @return int 1 se la disconnessione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_async_destroy (os_async_t* async) {
+    ASSERT_ERRNO_RETURN(async != NULL, EINVAL, 0);
+    if (async->dispatching > 0) {
+        async->destroyed = 1;
+        return 1;
+    }
+    return close_async(async);
+}
+
+/**
+ * @brief Restituisce il file descriptor da sorvegliare nel loop di eventi
+ * 
+ * @param async Connessione
+ * @return int File descriptor del socket
+ */
+int os_async_fd (os_async_t* async) {
+    return async->server_fd;
+}
+
+/**
+ * @brief Restituisce gli eventi da sorvegliare sul file descriptor: POLLIN se ci sono richieste in attesa di risposta, più POLLOUT
+ * se ci sono dati ancora da inviare.
+ * 
+ * @param async Connessione
+ * @return short Maschera di eventi, 0 se non c'è niente da aspettare
+ */
+short os_async_events (os_async_t* async) {
+    if (async->broken) return 0;
+    short events = 0;
+    if (async->pending > 0) events |= POLLIN;
+    if (async->output_sent < async->output_length) events |= POLLOUT;
+    return events;
+}
+
+/**
+ * @brief Restituisce il numero di richieste non ancora completate
+ * 
+ * @param async Connessione
+ * @return int Numero di richieste in volo
+ */
+int os_async_pending (os_async_t* async) {
+    return async->pending;
+}
+
+/**
+ * @brief Invia quello che il socket accetta, legge le risposte disponibili e chiama le callback delle richieste completate,
+ * senza mai bloccarsi e senza chiudere la connessione se una callback lo chiede.
+ * 
+ * @return int Numero di richieste completate. Se la connessione si è interrotta restituisce -1 e setta errno.
+ */
+static int process (os_async_t* async) {
+    ASSERT_ERRNO_RETURN(!async->broken && !async->destroyed, ENOTCONN, -1);
+    // Invia il più possibile del buffer di uscita
+    while (async->output_sent < async->output_length) {
+        ssize_t written = send(async->server_fd, async->output + async->output_sent, async->output_length - async->output_sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) break;
+            return break_connection(async, errno);
+        }
+        async->output_sent += written;
+    }
+    // Legge le risposte disponibili, consumandole man mano
+    int completed = 0;
+    while ((async->pending > 0) && !async->destroyed) {
+        ssize_t bytes_read = read(async->server_fd, async->input, ASYNC_READ_SIZE);
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) break;
+            return break_connection(async, errno);
+        }
+        if (bytes_read == 0) return break_connection(async, ECONNRESET);
+        async->input_start = 0;
+        async->input_end = (size_t) bytes_read;
+        int result = consume_input(async);
+        if (result == -1) return break_connection(async, errno);
+        completed += result;
+    }
+    return completed;
+}
+
+/**
+ * @brief Invia quello che il socket accetta, legge le risposte disponibili e chiama le callback delle richieste completate,
+ * senza mai bloccarsi. Se una callback ha chiuso la connessione la chiude al ritorno delle callback.
+ * 
+ * @param async Connessione
+ * @return int Numero di richieste completate. Se la connessione si è interrotta restituisce -1 e setta errno.
+ */
+int os_async_process (os_async_t* async) {
+    ASSERT_ERRNO_RETURN(async != NULL, EINVAL, -1);
+    int completed = process(async);
+    close_if_destroyed(async);
+    return completed;
+}
+
+/**
+ * @brief Accoda la memorizzazione di un blocco. I dati vengono copiati, quindi block può essere riusato subito.
+ * 
+ * @param async Connessione
+ * @param name Nome del blocco da memorizzare
+ * @param block Dati del blocco
+ * @param len Lunghezza del blocco
+ * @param callback Funzione chiamata al completamento, può essere NULL
+ * @param arg Argomento della callback
+ * @return int 1 se la richiesta è stata accodata. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_async_store (os_async_t* async, char* name, void* block, size_t len, os_async_callback_t callback, void* arg) {
+    ASSERT_ERRNO_RETURN((async != NULL) && (name != NULL) && (strlen(name) < 256) && (block != NULL) && (len > 0), EINVAL, 0);
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "STORE %s %zu \n ", name, len);
+    return submit(async, header, block, len, 0, callback, arg);
+}
+
+/**
+ * @brief Accoda il recupero di un blocco, che viene passato alla callback
+ * 
+ * @param async Connessione
+ * @param name Nome del blocco da recuperare
+ * @param callback Funzione chiamata al completamento
+ * @param arg Argomento della callback
+ * @return int 1 se la richiesta è stata accodata. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_async_retrieve (os_async_t* async, char* name, os_async_callback_t callback, void* arg) {
+    ASSERT_ERRNO_RETURN((async != NULL) && (name != NULL) && (strlen(name) < 256), EINVAL, 0);
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "RETRIEVE %s \n", name);
+    return submit(async, header, NULL, 0, 1, callback, arg);
+}
+
+/**
+ * @brief Accoda la cancellazione di un blocco
+ * 
+ * @param async Connessione
+ * @param name Nome del blocco da cancellare
+ * @param callback Funzione chiamata al completamento, può essere NULL
+ * @param arg Argomento della callback
+ * @return int 1 se la richiesta è stata accodata. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_async_delete (os_async_t* async, char* name, os_async_callback_t callback, void* arg) {
+    ASSERT_ERRNO_RETURN((async != NULL) && (name != NULL) && (strlen(name) < 256), EINVAL, 0);
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "DELETE %s \n", name);
+    return submit(async, header, NULL, 0, 0, callback, arg);
+}
+
+/**
+ * @brief Aspetta con poll che tutte le richieste in volo siano completate, per chi non ha un proprio loop di eventi
+ * 
+ * @param async Connessione
+ * @return int 1 se tutte le richieste sono state completate. Se la connessione si è interrotta restituisce 0 e setta errno
+ * (ECANCELED se è stata chiusa da una callback).
+ */
+int os_async_wait (os_async_t* async) {
+    ASSERT_ERRNO_RETURN(async != NULL, EINVAL, 0);
+    while ((async->pending > 0) && !async->destroyed) {
+        struct pollfd pfd = { async->server_fd, os_async_events(async), 0 };
+        if (poll(&pfd, 1, -1) == -1) {
+            ASSERT_RETURN(errno == EINTR, 0);
+            continue;
+        }
+        int completed = process(async);
+        ASSERT_ERRNO_RETURN(!close_if_destroyed(async), ECANCELED, 0);
+        ASSERT_RETURN(completed != -1, 0);
+    }
+    ASSERT_ERRNO_RETURN(!async->destroyed, ECANCELED, 0);
+    return 1;
+}
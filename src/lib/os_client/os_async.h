@@ -0,0 +1,133 @@
+/**
+ * @file os_async.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header dell'interfaccia asincrona della libreria client. Le richieste vengono accodate senza attendere il server e
+ * completate da una callback; il socket della connessione è non bloccante e va sorvegliato dal loop di eventi del chiamante
+ * (poll, select o epoll) con gli eventi indicati da os_async_events, chiamando os_async_process quando è pronto.
+ * Il server risponde alle richieste di una connessione nell'ordine in cui le riceve, quindi se ne possono avere molte in volo
+ * contemporaneamente. Un os_async_t non è thread-safe: va usato dal solo thread del loop di eventi.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_OS_ASYNC)
+#define _OS_ASYNC
+
+#include <stddef.h>
+
+/**
+ * @brief Connessione asincrona con il server
+ */
+typedef struct os_async os_async_t;
+
+/**
+ * @brief Funzione chiamata al completamento di una richiesta.
+ * 
+ * @param arg Argomento passato all'invio della richiesta
+ * @param error 0 se la richiesta ha avuto successo, altrimenti il codice di errore
+ * @param data Per una os_async_retrieve riuscita i dati ricevuti, terminati da un '\0' in più, che appartengono alla callback
+ * e vanno liberati con free. Altrimenti NULL.
+ * @param size Dimensione dei dati
+ */
+typedef void (*os_async_callback_t) (void* arg, int error, void* data, size_t size);
+
+/**
+ * @brief Apre una connessione asincrona e vi registra l'utente. La registrazione è sincrona, poi il socket diventa non bloccante.
+ * 
+ * @param name Nome dell'utente da connettere
+ * @return os_async_t* Connessione aperta. Se c'è un errore restituisce NULL e setta errno.
+ */
+os_async_t* os_async_create (char* name);
+
+/**
+ * @brief Chiude la connessione. Le richieste ancora in volo vengono completate con l'errore ECANCELED.
+ * Se viene chiamata da una callback la chiusura è rimandata al ritorno di os_async_process o os_async_wait,
+ * che non chiamano altre callback se non quelle delle richieste cancellate; la connessione non va più usata.
+ * 
+ * @param async Connessione da chiudere
+ * @return int 1 se la disconnessione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_async_destroy (os_async_t* async);
+
+/**
+ * @brief Restituisce il file descriptor da sorvegliare nel loop di eventi
+ * 
+ * @param async Connessione
+ * @return int File descriptor del socket
+ */
+int os_async_fd (os_async_t* async);
+
+/**
+ * @brief Restituisce gli eventi da sorvegliare sul file descriptor: POLLIN se ci sono richieste in attesa di risposta, più POLLOUT
+ * se ci sono dati ancora da inviare. I valori coincidono con EPOLLIN ed EPOLLOUT, quindi vanno bene anche per epoll_ctl.
+ * 
+ * @param async Connessione
+ * @return short Maschera di eventi, 0 se non c'è niente da aspettare
+ */
+short os_async_events (os_async_t* async);
+
+/**
+ * @brief Restituisce il numero di richieste non ancora completate
+ * 
+ * @param async Connessione
+ * @return int Numero di richieste in volo
+ */
+int os_async_pending (os_async_t* async);
+
+/**
+ * @brief Invia quello che il socket accetta, legge le risposte disponibili e chiama le callback delle richieste completate,
+ * senza mai bloccarsi. Va chiamata quando il file descriptor è pronto per uno degli eventi di os_async_events.
+ * Se la connessione si interrompe tutte le richieste in volo vengono completate con l'errore. Se una callback ha chiamato
+ * os_async_destroy la connessione viene chiusa prima di tornare e async non è più valido.
+ * 
+ * @param async Connessione
+ * @return int Numero di richieste completate. Se la connessione si è interrotta restituisce -1 e setta errno.
+ */
+int os_async_process (os_async_t* async);
+
+/**
+ * @brief Accoda la memorizzazione di un blocco. I dati vengono copiati, quindi block può essere riusato subito.
+ * 
+ * @param async Connessione
+ * @param name Nome del blocco da memorizzare
+ * @param block Dati del blocco
+ * @param len Lunghezza del blocco
+ * @param callback Funzione chiamata al completamento, può essere NULL
+ * @param arg Argomento della callback
+ * @return int 1 se la richiesta è stata accodata. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_async_store (os_async_t* async, char* name, void* block, size_t len, os_async_callback_t callback, void* arg);
+
+/**
+ * @brief Accoda il recupero di un blocco, che viene passato alla callback
+ * 
+ * @param async Connessione
+ * @param name Nome del blocco da recuperare
+ * @param callback Funzione chiamata al completamento
+ * @param arg Argomento della callback
+ * @return int 1 se la richiesta è stata accodata. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_async_retrieve (os_async_t* async, char* name, os_async_callback_t callback, void* arg);
+
+/**
+ * @brief Accoda la cancellazione di un blocco
+ * 
+ * @param async Connessione
+ * @param name Nome del blocco da cancellare
+ * @param callback Funzione chiamata al completamento, può essere NULL
+ * @param arg Argomento della callback
+ * @return int 1 se la richiesta è stata accodata. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_async_delete (os_async_t* async, char* name, os_async_callback_t callback, void* arg);
+
+/**
+ * @brief Aspetta con poll che tutte le richieste in volo siano completate, per chi non ha un proprio loop di eventi
+ * 
+ * @param async Connessione
+ * @return int 1 se tutte le richieste sono state completate. Se la connessione si è interrotta restituisce 0 e setta errno
+ * (ECANCELED se è stata chiusa da una callback).
+ */
+int os_async_wait (os_async_t* async);
+
+#endif // _OS_ASYNC
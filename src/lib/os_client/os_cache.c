@@ -0,0 +1,323 @@
+/**
+ * @file os_cache.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della cache lato client degli oggetti recuperati. Gli oggetti sono in una tabella hash per nome e
+ * in una lista ordinata per uso, dalla quale vengono scartati a partire dal meno recente quando si supera la capacità.
+ * La mutex non viene tenuta durante le richieste al server, così che letture di oggetti diversi procedano in parallelo.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include <os_client/os_cache.h>
+#include <hashtable/typed_hashtable.h>
+
+#include <assertmacros.h>
+#include <mutexmacros.h>
+
+#include <shared.h>
+
+/**
+ * @brief Oggetto in cache
+ */
+struct cache_entry {
+    char* name;
+    // Dati dell'oggetto, terminati da un '\0' in più
+    char* data;
+    size_t size;
+    char tag[TAG_LENGTH + 1];
+    // Istante dell'ultima validazione con il server, in millisecondi
+    long validated;
+    // Lista degli oggetti ordinata dal più al meno recentemente usato
+    struct cache_entry* prev;
+    struct cache_entry* next;
+};
+
+TYPED_HASHTABLE(entry_map, const char*, struct cache_entry*, string_hash, string_equals)
+
+/**
+ * @brief Cache degli oggetti di un client
+ */
+struct os_cache {
+    os_client_t* client;
+    size_t capacity;
+    long ttl_ms;
+    entry_map_t* entries;
+    // Estremi della lista per uso: in testa il più recente, in coda il primo da scartare
+    struct cache_entry* head;
+    struct cache_entry* tail;
+    os_cache_stats_t stats;
+    pthread_mutex_t mutex;
+};
+
+/**
+ * @brief Restituisce l'istante attuale di un orologio monotono in millisecondi
+ */
+static long now_ms () {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Toglie un oggetto dalla lista per uso
+ */
+static void lru_unlink (os_cache_t* cache, struct cache_entry* entry) {
+    if (entry->prev != NULL) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next != NULL) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+/**
+ * @brief Mette un oggetto in testa alla lista per uso
+ */
+static void lru_push (os_cache_t* cache, struct cache_entry* entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head != NULL) cache->head->prev = entry;
+    else cache->tail = entry;
+    cache->head = entry;
+}
+
+/**
+ * @brief Toglie un oggetto dalla cache e lo libera. Va chiamata con la mutex acquisita.
+ */
+static void remove_entry (os_cache_t* cache, struct cache_entry* entry) {
+    entry_map_remove(cache->entries, entry->name, NULL);
+    lru_unlink(cache, entry);
+    cache->stats.objects--;
+    cache->stats.bytes -= entry->size;
+    free(entry->name);
+    free(entry->data);
+    free(entry);
+}
+
+/**
+ * @brief Segna un oggetto come usato e ne restituisce una copia. Va chiamata con la mutex acquisita.
+ * 
+ * @return void* Copia dei dati, terminata da un '\0' in più. Se manca memoria restituisce NULL e setta errno.
+ */
+static void* use_entry (os_cache_t* cache, struct cache_entry* entry, size_t* size_ptr) {
+    lru_unlink(cache, entry);
+    lru_push(cache, entry);
+    char* copy = (char*) malloc(entry->size + 1);
+    ASSERT_ERRNO_RETURN(copy != NULL, ENOMEM, NULL);
+    memcpy(copy, entry->data, entry->size + 1);
+    if (size_ptr != NULL) *size_ptr = entry->size;
+    return copy;
+}
+
+/**
+ * @brief Conserva in cache la versione ricevuta di un oggetto, sostituendo la precedente e scartando gli oggetti usati meno
+ * di recente finché non si rientra nella capacità. Va chiamata con la mutex acquisita.
+ * 
+ * @param data Dati ricevuti, che passano alla cache se l'oggetto viene conservato
+ * @return int 1 se l'oggetto è stato conservato, 0 se i dati restano del chiamante
+ */
+static int insert_entry (os_cache_t* cache, char* name, char* data, size_t size, char* tag) {
+    struct cache_entry** found = entry_map_find(cache->entries, name);
+    if (found != NULL) remove_entry(cache, *found);
+    // Senza tag la versione non si può validare, e un oggetto più grande della cache la svuoterebbe
+    if ((tag[0] == '\0') || (size > cache->capacity)) return 0;
+    struct cache_entry* entry = (struct cache_entry*) malloc(sizeof(struct cache_entry));
+    if (entry == NULL) return 0;
+    entry->name = strdup(name);
+    if (entry->name == NULL) {
+        free(entry);
+        return 0;
+    }
+    if (entry_map_insert(cache->entries, entry->name, entry) == -1) {
+        free(entry->name);
+        free(entry);
+        return 0;
+    }
+    entry->data = data;
+    entry->size = size;
+    strcpy(entry->tag, tag);
+    entry->validated = now_ms();
+    lru_push(cache, entry);
+    cache->stats.objects++;
+    cache->stats.bytes += size;
+    // Scarta dalla coda, senza mai togliere l'oggetto appena inserito che sta in testa
+    while (cache->stats.bytes > cache->capacity) {
+        remove_entry(cache, cache->tail);
+        cache->stats.evicted++;
+    }
+    return 1;
+}
+
+/**
+ * @brief Crea una cache per gli oggetti letti con il client passato
+ * 
+ * @param client Client con cui comunicare con il server, che deve restare valido finché la cache non viene liberata
+ * @param capacity Numero massimo di byte di dati in cache. Gli oggetti più grandi non vengono conservati.
+ * @param ttl_ms Millisecondi per cui un oggetto validato viene considerato attuale senza chiedere al server, 0 per validarlo ad ogni lettura
+ * @return os_cache_t* Cache vuota. Se c'è un errore restituisce NULL e setta errno.
+ */
+os_cache_t* os_cache_create (os_client_t* client, size_t capacity, long ttl_ms) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((client != NULL) && (capacity > 0) && (ttl_ms >= 0), EINVAL, NULL);
+    os_cache_t* cache = (os_cache_t*) calloc(1, sizeof(os_cache_t));
+    ASSERT_ERRNO_RETURN(cache != NULL, ENOMEM, NULL);
+    cache->client = client;
+    cache->capacity = capacity;
+    cache->ttl_ms = ttl_ms;
+    cache->entries = entry_map_create();
+    ASSERT(cache->entries != NULL, free(cache); return NULL);
+    ASSERT((errno = pthread_mutex_init(&cache->mutex, NULL)) == 0, entry_map_destroy(cache->entries); free(cache); return NULL);
+    return cache;
+}
+
+/**
+ * @brief Libera la cache e gli oggetti che contiene, ma non il client
+ * 
+ * @param cache Cache da liberare
+ */
+void os_cache_destroy (os_cache_t* cache) {
+    if (cache == NULL) return;
+    while (cache->head != NULL)
+        remove_entry(cache, cache->head);
+    entry_map_destroy(cache->entries);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+/**
+ * @brief Recupera un oggetto dalla cache se è ancora attuale, altrimenti dal server, conservandone la nuova versione.
+ * Se il TTL è scaduto si chiede al server l'oggetto solo se il tag è cambiato: se non lo è la risposta non contiene i dati.
+ * 
+ * @param cache Cache da usare
+ * @param name Nome del blocco di dati
+ * @param size_ptr Se non è NULL vi viene scritta la dimensione del blocco
+ * @return void* Copia del blocco, terminata da un '\0' in più, da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+void* os_cache_retrieve (os_cache_t* cache, char* name, size_t* size_ptr) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((cache != NULL) && (name != NULL), EINVAL, NULL);
+    char tag[TAG_LENGTH + 1];
+    LOCK_ACQUIRE(&cache->mutex, return NULL);
+    struct cache_entry** found = entry_map_find(cache->entries, name);
+    if (found != NULL) {
+        struct cache_entry* entry = *found;
+        // Entro il TTL l'oggetto si considera attuale senza chiedere al server
+        if ((cache->ttl_ms > 0) && (now_ms() - entry->validated < cache->ttl_ms)) {
+            cache->stats.hits++;
+            void* copy = use_entry(cache, entry, size_ptr);
+            LOCK_RELEASE(&cache->mutex, free(copy); return NULL);
+            return copy;
+        }
+        strcpy(tag, entry->tag);
+    }
+    else tag[0] = '\0';
+    LOCK_RELEASE(&cache->mutex, return NULL);
+    while (1) {
+        // La richiesta al server avviene senza la mutex
+        char requested[TAG_LENGTH + 1];
+        strcpy(requested, tag);
+        size_t size = 0;
+        char* data = (char*) os_client_retrieve_if_none_match(cache->client, name, tag, &size);
+        int error = errno;
+        LOCK_ACQUIRE(&cache->mutex, free(data); return NULL);
+        found = entry_map_find(cache->entries, name);
+        if ((data == NULL) && (error == EALREADY)) {
+            // La versione posseduta è attuale, se nel frattempo non è stata scartata o sostituita
+            if ((found != NULL) && EQUALS((*found)->tag, requested)) {
+                cache->stats.validated++;
+                (*found)->validated = now_ms();
+                void* copy = use_entry(cache, *found, size_ptr);
+                LOCK_RELEASE(&cache->mutex, free(copy); return NULL);
+                return copy;
+            }
+            // Altrimenti la si chiede di nuovo senza condizione
+            LOCK_RELEASE(&cache->mutex, return NULL);
+            tag[0] = '\0';
+            continue;
+        }
+        if (data == NULL) {
+            // Lo stato dell'oggetto sul server non è noto, quindi la versione in cache non è più affidabile
+            if (found != NULL) remove_entry(cache, *found);
+            LOCK_RELEASE(&cache->mutex, );
+            errno = error;
+            return NULL;
+        }
+        cache->stats.fetched++;
+        // Se l'oggetto viene conservato i dati passano alla cache e al chiamante va una copia
+        char* result = data;
+        if (insert_entry(cache, name, data, size, tag)) {
+            result = (char*) malloc(size + 1);
+            if (result != NULL) memcpy(result, data, size + 1);
+            else errno = ENOMEM;
+        }
+        LOCK_RELEASE(&cache->mutex, free(result); return NULL);
+        if ((result != NULL) && (size_ptr != NULL)) *size_ptr = size;
+        return result;
+    }
+}
+
+/**
+ * @brief Memorizza un blocco sul server con os_client_store e toglie dalla cache la versione precedente
+ * 
+ * @return int 1 se la memorizzazione è andata a buon fine. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_cache_store (os_cache_t* cache, char* name, void* block, size_t len) {
+    ASSERT_ERRNO_RETURN(cache != NULL, EINVAL, 0);
+    int success = os_client_store(cache->client, name, block, len);
+    int error = errno;
+    // Anche se la memorizzazione fallisce l'oggetto sul server potrebbe essere cambiato
+    if (name != NULL) os_cache_invalidate(cache, name);
+    errno = error;
+    return success;
+}
+
+/**
+ * @brief Cancella un blocco dal server con os_client_delete e lo toglie dalla cache
+ * 
+ * @return int 1 se l'eliminazione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_cache_delete (os_cache_t* cache, char* name) {
+    ASSERT_ERRNO_RETURN(cache != NULL, EINVAL, 0);
+    int success = os_client_delete(cache->client, name);
+    int error = errno;
+    if (name != NULL) os_cache_invalidate(cache, name);
+    errno = error;
+    return success;
+}
+
+/**
+ * @brief Toglie un oggetto dalla cache, così che la prossima lettura lo riceva dal server
+ * 
+ * @param cache Cache da usare
+ * @param name Nome del blocco di dati
+ */
+void os_cache_invalidate (os_cache_t* cache, char* name) {
+    if ((cache == NULL) || (name == NULL)) return;
+    LOCK_ACQUIRE(&cache->mutex, return);
+    struct cache_entry** found = entry_map_find(cache->entries, name);
+    if (found != NULL) remove_entry(cache, *found);
+    LOCK_RELEASE(&cache->mutex, );
+}
+
+/**
+ * @brief Legge i contatori della cache
+ * 
+ * @param cache Cache da usare
+ * @param stats_ptr Puntatore in cui scrivere i contatori
+ */
+void os_cache_get_stats (os_cache_t* cache, os_cache_stats_t* stats_ptr) {
+    if ((cache == NULL) || (stats_ptr == NULL)) return;
+    LOCK_ACQUIRE(&cache->mutex, return);
+    *stats_ptr = cache->stats;
+    LOCK_RELEASE(&cache->mutex, );
+}
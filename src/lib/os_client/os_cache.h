@@ -0,0 +1,101 @@
+/**
+ * @file os_cache.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della cache lato client degli oggetti recuperati. Ogni oggetto viene conservato con il tag della sua versione:
+ * una lettura successiva, se l'oggetto è stato validato da meno del TTL, viene servita dalla memoria senza contattare
+ * il server; altrimenti viene rivalidato con una RETRIEVE condizionata, a cui il server risponde senza inviare i dati se
+ * la versione non è cambiata. La cache ha una dimensione massima in byte e scarta gli oggetti usati meno di recente.
+ * Può essere usata da più thread contemporaneamente, come il client su cui si appoggia.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_OS_CACHE)
+#define _OS_CACHE
+
+#include <stddef.h>
+
+#include <os_client/os_client.h>
+
+/**
+ * @brief Cache degli oggetti di un client
+ */
+typedef struct os_cache os_cache_t;
+
+/**
+ * @brief Contatori della cache
+ */
+typedef struct os_cache_stats {
+    // Letture servite dalla memoria entro il TTL, senza contattare il server
+    unsigned long hits;
+    // Letture per cui il server ha confermato che la versione posseduta è quella attuale
+    unsigned long validated;
+    // Letture per cui i dati sono stati ricevuti dal server
+    unsigned long fetched;
+    // Oggetti scartati per fare spazio
+    unsigned long evicted;
+    // Oggetti e byte attualmente in cache
+    unsigned long objects;
+    size_t bytes;
+} os_cache_stats_t;
+
+/**
+ * @brief Crea una cache per gli oggetti letti con il client passato
+ * 
+ * @param client Client con cui comunicare con il server, che deve restare valido finché la cache non viene liberata
+ * @param capacity Numero massimo di byte di dati in cache. Gli oggetti più grandi non vengono conservati.
+ * @param ttl_ms Millisecondi per cui un oggetto validato viene considerato attuale senza chiedere al server, 0 per validarlo ad ogni lettura
+ * @return os_cache_t* Cache vuota. Se c'è un errore restituisce NULL e setta errno.
+ */
+os_cache_t* os_cache_create (os_client_t* client, size_t capacity, long ttl_ms);
+
+/**
+ * @brief Libera la cache e gli oggetti che contiene, ma non il client
+ * 
+ * @param cache Cache da liberare
+ */
+void os_cache_destroy (os_cache_t* cache);
+
+/**
+ * @brief Recupera un oggetto dalla cache se è ancora attuale, altrimenti dal server, conservandone la nuova versione.
+ * 
+ * @param cache Cache da usare
+ * @param name Nome del blocco di dati
+ * @param size_ptr Se non è NULL vi viene scritta la dimensione del blocco
+ * @return void* Copia del blocco, terminata da un '\0' in più, da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+void* os_cache_retrieve (os_cache_t* cache, char* name, size_t* size_ptr);
+
+/**
+ * @brief Memorizza un blocco sul server con os_client_store e toglie dalla cache la versione precedente
+ * 
+ * @return int 1 se la memorizzazione è andata a buon fine. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_cache_store (os_cache_t* cache, char* name, void* block, size_t len);
+
+/**
+ * @brief Cancella un blocco dal server con os_client_delete e lo toglie dalla cache
+ * 
+ * @return int 1 se l'eliminazione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_cache_delete (os_cache_t* cache, char* name);
+
+/**
+ * @brief Toglie un oggetto dalla cache, così che la prossima lettura lo riceva dal server. Serve quando l'oggetto è stato
+ * modificato senza passare dalla cache.
+ * 
+ * @param cache Cache da usare
+ * @param name Nome del blocco di dati
+ */
+void os_cache_invalidate (os_cache_t* cache, char* name);
+
+/**
+ * @brief Legge i contatori della cache
+ * 
+ * @param cache Cache da usare
+ * @param stats_ptr Puntatore in cui scrivere i contatori
+ */
+void os_cache_get_stats (os_cache_t* cache, os_cache_stats_t* stats_ptr);
+
+#endif // _OS_CACHE
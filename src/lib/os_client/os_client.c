@@ -7,23 +7,58 @@
  * 
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/select.h>
+#include <sys/stat.h>
 
 #include <socket/socket.h>
+#include <socket/safeio.h>
 
 #include <os_client/os_client.h>
 
 #include <assertmacros.h>
+#include <mutexmacros.h>
 
 #include <shared.h>
 
-// File descriptor del client, variabile globlae della libreria
-static int server_fd = -1;
+// Dimensione del buffer sullo stack con cui os_retrieve_to_fd copia i dati dal socket al file
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief Connessione del pool, registrata sul server con il nome del client
+ */
+struct os_connection {
+    int server_fd;
+    // Settato quando un invio o una ricezione falliscono: il flusso non è più allineato al protocollo e la connessione va chiusa
+    int broken;
+    struct os_connection* next;
+};
+
+/**
+ * @brief Client con il suo pool di connessioni. Ogni operazione prende una connessione libera, oppure ne apre una nuova se
+ * non si è raggiunto il massimo, oppure aspetta che un'altra operazione ne liberi una.
+ */
+struct os_client {
+    char* name;
+    int max_connections;
+    // Connessioni aperte, libere o in uso
+    int connections;
+    // Pila delle connessioni libere
+    struct os_connection* idle;
+    pthread_mutex_t mutex;
+    pthread_cond_t idle_cond;
+};
+
+// Client usato dall'interfaccia con una sola connessione (os_connect, os_store, ...)
+static os_client_t* default_client = NULL;
 
 /**
  * @brief Riconosce un codice di errore nella stringa passata
@@ -47,18 +82,76 @@ static int parse_error (char* response) {
  */
 static int check_response (char* response) {
     if (EQUALS(response, "OK \n")) return 1;
-    return parse_error(response);
+    // Se la risposta non contiene un codice di errore non è conforme al protocollo
+    if (!parse_error(response)) errno = EPROTO;
+    return 0;
+}
+
+/**
+ * @brief Invia un messaggio sulla connessione, segnandola come rotta se l'invio fallisce
+ * 
+ * @param connection Connessione su cui inviare
+ * @param message Messaggio da inviare
+ * @param size Dimensione del messaggio
+ * @return int 0 se il messaggio è stato inviato correttamente. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int connection_send (struct os_connection* connection, void* message, size_t size) {
+    int success = send_message(connection->server_fd, message, size);
+    if (success == -1) connection->broken = 1;
+    return success;
+}
+
+/**
+ * @brief Riceve un messaggio di dimensione size dalla connessione, segnandola come rotta se la ricezione fallisce
+ * 
+ * @param connection Connessione da cui ricevere
+ * @param size Dimensione del messaggio
+ * @return void* Messaggio ricevuto, da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+static void* connection_receive (struct os_connection* connection, size_t size) {
+    void* message = receive_message(connection->server_fd, size);
+    if (message == NULL) connection->broken = 1;
+    return message;
+}
+
+/**
+ * @brief Riceve size byte dalla connessione direttamente nel buffer passato, segnandola come rotta se la ricezione fallisce
+ * 
+ * @param connection Connessione da cui ricevere
+ * @param buffer Buffer in cui scrivere i dati, di almeno size byte
+ * @param size Numero di byte da ricevere
+ * @return int 0 se i dati sono stati ricevuti. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int connection_receive_into (struct os_connection* connection, void* buffer, size_t size) {
+    int success = receive_message_into(connection->server_fd, buffer, size);
+    if (success == -1) connection->broken = 1;
+    return success;
+}
+
+/**
+ * @brief Riceve una risposta "OK \n" o "KO <errno> \n"
+ * 
+ * @param connection Connessione da cui ricevere
+ * @return int 1 se la risposta è OK. Se c'è un errore restituisce 0 e setta errno.
+ */
+static int receive_response (struct os_connection* connection) {
+    char* response = connection_receive(connection, sizeof(char) * MAX_RESPONSE_LENGTH);
+    ASSERT_RETURN(response != NULL, 0);
+    int success = check_response(response);
+    free(response);
+    return success;
 }
 
 /**
  * @brief Costruisce e invia un header a partire dal formato e gli argomenti passati
  * 
+ * @param connection Connessione su cui inviare
  * @param format Formato della stringa da inviare
  * @param name Nome della risorsa da creare/manipolare
- * @param length (Opzionale) Lunghezza della 
+ * @param length (Opzionale) Lunghezza della
  * @return int Se creazione e invio sono andate a buon fine restituisce 0. Se c'è stato un errore restituisce -1 e setta errno.
  */
-static int send_header (char* format, char* name, size_t length) {
+static int send_header (struct os_connection* connection, char* format, char* name, size_t length) {
     // Buffer che contiene l'header
     char header[MAX_HEADER_LENGTH];
     memset(header, 0, MAX_HEADER_LENGTH);
@@ -66,121 +159,976 @@ static int send_header (char* format, char* name, size_t length) {
     if (length != 0) sprintf(header, format, name, length);
     else sprintf(header, format, name);
     // Invia l'header
-    int success = send_message(server_fd, header, sizeof(char) * MAX_HEADER_LENGTH);
+    int success = connection_send(connection, header, sizeof(char) * MAX_HEADER_LENGTH);
     // Restituisce il successo dell'operazione
     return success;
 }
 
 /**
- * @brief Inizializza la connessione con il server.
+ * @brief Apre una nuova connessione con il server e vi registra l'utente
  * 
- * @param name Nome dell'utente da connettere
- * @return int 1 se la connessione è andata a buon fine. Se c'è un errore restituisce 0 e setta errno.
+ * @param name Nome dell'utente
+ * @return struct os_connection* Connessione aperta. Se c'è un errore restituisce NULL e setta errno.
  */
-int os_connect (char* name) {
+static struct os_connection* open_connection (char* name) {
+    struct os_connection* connection = (struct os_connection*) malloc(sizeof(struct os_connection));
+    ASSERT_ERRNO_RETURN(connection != NULL, ENOMEM, NULL);
+    connection->broken = 0;
+    connection->next = NULL;
     // Si collega al server socket
-    server_fd = create_client_socket(SOCKET_NAME);
-    ASSERT_RETURN(server_fd != -1, -1);
+    connection->server_fd = create_client_socket(SOCKET_NAME);
+    ASSERT(connection->server_fd != -1, free(connection); return NULL);
+    // Invia l'header e controlla la risposta
+    int success = send_header(connection, "REGISTER %s \n", name, 0);
+    if (success != -1) success = receive_response(connection) ? 0 : -1;
+    if (success == -1) {
+        int error = errno;
+        close_socket(connection->server_fd);
+        free(connection);
+        errno = error;
+        return NULL;
+    }
+    return connection;
+}
+
+/**
+ * @brief Chiude una connessione, avvisando il server se il flusso è ancora valido
+ * 
+ * @param connection Connessione da chiudere
+ * @return int 1 se la disconnessione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
+ */
+static int close_connection (struct os_connection* connection) {
+    int success = 0;
+    if (!connection->broken) {
+        // Invia al server il comando di leave
+        char leave_string[MAX_HEADER_LENGTH] = "LEAVE \n";
+        success = send_message(connection->server_fd, leave_string, sizeof(char) * MAX_HEADER_LENGTH);
+    }
+    // Chiude la connessione al socket
+    if (close_socket(connection->server_fd) != 0) success = -1;
+    free(connection);
+    return (success == 0);
+}
+
+/**
+ * @brief Prende una connessione dal pool: una libera se c'è, altrimenti ne apre una nuova se non si è raggiunto il massimo,
+ * altrimenti aspetta che un'altra operazione la restituisca.
+ * 
+ * @param client Client da cui prendere la connessione
+ * @return struct os_connection* Connessione da restituire con release_connection. Se c'è un errore restituisce NULL e setta errno.
+ */
+static struct os_connection* acquire_connection (os_client_t* client) {
+    ASSERT_ERRNO_RETURN(client != NULL, ENOTCONN, NULL);
+    LOCK_ACQUIRE(&client->mutex, return NULL);
+    while ((client->idle == NULL) && (client->connections >= client->max_connections))
+        pthread_cond_wait(&client->idle_cond, &client->mutex);
+    struct os_connection* connection = client->idle;
+    if (connection != NULL) client->idle = connection->next;
+    // Riserva il posto della nuova connessione, che viene aperta senza la lock
+    else client->connections++;
+    LOCK_RELEASE(&client->mutex, return NULL);
+    if (connection != NULL) return connection;
+    connection = open_connection(client->name);
+    if (connection == NULL) {
+        int error = errno;
+        LOCK_ACQUIRE(&client->mutex, errno = error; return NULL);
+        client->connections--;
+        pthread_cond_signal(&client->idle_cond);
+        LOCK_RELEASE(&client->mutex, );
+        errno = error;
+    }
+    return connection;
+}
+
+/**
+ * @brief Restituisce una connessione al pool, chiudendola se è rotta. Non modifica errno.
+ * 
+ * @param client Client a cui restituire la connessione
+ * @param connection Connessione ottenuta con acquire_connection
+ */
+static void release_connection (os_client_t* client, struct os_connection* connection) {
+    int error = errno;
+    if (connection->broken) {
+        close_connection(connection);
+        connection = NULL;
+    }
+    LOCK_ACQUIRE(&client->mutex, errno = error; return);
+    if (connection != NULL) {
+        connection->next = client->idle;
+        client->idle = connection;
+    }
+    else client->connections--;
+    pthread_cond_signal(&client->idle_cond);
+    LOCK_RELEASE(&client->mutex, );
+    errno = error;
+}
+
+/**
+ * @brief Crea un client con un pool di connessioni verso il server, tutte registrate con lo stesso nome. La prima connessione
+ * viene aperta subito, le altre quando servono. Più thread possono usare lo stesso client contemporaneamente.
+ * 
+ * @param name Nome dell'utente da connettere
+ * @param max_connections Numero massimo di connessioni aperte, 0 per OS_CLIENT_DEFAULT_CONNECTIONS
+ * @return os_client_t* Client connesso. Se c'è un errore restituisce NULL e setta errno.
+ */
+os_client_t* os_client_create (char* name, int max_connections) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && (max_connections >= 0), EINVAL, NULL);
+    os_client_t* client = (os_client_t*) calloc(1, sizeof(os_client_t));
+    ASSERT_ERRNO_RETURN(client != NULL, ENOMEM, NULL);
+    client->max_connections = (max_connections > 0) ? max_connections : OS_CLIENT_DEFAULT_CONNECTIONS;
+    client->name = strdup(name);
+    ASSERT_ERRNO(client->name != NULL, ENOMEM, free(client); return NULL);
+    ASSERT((errno = pthread_mutex_init(&client->mutex, NULL)) == 0, free(client->name); free(client); return NULL);
+    ASSERT((errno = pthread_cond_init(&client->idle_cond, NULL)) == 0, pthread_mutex_destroy(&client->mutex); free(client->name); free(client); return NULL);
+    // Apre la prima connessione, così che un nome non valido o un server assente vengano segnalati subito
+    client->idle = open_connection(name);
+    if (client->idle == NULL) {
+        int error = errno;
+        pthread_cond_destroy(&client->idle_cond);
+        pthread_mutex_destroy(&client->mutex);
+        free(client->name);
+        free(client);
+        errno = error;
+        return NULL;
+    }
+    client->connections = 1;
+    return client;
+}
+
+/**
+ * @brief Chiude tutte le connessioni del client e lo libera. Nessuna operazione deve essere in corso sul client.
+ * 
+ * @param client Client da liberare
+ * @return int 1 se la disconnessione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno (EBUSY se delle connessioni sono in uso).
+ */
+int os_client_destroy (os_client_t* client) {
+    ASSERT_ERRNO_RETURN(client != NULL, EINVAL, 0);
+    // Conta le connessioni libere, che devono essere tutte quelle aperte
+    int idle = 0;
+    for (struct os_connection* connection = client->idle; connection != NULL; connection = connection->next)
+        idle++;
+    ASSERT_ERRNO_RETURN(idle == client->connections, EBUSY, 0);
+    int success = 1;
+    while (client->idle != NULL) {
+        struct os_connection* connection = client->idle;
+        client->idle = connection->next;
+        if (!close_connection(connection)) success = 0;
+    }
+    pthread_cond_destroy(&client->idle_cond);
+    pthread_mutex_destroy(&client->mutex);
+    free(client->name);
+    free(client);
+    return success;
+}
+
+/**
+ * @brief Memorizza sul server l'area di memoria di lunghezza len puntata da block, usando la connessione passata.
+ */
+static int store_on (struct os_connection* connection, char* name, void* block, size_t len) {
     // Invia l'header
-    int success = send_header("REGISTER %s \n", name, 0);
+    int success = send_header(connection, "STORE %s %ld \n ", name, len);
+    // Verifica che l'invio sia andato a buon fine
+    ASSERT_RETURN(success != -1, 0);
+    // Invia i dati
+    success = connection_send(connection, block, len);
     ASSERT_RETURN(success != -1, 0);
     // Riceve la risposta
-    char* response = receive_message(server_fd, sizeof(char) * MAX_RESPONSE_LENGTH);
-    ASSERT(response != NULL, free(response); return 0);
-    // Restituisce il valore della risposta
-    success = check_response(response);
-    free(response);
-    return success;
+    return receive_response(connection);
 }
 
 /**
  * @brief Memorizza sul server l'area di memoria di lunghezza len puntata da block.
  * 
+ * @param client Client da usare
  * @param name Nome del blocco da memorizzare
  * @param block Dati del blocco da memorizzare
  * @param len Lunghezza del blocco da memorizzare
  * @return int 1 se la memorizzazione è andata a buon fine. Se c'è un errore restituisce 0 e setta errno.
  */
-int os_store (char* name, void* block, size_t len) {
+int os_client_store (os_client_t* client, char* name, void* block, size_t len) {
     // Controlla la correttezza dei parametri
     ASSERT_ERRNO_RETURN((name != NULL) && (block != NULL) && (len > 0), EINVAL, 0);
-    ASSERT_ERRNO_RETURN(server_fd > 0, ENOTCONN, -1);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    int success = store_on(connection, name, block, len);
+    release_connection(client, connection);
+    return success;
+}
+
+/**
+ * @brief Accoda dei dati in fondo a un blocco, usando la connessione passata.
+ */
+static int append_on (struct os_connection* connection, char* name, void* block, size_t len) {
     // Invia l'header
-    int success = send_header("STORE %s %ld \n ", name, len);
-    // Verifica che l'invio sia andato a buon fine
+    int success = send_header(connection, "APPEND %s %ld \n ", name, len);
     ASSERT_RETURN(success != -1, 0);
     // Invia i dati
-    success = send_message(server_fd, block, len);
+    success = connection_send(connection, block, len);
     ASSERT_RETURN(success != -1, 0);
     // Riceve la risposta
-    char* response = receive_message(server_fd, sizeof(char) * MAX_RESPONSE_LENGTH);
-    ASSERT(response != NULL, free(response); return 0);
-    // Restituisce il valore della risposta
-    success = check_response(response);
-    free(response);
+    return receive_response(connection);
+}
+
+/**
+ * @brief Accoda l'area di memoria di lunghezza len puntata da block in fondo al blocco name, creandolo se non esiste.
+ * Viene inviata solo la parte nuova del blocco.
+ * 
+ * @param client Client da usare
+ * @param name Nome del blocco da estendere
+ * @param block Dati da accodare
+ * @param len Lunghezza dei dati da accodare
+ * @return int 1 se l'aggiunta è andata a buon fine. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_client_append (os_client_t* client, char* name, void* block, size_t len) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && (block != NULL) && (len > 0), EINVAL, 0);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    int success = append_on(connection, name, block, len);
+    release_connection(client, connection);
     return success;
 }
 
+/**
+ * @brief Riceve l'header di una risposta "DATA <size> [<tag>] \n ", dopo il quale arrivano size byte di dati
+ * 
+ * @param connection Connessione da cui ricevere
+ * @param size_ptr Puntatore alla dimensione dei dati in arrivo, il cui valore puntato viene settato dalla funzione
+ * @param tag Se non è NULL vi viene copiato il tag della versione ricevuta, se presente
+ * @return int 0 se l'header annuncia dei dati. Se c'è un errore restituisce -1 e setta errno
+ * (EALREADY se il server risponde che la versione posseduta è quella attuale).
+ */
+static int receive_data_header (struct os_connection* connection, size_t* size_ptr, char* tag) {
+    // L'header è piccolo e di dimensione fissa, quindi sta sullo stack
+    char res_header[MAX_DATA_LENGTH + 1];
+    ASSERT_RETURN(connection_receive_into(connection, res_header, sizeof(char) * MAX_DATA_LENGTH) != -1, -1);
+    res_header[MAX_DATA_LENGTH] = '\0';
+    // Controlla che non sia stato restituito un errore
+    ASSERT_RETURN(parse_error(res_header) == 0, -1);
+    // Controlla se i dati posseduti sono ancora validi
+    ASSERT_ERRNO_RETURN(strncmp(res_header, "NOT-MODIFIED ", 13) != 0, EALREADY, -1);
+    // Legge la dimensione dei dati in arrivo e l'eventuale tag
+    size_t size = 0;
+    char received_tag[TAG_LENGTH + 1] = "";
+    int matched = sscanf(res_header, "DATA %zu %16[0-9a-f]", &size, received_tag);
+    // Senza la dimensione non si sa quanti byte seguono, quindi il flusso non è più allineato
+    ASSERT(matched >= 1, connection->broken = 1; errno = EPROTO; return -1);
+    if (tag && (matched == 2)) strcpy(tag, received_tag);
+    *size_ptr = size;
+    return 0;
+}
+
+/**
+ * @brief Parte di un caricamento assegnata a un thread: i byte tra start ed end, presi dal buffer se non è NULL,
+ * altrimenti letti dal file
+ */
+struct upload_task {
+    os_client_t* client;
+    unsigned long id;
+    char* block;
+    int file_fd;
+    size_t start;
+    size_t end;
+    // Errore della parte, 0 se è stata caricata
+    int error;
+};
+
+/**
+ * @brief Legge length byte di un file a partire dalla posizione indicata
+ * 
+ * @return int 0 se i byte sono stati letti. Se c'è un errore restituisce -1 e setta errno (EIO se il file è più corto).
+ */
+static int pread_all (int file_fd, char* buffer, size_t length, size_t offset) {
+    while (length > 0) {
+        ssize_t bytes_read = pread(file_fd, buffer, length, (off_t) offset);
+        if (bytes_read < 0) {
+            // Se la lettura è stata interrotta deve essere ritentata
+            ASSERT_RETURN(errno == EINTR, -1);
+            continue;
+        }
+        ASSERT_ERRNO_RETURN(bytes_read > 0, EIO, -1);
+        buffer += bytes_read;
+        offset += bytes_read;
+        length -= bytes_read;
+    }
+    return 0;
+}
+
+/**
+ * @brief Invia una parte di un caricamento con l'header "PART <id> <offset> <length> \n", usando la connessione passata.
+ */
+static int send_part_on (struct os_connection* connection, unsigned long id, size_t offset, void* data, size_t length) {
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "PART %0*lx %zu %zu \n", TAG_LENGTH, id, offset, length);
+    int success = connection_send(connection, header, sizeof(char) * MAX_HEADER_LENGTH);
+    if (success != -1) success = connection_send(connection, data, length);
+    ASSERT_RETURN(success != -1, 0);
+    return receive_response(connection);
+}
+
+/**
+ * @brief Corpo di un thread di caricamento: invia la sua parte su una connessione del pool, in messaggi di al più
+ * OS_UPLOAD_PART_SIZE byte.
+ * 
+ * @param ptr Puntatore alla upload_task del thread, in cui viene scritto l'eventuale errore
+ * @return void* Sempre NULL
+ */
+static void* upload_worker (void* ptr) {
+    struct upload_task* task = (struct upload_task*) ptr;
+    size_t total = task->end - task->start;
+    // Se i dati vengono dal file servono un buffer in cui leggerli
+    char* buffer = NULL;
+    if (task->block == NULL) {
+        buffer = (char*) malloc((total < OS_UPLOAD_PART_SIZE) ? total : OS_UPLOAD_PART_SIZE);
+        ASSERT(buffer != NULL, task->error = ENOMEM; return NULL);
+    }
+    struct os_connection* connection = acquire_connection(task->client);
+    ASSERT(connection != NULL, task->error = errno; free(buffer); return NULL);
+    for (size_t offset = task->start; offset < task->end; ) {
+        size_t length = task->end - offset;
+        if (length > OS_UPLOAD_PART_SIZE) length = OS_UPLOAD_PART_SIZE;
+        char* data = task->block ? task->block + offset : buffer;
+        if ((task->block == NULL) && (pread_all(task->file_fd, buffer, length, offset) == -1)) {
+            task->error = errno;
+            break;
+        }
+        if (!send_part_on(connection, task->id, offset, data, length)) {
+            task->error = errno;
+            break;
+        }
+        offset += length;
+    }
+    release_connection(task->client, connection);
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * @brief Avvia un caricamento con l'header "INITIATE <name> <size> \n" e ne riceve l'identificativo, usando la connessione passata.
+ */
+static int initiate_on (struct os_connection* connection, char* name, size_t size, unsigned long* id_ptr) {
+    int success = send_header(connection, "INITIATE %s %zu \n", name, size);
+    ASSERT_RETURN(success != -1, 0);
+    char response[MAX_DATA_LENGTH + 1];
+    ASSERT_RETURN(connection_receive_into(connection, response, sizeof(char) * MAX_DATA_LENGTH) != -1, 0);
+    response[MAX_DATA_LENGTH] = '\0';
+    ASSERT_RETURN(parse_error(response) == 0, 0);
+    ASSERT_ERRNO_RETURN(sscanf(response, "UPLOAD %lx", id_ptr) == 1, EPROTO, 0);
+    return 1;
+}
+
+/**
+ * @brief Completa o interrompe un caricamento con l'header "COMPLETE <id> \n" o "ABORT <id> \n", usando una connessione del client.
+ */
+static int finish_upload (os_client_t* client, unsigned long id, int complete) {
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "%s %0*lx \n", complete ? "COMPLETE" : "ABORT", TAG_LENGTH, id);
+    int success = connection_send(connection, header, sizeof(char) * MAX_HEADER_LENGTH);
+    success = (success != -1) ? receive_response(connection) : 0;
+    release_connection(client, connection);
+    return success;
+}
+
+/**
+ * @brief Carica un oggetto in parti contigue inviate in parallelo da thread diversi, ciascuno con una connessione del pool.
+ * 
+ * @param client Client da usare
+ * @param name Nome dell'oggetto
+ * @param block Dati dell'oggetto, NULL per leggerli dal file
+ * @param file_fd File da cui leggere i dati se block è NULL
+ * @param size Dimensione dell'oggetto
+ * @param parts Numero di parti, 0 per il numero massimo di connessioni del client
+ * @return int 1 se l'oggetto è stato caricato. Se c'è un errore restituisce 0 e setta errno.
+ */
+static int upload_parts (os_client_t* client, char* name, char* block, int file_fd, size_t size, int parts) {
+    ASSERT_ERRNO_RETURN(client != NULL, ENOTCONN, 0);
+    if (parts <= 0) parts = client->max_connections;
+    // Ogni parte contiene almeno un byte
+    if ((size_t) parts > size) parts = (int) size;
+    // Avvia il caricamento
+    unsigned long id;
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    int success = initiate_on(connection, name, size, &id);
+    release_connection(client, connection);
+    ASSERT_RETURN(success, 0);
+    struct upload_task* tasks = (struct upload_task*) calloc(parts, sizeof(struct upload_task));
+    pthread_t* threads = (pthread_t*) calloc(parts, sizeof(pthread_t));
+    int* started = (int*) calloc(parts, sizeof(int));
+    ASSERT((tasks != NULL) && (threads != NULL) && (started != NULL),
+        free(tasks); free(threads); free(started); finish_upload(client, id, 0); errno = ENOMEM; return 0);
+    // Divide l'oggetto in parti contigue che differiscono al più di un byte
+    size_t base = size / parts;
+    size_t remainder = size % parts;
+    for (int i = 0; i < parts; i++) {
+        tasks[i].client = client;
+        tasks[i].id = id;
+        tasks[i].block = block;
+        tasks[i].file_fd = file_fd;
+        tasks[i].start = i * base + (((size_t) i < remainder) ? (size_t) i : remainder);
+        tasks[i].end = tasks[i].start + base + (((size_t) i < remainder) ? 1 : 0);
+        // Se non riesce a creare il thread carica la parte da sé
+        started[i] = (pthread_create(&threads[i], NULL, upload_worker, &tasks[i]) == 0);
+        if (!started[i]) upload_worker(&tasks[i]);
+    }
+    // Attende tutte le parti e ne raccoglie il primo errore
+    int error = 0;
+    for (int i = 0; i < parts; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+        if ((error == 0) && (tasks[i].error != 0)) error = tasks[i].error;
+    }
+    free(tasks);
+    free(threads);
+    free(started);
+    // Se una parte non è arrivata scarta il caricamento, altrimenti lo completa
+    if (error != 0) {
+        finish_upload(client, id, 0);
+        errno = error;
+        return 0;
+    }
+    return finish_upload(client, id, 1);
+}
+
+/**
+ * @brief Carica un oggetto grande dividendolo in parti inviate in parallelo su più connessioni del client. Il server
+ * scrive ogni parte direttamente alla sua posizione e crea l'oggetto solo quando sono arrivate tutte.
+ * 
+ * @param client Client da usare
+ * @param name Nome dell'oggetto
+ * @param block Dati dell'oggetto
+ * @param len Dimensione dell'oggetto
+ * @param parts Numero di parti in parallelo, 0 per il numero massimo di connessioni del client
+ * @return int 1 se l'oggetto è stato caricato. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_client_upload (os_client_t* client, char* name, void* block, size_t len, int parts) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && (block != NULL) && (len > 0) && (parts >= 0), EINVAL, 0);
+    return upload_parts(client, name, (char*) block, -1, len, parts);
+}
+
+/**
+ * @brief Carica come oggetto l'intero contenuto di un file, dividendolo in parti lette e inviate in parallelo su più
+ * connessioni del client.
+ * 
+ * @param client Client da usare
+ * @param name Nome dell'oggetto
+ * @param file_fd File descriptor del file, aperto in lettura
+ * @param parts Numero di parti in parallelo, 0 per il numero massimo di connessioni del client
+ * @return int 1 se l'oggetto è stato caricato. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_client_upload_file (os_client_t* client, char* name, int file_fd, int parts) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && (file_fd >= 0) && (parts >= 0), EINVAL, 0);
+    struct stat sb;
+    ASSERT_RETURN(fstat(file_fd, &sb) != -1, 0);
+    ASSERT_ERRNO_RETURN(S_ISREG(sb.st_mode) && (sb.st_size > 0), EINVAL, 0);
+    return upload_parts(client, name, NULL, file_fd, (size_t) sb.st_size, parts);
+}
+
+/**
+ * @brief Riceve una risposta "DATA <size> [<tag>] \n " seguita dai dati
+ * 
+ * @param connection Connessione da cui ricevere
+ * @param size_ptr Puntatore alla dimensione dei dati ricevuti, il cui valore puntato viene settato dalla funzione
+ * @param tag Se non è NULL vi viene copiato il tag della versione ricevuta, se presente
+ * @return void* Dati ricevuti, terminati da un '\0' in più. Se c'è un errore restituisce NULL e setta errno
+ * (EALREADY se il server risponde che la versione posseduta è quella attuale).
+ */
+static void* receive_data (struct os_connection* connection, size_t* size_ptr, char* tag) {
+    size_t size = 0;
+    ASSERT_RETURN(receive_data_header(connection, &size, tag) != -1, NULL);
+    // Riceve i dati direttamente nel buffer restituito, lasciando spazio per il terminatore
+    char* data = (char*) malloc(size + 1);
+    ASSERT(data != NULL, connection->broken = 1; errno = ENOMEM; return NULL);
+    if (size > 0) {
+        ASSERT(connection_receive_into(connection, data, size) != -1, free(data); return NULL);
+    }
+    data[size] = '\0';
+    *size_ptr = size;
+    return data;
+}
+
+/**
+ * @brief Riceve size byte di dati dalla connessione a blocchi, scrivendoli sul file descriptor passato oppure scartandoli.
+ * Se la scrittura sul file fallisce i dati rimanenti vengono comunque consumati, così che la connessione resti utilizzabile.
+ * 
+ * @param connection Connessione da cui ricevere
+ * @param size Numero di byte da ricevere
+ * @param file_descriptor File descriptor su cui scrivere i dati, -1 per scartarli
+ * @return int 0 se i dati sono stati ricevuti e scritti. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int receive_data_to_fd (struct os_connection* connection, size_t size, int file_descriptor) {
+    char buffer[COPY_BUFFER_SIZE];
+    int write_error = 0;
+    while (size > 0) {
+        size_t chunk = (size < COPY_BUFFER_SIZE) ? size : COPY_BUFFER_SIZE;
+        ASSERT_RETURN(connection_receive_into(connection, buffer, chunk) != -1, -1);
+        if ((file_descriptor != -1) && (write_error == 0) && (writen(file_descriptor, buffer, chunk) == -1)) write_error = errno;
+        size -= chunk;
+    }
+    ASSERT_ERRNO_RETURN(write_error == 0, write_error, -1);
+    return 0;
+}
+
+/**
+ * @brief Recupera il blocco di dati identificato da name, usando la connessione passata.
+ */
+static void* retrieve_on (struct os_connection* connection, char* name) {
+    // Invia l'header
+    int success = send_header(connection, "RETRIEVE %s \n", name, 0);
+    ASSERT_RETURN(success != -1, NULL);
+    // Riceve i dati
+    size_t size = 0;
+    void* data = receive_data(connection, &size, NULL);
+    ASSERT_RETURN(data != NULL, NULL);
+    // Un oggetto vuoto non è valido
+    ASSERT(size > 0, free(data); return NULL);
+    // Restituisce i dati
+    return data;
+}
+
 /**
  * @brief Recupera il blocco di dati identificato da name.
  * 
+ * @param client Client da usare
  * @param name Nome del blocco di dati.
  * @return void* Blocco di dati se il recupero ha avuto successo. Se c'è un errore restituisce NULL e setta errno.
  */
-void* os_retrieve (char* name) {
+void* os_client_retrieve (os_client_t* client, char* name) {
     // Controlla che il nome sia stato passato correttamente
     ASSERT_ERRNO_RETURN(name != NULL, EINVAL, NULL);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, NULL);
+    void* data = retrieve_on(connection, name);
+    release_connection(client, connection);
+    return data;
+}
+
+/**
+ * @brief Recupera un blocco nel buffer del chiamante, usando la connessione passata.
+ */
+static int retrieve_into_on (struct os_connection* connection, char* name, void* buffer, size_t capacity, size_t* len_ptr) {
     // Invia l'header
-    int success = send_header("RETRIEVE %s \n", name, 0);
-    ASSERT_RETURN(success != -1, NULL);
-    // Riceve il messaggio con l'header della risposta
-    char* res_header = receive_message(server_fd, sizeof(char) * MAX_DATA_LENGTH);
-    ASSERT_RETURN(res_header != NULL, NULL);
-    // Controlla che non sia stato restituito un errore
-    int is_error = parse_error(res_header);
-    ASSERT(is_error == 0, free(res_header); return NULL);
-    // Legge la dimensione dei dati in arrivo
+    int success = send_header(connection, "RETRIEVE %s \n", name, 0);
+    ASSERT_RETURN(success != -1, 0);
+    // Riceve la dimensione e, se il buffer è abbastanza grande, i dati direttamente al suo interno
     size_t size = 0;
-    sscanf(res_header, "DATA %zu \n", &size);
-    free(res_header);
-    // Se l'header non è arrivato con successo esce
-    ASSERT_RETURN(size > 0, NULL);
-    // Riceve effettivamente i dati
-    void* data = receive_message(server_fd, size);
-    ASSERT_RETURN(data != NULL, 0);
-    // Restituisce i dati
-    return data;
+    ASSERT_RETURN(receive_data_header(connection, &size, NULL) != -1, 0);
+    *len_ptr = size;
+    if (size > capacity) {
+        // I dati vanno comunque consumati per mantenere il flusso allineato al protocollo
+        ASSERT_RETURN(receive_data_to_fd(connection, size, -1) != -1, 0);
+        errno = ERANGE;
+        return 0;
+    }
+    if (size > 0) {
+        ASSERT_RETURN(connection_receive_into(connection, buffer, size) != -1, 0);
+    }
+    return 1;
 }
 
 /**
- * @brief Cancella il blocco di dati identificato da name
+ * @brief Recupera il blocco di dati identificato da name scrivendolo nel buffer passato, senza allocare memoria.
  * 
+ * @param client Client da usare
  * @param name Nome del blocco di dati
- * @return int 1 se l'eliminazione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
+ * @param buffer Buffer in cui scrivere il blocco
+ * @param capacity Dimensione del buffer
+ * @param len_ptr Puntatore in cui scrivere la dimensione del blocco, anche quando non entra nel buffer
+ * @return int 1 se il recupero ha avuto successo. Se c'è un errore restituisce 0 e setta errno (ERANGE se il blocco è più
+ * grande del buffer, nel qual caso il contenuto del buffer non è definito).
  */
-int os_delete (char* name) {
+int os_client_retrieve_into (os_client_t* client, char* name, void* buffer, size_t capacity, size_t* len_ptr) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && ((buffer != NULL) || (capacity == 0)) && (len_ptr != NULL), EINVAL, 0);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    int success = retrieve_into_on(connection, name, buffer, capacity, len_ptr);
+    release_connection(client, connection);
+    return success;
+}
+
+/**
+ * @brief Recupera un blocco scrivendolo su un file descriptor, usando la connessione passata.
+ */
+static int retrieve_to_fd_on (struct os_connection* connection, char* name, int file_descriptor) {
     // Invia l'header
-    int success = send_header("DELETE %s \n", name, 0);
+    int success = send_header(connection, "RETRIEVE %s \n", name, 0);
     ASSERT_RETURN(success != -1, 0);
-    // Attende la risposta
-    char* response = receive_message(server_fd, sizeof(char) * MAX_RESPONSE_LENGTH);
-    // Verifica che sia un ok
-    success = check_response(response);
+    // Riceve la dimensione e copia i dati sul file a blocchi
+    size_t size = 0;
+    ASSERT_RETURN(receive_data_header(connection, &size, NULL) != -1, 0);
+    return (receive_data_to_fd(connection, size, file_descriptor) != -1);
+}
+
+/**
+ * @brief Recupera il blocco di dati identificato da name scrivendolo sul file descriptor passato, a partire dalla sua
+ * posizione corrente. I dati passano da un buffer di dimensione fissa, quindi non viene allocata memoria per l'intero blocco.
+ * 
+ * @param client Client da usare
+ * @param name Nome del blocco di dati
+ * @param file_descriptor File descriptor aperto in scrittura
+ * @return int 1 se il recupero ha avuto successo. Se c'è un errore restituisce 0 e setta errno; se la scrittura fallisce
+ * il file può contenere una parte del blocco.
+ */
+int os_client_retrieve_to_fd (os_client_t* client, char* name, int file_descriptor) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && (file_descriptor > 0), EINVAL, 0);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    int success = retrieve_to_fd_on(connection, name, file_descriptor);
+    release_connection(client, connection);
+    return success;
+}
+
+/**
+ * @brief Recupera un blocco solo se è cambiato rispetto alla versione posseduta, usando la connessione passata.
+ */
+static void* retrieve_if_none_match_on (struct os_connection* connection, char* name, char* tag, size_t* size_ptr) {
+    // Invia l'header, con la condizione solo se si possiede una versione
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    if (tag[0] != '\0') sprintf(header, "RETRIEVE %s IF-NONE-MATCH %s \n", name, tag);
+    else sprintf(header, "RETRIEVE %s \n", name);
+    int success = connection_send(connection, header, sizeof(char) * MAX_HEADER_LENGTH);
+    ASSERT_RETURN(success != -1, NULL);
+    // Riceve i dati e il nuovo tag
+    return receive_data(connection, size_ptr, tag);
+}
+
+/**
+ * @brief Recupera il blocco di dati identificato da name solo se è cambiato rispetto alla versione posseduta.
+ * 
+ * @param client Client da usare
+ * @param name Nome del blocco di dati
+ * @param tag Buffer di TAG_LENGTH + 1 caratteri con il tag della versione posseduta, stringa vuota se non se ne possiede nessuna.
+ * Se il blocco viene ricevuto vi viene scritto il tag della nuova versione.
+ * @param size_ptr Puntatore alla dimensione del blocco, il cui valore puntato viene settato dalla funzione
+ * @return void* Blocco di dati se il recupero ha avuto successo. Se c'è un errore restituisce NULL e setta errno
+ * (EALREADY se la versione posseduta è quella attuale).
+ */
+void* os_client_retrieve_if_none_match (os_client_t* client, char* name, char* tag, size_t* size_ptr) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && (tag != NULL) && (size_ptr != NULL), EINVAL, NULL);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, NULL);
+    void* data = retrieve_if_none_match_on(connection, name, tag, size_ptr);
+    release_connection(client, connection);
+    return data;
+}
+
+/**
+ * @brief Memorizza un blocco solo se la versione attuale è quella indicata, usando la connessione passata.
+ */
+static int store_if_match_on (struct os_connection* connection, char* name, void* block, size_t len, char* tag) {
+    // Invia l'header con la condizione
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "STORE %s %zu IF-MATCH %s \n", name, len, tag);
+    int success = connection_send(connection, header, sizeof(char) * MAX_HEADER_LENGTH);
+    ASSERT_RETURN(success != -1, 0);
+    // Invia i dati, che il server consuma anche se la condizione non è soddisfatta
+    success = connection_send(connection, block, len);
+    ASSERT_RETURN(success != -1, 0);
+    // Riceve la risposta
+    return receive_response(connection);
+}
+
+/**
+ * @brief Memorizza sul server il blocco solo se la versione attuale dell'oggetto è quella indicata.
+ * 
+ * @param client Client da usare
+ * @param name Nome del blocco da memorizzare
+ * @param block Dati del blocco da memorizzare
+ * @param len Lunghezza del blocco da memorizzare
+ * @param tag Tag della versione attesa, OS_TAG_ABSENT se l'oggetto non deve esistere
+ * @return int 1 se la memorizzazione è andata a buon fine. Se c'è un errore restituisce 0 e setta errno (ECANCELED se la versione è cambiata).
+ */
+int os_client_store_if_match (os_client_t* client, char* name, void* block, size_t len, char* tag) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && (block != NULL) && (len > 0) && (tag != NULL) && (strlen(tag) == TAG_LENGTH), EINVAL, 0);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    int success = store_if_match_on(connection, name, block, len, tag);
+    release_connection(client, connection);
+    return success;
+}
+
+/**
+ * @brief Recupera i metadati di un oggetto, usando la connessione passata.
+ */
+static int stat_on (struct os_connection* connection, char* name, os_stat_t* stat_ptr) {
+    // Invia l'header
+    int success = send_header(connection, "STAT %s \n", name, 0);
+    ASSERT_RETURN(success != -1, 0);
+    // Riceve la risposta
+    char* response = connection_receive(connection, sizeof(char) * MAX_STAT_LENGTH);
+    ASSERT_RETURN(response != NULL, 0);
+    int is_error = parse_error(response);
+    ASSERT(is_error == 0, free(response); return 0);
+    int matched = sscanf(response, "STAT %zu %ld %16[0-9a-f]", &stat_ptr->size, &stat_ptr->mtime, stat_ptr->tag);
     free(response);
+    ASSERT_ERRNO_RETURN(matched == 3, EPROTO, 0);
+    return 1;
+}
+
+/**
+ * @brief Recupera dimensione, istante dell'ultima modifica e tag della versione di un oggetto, senza riceverne il contenuto.
+ * 
+ * @param client Client da usare
+ * @param name Nome del blocco di dati
+ * @param stat_ptr Puntatore in cui scrivere i metadati
+ * @return int 1 se l'oggetto esiste. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_client_stat (os_client_t* client, char* name, os_stat_t* stat_ptr) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((name != NULL) && (stat_ptr != NULL), EINVAL, 0);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    int success = stat_on(connection, name, stat_ptr);
+    release_connection(client, connection);
+    return success;
+}
+
+/**
+ * @brief Elenca i nomi degli oggetti, usando la connessione passata.
+ */
+static char** list_on (struct os_connection* connection, char* prefix, char* start_after, int limit) {
+    // Costruisce e invia l'header
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "LIST %s %s %d \n", prefix, start_after, (limit > 0) ? limit : LIST_DEFAULT_LIMIT);
+    int success = connection_send(connection, header, sizeof(char) * MAX_HEADER_LENGTH);
+    ASSERT_RETURN(success != -1, NULL);
+    // Riceve l'elenco dei nomi separati da '\n'
+    size_t size = 0;
+    char* list = receive_data(connection, &size, NULL);
+    ASSERT_RETURN(list != NULL, NULL);
+    // Conta i nomi
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++)
+        if (list[i] == '\n') count++;
+    // Alloca l'array di puntatori seguito dai nomi, così che basti una sola free
+    char** names = (char**) malloc((count + 1) * sizeof(char*) + size + 1);
+    ASSERT_ERRNO(names != NULL, ENOMEM, free(list); return NULL);
+    char* strings = (char*) (names + count + 1);
+    memcpy(strings, list, size + 1);
+    free(list);
+    // Spezza l'elenco sostituendo i separatori con terminatori
+    size_t index = 0;
+    char* start = strings;
+    for (size_t i = 0; i < size; i++) {
+        if (strings[i] != '\n') continue;
+        strings[i] = '\0';
+        names[index++] = start;
+        start = strings + i + 1;
+    }
+    names[index] = NULL;
+    return names;
+}
+
+/**
+ * @brief Elenca in ordine alfabetico i nomi degli oggetti che iniziano con prefix. Per scorrere le pagine
+ * successive si passa come start_after l'ultimo nome ricevuto, finché non vengono restituiti meno di limit nomi.
+ * 
+ * @param client Client da usare
+ * @param prefix Prefisso dei nomi da elencare, NULL o stringa vuota per tutti gli oggetti
+ * @param start_after Ultimo nome della pagina precedente, NULL o stringa vuota per partire dall'inizio
+ * @param limit Numero massimo di nomi da restituire, 0 per il limite predefinito del server
+ * @return char** Array di nomi terminato da NULL, allocato in un unico blocco da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+char** os_client_list (os_client_t* client, char* prefix, char* start_after, int limit) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN(limit >= 0, EINVAL, NULL);
+    // I nomi vuoti vengono sostituiti dal segnaposto
+    if ((prefix == NULL) || (prefix[0] == '\0')) prefix = EMPTY_NAME;
+    if ((start_after == NULL) || (start_after[0] == '\0')) start_after = EMPTY_NAME;
+    ASSERT_ERRNO_RETURN((strlen(prefix) < 256) && (strlen(start_after) < 256), ENAMETOOLONG, NULL);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, NULL);
+    char** names = list_on(connection, prefix, start_after, limit);
+    release_connection(client, connection);
+    return names;
+}
+
+/**
+ * @brief Invia un elenco di nomi da leggere in anticipo, usando la connessione passata.
+ */
+static int prefetch_on (struct os_connection* connection, char* list, size_t length) {
+    // Invia l'header seguito dall'elenco
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "PREFETCH %zu \n", length);
+    int success = connection_send(connection, header, sizeof(char) * MAX_HEADER_LENGTH);
+    if (success != -1) success = connection_send(connection, list, length);
+    ASSERT_RETURN(success != -1, 0);
+    // Riceve la risposta
+    return receive_response(connection);
+}
+
+/**
+ * @brief Chiede al server di portare in memoria gli oggetti indicati, che si prevede di leggere a breve.
+ * La richiesta non attende la lettura dal disco, e i nomi di oggetti che non esistono vengono ignorati.
+ * 
+ * @param client Client da usare
+ * @param names Nomi degli oggetti
+ * @param count Numero di nomi
+ * @return int 1 se la richiesta è stata accettata. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_client_prefetch (os_client_t* client, char** names, int count) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((names != NULL) && (count > 0), EINVAL, 0);
+    // Calcola la lunghezza dell'elenco, con un separatore dopo ogni nome
+    size_t length = 0;
+    for (int i = 0; i < count; i++) {
+        ASSERT_ERRNO_RETURN(names[i] != NULL, EINVAL, 0);
+        length += strlen(names[i]) + 1;
+    }
+    // Il server rifiuta gli elenchi più lunghi di PREFETCH_MAX_LENGTH
+    ASSERT_ERRNO_RETURN(length <= PREFETCH_MAX_LENGTH, EINVAL, 0);
+    // Costruisce l'elenco
+    char* list = (char*) malloc(length);
+    ASSERT_ERRNO_RETURN(list != NULL, ENOMEM, 0);
+    char* end = list;
+    for (int i = 0; i < count; i++) {
+        size_t name_length = strlen(names[i]);
+        memcpy(end, names[i], name_length);
+        end += name_length;
+        *(end++) = '\n';
+    }
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT(connection != NULL, free(list); return 0);
+    int success = prefetch_on(connection, list, length);
+    release_connection(client, connection);
+    free(list);
     return success;
 }
 
+/**
+ * @brief Riceve le misure del server, usando la connessione passata.
+ */
+static char* stats_on (struct os_connection* connection, size_t* size_ptr) {
+    // Costruisce e invia l'header
+    char header[MAX_HEADER_LENGTH];
+    memset(header, 0, MAX_HEADER_LENGTH);
+    sprintf(header, "STATS \n");
+    int success = connection_send(connection, header, sizeof(char) * MAX_HEADER_LENGTH);
+    ASSERT_RETURN(success != -1, NULL);
+    // Riceve il testo delle misure, già terminato da '\0'
+    return (char*) receive_data(connection, size_ptr, NULL);
+}
+
+/**
+ * @brief Legge le misure del server come testo di righe "<nome> <valore>\n", con valori interi.
+ * 
+ * @param client Client da usare
+ * @param size_ptr Se non è NULL vi viene scritta la lunghezza del testo
+ * @return char* Testo terminato da '\0', da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+char* os_client_stats (os_client_t* client, size_t* size_ptr) {
+    size_t size = 0;
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, NULL);
+    char* text = stats_on(connection, &size);
+    release_connection(client, connection);
+    if ((text != NULL) && (size_ptr != NULL)) *size_ptr = size;
+    return text;
+}
+
+/**
+ * @brief Cancella il blocco di dati identificato da name
+ * 
+ * @param client Client da usare
+ * @param name Nome del blocco di dati
+ * @return int 1 se l'eliminazione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_client_delete (os_client_t* client, char* name) {
+    ASSERT_ERRNO_RETURN(name != NULL, EINVAL, 0);
+    struct os_connection* connection = acquire_connection(client);
+    ASSERT_RETURN(connection != NULL, 0);
+    // Invia l'header e attende la risposta
+    int success = send_header(connection, "DELETE %s \n", name, 0);
+    success = (success != -1) ? receive_response(connection) : 0;
+    release_connection(client, connection);
+    return success;
+}
+
+/**
+ * @brief Inizializza la connessione con il server.
+ * 
+ * @param name Nome dell'utente da connettere
+ * @return int 1 se la connessione è andata a buon fine. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_connect (char* name) {
+    ASSERT_ERRNO_RETURN(default_client == NULL, EISCONN, 0);
+    // L'interfaccia senza client usa una sola connessione, come se le chiamate fossero in sequenza
+    default_client = os_client_create(name, 1);
+    return (default_client != NULL);
+}
+
+// Le funzioni seguenti sono l'interfaccia senza client, documentata in os_client.h, e usano il client di os_connect
+
+int os_store (char* name, void* block, size_t len) {
+    return os_client_store(default_client, name, block, len);
+}
+
+int os_append (char* name, void* block, size_t len) {
+    return os_client_append(default_client, name, block, len);
+}
+
+void* os_retrieve (char* name) {
+    return os_client_retrieve(default_client, name);
+}
+
+int os_retrieve_into (char* name, void* buffer, size_t capacity, size_t* len_ptr) {
+    return os_client_retrieve_into(default_client, name, buffer, capacity, len_ptr);
+}
+
+int os_retrieve_to_fd (char* name, int file_descriptor) {
+    return os_client_retrieve_to_fd(default_client, name, file_descriptor);
+}
+
+void* os_retrieve_if_none_match (char* name, char* tag, size_t* size_ptr) {
+    return os_client_retrieve_if_none_match(default_client, name, tag, size_ptr);
+}
+
+int os_store_if_match (char* name, void* block, size_t len, char* tag) {
+    return os_client_store_if_match(default_client, name, block, len, tag);
+}
+
+int os_stat (char* name, os_stat_t* stat_ptr) {
+    return os_client_stat(default_client, name, stat_ptr);
+}
+
+char** os_list (char* prefix, char* start_after, int limit) {
+    return os_client_list(default_client, prefix, start_after, limit);
+}
+
+int os_prefetch (char** names, int count) {
+    return os_client_prefetch(default_client, names, count);
+}
+
+int os_delete (char* name) {
+    return os_client_delete(default_client, name);
+}
+
+char* os_stats (size_t* size_ptr) {
+    return os_client_stats(default_client, size_ptr);
+}
+
 /**
  * @brief Si disconnette dal server
  * 
  * @return int 1 se la disconnessione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno.
  */
 int os_disconnect() {
-    // Invia al server il comando di leave
-    char leave_string[MAX_HEADER_LENGTH] = "LEAVE \n";
-    int success = send_message(server_fd, leave_string, sizeof(char) * MAX_HEADER_LENGTH);
-    ASSERT_RETURN(success != 1, 0);
-    // Chiude la connessione al socket
-    success = close_socket(server_fd);
-    return (success == 0);
-}
\ No newline at end of file
+    ASSERT_ERRNO_RETURN(default_client != NULL, ENOTCONN, 0);
+    int success = os_client_destroy(default_client);
+    default_client = NULL;
+    return success;
+}
@@ -10,6 +10,143 @@
 #if !defined(_CLIENT)
 #define _CLIENT
 
+#include <stddef.h>
+
+#include <shared.h>
+
+// Tag da passare a os_store_if_match per memorizzare un oggetto solo se non esiste
+#define OS_TAG_ABSENT "0000000000000000"
+
+/**
+ * @brief Metadati di un oggetto: dimensione, istante dell'ultima modifica e tag della versione.
+ */
+typedef struct os_stat {
+    size_t size;
+    long mtime;
+    char tag[TAG_LENGTH + 1];
+} os_stat_t;
+
+// Numero massimo di connessioni di un client se non viene indicato
+#define OS_CLIENT_DEFAULT_CONNECTIONS 8
+
+// Dimensione delle parti in cui il client divide un caricamento, pari al massimo accettato dal server
+#define OS_UPLOAD_PART_SIZE MAX_PART_LENGTH
+
+/**
+ * @brief Client con un pool di connessioni verso il server. Può essere usato da più thread contemporaneamente: ogni operazione
+ * prende una connessione libera (aprendone una nuova fino al massimo indicato alla creazione) e la restituisce alla fine,
+ * così che chiamate concorrenti usino connessioni indipendenti e quelle successive le riusino.
+ */
+typedef struct os_client os_client_t;
+
+/**
+ * @brief Crea un client con un pool di connessioni verso il server, tutte registrate con lo stesso nome. La prima connessione
+ * viene aperta subito, le altre quando servono.
+ * 
+ * @param name Nome dell'utente da connettere
+ * @param max_connections Numero massimo di connessioni aperte, 0 per OS_CLIENT_DEFAULT_CONNECTIONS
+ * @return os_client_t* Client connesso. Se c'è un errore restituisce NULL e setta errno.
+ */
+os_client_t* os_client_create (char* name, int max_connections);
+
+/**
+ * @brief Chiude tutte le connessioni del client e lo libera. Nessuna operazione deve essere in corso sul client.
+ * 
+ * @param client Client da liberare
+ * @return int 1 se la disconnessione è avvenuta con successo. Se c'è un errore restituisce 0 e setta errno (EBUSY se delle connessioni sono in uso).
+ */
+int os_client_destroy (os_client_t* client);
+
+/**
+ * @brief Come os_store, usando una connessione del client.
+ */
+int os_client_store (os_client_t* client, char* name, void* block, size_t len);
+
+/**
+ * @brief Come os_append, usando una connessione del client.
+ */
+int os_client_append (os_client_t* client, char* name, void* block, size_t len);
+
+/**
+ * @brief Carica un oggetto grande dividendolo in parti inviate in parallelo da più thread, ciascuno con una connessione
+ * del client. Il server scrive ogni parte direttamente alla sua posizione e crea l'oggetto, sostituendone la versione
+ * precedente, solo quando sono arrivate tutte; se una parte fallisce il caricamento viene scartato.
+ * 
+ * @param client Client da usare
+ * @param name Nome dell'oggetto
+ * @param block Dati dell'oggetto
+ * @param len Dimensione dell'oggetto
+ * @param parts Numero di parti in parallelo, 0 per il numero massimo di connessioni del client
+ * @return int 1 se l'oggetto è stato caricato. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_client_upload (os_client_t* client, char* name, void* block, size_t len, int parts);
+
+/**
+ * @brief Come os_client_upload, leggendo l'oggetto dall'intero contenuto di un file regolare. Ogni thread legge la sua
+ * parte con pread, a blocchi di OS_UPLOAD_PART_SIZE byte.
+ * 
+ * @param client Client da usare
+ * @param name Nome dell'oggetto
+ * @param file_fd File descriptor del file, aperto in lettura
+ * @param parts Numero di parti in parallelo, 0 per il numero massimo di connessioni del client
+ * @return int 1 se l'oggetto è stato caricato. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_client_upload_file (os_client_t* client, char* name, int file_fd, int parts);
+
+/**
+ * @brief Come os_retrieve, usando una connessione del client.
+ */
+void* os_client_retrieve (os_client_t* client, char* name);
+
+/**
+ * @brief Come os_retrieve_into, usando una connessione del client.
+ */
+int os_client_retrieve_into (os_client_t* client, char* name, void* buffer, size_t capacity, size_t* len_ptr);
+
+/**
+ * @brief Come os_retrieve_to_fd, usando una connessione del client.
+ */
+int os_client_retrieve_to_fd (os_client_t* client, char* name, int file_descriptor);
+
+/**
+ * @brief Come os_retrieve_if_none_match, usando una connessione del client.
+ */
+void* os_client_retrieve_if_none_match (os_client_t* client, char* name, char* tag, size_t* size_ptr);
+
+/**
+ * @brief Come os_store_if_match, usando una connessione del client.
+ */
+int os_client_store_if_match (os_client_t* client, char* name, void* block, size_t len, char* tag);
+
+/**
+ * @brief Come os_stat, usando una connessione del client.
+ */
+int os_client_stat (os_client_t* client, char* name, os_stat_t* stat_ptr);
+
+/**
+ * @brief Come os_list, usando una connessione del client.
+ */
+char** os_client_list (os_client_t* client, char* prefix, char* start_after, int limit);
+
+/**
+ * @brief Come os_prefetch, usando una connessione del client.
+ */
+int os_client_prefetch (os_client_t* client, char** names, int count);
+
+/**
+ * @brief Come os_delete, usando una connessione del client.
+ */
+int os_client_delete (os_client_t* client, char* name);
+
+/**
+ * @brief Come os_stats, usando una connessione del client.
+ */
+char* os_client_stats (os_client_t* client, size_t* size_ptr);
+
+/*
+ * Le funzioni seguenti usano un unico client con una sola connessione, creato da os_connect e liberato da os_disconnect.
+ */
+
 /**
  * @brief Inizializza la connessione con il server.
  * 
@@ -28,6 +165,17 @@ int os_connect (char* name);
  */
 int os_store (char* name, void* block, size_t len);
 
+/**
+ * @brief Accoda l'area di memoria di lunghezza len puntata da block in fondo al blocco name, creandolo se non esiste.
+ * Viene inviata solo la parte nuova del blocco.
+ * 
+ * @param name Nome del blocco da estendere
+ * @param block Dati da accodare
+ * @param len Lunghezza dei dati da accodare
+ * @return int 1 se l'aggiunta è andata a buon fine. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_append (char* name, void* block, size_t len);
+
 /**
  * @brief Recupera il blocco di dati identificato da name.
  * 
@@ -36,6 +184,81 @@ int os_store (char* name, void* block, size_t len);
  */
 void* os_retrieve (char* name);
 
+/**
+ * @brief Recupera il blocco di dati identificato da name scrivendolo nel buffer passato, senza allocare memoria.
+ * 
+ * @param name Nome del blocco di dati
+ * @param buffer Buffer in cui scrivere il blocco
+ * @param capacity Dimensione del buffer
+ * @param len_ptr Puntatore in cui scrivere la dimensione del blocco, anche quando non entra nel buffer
+ * @return int 1 se il recupero ha avuto successo. Se c'è un errore restituisce 0 e setta errno (ERANGE se il blocco è più
+ * grande del buffer, nel qual caso il contenuto del buffer non è definito).
+ */
+int os_retrieve_into (char* name, void* buffer, size_t capacity, size_t* len_ptr);
+
+/**
+ * @brief Recupera il blocco di dati identificato da name scrivendolo sul file descriptor passato, a partire dalla sua
+ * posizione corrente, senza allocare memoria per l'intero blocco.
+ * 
+ * @param name Nome del blocco di dati
+ * @param file_descriptor File descriptor aperto in scrittura
+ * @return int 1 se il recupero ha avuto successo. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_retrieve_to_fd (char* name, int file_descriptor);
+
+/**
+ * @brief Recupera il blocco di dati identificato da name solo se è cambiato rispetto alla versione posseduta.
+ * 
+ * @param name Nome del blocco di dati
+ * @param tag Buffer di TAG_LENGTH + 1 caratteri con il tag della versione posseduta, stringa vuota se non se ne possiede nessuna.
+ * Se il blocco viene ricevuto vi viene scritto il tag della nuova versione.
+ * @param size_ptr Puntatore alla dimensione del blocco, il cui valore puntato viene settato dalla funzione
+ * @return void* Blocco di dati se il recupero ha avuto successo. Se c'è un errore restituisce NULL e setta errno
+ * (EALREADY se la versione posseduta è quella attuale).
+ */
+void* os_retrieve_if_none_match (char* name, char* tag, size_t* size_ptr);
+
+/**
+ * @brief Memorizza sul server il blocco solo se la versione attuale dell'oggetto è quella indicata.
+ * 
+ * @param name Nome del blocco da memorizzare
+ * @param block Dati del blocco da memorizzare
+ * @param len Lunghezza del blocco da memorizzare
+ * @param tag Tag della versione attesa, OS_TAG_ABSENT se l'oggetto non deve esistere
+ * @return int 1 se la memorizzazione è andata a buon fine. Se c'è un errore restituisce 0 e setta errno (ECANCELED se la versione è cambiata).
+ */
+int os_store_if_match (char* name, void* block, size_t len, char* tag);
+
+/**
+ * @brief Recupera dimensione, istante dell'ultima modifica e tag della versione di un oggetto, senza riceverne il contenuto.
+ * 
+ * @param name Nome del blocco di dati
+ * @param stat_ptr Puntatore in cui scrivere i metadati
+ * @return int 1 se l'oggetto esiste. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_stat (char* name, os_stat_t* stat_ptr);
+
+/**
+ * @brief Elenca in ordine alfabetico i nomi degli oggetti che iniziano con prefix. Per scorrere le pagine
+ * successive si passa come start_after l'ultimo nome ricevuto, finché non vengono restituiti meno di limit nomi.
+ * 
+ * @param prefix Prefisso dei nomi da elencare, NULL o stringa vuota per tutti gli oggetti
+ * @param start_after Ultimo nome della pagina precedente, NULL o stringa vuota per partire dall'inizio
+ * @param limit Numero massimo di nomi da restituire, 0 per il limite predefinito del server
+ * @return char** Array di nomi terminato da NULL, allocato in un unico blocco da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+char** os_list (char* prefix, char* start_after, int limit);
+
+/**
+ * @brief Chiede al server di portare in memoria gli oggetti indicati, che si prevede di leggere a breve.
+ * La richiesta non attende la lettura dal disco, e i nomi di oggetti che non esistono vengono ignorati.
+ * 
+ * @param names Nomi degli oggetti
+ * @param count Numero di nomi
+ * @return int 1 se la richiesta è stata accettata. Se c'è un errore restituisce 0 e setta errno.
+ */
+int os_prefetch (char** names, int count);
+
 /**
  * @brief Cancella il blocco di dati identificato da name
  * 
@@ -44,6 +267,16 @@ void* os_retrieve (char* name);
  */
 int os_delete (char* name);
 
+/**
+ * @brief Legge le misure del server: connessioni, richieste in corso, indice, pool dei buffer e, per ogni verbo,
+ * richieste, errori, byte e latenze in nanosecondi. Il testo è fatto di righe "<nome> <valore>\n" con valori interi;
+ * i nomi sono descritti nella relazione e ne possono essere aggiunti di nuovi.
+ * 
+ * @param size_ptr Se non è NULL vi viene scritta la lunghezza del testo
+ * @return char* Testo terminato da '\0', da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+char* os_stats (size_t* size_ptr);
+
 /**
  * @brief Si disconnette dal server
  * 
@@ -0,0 +1,285 @@
+/**
+ * @file pool.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria che mantiene un pool globale di buffer divisi in classi di dimensione.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <sys/mman.h>
+
+#include <assertmacros.h>
+#include <mutexmacros.h>
+
+#include <pool/pool.h>
+
+/**
+ * @brief Buffer libero di una classe: i primi byte del buffer contengono il puntatore al successivo.
+ */
+struct free_buffer {
+    struct free_buffer* next;
+};
+
+/**
+ * @brief Classe di dimensione del pool globale, con la lista dei buffer liberi e la lock che la protegge.
+ */
+struct size_class {
+    pthread_mutex_t lock;
+    struct free_buffer* head;
+};
+
+/**
+ * @brief Cache di un thread: al più un buffer per classe, a cui il thread accede senza lock.
+ */
+struct thread_cache {
+    void* buffers[POOL_CLASSES];
+};
+
+// Classi del pool globale
+static struct size_class classes[POOL_CLASSES];
+
+// Chiave che associa ad ogni thread la sua cache
+static pthread_key_t cache_key;
+
+// Garantisce che lock e chiave vengano inizializzate una sola volta
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+// Esito dell'inizializzazione
+static int pool_ready = 0;
+
+// Statistiche, aggiornate con operazioni atomiche
+static pool_stats_t stats;
+
+/**
+ * @brief Restituisce l'indice della classe che contiene size byte
+ * 
+ * @param size Numero di byte
+ * @return int Indice della classe, -1 se size supera la classe più grande
+ */
+static int class_index (size_t size) {
+    if (size > ((size_t) 1 << POOL_MAX_SHIFT)) return -1;
+    int shift = POOL_MIN_SHIFT;
+    while (((size_t) 1 << shift) < size) shift++;
+    return shift - POOL_MIN_SHIFT;
+}
+
+/**
+ * @brief Restituisce la capacità dei buffer di una classe
+ * 
+ * @param index Indice della classe
+ * @return size_t Capacità in byte
+ */
+static size_t class_size (int index) {
+    return (size_t) 1 << (index + POOL_MIN_SHIFT);
+}
+
+/**
+ * @brief Alloca un nuovo buffer dal sistema
+ * 
+ * @param capacity Capacità del buffer
+ * @return void* Buffer allocato. Se c'è un errore restituisce NULL e setta errno.
+ */
+static void* allocate_buffer (size_t capacity) {
+    size_t alignment = POOL_ALIGNMENT;
+#if defined(POOL_HUGEPAGES) && defined(MADV_HUGEPAGE)
+    // I buffer grandi vengono allineati alla pagina grande, così il kernel può mapparli interamente con pagine grandi
+    if (capacity >= POOL_HUGEPAGE_SIZE) alignment = POOL_HUGEPAGE_SIZE;
+#endif
+    void* buffer = NULL;
+    errno = posix_memalign(&buffer, alignment, capacity);
+    ASSERT_RETURN(errno == 0, NULL);
+#if defined(POOL_HUGEPAGES) && defined(MADV_HUGEPAGE)
+    // Il consiglio è facoltativo: se il kernel non supporta le pagine grandi il buffer resta valido
+    if (capacity >= POOL_HUGEPAGE_SIZE) madvise(buffer, capacity, MADV_HUGEPAGE);
+#endif
+    return buffer;
+}
+
+/**
+ * @brief Inserisce un buffer nella lista dei liberi della sua classe
+ * 
+ * @param index Indice della classe
+ * @param buffer Buffer da inserire
+ */
+static void push_buffer (int index, void* buffer) {
+    struct free_buffer* node = (struct free_buffer*) buffer;
+    // Se non riesce ad acquisire la lock restituisce il buffer al sistema
+    LOCK_ACQUIRE(&classes[index].lock, __sync_fetch_and_sub(&stats.retained, class_size(index)); free(buffer); return);
+    node->next = classes[index].head;
+    classes[index].head = node;
+    LOCK_RELEASE(&classes[index].lock, return);
+}
+
+/**
+ * @brief Estrae un buffer dalla lista dei liberi di una classe
+ * 
+ * @param index Indice della classe
+ * @return void* Buffer estratto, NULL se la lista è vuota
+ */
+static void* pop_buffer (int index) {
+    LOCK_ACQUIRE(&classes[index].lock, return NULL);
+    struct free_buffer* node = classes[index].head;
+    if (node) classes[index].head = node->next;
+    LOCK_RELEASE(&classes[index].lock, return node);
+    return node;
+}
+
+/**
+ * @brief Restituisce al pool globale i buffer della cache di un thread che termina
+ * 
+ * @param ptr Cache del thread
+ */
+static void release_thread_cache (void* ptr) {
+    struct thread_cache* cache = (struct thread_cache*) ptr;
+    for (int i = 0; i < POOL_CLASSES; i++)
+        if (cache->buffers[i]) push_buffer(i, cache->buffers[i]);
+    free(cache);
+}
+
+/**
+ * @brief Inizializza le lock delle classi e la chiave delle cache dei thread
+ */
+static void init_pool () {
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        if (pthread_mutex_init(&classes[i].lock, NULL) != 0) return;
+        classes[i].head = NULL;
+    }
+    if (pthread_key_create(&cache_key, release_thread_cache) != 0) return;
+    pool_ready = 1;
+}
+
+/**
+ * @brief Restituisce la cache del thread chiamante, creandola al primo uso
+ * 
+ * @return struct thread_cache* Cache del thread, NULL se non può essere creata
+ */
+static struct thread_cache* get_thread_cache () {
+    struct thread_cache* cache = (struct thread_cache*) pthread_getspecific(cache_key);
+    if (cache) return cache;
+    cache = (struct thread_cache*) calloc(1, sizeof(struct thread_cache));
+    if (cache == NULL) return NULL;
+    ASSERT(pthread_setspecific(cache_key, cache) == 0, free(cache); return NULL);
+    return cache;
+}
+
+/**
+ * @brief Restituisce la capacità del buffer che il pool assegna ad una richiesta di size byte
+ * 
+ * @param size Numero di byte richiesti
+ * @return size_t Dimensione della classe, oppure size se supera la classe più grande
+ */
+size_t pool_capacity (size_t size) {
+    int index = class_index(size);
+    return (index == -1) ? size : class_size(index);
+}
+
+/**
+ * @brief Prende in prestito un buffer di almeno size byte, allineato a POOL_ALIGNMENT
+ * 
+ * @param size Numero di byte richiesti
+ * @return void* Buffer di pool_capacity(size) byte. Se c'è un errore restituisce NULL e setta errno.
+ */
+void* pool_acquire (size_t size) {
+    ASSERT_ERRNO_RETURN(size > 0, EINVAL, NULL);
+    pthread_once(&pool_once, init_pool);
+    int index = class_index(size);
+    // I buffer fuori dalle classi, o se il pool non è disponibile, vengono allocati direttamente
+    if ((index == -1) || !pool_ready) {
+        void* buffer = allocate_buffer(size);
+        ASSERT_RETURN(buffer != NULL, NULL);
+        __sync_fetch_and_add(&stats.misses, 1);
+        __sync_fetch_and_add(&stats.outstanding, size);
+        return buffer;
+    }
+    size_t capacity = class_size(index);
+    // Prima cerca nella cache del thread, senza lock, poi nel pool globale
+    void* buffer = NULL;
+    struct thread_cache* cache = get_thread_cache();
+    if (cache && cache->buffers[index]) {
+        buffer = cache->buffers[index];
+        cache->buffers[index] = NULL;
+    }
+    else buffer = pop_buffer(index);
+    if (buffer) {
+        __sync_fetch_and_add(&stats.hits, 1);
+        __sync_fetch_and_sub(&stats.retained, capacity);
+    }
+    // Se nessuno dei due ha un buffer libero ne alloca uno nuovo
+    else {
+        buffer = allocate_buffer(capacity);
+        ASSERT_RETURN(buffer != NULL, NULL);
+        __sync_fetch_and_add(&stats.misses, 1);
+    }
+    __sync_fetch_and_add(&stats.outstanding, capacity);
+    return buffer;
+}
+
+/**
+ * @brief Restituisce al pool un buffer preso con pool_acquire
+ * 
+ * @param buffer Buffer da restituire
+ * @param size Dimensione passata a pool_acquire
+ */
+void pool_release (void* buffer, size_t size) {
+    if (buffer == NULL) return;
+    int index = class_index(size);
+    if ((index == -1) || !pool_ready) {
+        __sync_fetch_and_sub(&stats.outstanding, size);
+        free(buffer);
+        return;
+    }
+    size_t capacity = class_size(index);
+    __sync_fetch_and_sub(&stats.outstanding, capacity);
+    // Riserva lo spazio nel pool: se supererebbe il limite restituisce il buffer al sistema
+    if (__sync_add_and_fetch(&stats.retained, capacity) > POOL_MAX_RETAINED) {
+        __sync_fetch_and_sub(&stats.retained, capacity);
+        __sync_fetch_and_add(&stats.dropped, 1);
+        free(buffer);
+        return;
+    }
+    // I buffer piccoli restano nella cache del thread, se c'è posto
+    if (capacity <= POOL_THREAD_CACHE_MAX) {
+        struct thread_cache* cache = get_thread_cache();
+        if (cache && (cache->buffers[index] == NULL)) {
+            cache->buffers[index] = buffer;
+            return;
+        }
+    }
+    // Gli altri tornano nel pool globale
+    push_buffer(index, buffer);
+}
+
+/**
+ * @brief Copia le statistiche del pool
+ * 
+ * @param stats_ptr Puntatore in cui copiare le statistiche
+ */
+void pool_stats (pool_stats_t* stats_ptr) {
+    if (stats_ptr == NULL) return;
+    stats_ptr->hits = __sync_fetch_and_add(&stats.hits, 0);
+    stats_ptr->misses = __sync_fetch_and_add(&stats.misses, 0);
+    stats_ptr->dropped = __sync_fetch_and_add(&stats.dropped, 0);
+    stats_ptr->retained = __sync_fetch_and_add(&stats.retained, 0);
+    stats_ptr->outstanding = __sync_fetch_and_add(&stats.outstanding, 0);
+}
+
+/**
+ * @brief Libera tutti i buffer trattenuti dal pool globale. Va chiamata quando nessun thread usa più il pool.
+ */
+void destroy_pool () {
+    if (!pool_ready) return;
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        void* buffer;
+        while ((buffer = pop_buffer(i)) != NULL) {
+            __sync_fetch_and_sub(&stats.retained, class_size(i));
+            free(buffer);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file pool.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria che mantiene un pool globale di buffer divisi in classi di dimensione potenza di due.
+ * I buffer restituiti al pool vengono riusati dalle richieste successive invece di tornare all'allocatore di sistema,
+ * così sotto carico la memoria del processo non si frammenta. Ogni thread conserva un buffer per classe
+ * a cui accede senza lock, e la memoria trattenuta dal pool globale ha un limite massimo.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_POOL)
+#define _POOL
+
+#include <stddef.h>
+
+// Logaritmo della classe più piccola (4KB) e della più grande (128MB, sufficiente per un oggetto di 100MB)
+#define POOL_MIN_SHIFT 12
+#define POOL_MAX_SHIFT 27
+
+// Numero di classi di dimensione
+#define POOL_CLASSES (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+
+// Memoria massima trattenuta dal pool globale, ridefinibile in compilazione con -DPOOL_MAX_RETAINED=<bytes>
+#if !defined(POOL_MAX_RETAINED)
+#define POOL_MAX_RETAINED (256 * 1024 * 1024)
+#endif
+
+// Classe più grande conservata nella cache di ogni thread
+#define POOL_THREAD_CACHE_MAX (4 * 1024 * 1024)
+
+// Allineamento dei buffer, compatibile con O_DIRECT
+#define POOL_ALIGNMENT 4096
+
+// Dimensione di una pagina grande: se si compila con -DPOOL_HUGEPAGES i buffer almeno così grandi
+// vengono allineati a questa dimensione e il kernel viene invitato a usare pagine grandi
+#define POOL_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @brief Statistiche del pool.
+ */
+typedef struct pool_stats {
+    unsigned long hits;         // Richieste servite con un buffer già allocato
+    unsigned long misses;       // Richieste che hanno allocato un nuovo buffer
+    unsigned long dropped;      // Buffer restituiti al sistema perché il pool era pieno
+    size_t retained;            // Byte trattenuti dal pool globale e dalle cache dei thread
+    size_t outstanding;         // Byte prestati e non ancora restituiti
+} pool_stats_t;
+
+/**
+ * @brief Restituisce la capacità del buffer che il pool assegna ad una richiesta di size byte
+ * 
+ * @param size Numero di byte richiesti
+ * @return size_t Dimensione della classe, oppure size se supera la classe più grande
+ */
+size_t pool_capacity (size_t size);
+
+/**
+ * @brief Prende in prestito un buffer di almeno size byte, allineato a POOL_ALIGNMENT
+ * 
+ * @param size Numero di byte richiesti
+ * @return void* Buffer di pool_capacity(size) byte. Se c'è un errore restituisce NULL e setta errno.
+ */
+void* pool_acquire (size_t size);
+
+/**
+ * @brief Restituisce al pool un buffer preso con pool_acquire
+ * 
+ * @param buffer Buffer da restituire
+ * @param size Dimensione passata a pool_acquire
+ */
+void pool_release (void* buffer, size_t size);
+
+/**
+ * @brief Copia le statistiche del pool
+ * 
+ * @param stats_ptr Puntatore in cui copiare le statistiche
+ */
+void pool_stats (pool_stats_t* stats_ptr);
+
+/**
+ * @brief Libera tutti i buffer trattenuti dal pool globale. Va chiamata quando nessun thread usa più il pool.
+ */
+void destroy_pool ();
+
+#endif // _POOL
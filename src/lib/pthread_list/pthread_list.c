@@ -1,7 +1,7 @@
 /**
  * @file pthread_list.c
  * @author Giacomo Mariani, Matricola 545519, Corso B
- * @brief Implementazione della libreria di creazione e gestione di una lista linkata di pthread_t.
+ * @brief Implementazione della libreria di creazione e gestione di una lista linkata di pthread_t e della coda di completamento.
  * 
  * Si dichiara che tutto il codice è stato realizzato dallo studente.
  * 
@@ -12,6 +12,7 @@
 #include <pthread.h>
 
 #include <assertmacros.h>
+#include <mutexmacros.h>
 
 #include <pthread_list/pthread_list.h>
 
@@ -55,4 +56,114 @@ pthread_t remove_pthread_list_head (pthread_list_t** head) {
     free(old_head);
     // Restituisce il valore del nodo
     return thread_id;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Inizializza una coda di completamento vuota
+ * 
+ * @param queue Coda da inizializzare
+ * @return int Se l'inizializzazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int init_pthread_queue (pthread_queue_t* queue) {
+    ASSERT_ERRNO_RETURN(queue != NULL, EINVAL, -1);
+    ASSERT_RETURN((errno = pthread_mutex_init(&queue->mutex, NULL)) == 0, -1);
+    ASSERT((errno = pthread_cond_init(&queue->finished_cond, NULL)) == 0, pthread_mutex_destroy(&queue->mutex); return -1);
+    queue->finished = NULL;
+    queue->running = 0;
+    return 0;
+}
+
+/**
+ * @brief Libera le risorse di una coda di completamento, che non deve avere thread in esecuzione
+ * 
+ * @param queue Coda da distruggere
+ * @return int Se la distruzione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int destroy_pthread_queue (pthread_queue_t* queue) {
+    ASSERT_ERRNO_RETURN(queue != NULL, EINVAL, -1);
+    ASSERT_ERRNO_RETURN((queue->running == 0) && (queue->finished == NULL), EBUSY, -1);
+    pthread_cond_destroy(&queue->finished_cond);
+    pthread_mutex_destroy(&queue->mutex);
+    return 0;
+}
+
+/**
+ * @brief Conta un thread che sta per essere creato, che dovrà inserirsi nella coda quando termina. Va chiamata prima di
+ * pthread_create, così che il thread non possa terminare senza essere contato.
+ * 
+ * @param queue Coda di completamento
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int add_pthread_queue (pthread_queue_t* queue) {
+    ASSERT_ERRNO_RETURN(queue != NULL, EINVAL, -1);
+    LOCK_ACQUIRE(&queue->mutex, return -1);
+    queue->running++;
+    LOCK_RELEASE(&queue->mutex, return -1);
+    return 0;
+}
+
+/**
+ * @brief Toglie dal conto un thread contato con add_pthread_queue la cui creazione è fallita
+ * 
+ * @param queue Coda di completamento
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int remove_pthread_queue (pthread_queue_t* queue) {
+    ASSERT_ERRNO_RETURN(queue != NULL, EINVAL, -1);
+    LOCK_ACQUIRE(&queue->mutex, return -1);
+    queue->running--;
+    LOCK_RELEASE(&queue->mutex, return -1);
+    return 0;
+}
+
+/**
+ * @brief Inserisce nella coda il thread corrente, che sta per terminare. Il nodo va allocato prima di creare il thread, così che
+ * la terminazione non debba allocare memoria, e viene liberato da reap_pthread_queue dopo la pthread_join.
+ * 
+ * @param queue Coda di completamento
+ * @param node Nodo del thread corrente
+ * @return int Se l'inserimento è andato a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int push_pthread_queue (pthread_queue_t* queue, pthread_list_t* node) {
+    ASSERT_ERRNO_RETURN((queue != NULL) && (node != NULL), EINVAL, -1);
+    node->thread_id = pthread_self();
+    LOCK_ACQUIRE(&queue->mutex, return -1);
+    node->next = queue->finished;
+    queue->finished = node;
+    pthread_cond_signal(&queue->finished_cond);
+    LOCK_RELEASE(&queue->mutex, return -1);
+    return 0;
+}
+
+/**
+ * @brief Attende con pthread_join tutti i thread terminati presenti nella coda e ne libera i nodi
+ * 
+ * @param queue Coda di completamento
+ * @param wait Se è diverso da 0 e ci sono thread in esecuzione, aspetta che almeno uno termini
+ * @return int Numero di thread attesi (0 se non ci sono più thread in esecuzione). Se c'è un errore restituisce -1 e setta errno.
+ */
+int reap_pthread_queue (pthread_queue_t* queue, int wait) {
+    ASSERT_ERRNO_RETURN(queue != NULL, EINVAL, -1);
+    LOCK_ACQUIRE(&queue->mutex, return -1);
+    while (wait && (queue->finished == NULL) && (queue->running > 0))
+        pthread_cond_wait(&queue->finished_cond, &queue->mutex);
+    // Stacca tutta la lista dei thread terminati, così che le join avvengano senza la lock
+    pthread_list_t* finished = queue->finished;
+    queue->finished = NULL;
+    LOCK_RELEASE(&queue->mutex, return -1);
+    int reaped = 0;
+    int error = 0;
+    while (finished != NULL) {
+        // Il thread si è inserito poco prima di uscire, quindi la join non attende a lungo
+        pthread_t thread_id = remove_pthread_list_head(&finished);
+        int result = pthread_join(thread_id, NULL);
+        // Un thread che non si riesce ad attendere viene comunque tolto dal conto, altrimenti non si finirebbe mai di aspettarlo
+        if (result != 0) error = result;
+        reaped++;
+    }
+    LOCK_ACQUIRE(&queue->mutex, return -1);
+    queue->running -= reaped;
+    LOCK_RELEASE(&queue->mutex, return -1);
+    ASSERT_ERRNO_RETURN(error == 0, error, -1);
+    return reaped;
+}
@@ -1,7 +1,8 @@
 /**
  * @file pthread_list.h
  * @author Giacomo Mariani, Matricola 545519, Corso B
- * @brief Header file della libreria che fornisce i metodi di gestione per una lista concatenata di pthread_t.
+ * @brief Header file della libreria che fornisce i metodi di gestione per una lista concatenata di pthread_t, e una coda
+ * di completamento in cui i thread si inseriscono quando terminano, così che possano essere attesi man mano.
  * 
  * Si dichiara che tutto il codice è stato realizzato dallo studente.
  * 
@@ -10,6 +11,8 @@
 #if !defined(_PTHREAD_LIST)
 #define _PTHREAD_LIST
 
+#include <pthread.h>
+
 /**
  * @brief Nodo di una lista concatenata
  * 
@@ -36,4 +39,69 @@ int insert_pthread_list (pthread_list_t** head, pthread_t thread_id);
  */
 pthread_t remove_pthread_list_head (pthread_list_t** head);
 
+/**
+ * @brief Coda di completamento dei thread. Un thread che termina inserisce il proprio nodo nella coda, e un solo thread
+ * (quello che li ha creati) li attende con reap_pthread_queue: la memoria è proporzionale ai thread vivi e non a quelli creati.
+ */
+typedef struct pthread_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t finished_cond;
+    // Thread terminati e non ancora attesi
+    pthread_list_t* finished;
+    // Thread creati e non ancora attesi
+    int running;
+} pthread_queue_t;
+
+/**
+ * @brief Inizializza una coda di completamento vuota
+ * 
+ * @param queue Coda da inizializzare
+ * @return int Se l'inizializzazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int init_pthread_queue (pthread_queue_t* queue);
+
+/**
+ * @brief Libera le risorse di una coda di completamento, che non deve avere thread in esecuzione
+ * 
+ * @param queue Coda da distruggere
+ * @return int Se la distruzione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int destroy_pthread_queue (pthread_queue_t* queue);
+
+/**
+ * @brief Conta un thread che sta per essere creato, che dovrà inserirsi nella coda quando termina. Va chiamata prima di
+ * pthread_create, così che il thread non possa terminare senza essere contato.
+ * 
+ * @param queue Coda di completamento
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int add_pthread_queue (pthread_queue_t* queue);
+
+/**
+ * @brief Toglie dal conto un thread contato con add_pthread_queue la cui creazione è fallita
+ * 
+ * @param queue Coda di completamento
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int remove_pthread_queue (pthread_queue_t* queue);
+
+/**
+ * @brief Inserisce nella coda il thread corrente, che sta per terminare. Il nodo va allocato prima di creare il thread, così che
+ * la terminazione non debba allocare memoria, e viene liberato da reap_pthread_queue dopo la pthread_join.
+ * 
+ * @param queue Coda di completamento
+ * @param node Nodo del thread corrente
+ * @return int Se l'inserimento è andato a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int push_pthread_queue (pthread_queue_t* queue, pthread_list_t* node);
+
+/**
+ * @brief Attende con pthread_join tutti i thread terminati presenti nella coda e ne libera i nodi
+ * 
+ * @param queue Coda di completamento
+ * @param wait Se è diverso da 0 e ci sono thread in esecuzione, aspetta che almeno uno termini
+ * @return int Numero di thread attesi (0 se non ci sono più thread in esecuzione). Se c'è un errore restituisce -1 e setta errno.
+ */
+int reap_pthread_queue (pthread_queue_t* queue, int wait);
+
 #endif // _PTHREAD_LIST
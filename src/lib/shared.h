@@ -17,14 +17,38 @@
 // Nome della cartella dati
 #define DATA_DIRECTORY "./data"
 
-// Lunghezza massima di un header che contiene un comando dato da verbo di lunghezza massima ("RETRIEVE") + massima dimensione di un nome di file POSIX (255) + due spazi + \n + \0
-#define MAX_HEADER_LENGTH 267
+// Lunghezza massima di un header che contiene un comando dato da verbo di lunghezza massima ("RETRIEVE") + due nomi di file POSIX (255) + un numero fino a 20 cifre + quattro spazi + \n + \0
+#define MAX_HEADER_LENGTH 544
 
-// Lunghezza massima di una risposta di tipo diverso dai dati, costituito da "KO <er> \n"
-#define MAX_RESPONSE_LENGTH 8
+// Dimensione massima dei dati che seguono un singolo header: gli oggetti più grandi vanno caricati in più parti
+#define MAX_PAYLOAD_LENGTH ((size_t) 1 << 30)
 
-// Lunghezza massima della stringa "DATA <length> \n ", con la lunghezza massima di length data da 2^64 (20 cifre)
-#define MAX_DATA_LENGTH 29
+// Dimensione massima dei dati di un messaggio PART di un caricamento in più parti, che il server riceve in memoria prima di scriverli
+#define MAX_PART_LENGTH ((size_t) 8 << 20)
+
+// Segnaposto per un nome vuoto in un header, dato che '/' non può comparire nel nome di un oggetto
+#define EMPTY_NAME "/"
+
+// Numero di nomi restituiti da LIST se il client non specifica un limite
+#define LIST_DEFAULT_LIMIT 1000
+
+// Numero massimo di nomi restituiti da una singola LIST
+#define LIST_MAX_LIMIT 10000
+
+// Lunghezza massima dell'elenco di nomi di un PREFETCH: LIST_MAX_LIMIT nomi di file POSIX (255), ciascuno seguito da \n
+#define PREFETCH_MAX_LENGTH ((size_t) LIST_MAX_LIMIT * (255 + 1))
+
+// Lunghezza massima di una risposta di tipo diverso dai dati, costituito da "KO <err> \n" con codice di errore fino a 3 cifre + \0
+#define MAX_RESPONSE_LENGTH 9
+
+// Numero di cifre esadecimali del tag che identifica la versione di un oggetto
+#define TAG_LENGTH 16
+
+// Lunghezza massima della stringa "DATA <length> <tag> \n ", con la lunghezza massima di length data da 2^64 (20 cifre)
+#define MAX_DATA_LENGTH (29 + TAG_LENGTH + 1)
+
+// Lunghezza massima della stringa "STAT <size> <mtime> <tag> \n", con size e mtime fino a 20 cifre
+#define MAX_STAT_LENGTH (5 + 20 + 1 + 20 + 1 + TAG_LENGTH + 3)
 
 // Macro che testa se i primi n bytes dell stringa b sono uguali ai primi n bytes della stringa a
 #define EQUALS(a, b) (strcmp(a, b) == 0)
@@ -0,0 +1,200 @@
+/**
+ * @file skiplist.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria di creazione e gestione di una skiplist ordinata di coppie (stringa, metadati di un oggetto).
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <assertmacros.h>
+#include <shared.h>
+
+#include <skiplist/skiplist.h>
+
+/**
+ * @brief Crea un nodo con il numero di livelli dato
+ * 
+ * @param key Chiave del nodo, che viene copiata. Può essere NULL per il nodo sentinella.
+ * @param info Metadati associati alla chiave
+ * @param levels Numero di livelli del nodo
+ * @return struct skip_node* Nodo appena creato. Se c'è un errore restituisce NULL e setta errno.
+ */
+static struct skip_node* create_node (char* key, object_info_t info, int levels) {
+    struct skip_node* node = (struct skip_node*) calloc(1, sizeof(struct skip_node) + levels * sizeof(struct skip_node*));
+    ASSERT_ERRNO_RETURN(node != NULL, ENOMEM, NULL);
+    if (key) {
+        node->key = strdup(key);
+        ASSERT_ERRNO(node->key != NULL, ENOMEM, free(node); return NULL);
+    }
+    node->info = info;
+    node->levels = levels;
+    return node;
+}
+
+/**
+ * @brief Estrae il numero di livelli di un nuovo nodo, ognuno con probabilità 1/4 rispetto al precedente
+ * 
+ * @param list Skiplist che contiene lo stato del generatore xorshift
+ * @return int Numero di livelli tra 1 e SKIPLIST_MAX_LEVEL
+ */
+static int random_levels (skiplist_t* list) {
+    int levels = 1;
+    while (levels < SKIPLIST_MAX_LEVEL) {
+        list->seed ^= list->seed << 13;
+        list->seed ^= list->seed >> 17;
+        list->seed ^= list->seed << 5;
+        if ((list->seed & 3) != 0) break;
+        levels++;
+    }
+    return levels;
+}
+
+/**
+ * @brief Trova per ogni livello l'ultimo nodo con chiave strettamente minore di key
+ * 
+ * @param list Skiplist in cui cercare
+ * @param key Chiave da cercare
+ * @param update Array di SKIPLIST_MAX_LEVEL puntatori in cui scrivere i predecessori
+ * @return struct skip_node* Il primo nodo con chiave maggiore o uguale a key, NULL se non esiste
+ */
+static struct skip_node* find_predecessors (skiplist_t* list, char* key, struct skip_node** update) {
+    struct skip_node* node = list->head;
+    for (int level = list->levels - 1; level >= 0; level--) {
+        while (node->next[level] && strcmp(node->next[level]->key, key) < 0)
+            node = node->next[level];
+        update[level] = node;
+    }
+    return node->next[0];
+}
+
+/**
+ * @brief Crea una skiplist vuota
+ * 
+ * @return skiplist_t* Skiplist appena creata. Se c'è un errore restituisce NULL e setta errno.
+ */
+skiplist_t* create_skiplist () {
+    skiplist_t* list = (skiplist_t*) malloc(sizeof(skiplist_t));
+    ASSERT_ERRNO_RETURN(list != NULL, ENOMEM, NULL);
+    object_info_t empty = {0};
+    list->head = create_node(NULL, empty, SKIPLIST_MAX_LEVEL);
+    ASSERT(list->head != NULL, free(list); return NULL);
+    list->elements = 0;
+    list->levels = 1;
+    list->seed = 2463534242u;
+    return list;
+}
+
+/**
+ * @brief Libera la memoria occupata dalla skiplist e da tutti i suoi nodi
+ * 
+ * @param list Skiplist da eliminare
+ * @return int Se l'eliminazione è avvenuta correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int destroy_skiplist (skiplist_t* list) {
+    ASSERT_ERRNO_RETURN(list != NULL, EINVAL, -1);
+    // Scorre il livello più basso, che contiene tutti i nodi
+    struct skip_node* node = list->head;
+    while (node) {
+        struct skip_node* next = node->next[0];
+        free(node->key);
+        free(node);
+        node = next;
+    }
+    free(list);
+    return 0;
+}
+
+/**
+ * @brief Recupera i metadati associati alla chiave
+ * 
+ * @param list Skiplist in cui cercare
+ * @param key Chiave da cercare
+ * @return object_info_t* Metadati associati alla chiave. Se la chiave non esiste restituisce NULL e setta errno.
+ */
+object_info_t* get_skiplist (skiplist_t* list, char* key) {
+    ASSERT_ERRNO_RETURN((list != NULL) && (key != NULL), EINVAL, NULL);
+    struct skip_node* update[SKIPLIST_MAX_LEVEL];
+    struct skip_node* node = find_predecessors(list, key, update);
+    ASSERT_ERRNO_RETURN((node != NULL) && EQUALS(node->key, key), ENOENT, NULL);
+    return &node->info;
+}
+
+/**
+ * @brief Inserisce una coppia nella skiplist, oppure aggiorna i metadati se la chiave esiste già
+ * 
+ * @param list Skiplist in cui inserire
+ * @param key Chiave da inserire, che viene copiata
+ * @param info Metadati associati alla chiave
+ * @return int 1 se la chiave è stata inserita, 0 se è stata aggiornata. Se c'è un errore restituisce -1 e setta errno.
+ */
+int put_skiplist (skiplist_t* list, char* key, object_info_t info) {
+    ASSERT_ERRNO_RETURN((list != NULL) && (key != NULL), EINVAL, -1);
+    struct skip_node* update[SKIPLIST_MAX_LEVEL];
+    struct skip_node* node = find_predecessors(list, key, update);
+    // Se la chiave esiste già aggiorna i metadati
+    if (node && EQUALS(node->key, key)) {
+        node->info = info;
+        return 0;
+    }
+    // Crea il nuovo nodo, aggiungendo se necessario dei livelli alla lista
+    int levels = random_levels(list);
+    node = create_node(key, info, levels);
+    ASSERT_RETURN(node != NULL, -1);
+    for (; list->levels < levels; list->levels++)
+        update[list->levels] = list->head;
+    // Collega il nodo dopo i suoi predecessori su ogni livello
+    for (int level = 0; level < levels; level++) {
+        node->next[level] = update[level]->next[level];
+        update[level]->next[level] = node;
+    }
+    list->elements++;
+    return 1;
+}
+
+/**
+ * @brief Rimuove la chiave dalla skiplist
+ * 
+ * @param list Skiplist da cui rimuovere
+ * @param key Chiave da rimuovere
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati della chiave rimossa
+ * @return int Se la chiave è stata rimossa restituisce 0. Se la chiave non esiste restituisce -1 e setta errno.
+ */
+int remove_skiplist (skiplist_t* list, char* key, object_info_t* info_ptr) {
+    ASSERT_ERRNO_RETURN((list != NULL) && (key != NULL), EINVAL, -1);
+    struct skip_node* update[SKIPLIST_MAX_LEVEL];
+    struct skip_node* node = find_predecessors(list, key, update);
+    ASSERT_ERRNO_RETURN((node != NULL) && EQUALS(node->key, key), ENOENT, -1);
+    // Scollega il nodo da tutti i livelli in cui compare
+    for (int level = 0; level < node->levels; level++)
+        update[level]->next[level] = node->next[level];
+    // Riduce il numero di livelli in uso se quelli più alti sono rimasti vuoti
+    while ((list->levels > 1) && (list->head->next[list->levels - 1] == NULL))
+        list->levels--;
+    if (info_ptr) *info_ptr = node->info;
+    free(node->key);
+    free(node);
+    list->elements--;
+    return 0;
+}
+
+/**
+ * @brief Posiziona un cursore sul primo nodo con chiave maggiore o uguale a key.
+ * I nodi successivi si visitano in ordine seguendo next[0].
+ * 
+ * @param list Skiplist in cui cercare
+ * @param key Chiave da cercare. Se è NULL restituisce il primo nodo della lista.
+ * @return struct skip_node* Primo nodo con chiave maggiore o uguale a key. Se non esiste restituisce NULL.
+ */
+struct skip_node* seek_skiplist (skiplist_t* list, char* key) {
+    ASSERT_ERRNO_RETURN(list != NULL, EINVAL, NULL);
+    if (key == NULL) return list->head->next[0];
+    struct skip_node* update[SKIPLIST_MAX_LEVEL];
+    return find_predecessors(list, key, update);
+}
@@ -0,0 +1,102 @@
+/**
+ * @file skiplist.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria di creazione e gestione di una skiplist ordinata di coppie (stringa, metadati di un oggetto).
+ * La libreria non è thread-safe: l'accesso concorrente va protetto dal chiamante.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_SKIPLIST)
+#define _SKIPLIST
+
+#include <stddef.h>
+
+// Numero massimo di livelli di un nodo, sufficiente per decine di milioni di elementi
+#define SKIPLIST_MAX_LEVEL 24
+
+/**
+ * @brief Metadati di un oggetto: dimensione, istante dell'ultima modifica e versione.
+ */
+typedef struct object_info {
+    size_t size;
+    long mtime;
+    unsigned long version;
+} object_info_t;
+
+/**
+ * @brief Nodo della skiplist con chiave, metadati e un puntatore al successore per ogni livello del nodo.
+ */
+struct skip_node {
+    char* key;
+    object_info_t info;
+    int levels;
+    struct skip_node* next[];
+};
+
+/**
+ * @brief Skiplist con numero di elementi, numero di livelli in uso, stato del generatore casuale e nodo sentinella di testa.
+ */
+typedef struct skiplist {
+    int elements;
+    int levels;
+    unsigned int seed;
+    struct skip_node* head;
+} skiplist_t;
+
+/**
+ * @brief Crea una skiplist vuota
+ * 
+ * @return skiplist_t* Skiplist appena creata. Se c'è un errore restituisce NULL e setta errno.
+ */
+skiplist_t* create_skiplist ();
+
+/**
+ * @brief Libera la memoria occupata dalla skiplist e da tutti i suoi nodi
+ * 
+ * @param list Skiplist da eliminare
+ * @return int Se l'eliminazione è avvenuta correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int destroy_skiplist (skiplist_t* list);
+
+/**
+ * @brief Recupera i metadati associati alla chiave
+ * 
+ * @param list Skiplist in cui cercare
+ * @param key Chiave da cercare
+ * @return object_info_t* Metadati associati alla chiave. Se la chiave non esiste restituisce NULL e setta errno.
+ */
+object_info_t* get_skiplist (skiplist_t* list, char* key);
+
+/**
+ * @brief Inserisce una coppia nella skiplist, oppure aggiorna i metadati se la chiave esiste già
+ * 
+ * @param list Skiplist in cui inserire
+ * @param key Chiave da inserire, che viene copiata
+ * @param info Metadati associati alla chiave
+ * @return int 1 se la chiave è stata inserita, 0 se è stata aggiornata. Se c'è un errore restituisce -1 e setta errno.
+ */
+int put_skiplist (skiplist_t* list, char* key, object_info_t info);
+
+/**
+ * @brief Rimuove la chiave dalla skiplist
+ * 
+ * @param list Skiplist da cui rimuovere
+ * @param key Chiave da rimuovere
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati della chiave rimossa
+ * @return int Se la chiave è stata rimossa restituisce 0. Se la chiave non esiste restituisce -1 e setta errno.
+ */
+int remove_skiplist (skiplist_t* list, char* key, object_info_t* info_ptr);
+
+/**
+ * @brief Posiziona un cursore sul primo nodo con chiave maggiore o uguale a key.
+ * I nodi successivi si visitano in ordine seguendo next[0].
+ * 
+ * @param list Skiplist in cui cercare
+ * @param key Chiave da cercare. Se è NULL restituisce il primo nodo della lista.
+ * @return struct skip_node* Primo nodo con chiave maggiore o uguale a key. Se non esiste restituisce NULL.
+ */
+struct skip_node* seek_skiplist (skiplist_t* list, char* key);
+
+#endif // _SKIPLIST
@@ -28,7 +28,7 @@ size_t readn (int file_descriptor, void* buffer, size_t n) {
 	// Numero di bytes rimasti
 	size_t nleft = n;
 	// Numero di bytes letti ad ogni iterazione
-	size_t nread;
+	ssize_t nread;
 	// Puntatore che si sposta all'interno del buffer
 	char* ptr = buffer;
 	// Continua a scorrere finché non ha letto tutti i bytes
@@ -67,7 +67,7 @@ size_t writen (int file_descriptor, const void *buffer, size_t n) {
 	// Numero di bytes rimasti da leggere
 	size_t nleft = n;
 	// Numero di bytes scritti ad ogni iterazione
-	size_t nwritten;
+	ssize_t nwritten;
 	// Buffer che si sposta all'interno del buffer
 	const char* ptr = buffer;
 	// Continua finché non ha scritto tutti i bytes
@@ -7,9 +7,12 @@
  * 
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #include <unistd.h>
 #include <sys/socket.h>
@@ -67,6 +70,112 @@ void* receive_message (int file_descriptor, size_t size) {
 	return buffer;
 }
 
+/**
+ * @brief Riceve dal client un messaggio di dimensione size in un buffer già allocato
+ *
+ * @param file_descriptor File descriptor da cui leggere
+ * @param buffer Buffer di almeno size byte
+ * @param size Dimensione del messaggio
+ * @return int 0 se il messaggio è stato ricevuto per intero. Se c'è un errore restituisce -1 e setta errno (ECONNRESET se la connessione è stata chiusa).
+ */
+int receive_message_into (int file_descriptor, void* buffer, size_t size) {
+	// Controlla che i parametri siano corretti
+	ASSERT_ERRNO_RETURN((file_descriptor > 0) && (buffer != NULL) && (size > 0), EINVAL, -1);
+	// Riceve i dati
+	size_t bytes_read = readn(file_descriptor, buffer, size);
+	ASSERT_RETURN(bytes_read != -1, -1);
+	// Se la connessione è stata chiusa prima della fine il messaggio è incompleto
+	ASSERT_ERRNO_RETURN(bytes_read == size, ECONNRESET, -1);
+	return 0;
+}
+
+/**
+ * @brief Lettore bufferizzato: i byte ancora da consumare sono quelli tra start ed end
+ */
+struct socket_reader {
+	int file_descriptor;
+	size_t start;
+	size_t end;
+	// Istante in nanosecondi dell'ultima read che ha riempito il buffer
+	unsigned long fill_time;
+	char buffer[];
+};
+
+/**
+ * @brief Crea il lettore bufferizzato di una connessione
+ * 
+ * @param file_descriptor File descriptor da cui leggere
+ * @return socket_reader_t* Lettore appena creato. Se c'è un errore restituisce NULL e setta errno.
+ */
+socket_reader_t* create_socket_reader (int file_descriptor) {
+	ASSERT_ERRNO_RETURN(file_descriptor > 0, EINVAL, NULL);
+	socket_reader_t* reader = (socket_reader_t*) malloc(sizeof(socket_reader_t) + READER_BUFFER_SIZE);
+	ASSERT_ERRNO_RETURN(reader != NULL, ENOMEM, NULL);
+	reader->file_descriptor = file_descriptor;
+	reader->start = 0;
+	reader->end = 0;
+	reader->fill_time = 0;
+	return reader;
+}
+
+/**
+ * @brief Libera il lettore, senza chiudere il file descriptor. I byte ricevuti e non ancora consumati vengono persi.
+ * 
+ * @param reader Lettore da liberare
+ */
+void destroy_socket_reader (socket_reader_t* reader) {
+	free(reader);
+}
+
+/**
+ * @brief Riceve un messaggio di dimensione size in un buffer già allocato, consumando prima i byte già presenti nel buffer del lettore.
+ * I messaggi grandi almeno quanto il buffer del lettore vengono letti direttamente nella destinazione.
+ * 
+ * @param reader Lettore della connessione
+ * @param buffer Buffer di almeno size byte
+ * @param size Dimensione del messaggio
+ * @return int 0 se il messaggio è stato ricevuto per intero. Se c'è un errore restituisce -1 e setta errno (ECONNRESET se la connessione è stata chiusa).
+ */
+int receive_buffered_into (socket_reader_t* reader, void* buffer, size_t size) {
+	// Controlla che i parametri siano corretti
+	ASSERT_ERRNO_RETURN((reader != NULL) && (buffer != NULL) && (size > 0), EINVAL, -1);
+	char* ptr = buffer;
+	while (size > 0) {
+		// Consuma i byte già ricevuti
+		size_t available = reader->end - reader->start;
+		if (available > 0) {
+			size_t chunk = (available < size) ? available : size;
+			memcpy(ptr, reader->buffer + reader->start, chunk);
+			reader->start += chunk;
+			ptr += chunk;
+			size -= chunk;
+			continue;
+		}
+		// Il buffer è vuoto: i messaggi grandi vengono letti direttamente nella destinazione, senza copiarli due volte
+		reader->start = 0;
+		reader->end = 0;
+		if (size >= READER_BUFFER_SIZE) return receive_message_into(reader->file_descriptor, ptr, size);
+		// Altrimenti chiede al socket tutto quello che entra nel buffer, anche oltre il messaggio richiesto
+		ssize_t bytes_read = read(reader->file_descriptor, reader->buffer, READER_BUFFER_SIZE);
+		if (bytes_read < 0) {
+			// Se la read è stata interrotta deve essere ritentata
+			ASSERT_RETURN(errno == EINTR, -1);
+			continue;
+		}
+		// Se la connessione è stata chiusa prima della fine il messaggio è incompleto
+		ASSERT_ERRNO_RETURN(bytes_read > 0, ECONNRESET, -1);
+		reader->end = (size_t) bytes_read;
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		reader->fill_time = (unsigned long) now.tv_sec * 1000000000UL + (unsigned long) now.tv_nsec;
+	}
+	return 0;
+}
+
+unsigned long socket_reader_fill_time (socket_reader_t* reader) {
+	return reader->fill_time;
+}
+
 /**
  * @brief Crea una struttura dati per ospitare l'indirizzo del socket.
  *
@@ -29,6 +29,60 @@ int send_message (int file_descriptor, void* message, size_t size);
  */
 void* receive_message (int file_descriptor, size_t size);
 
+/**
+ * @brief Riceve dal client un messaggio di dimensione size in un buffer già allocato
+ * 
+ * @param file_descriptor File descriptor da cui leggere
+ * @param buffer Buffer di almeno size byte
+ * @param size Dimensione del messaggio
+ * @return int 0 se il messaggio è stato ricevuto per intero. Se c'è un errore restituisce -1 e setta errno (ECONNRESET se la connessione è stata chiusa).
+ */
+int receive_message_into (int file_descriptor, void* buffer, size_t size);
+
+// Dimensione del buffer di lettura di una connessione
+#define READER_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief Lettore bufferizzato di una connessione. Ogni read chiede al socket fino a READER_BUFFER_SIZE byte, così che con una
+ * sola chiamata di sistema si ricevano l'header e l'inizio dei dati che lo seguono, o più richieste piccole inviate di seguito.
+ */
+typedef struct socket_reader socket_reader_t;
+
+/**
+ * @brief Crea il lettore bufferizzato di una connessione
+ * 
+ * @param file_descriptor File descriptor da cui leggere
+ * @return socket_reader_t* Lettore appena creato. Se c'è un errore restituisce NULL e setta errno.
+ */
+socket_reader_t* create_socket_reader (int file_descriptor);
+
+/**
+ * @brief Libera il lettore, senza chiudere il file descriptor. I byte ricevuti e non ancora consumati vengono persi.
+ * 
+ * @param reader Lettore da liberare
+ */
+void destroy_socket_reader (socket_reader_t* reader);
+
+/**
+ * @brief Riceve un messaggio di dimensione size in un buffer già allocato, consumando prima i byte già presenti nel buffer del lettore.
+ * I messaggi grandi almeno quanto il buffer del lettore vengono letti direttamente nella destinazione.
+ * 
+ * @param reader Lettore della connessione
+ * @param buffer Buffer di almeno size byte
+ * @param size Dimensione del messaggio
+ * @return int 0 se il messaggio è stato ricevuto per intero. Se c'è un errore restituisce -1 e setta errno (ECONNRESET se la connessione è stata chiusa).
+ */
+int receive_buffered_into (socket_reader_t* reader, void* buffer, size_t size);
+
+/**
+ * @brief Restituisce l'istante in cui è arrivato l'ultimo blocco di byte letto nel buffer, cioè quello in cui il messaggio
+ * appena ricevuto era disponibile se è stato consumato dal buffer. I messaggi letti direttamente nella destinazione non lo aggiornano.
+ * 
+ * @param reader Lettore della connessione
+ * @return unsigned long Istante in nanosecondi sul clock CLOCK_MONOTONIC, 0 se il lettore non ha ancora letto niente
+ */
+unsigned long socket_reader_fill_time (socket_reader_t* reader);
+
 /**
  * @brief Crea un file descriptor collegato ad un server socket AF_UNIX.
  *
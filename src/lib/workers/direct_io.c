@@ -0,0 +1,224 @@
+/**
+ * @file direct_io.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria che scrive e legge oggetti di grandi dimensioni bypassando la page cache.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <assertmacros.h>
+#include <mutexmacros.h>
+
+#include <socket/safeio.h>
+
+#include <workers/direct_io.h>
+
+// Arrotonda n al multiplo di DIRECT_IO_ALIGNMENT successivo
+#define ALIGN_UP(n) DIRECT_IO_BUFFER_SIZE(n)
+
+// Dimensione a partire dalla quale un oggetto è considerato grande
+static size_t large_object_threshold = LARGE_OBJECT_THRESHOLD;
+
+// Pila dei buffer allineati liberi
+static void* free_chunks[DIRECT_IO_POOL_SIZE];
+// Numero di buffer liberi nella pila
+static int free_count = 0;
+// Lock e variabile di condizione che proteggono il pool
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Prende un buffer dal pool, attendendo se sono tutti in uso.
+ * 
+ * @return void* Buffer allineato di DIRECT_IO_CHUNK_SIZE bytes. Se c'è un errore restituisce NULL e setta errno.
+ */
+static void* borrow_chunk () {
+    LOCK_ACQUIRE(&pool_mutex, return NULL);
+    while (free_count == 0)
+        ASSERT((errno = pthread_cond_wait(&pool_cond, &pool_mutex)) == 0, pthread_mutex_unlock(&pool_mutex); return NULL);
+    void* chunk = free_chunks[--free_count];
+    LOCK_RELEASE(&pool_mutex, return NULL);
+    return chunk;
+}
+
+/**
+ * @brief Restituisce un buffer al pool e sveglia un thread in attesa.
+ * 
+ * @param chunk Buffer preso con borrow_chunk
+ */
+static void return_chunk (void* chunk) {
+    LOCK_ACQUIRE(&pool_mutex, return);
+    free_chunks[free_count++] = chunk;
+    pthread_cond_signal(&pool_cond);
+    LOCK_RELEASE(&pool_mutex, return);
+}
+
+/**
+ * @brief Attiva o disattiva O_DIRECT sul file descriptor.
+ * 
+ * @param file_fd File descriptor del file
+ * @param enable 1 per attivare O_DIRECT, 0 per disattivarlo
+ * @return int Se il flag è stato cambiato restituisce 0. Se il file system non lo supporta restituisce -1 e setta errno.
+ */
+static int set_direct (int file_fd, int enable) {
+    int flags = fcntl(file_fd, F_GETFL);
+    ASSERT_RETURN(flags != -1, -1);
+    flags = enable ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    return fcntl(file_fd, F_SETFL, flags);
+}
+
+/**
+ * @brief Scrive n bytes sul file a partire da offset, ripetendo la scrittura se interrotta.
+ * 
+ * @param file_fd File descriptor del file
+ * @param buffer Dati da scrivere
+ * @param n Numero di bytes da scrivere
+ * @param offset Posizione nel file
+ * @return int Se la scrittura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int pwriten (int file_fd, const char* buffer, size_t n, off_t offset) {
+    while (n > 0) {
+        ssize_t written = pwrite(file_fd, buffer, n, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buffer += written;
+        offset += written;
+        n -= written;
+    }
+    return 0;
+}
+
+/**
+ * @brief Alloca il pool di buffer allineati.
+ * 
+ * @return int Se l'inizializzazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int init_direct_io () {
+    for (free_count = 0; free_count < DIRECT_IO_POOL_SIZE; free_count++) {
+        int success = posix_memalign(&free_chunks[free_count], DIRECT_IO_ALIGNMENT, DIRECT_IO_CHUNK_SIZE);
+        ASSERT_ERRNO(success == 0, success, stop_direct_io(); return -1);
+    }
+    return 0;
+}
+
+/**
+ * @brief Libera il pool di buffer allineati.
+ * 
+ * @return int Se l'eliminazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int stop_direct_io () {
+    LOCK_ACQUIRE(&pool_mutex, return -1);
+    while (free_count > 0)
+        free(free_chunks[--free_count]);
+    LOCK_RELEASE(&pool_mutex, return -1);
+    return 0;
+}
+
+/**
+ * @brief Cambia la dimensione a partire dalla quale un oggetto è considerato grande. Va chiamata prima di avviare i thread
+ * che leggono e scrivono oggetti.
+ * 
+ * @param threshold Dimensione in byte, maggiore di zero
+ * @return int Se la dimensione è valida restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int set_large_object_threshold (size_t threshold) {
+    ASSERT_ERRNO_RETURN(threshold > 0, EINVAL, -1);
+    large_object_threshold = threshold;
+    return 0;
+}
+
+/**
+ * @brief Indica se un oggetto è abbastanza grande da essere letto e scritto bypassando la page cache.
+ * 
+ * @param size Dimensione dell'oggetto
+ * @return int 1 se l'oggetto è grande, altrimenti 0.
+ */
+int is_large_object (size_t size) {
+    return size >= large_object_threshold;
+}
+
+/**
+ * @brief Scrive size bytes all'inizio del file, preallocando lo spazio e bypassando la page cache.
+ * Se il file system non supporta O_DIRECT ripiega su una scrittura bufferizzata.
+ * 
+ * @param file_fd File descriptor del file, aperto in scrittura
+ * @param data Dati da scrivere
+ * @param size Dimensione dei dati
+ * @return int Se la scrittura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int direct_write_file (int file_fd, void* data, size_t size) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((file_fd > 0) && (data != NULL) && (size > 0), EINVAL, -1);
+    // Prealloca lo spazio in modo che il file sia il più possibile contiguo su disco
+    int success = fallocate(file_fd, 0, 0, ALIGN_UP(size));
+    ASSERT_RETURN((success != -1) || (errno == EOPNOTSUPP) || (errno == ENOSYS), -1);
+    // Se il file system non supporta O_DIRECT scrive normalmente
+    if (set_direct(file_fd, 1) == -1) {
+        ASSERT_RETURN(writen(file_fd, data, size) != -1, -1);
+        return ftruncate(file_fd, size);
+    }
+    // Prende un buffer allineato dal pool
+    char* chunk = borrow_chunk();
+    ASSERT_RETURN(chunk != NULL, -1);
+    // Scrive i dati un blocco alla volta, completando l'ultimo blocco con zeri fino all'allineamento
+    size_t offset = 0;
+    while (offset < size) {
+        size_t length = (size - offset < DIRECT_IO_CHUNK_SIZE) ? size - offset : DIRECT_IO_CHUNK_SIZE;
+        size_t aligned = ALIGN_UP(length);
+        memcpy(chunk, (char*) data + offset, length);
+        memset(chunk + length, 0, aligned - length);
+        success = pwriten(file_fd, chunk, aligned, offset);
+        // Alcuni file system accettano il flag ma rifiutano la scrittura: prosegue senza O_DIRECT
+        if ((success == -1) && (errno == EINVAL) && (set_direct(file_fd, 0) != -1))
+            success = pwriten(file_fd, chunk, length, offset);
+        ASSERT(success != -1, return_chunk(chunk); return -1);
+        offset += length;
+    }
+    return_chunk(chunk);
+    // Elimina il riempimento finale e l'eventuale coda di un oggetto precedente più grande
+    return ftruncate(file_fd, size);
+}
+
+/**
+ * @brief Legge size bytes dall'inizio del file bypassando la page cache.
+ * Se il file system non supporta O_DIRECT ripiega su una lettura bufferizzata.
+ * 
+ * @param file_fd File descriptor del file, aperto in lettura
+ * @param buffer Buffer allineato a DIRECT_IO_ALIGNMENT di almeno DIRECT_IO_BUFFER_SIZE(size) byte
+ * @param size Dimensione del file
+ * @return int Se la lettura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int direct_read_file (int file_fd, void* buffer, size_t size) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN((file_fd > 0) && (buffer != NULL) && (size > 0), EINVAL, -1);
+    // Se possibile legge bypassando la page cache, altrimenti legge normalmente
+    size_t to_read = (set_direct(file_fd, 1) != -1) ? ALIGN_UP(size) : size;
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t bytes_read = pread(file_fd, (char*) buffer + offset, to_read - offset, offset);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        // Alcuni file system accettano il flag ma rifiutano la lettura: prosegue senza O_DIRECT
+        if (bytes_read < 0 && errno == EINVAL && to_read != size && set_direct(file_fd, 0) != -1) {
+            to_read = size;
+            continue;
+        }
+        ASSERT_RETURN(bytes_read >= 0, -1);
+        // Il file è più corto del previsto
+        ASSERT_ERRNO_RETURN(bytes_read > 0, EIO, -1);
+        offset += bytes_read;
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file direct_io.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria che scrive e legge oggetti di grandi dimensioni bypassando la page cache (O_DIRECT),
+ * preallocando lo spazio su disco e usando un pool di buffer allineati.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_DIRECT_IO)
+#define _DIRECT_IO
+
+#include <stddef.h>
+
+// Dimensione predefinita a partire dalla quale un oggetto è considerato grande, cambiabile all'avvio del server con l'opzione -l
+#if !defined(LARGE_OBJECT_THRESHOLD)
+#define LARGE_OBJECT_THRESHOLD (1024 * 1024)
+#endif
+
+// Allineamento di indirizzi, offset e lunghezze richiesto da O_DIRECT
+#define DIRECT_IO_ALIGNMENT 4096
+
+// Dimensione di ogni buffer del pool, multiplo di DIRECT_IO_ALIGNMENT
+#define DIRECT_IO_CHUNK_SIZE (1024 * 1024)
+
+// Numero di buffer allineati nel pool
+#define DIRECT_IO_POOL_SIZE 8
+
+// Dimensione del buffer in cui leggere un oggetto di size byte, arrotondata all'allineamento
+#define DIRECT_IO_BUFFER_SIZE(size) (((size) + DIRECT_IO_ALIGNMENT - 1) & ~((size_t) DIRECT_IO_ALIGNMENT - 1))
+
+/**
+ * @brief Alloca il pool di buffer allineati.
+ * 
+ * @return int Se l'inizializzazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int init_direct_io ();
+
+/**
+ * @brief Libera il pool di buffer allineati.
+ * 
+ * @return int Se l'eliminazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int stop_direct_io ();
+
+/**
+ * @brief Cambia la dimensione a partire dalla quale un oggetto è considerato grande. Va chiamata prima di avviare i thread
+ * che leggono e scrivono oggetti.
+ * 
+ * @param threshold Dimensione in byte, maggiore di zero
+ * @return int Se la dimensione è valida restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int set_large_object_threshold (size_t threshold);
+
+/**
+ * @brief Indica se un oggetto è abbastanza grande da essere letto e scritto bypassando la page cache.
+ * 
+ * @param size Dimensione dell'oggetto
+ * @return int 1 se l'oggetto è grande, altrimenti 0.
+ */
+int is_large_object (size_t size);
+
+/**
+ * @brief Scrive size bytes all'inizio del file, preallocando lo spazio e bypassando la page cache.
+ * Se il file system non supporta O_DIRECT ripiega su una scrittura bufferizzata.
+ * 
+ * @param file_fd File descriptor del file, aperto in scrittura
+ * @param data Dati da scrivere
+ * @param size Dimensione dei dati
+ * @return int Se la scrittura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int direct_write_file (int file_fd, void* data, size_t size);
+
+/**
+ * @brief Legge size bytes dall'inizio del file bypassando la page cache.
+ * Se il file system non supporta O_DIRECT ripiega su una lettura bufferizzata.
+ * 
+ * @param file_fd File descriptor del file, aperto in lettura
+ * @param buffer Buffer allineato a DIRECT_IO_ALIGNMENT di almeno DIRECT_IO_BUFFER_SIZE(size) byte
+ * @param size Dimensione del file
+ * @return int Se la lettura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int direct_read_file (int file_fd, void* buffer, size_t size);
+
+#endif // _DIRECT_IO
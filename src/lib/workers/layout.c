@@ -0,0 +1,219 @@
+/**
+ * @file layout.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria che stabilisce dove si trova un oggetto all'interno della cartella del suo utente.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <assertmacros.h>
+#include <shared.h>
+
+#include <workers/layout.h>
+
+/**
+ * @brief Funzione hash FNV-1a a 32 bit sul nome dell'oggetto
+ * 
+ * @param name Nome dell'oggetto
+ * @return unsigned int Hash del nome
+ */
+unsigned int name_hash (char* name) {
+    unsigned int hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (unsigned char) *name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Crea, se non esistono, tutte le cartelle che precedono l'ultimo componente del percorso
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param path Percorso relativo dell'oggetto
+ * @return int Se le cartelle esistono o sono state create restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int create_parent_directories (int dir_fd, char* path) {
+    char buffer[MAX_OBJECT_PATH];
+    strcpy(buffer, path);
+    for (char* slash = strchr(buffer, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        int success = mkdirat(dir_fd, buffer, 0777);
+        ASSERT_RETURN((success != -1) || (errno == EEXIST), -1);
+        *slash = '/';
+    }
+    return 0;
+}
+
+/**
+ * @brief Scrive nel buffer il percorso dell'oggetto relativo alla cartella dell'utente.
+ * 
+ * @param name Nome dell'oggetto
+ * @param path Buffer di almeno MAX_OBJECT_PATH caratteri
+ * @return char* Il buffer passato. Se c'è un errore restituisce NULL e setta errno.
+ */
+char* object_path (char* name, char* path) {
+    // Il nome della cartella di fanout è riservato
+    ASSERT_ERRNO_RETURN((name != NULL) && (path != NULL) && !EQUALS(name, FANOUT_ROOT), EINVAL, NULL);
+    ASSERT_ERRNO_RETURN(strlen(name) < 256, ENAMETOOLONG, NULL);
+    // Con il layout piatto il percorso coincide con il nome
+    if (FANOUT_LEVELS == 0) return strcpy(path, name);
+    // Aggiunge una cartella per ogni livello, nominata con un byte dell'hash
+    unsigned int hash = name_hash(name);
+    char* ptr = path + sprintf(path, "%s", FANOUT_ROOT);
+    for (int i = 0; i < FANOUT_LEVELS; i++) {
+        ptr += sprintf(ptr, "/%02x", hash & 0xff);
+        hash = (hash >> 8) | (hash << 24);
+    }
+    sprintf(ptr, "/%s", name);
+    return path;
+}
+
+/**
+ * @brief Apre un oggetto nella cartella dell'utente. In creazione crea le cartelle di fanout che mancano,
+ * in lettura cerca l'oggetto anche nel layout piatto e, se non c'è più, di nuovo in quello corrente, così che
+ * un oggetto migrato durante l'apertura venga comunque trovato.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ * @param flags Flag di apertura, come per openat
+ * @param mode Permessi del file se viene creato
+ * @return int File descriptor dell'oggetto. Se c'è un errore restituisce -1 e setta errno.
+ */
+int open_object (int dir_fd, char* name, int flags, mode_t mode) {
+    char path[MAX_OBJECT_PATH];
+    ASSERT_RETURN(object_path(name, path) != NULL, -1);
+    // Prova prima il percorso nel layout corrente
+    int file_fd = openat(dir_fd, path, flags | O_CLOEXEC, mode);
+    if ((file_fd != -1) || (errno != ENOENT) || (FANOUT_LEVELS == 0)) return file_fd;
+    // In creazione mancano le cartelle di fanout
+    if (flags & O_CREAT) {
+        ASSERT_RETURN(create_parent_directories(dir_fd, path) != -1, -1);
+        return openat(dir_fd, path, flags | O_CLOEXEC, mode);
+    }
+    // In lettura l'oggetto potrebbe non essere ancora stato migrato
+    file_fd = openat(dir_fd, name, flags | O_CLOEXEC, mode);
+    // La migrazione collega l'oggetto nel nuovo percorso prima di rimuoverlo dal vecchio: se nel frattempo è sparito
+    // da quello piatto ora si trova nel layout corrente, e l'oggetto manca solo se manca anche lì
+    if ((file_fd == -1) && (errno == ENOENT)) file_fd = openat(dir_fd, path, flags | O_CLOEXEC, mode);
+    return file_fd;
+}
+
+/**
+ * @brief Sposta un file nel percorso di un oggetto della cartella dell'utente, sostituendo atomicamente la versione
+ * precedente e creando le cartelle di fanout che mancano. I due percorsi devono trovarsi sullo stesso file system.
+ * 
+ * @param from_fd File descriptor della cartella che contiene il file
+ * @param from_path Percorso del file relativo a from_fd
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se il file è stato spostato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int rename_object (int from_fd, char* from_path, int dir_fd, char* name) {
+    char path[MAX_OBJECT_PATH];
+    ASSERT_RETURN(object_path(name, path) != NULL, -1);
+    int success = renameat(from_fd, from_path, dir_fd, path);
+    // Se mancano le cartelle di fanout le crea e riprova
+    if ((success == -1) && (errno == ENOENT) && (FANOUT_LEVELS > 0)) {
+        ASSERT_RETURN(create_parent_directories(dir_fd, path) != -1, -1);
+        success = renameat(from_fd, from_path, dir_fd, path);
+    }
+    return success;
+}
+
+/**
+ * @brief Rimuove la copia nel layout piatto di un oggetto appena scritto nel layout a fanout, se esiste.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ */
+void discard_flat_object (int dir_fd, char* name) {
+    if (FANOUT_LEVELS == 0) return;
+    // La copia piatta di norma non esiste, quindi l'errore viene ignorato
+    int saved_errno = errno;
+    unlinkat(dir_fd, name, 0);
+    errno = saved_errno;
+}
+
+/**
+ * @brief Rimuove un oggetto dalla cartella dell'utente, in qualunque layout si trovi.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se l'oggetto è stato rimosso restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int unlink_object (int dir_fd, char* name) {
+    char path[MAX_OBJECT_PATH];
+    ASSERT_RETURN(object_path(name, path) != NULL, -1);
+    int success = unlinkat(dir_fd, path, 0);
+    if ((success != -1) || (errno != ENOENT) || (FANOUT_LEVELS == 0)) return success;
+    // Se l'oggetto non è nel layout a fanout potrebbe essere ancora in quello piatto
+    success = unlinkat(dir_fd, name, 0);
+    if (success != -1) {
+        // Il migratore potrebbe averlo collegato nel layout a fanout dopo il primo tentativo, e senza la copia piatta
+        // non può più farlo: rimuove anche quel collegamento, che altrimenti riporterebbe in vita l'oggetto
+        ASSERT_RETURN((unlinkat(dir_fd, path, 0) != -1) || (errno == ENOENT), -1);
+        return 0;
+    }
+    // Oppure esservi appena stato migrato
+    if (errno == ENOENT) success = unlinkat(dir_fd, path, 0);
+    return success;
+}
+
+/**
+ * @brief Sposta nel layout a fanout tutti gli oggetti della cartella che si trovano nel layout piatto.
+ * La migrazione può avvenire mentre il server è in funzione: ogni oggetto viene prima collegato nel nuovo percorso
+ * e poi rimosso dal vecchio, e se nel nuovo percorso esiste già una versione più recente quella piatta viene scartata.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @return int Numero di oggetti spostati. Se c'è un errore restituisce -1 e setta errno.
+ */
+int migrate_directory (int dir_fd) {
+    if (FANOUT_LEVELS == 0) return 0;
+    // Apre una nuova descrizione della cartella per scorrerne il contenuto
+    int list_fd = openat(dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT_RETURN(list_fd != -1, -1);
+    DIR* dir = fdopendir(list_fd);
+    ASSERT(dir != NULL, close(list_fd); return -1);
+    int moved = 0;
+    char path[MAX_OBJECT_PATH];
+    struct dirent* entry;
+    while ((errno = 0, entry = readdir(dir)) != NULL) {
+        char* name = entry->d_name;
+        // Salta le cartelle speciali e tutto ciò che non è un file regolare
+        struct stat sb;
+        if (EQUALS(name, ".") || EQUALS(name, "..") || EQUALS(name, FANOUT_ROOT)) continue;
+        if ((fstatat(dir_fd, name, &sb, AT_SYMLINK_NOFOLLOW) == -1) || !S_ISREG(sb.st_mode)) continue;
+        ASSERT(object_path(name, path) != NULL, closedir(dir); return -1);
+        // Collega il file nel nuovo percorso, creando le cartelle se mancano
+        int success = linkat(dir_fd, name, dir_fd, path, 0);
+        if ((success == -1) && (errno == ENOENT)) {
+            ASSERT(create_parent_directories(dir_fd, path) != -1, closedir(dir); return -1);
+            success = linkat(dir_fd, name, dir_fd, path, 0);
+        }
+        // Se il file è sparito nel frattempo è stato cancellato dal server
+        if ((success == -1) && (errno == ENOENT)) continue;
+        // Se il nuovo percorso esiste già la copia piatta è obsoleta
+        ASSERT((success != -1) || (errno == EEXIST), closedir(dir); return -1);
+        // Rimuove la copia piatta
+        ASSERT((unlinkat(dir_fd, name, 0) != -1) || (errno == ENOENT), closedir(dir); return -1);
+        if (success != -1) moved++;
+    }
+    // Controlla che la lettura della cartella non sia terminata per un errore
+    int saved_errno = errno;
+    closedir(dir);
+    ASSERT_ERRNO_RETURN(saved_errno == 0, saved_errno, -1);
+    return moved;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file layout.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria che stabilisce dove si trova un oggetto all'interno della cartella del suo utente.
+ * Gli oggetti sono distribuiti in FANOUT_LEVELS livelli di cartelle, ciascuna con nome dato da due cifre esadecimali
+ * dell'hash del nome dell'oggetto, contenute nella cartella riservata FANOUT_ROOT: per esempio ".fanout/3f/a0/<nome>".
+ * Gli oggetti memorizzati con il layout piatto "<nome>" continuano ad essere trovati finché non vengono migrati.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_LAYOUT)
+#define _LAYOUT
+
+#include <sys/types.h>
+
+// Numero di livelli di cartelle sotto la cartella dell'utente, ridefinibile in compilazione con -DFANOUT_LEVELS=<n> (0 = layout piatto)
+#if !defined(FANOUT_LEVELS)
+#define FANOUT_LEVELS 2
+#endif
+
+// Nome della cartella riservata che contiene le cartelle di fanout
+#define FANOUT_ROOT ".fanout"
+
+// Lunghezza massima del percorso relativo di un oggetto: FANOUT_ROOT + "/xx" per livello + "/" + nome POSIX (255) + \0
+#define MAX_OBJECT_PATH (sizeof(FANOUT_ROOT) + 3 * FANOUT_LEVELS + 257)
+
+/**
+ * @brief Funzione hash FNV-1a a 32 bit sul nome dell'oggetto
+ * 
+ * @param name Nome dell'oggetto
+ * @return unsigned int Hash del nome
+ */
+unsigned int name_hash (char* name);
+
+/**
+ * @brief Scrive nel buffer il percorso dell'oggetto relativo alla cartella dell'utente.
+ * 
+ * @param name Nome dell'oggetto
+ * @param path Buffer di almeno MAX_OBJECT_PATH caratteri
+ * @return char* Il buffer passato. Se c'è un errore restituisce NULL e setta errno.
+ */
+char* object_path (char* name, char* path);
+
+/**
+ * @brief Apre un oggetto nella cartella dell'utente. In creazione crea le cartelle di fanout che mancano,
+ * in lettura cerca l'oggetto anche nel layout piatto e, se non c'è più, di nuovo in quello corrente, così che
+ * un oggetto migrato durante l'apertura venga comunque trovato.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ * @param flags Flag di apertura, come per openat
+ * @param mode Permessi del file se viene creato
+ * @return int File descriptor dell'oggetto. Se c'è un errore restituisce -1 e setta errno.
+ */
+int open_object (int dir_fd, char* name, int flags, mode_t mode);
+
+/**
+ * @brief Sposta un file nel percorso di un oggetto della cartella dell'utente, sostituendo atomicamente la versione
+ * precedente e creando le cartelle di fanout che mancano. I due percorsi devono trovarsi sullo stesso file system.
+ * 
+ * @param from_fd File descriptor della cartella che contiene il file
+ * @param from_path Percorso del file relativo a from_fd
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se il file è stato spostato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int rename_object (int from_fd, char* from_path, int dir_fd, char* name);
+
+/**
+ * @brief Rimuove la copia nel layout piatto di un oggetto appena scritto nel layout a fanout, se esiste.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ */
+void discard_flat_object (int dir_fd, char* name);
+
+/**
+ * @brief Rimuove un oggetto dalla cartella dell'utente, in qualunque layout si trovi.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se l'oggetto è stato rimosso restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int unlink_object (int dir_fd, char* name);
+
+/**
+ * @brief Sposta nel layout a fanout tutti gli oggetti della cartella che si trovano nel layout piatto.
+ * La migrazione può avvenire mentre il server è in funzione: ogni oggetto viene prima collegato nel nuovo percorso
+ * e poi rimosso dal vecchio, e se nel nuovo percorso esiste già una versione più recente quella piatta viene scartata.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @return int Numero di oggetti spostati. Se c'è un errore restituisce -1 e setta errno.
+ */
+int migrate_directory (int dir_fd);
+
+#endif // _LAYOUT
@@ -0,0 +1,501 @@
+/**
+ * @file multipart.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria che gestisce i caricamenti in più parti. I caricamenti in corso sono in una
+ * tabella hash per identificativo, e gli utenti con sessioni aperte in una tabella per nome che conta sessioni e
+ * caricamenti di ciascuno; entrambe sono protette da una mutex, che non viene tenuta durante la scrittura delle parti.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <assertmacros.h>
+#include <mutexmacros.h>
+#include <shared.h>
+
+#include <hashtable/typed_hashtable.h>
+#include <workers/layout.h>
+#include <workers/multipart.h>
+
+// Lunghezza del nome di un file temporaneo: l'identificativo in TAG_LENGTH cifre esadecimali più il terminatore
+#define UPLOAD_PATH_LENGTH (sizeof(UPLOAD_DIRECTORY) + TAG_LENGTH + 1)
+
+/**
+ * @brief Funzione hash sull'identificativo di un caricamento
+ */
+static inline unsigned int upload_hash (unsigned long id) {
+    return int_hash((int) (id ^ ((id >> 16) >> 16)));
+}
+
+/**
+ * @brief Confronta due identificativi
+ */
+static inline int upload_equals (unsigned long a, unsigned long b) {
+    return a == b;
+}
+
+TYPED_HASHTABLE(upload_map, unsigned long, upload_t*, upload_hash, upload_equals)
+
+/**
+ * @brief Utente con delle sessioni aperte
+ */
+struct upload_owner {
+    char* username;
+    int sessions;
+    // Caricamenti dell'utente presenti nella tabella
+    int uploads;
+};
+
+TYPED_HASHTABLE(owner_map, const char*, struct upload_owner*, string_hash, string_equals)
+
+// Caricamenti in corso
+static upload_map_t* uploads = NULL;
+// Utenti con sessioni aperte
+static owner_map_t* owners = NULL;
+// File descriptor della cartella dati
+static int uploads_data_fd = -1;
+// Prossimo identificativo da assegnare
+static unsigned long next_id = 0;
+// Mutex che protegge la tabella e i contatori dei caricamenti
+static pthread_mutex_t uploads_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Scrive il percorso del file temporaneo di un caricamento, relativo alla cartella dati
+ */
+static char* upload_path (unsigned long id, char* path) {
+    sprintf(path, "%s/%0*lx", UPLOAD_DIRECTORY, TAG_LENGTH, id);
+    return path;
+}
+
+/**
+ * @brief Scrive tutti i byte di un buffer alla posizione indicata di un file
+ * 
+ * @return int Se la scrittura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int pwrite_all (int file_fd, char* data, size_t length, size_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(file_fd, data, length, (off_t) offset);
+        if (written < 0) {
+            // Se la scrittura è stata interrotta deve essere ritentata
+            ASSERT_RETURN(errno == EINTR, -1);
+            continue;
+        }
+        data += written;
+        offset += written;
+        length -= written;
+    }
+    return 0;
+}
+
+/**
+ * @brief Restituisce la posizione del primo intervallo che finisce dopo offset, cioè di quello che lo contiene o,
+ * se nessuno lo contiene, di quello che lo segue. Va chiamata con la mutex acquisita.
+ */
+static int find_range (upload_t* upload, size_t offset) {
+    int low = 0, high = upload->range_count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (upload->ranges[middle].end > offset) high = middle;
+        else low = middle + 1;
+    }
+    return low;
+}
+
+/**
+ * @brief Riserva l'intervallo di una parte che sta per essere scritta, unendolo a quelli contigui. Va chiamata
+ * con la mutex acquisita, prima di contare lo scrittore. Lo spazio allocato basta sempre per un intervallo in più
+ * per ogni parte in scrittura, così che release_range non debba mai allocare.
+ * 
+ * @return int Se l'intervallo è stato riservato restituisce 0. Se c'è un errore restituisce -1 e setta errno
+ * (EEXIST se si sovrappone a un intervallo già riservato).
+ */
+static int reserve_range (upload_t* upload, size_t start, size_t end) {
+    int i = find_range(upload, start);
+    ASSERT_ERRNO_RETURN((i == upload->range_count) || (upload->ranges[i].start >= end), EEXIST, -1);
+    // Spazio per il nuovo intervallo e per la divisione di ciascuna parte in scrittura, compresa questa
+    int needed = upload->range_count + upload->writers + 2;
+    if (needed > upload->range_capacity) {
+        int capacity = (upload->range_capacity > 0) ? upload->range_capacity * 2 : 8;
+        while (capacity < needed) capacity *= 2;
+        upload_range_t* ranges = (upload_range_t*) realloc(upload->ranges, capacity * sizeof(upload_range_t));
+        ASSERT_ERRNO_RETURN(ranges != NULL, ENOMEM, -1);
+        upload->ranges = ranges;
+        upload->range_capacity = capacity;
+    }
+    int join_left = (i > 0) && (upload->ranges[i - 1].end == start);
+    int join_right = (i < upload->range_count) && (upload->ranges[i].start == end);
+    if (join_left && join_right) {
+        upload->ranges[i - 1].end = upload->ranges[i].end;
+        memmove(&upload->ranges[i], &upload->ranges[i + 1], (upload->range_count - i - 1) * sizeof(upload_range_t));
+        upload->range_count--;
+    }
+    else if (join_left) upload->ranges[i - 1].end = end;
+    else if (join_right) upload->ranges[i].start = start;
+    else {
+        memmove(&upload->ranges[i + 1], &upload->ranges[i], (upload->range_count - i) * sizeof(upload_range_t));
+        upload->ranges[i].start = start;
+        upload->ranges[i].end = end;
+        upload->range_count++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Libera l'intervallo di una parte la cui scrittura è fallita, così che possa essere inviata di nuovo.
+ * Va chiamata con la mutex acquisita, prima di togliere lo scrittore.
+ */
+static void release_range (upload_t* upload, size_t start, size_t end) {
+    int i = find_range(upload, start);
+    upload_range_t* range = &upload->ranges[i];
+    if ((range->start == start) && (range->end == end)) {
+        memmove(range, range + 1, (upload->range_count - i - 1) * sizeof(upload_range_t));
+        upload->range_count--;
+    }
+    else if (range->start == start) range->start = end;
+    else if (range->end == end) range->end = start;
+    else {
+        // Divide l'intervallo in due, nello spazio riservato da reserve_range
+        memmove(range + 1, range, (upload->range_count - i) * sizeof(upload_range_t));
+        range->end = start;
+        (range + 1)->start = end;
+        upload->range_count++;
+    }
+}
+
+/**
+ * @brief Rimuove i file temporanei rimasti nella cartella dei caricamenti
+ * 
+ * @return int Se la pulizia è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int clear_upload_directory () {
+    int list_fd = openat(uploads_data_fd, UPLOAD_DIRECTORY, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT_RETURN(list_fd != -1, -1);
+    DIR* dir = fdopendir(list_fd);
+    ASSERT(dir != NULL, close(list_fd); return -1);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (EQUALS(entry->d_name, ".") || EQUALS(entry->d_name, "..")) continue;
+        unlinkat(list_fd, entry->d_name, 0);
+    }
+    closedir(dir);
+    return 0;
+}
+
+/**
+ * @brief Crea la cartella dei caricamenti, rimuovendo i file rimasti da un'esecuzione precedente
+ * 
+ * @param data_fd File descriptor della cartella dati
+ * @return int Se l'inizializzazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int init_uploads (int data_fd) {
+    uploads_data_fd = data_fd;
+    int success = mkdirat(data_fd, UPLOAD_DIRECTORY, 0777);
+    ASSERT_RETURN((success != -1) || (errno == EEXIST), -1);
+    // I caricamenti di un'esecuzione precedente non possono più essere completati
+    ASSERT_RETURN(clear_upload_directory() != -1, -1);
+    uploads = upload_map_create();
+    ASSERT_RETURN(uploads != NULL, -1);
+    owners = owner_map_create();
+    ASSERT(owners != NULL, upload_map_destroy(uploads); uploads = NULL; return -1);
+    // Gli identificativi partono dall'istante di avvio, così che non coincidano con quelli di un'esecuzione precedente
+    next_id = ((unsigned long) time(NULL)) << 20;
+    return 0;
+}
+
+/**
+ * @brief Scarta i caricamenti non completati e libera le strutture dati
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int stop_uploads () {
+    if (uploads == NULL) return 0;
+    for (unsigned int i = 0; i < uploads->capacity; i++)
+        if (uploads->slots[i].hash != 0) release_upload(uploads->slots[i].value);
+    upload_map_destroy(uploads);
+    uploads = NULL;
+    for (unsigned int i = 0; i < owners->capacity; i++)
+        if (owners->slots[i].hash != 0) {
+            free(owners->slots[i].value->username);
+            free(owners->slots[i].value);
+        }
+    owner_map_destroy(owners);
+    owners = NULL;
+    return 0;
+}
+
+/**
+ * @brief Cerca un utente con sessioni aperte. Va chiamata con la mutex acquisita.
+ * 
+ * @return struct upload_owner* Utente trovato, NULL se non ha sessioni aperte
+ */
+static struct upload_owner* find_owner (char* username) {
+    struct upload_owner** found = owner_map_find(owners, username);
+    return (found != NULL) ? *found : NULL;
+}
+
+/**
+ * @brief Conta una sessione aperta dall'utente, da chiamare alla registrazione
+ * 
+ * @param username Utente della sessione
+ * @return int Se la sessione è stata contata restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int open_upload_session (char* username) {
+    ASSERT_ERRNO_RETURN(username != NULL, EINVAL, -1);
+    LOCK_ACQUIRE(&uploads_mutex, return -1);
+    struct upload_owner* owner = find_owner(username);
+    int error = 0;
+    if (owner == NULL) {
+        // Alla prima sessione l'utente viene aggiunto alla tabella, con una copia del nome che ne è la chiave
+        owner = (struct upload_owner*) calloc(1, sizeof(struct upload_owner));
+        if (owner != NULL) owner->username = strdup(username);
+        if ((owner == NULL) || (owner->username == NULL)) error = ENOMEM;
+        else if (owner_map_insert(owners, owner->username, owner) == -1) error = errno;
+        if ((error != 0) && (owner != NULL)) {
+            free(owner->username);
+            free(owner);
+        }
+    }
+    if (error == 0) owner->sessions++;
+    LOCK_RELEASE(&uploads_mutex, return -1);
+    ASSERT_ERRNO_RETURN(error == 0, error, -1);
+    return 0;
+}
+
+/**
+ * @brief Conta la chiusura di una sessione dell'utente. Se era l'ultima scarta i suoi caricamenti non completati,
+ * che nessuna connessione può più proseguire.
+ * 
+ * @param username Utente della sessione
+ */
+void close_upload_session (char* username) {
+    if (username == NULL) return;
+    LOCK_ACQUIRE(&uploads_mutex, return);
+    struct upload_owner* owner = find_owner(username);
+    if ((owner == NULL) || (--owner->sessions > 0)) {
+        LOCK_RELEASE(&uploads_mutex, );
+        return;
+    }
+    // Senza sessioni nessuna parte può essere in scrittura: stacca i caricamenti dell'utente, liberati fuori dalla mutex
+    upload_t** discarded = (upload_t**) malloc((owner->uploads + 1) * sizeof(upload_t*));
+    int count = 0;
+    if (discarded != NULL) {
+        for (unsigned int i = 0; i < uploads->capacity; i++) {
+            upload_t* upload = uploads->slots[i].value;
+            if ((uploads->slots[i].hash != 0) && EQUALS(upload->username, username)) discarded[count++] = upload;
+        }
+        for (int i = 0; i < count; i++)
+            upload_map_remove(uploads, discarded[i]->id, NULL);
+        owner_map_remove(owners, owner->username, NULL);
+        free(owner->username);
+        free(owner);
+    }
+    // Se la memoria non basta l'utente resta nella tabella, e i suoi caricamenti vengono scartati alla chiusura
+    else owner->sessions = 1;
+    LOCK_RELEASE(&uploads_mutex, );
+    for (int i = 0; i < count; i++)
+        release_upload(discarded[i]);
+    free(discarded);
+}
+
+/**
+ * @brief Avvia un caricamento creandone il file temporaneo della dimensione finale
+ * 
+ * @param username Utente che carica l'oggetto
+ * @param name Nome dell'oggetto
+ * @param size Dimensione finale dell'oggetto
+ * @param id_ptr Puntatore in cui scrivere l'identificativo del caricamento
+ * @return int Se il caricamento è stato avviato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int create_upload (char* username, char* name, size_t size, unsigned long* id_ptr) {
+    ASSERT_ERRNO_RETURN((username != NULL) && (name != NULL) && (size > 0) && (id_ptr != NULL), EINVAL, -1);
+    ASSERT_ERRNO_RETURN(size <= UPLOAD_MAX_SIZE, EFBIG, -1);
+    upload_t* upload = (upload_t*) calloc(1, sizeof(upload_t));
+    ASSERT_ERRNO_RETURN(upload != NULL, ENOMEM, -1);
+    upload->username = strdup(username);
+    upload->name = strdup(name);
+    upload->size = size;
+    upload->fd = -1;
+    ASSERT((upload->username != NULL) && (upload->name != NULL), errno = ENOMEM; release_upload(upload); return -1);
+    LOCK_ACQUIRE(&uploads_mutex, release_upload(upload); return -1);
+    upload->id = next_id++;
+    LOCK_RELEASE(&uploads_mutex, release_upload(upload); return -1);
+    // Crea il file temporaneo già della dimensione finale, così che le parti possano essere scritte in qualunque ordine
+    char path[UPLOAD_PATH_LENGTH];
+    upload->fd = openat(uploads_data_fd, upload_path(upload->id, path), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0777);
+    ASSERT(upload->fd != -1, release_upload(upload); return -1);
+    ASSERT(ftruncate(upload->fd, (off_t) size) != -1, release_upload(upload); return -1);
+    // Il caricamento viene contato solo se l'utente ha ancora una sessione e non ha raggiunto il limite
+    LOCK_ACQUIRE(&uploads_mutex, release_upload(upload); return -1);
+    struct upload_owner* owner = find_owner(username);
+    int error = 0;
+    if (owner == NULL) error = ENOTCONN;
+    else if (owner->uploads >= UPLOAD_MAX_PER_USER) error = EMFILE;
+    else if (upload_map_insert(uploads, upload->id, upload) == -1) error = errno;
+    else owner->uploads++;
+    LOCK_RELEASE(&uploads_mutex, );
+    ASSERT(error == 0, release_upload(upload); errno = error; return -1);
+    *id_ptr = upload->id;
+    return 0;
+}
+
+/**
+ * @brief Cerca un caricamento dell'utente. Va chiamata con la mutex acquisita.
+ * 
+ * @return upload_t* Caricamento trovato. Se non esiste, o appartiene a un altro utente, restituisce NULL e setta errno a ENOENT.
+ */
+static upload_t* find_upload (char* username, unsigned long id) {
+    upload_t** found = upload_map_find(uploads, id);
+    ASSERT_ERRNO_RETURN((found != NULL) && EQUALS((*found)->username, username), ENOENT, NULL);
+    return *found;
+}
+
+/**
+ * @brief Controlla che una parte possa essere scritta in un caricamento, prima di riceverne i dati. Il controllo
+ * viene ripetuto da write_upload_part, dato che nel frattempo il caricamento può essere completato o scartato.
+ * 
+ * @param username Utente che carica l'oggetto
+ * @param id Identificativo del caricamento
+ * @param offset Posizione della parte nell'oggetto
+ * @param length Lunghezza della parte
+ * @return int Se la parte può essere scritta restituisce 0. Se c'è un errore restituisce -1 e setta errno
+ * (ENOENT se il caricamento non esiste, EINVAL se la parte esce dall'oggetto, EEXIST se si sovrappone a una parte
+ * già ricevuta o in scrittura).
+ */
+int check_upload_part (char* username, unsigned long id, size_t offset, size_t length) {
+    ASSERT_ERRNO_RETURN((username != NULL) && (length > 0), EINVAL, -1);
+    LOCK_ACQUIRE(&uploads_mutex, return -1);
+    upload_t* upload = find_upload(username, id);
+    int error = 0;
+    if (upload == NULL) error = ENOENT;
+    else if ((length > upload->size) || (offset > upload->size - length)) error = EINVAL;
+    else {
+        int i = find_range(upload, offset);
+        if ((i < upload->range_count) && (upload->ranges[i].start < offset + length)) error = EEXIST;
+    }
+    LOCK_RELEASE(&uploads_mutex, return -1);
+    ASSERT_ERRNO_RETURN(error == 0, error, -1);
+    return 0;
+}
+
+/**
+ * @brief Scrive una parte di un caricamento alla sua posizione. Parti diverse possono essere scritte in parallelo.
+ * 
+ * @param username Utente che carica l'oggetto
+ * @param id Identificativo del caricamento
+ * @param offset Posizione della parte nell'oggetto
+ * @param data Dati della parte
+ * @param length Lunghezza della parte
+ * @return int Se la parte è stata scritta restituisce 0. Se c'è un errore restituisce -1 e setta errno
+ * (ENOENT se il caricamento non esiste, EINVAL se la parte esce dall'oggetto).
+ */
+int write_upload_part (char* username, unsigned long id, size_t offset, void* data, size_t length) {
+    ASSERT_ERRNO_RETURN((username != NULL) && (data != NULL) && (length > 0), EINVAL, -1);
+    // Segna la parte in scrittura, così che il caricamento non venga completato o liberato nel frattempo
+    LOCK_ACQUIRE(&uploads_mutex, return -1);
+    upload_t* upload = find_upload(username, id);
+    ASSERT(upload != NULL, LOCK_RELEASE(&uploads_mutex, ); errno = ENOENT; return -1);
+    ASSERT((length <= upload->size) && (offset <= upload->size - length), LOCK_RELEASE(&uploads_mutex, ); errno = EINVAL; return -1);
+    // Una parte non può sovrapporsi a un'altra, altrimenti un byte ricevuto due volte nasconderebbe un byte mancante
+    int error = (reserve_range(upload, offset, offset + length) == -1) ? errno : 0;
+    ASSERT(error == 0, LOCK_RELEASE(&uploads_mutex, ); errno = error; return -1);
+    upload->writers++;
+    LOCK_RELEASE(&uploads_mutex, return -1);
+    // Scrive la parte senza la mutex, in parallelo alle altre
+    int success = pwrite_all(upload->fd, data, length, offset);
+    error = errno;
+    LOCK_ACQUIRE(&uploads_mutex, return -1);
+    if (success == -1) release_range(upload, offset, offset + length);
+    upload->writers--;
+    LOCK_RELEASE(&uploads_mutex, return -1);
+    errno = error;
+    return success;
+}
+
+/**
+ * @brief Toglie un caricamento da quelli in corso, così che nessuna parte possa più essere scritta
+ * 
+ * @param username Utente che carica l'oggetto
+ * @param id Identificativo del caricamento
+ * @param complete 1 se il caricamento deve aver ricevuto tutti i byte dell'oggetto, 0 per scartarlo
+ * @return upload_t* Caricamento da liberare con release_upload. Se c'è un errore restituisce NULL e setta errno
+ * (ENOENT se il caricamento non esiste, EBUSY se delle parti sono in scrittura, ENODATA se mancano dei byte).
+ */
+upload_t* detach_upload (char* username, unsigned long id, int complete) {
+    ASSERT_ERRNO_RETURN(username != NULL, EINVAL, NULL);
+    LOCK_ACQUIRE(&uploads_mutex, return NULL);
+    upload_t* upload = find_upload(username, id);
+    int error = 0;
+    if (upload == NULL) error = ENOENT;
+    else if (upload->writers > 0) error = EBUSY;
+    // Senza parti in scrittura gli intervalli sono tutti scritti, e coprono l'oggetto solo se ne resta uno da 0 a size
+    else if (complete && ((upload->range_count != 1) || (upload->ranges[0].start != 0) || (upload->ranges[0].end != upload->size)))
+        error = ENODATA;
+    else {
+        upload_map_remove(uploads, id, NULL);
+        struct upload_owner* owner = find_owner(username);
+        if (owner != NULL) owner->uploads--;
+    }
+    LOCK_RELEASE(&uploads_mutex, return NULL);
+    ASSERT_ERRNO_RETURN(error == 0, error, NULL);
+    return upload;
+}
+
+/**
+ * @brief Sposta il file temporaneo di un caricamento staccato nel percorso dell'oggetto, sostituendone atomicamente
+ * la versione precedente. Va chiamata con il lock dell'oggetto in scrittura.
+ * 
+ * @param upload Caricamento ottenuto con detach_upload
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @return int Se il file è stato spostato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int commit_upload (upload_t* upload, int dir_fd) {
+    ASSERT_ERRNO_RETURN(upload != NULL, EINVAL, -1);
+    char path[UPLOAD_PATH_LENGTH];
+    upload_path(upload->id, path);
+    // Chiude il file prima di spostarlo, così che un errore di scrittura ritardato venga riportato
+    int success = close(upload->fd);
+    upload->fd = -1;
+    if (success != -1) success = rename_object(uploads_data_fd, path, dir_fd, upload->name);
+    // Se lo spostamento non è avvenuto il file temporaneo non serve più
+    if (success == -1) {
+        int saved_errno = errno;
+        unlinkat(uploads_data_fd, path, 0);
+        errno = saved_errno;
+    }
+    return success;
+}
+
+/**
+ * @brief Libera un caricamento staccato, rimuovendo il file temporaneo se non è stato spostato. Non modifica errno.
+ * 
+ * @param upload Caricamento ottenuto con detach_upload
+ */
+void release_upload (upload_t* upload) {
+    if (upload == NULL) return;
+    int saved_errno = errno;
+    // Il file temporaneo è aperto finché non viene spostato o rimosso da commit_upload
+    if (upload->fd != -1) {
+        char path[UPLOAD_PATH_LENGTH];
+        close(upload->fd);
+        unlinkat(uploads_data_fd, upload_path(upload->id, path), 0);
+    }
+    free(upload->username);
+    free(upload->name);
+    free(upload->ranges);
+    free(upload);
+    errno = saved_errno;
+}
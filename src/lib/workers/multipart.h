@@ -0,0 +1,156 @@
+/**
+ * @file multipart.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria che gestisce i caricamenti in più parti. Un caricamento ha un file temporaneo nella cartella
+ * UPLOAD_DIRECTORY della cartella dati, creato già della dimensione finale: ogni parte viene scritta direttamente alla
+ * sua posizione, anche da connessioni diverse contemporaneamente, e al completamento il file viene spostato nel percorso
+ * dell'oggetto senza copiarne il contenuto. I caricamenti non completati di un utente vengono scartati quando si chiude
+ * la sua ultima sessione, e tutti quelli rimasti alla chiusura del server.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_MULTIPART)
+#define _MULTIPART
+
+#include <stddef.h>
+
+// Cartella riservata della cartella dati che contiene i file temporanei dei caricamenti
+#define UPLOAD_DIRECTORY ".uploads"
+
+// Dimensione massima di un oggetto caricato in più parti
+#define UPLOAD_MAX_SIZE ((size_t) 64 << 30)
+
+// Numero massimo di caricamenti aperti contemporaneamente da un utente
+#define UPLOAD_MAX_PER_USER 16
+
+/**
+ * @brief Intervallo [start, end) di byte di un caricamento
+ */
+typedef struct upload_range {
+    size_t start;
+    size_t end;
+} upload_range_t;
+
+/**
+ * @brief Caricamento in corso
+ */
+typedef struct upload {
+    unsigned long id;
+    char* username;
+    // Nome dell'oggetto da creare
+    char* name;
+    // Dimensione finale dell'oggetto
+    size_t size;
+    // File temporaneo, aperto in scrittura
+    int fd;
+    // Intervalli scritti o in scrittura, ordinati, disgiunti e con quelli contigui uniti
+    upload_range_t* ranges;
+    int range_count;
+    int range_capacity;
+    // Parti in corso di scrittura, durante le quali il caricamento non può essere completato
+    int writers;
+} upload_t;
+
+/**
+ * @brief Crea la cartella dei caricamenti, rimuovendo i file rimasti da un'esecuzione precedente
+ * 
+ * @param data_fd File descriptor della cartella dati
+ * @return int Se l'inizializzazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int init_uploads (int data_fd);
+
+/**
+ * @brief Scarta i caricamenti non completati e libera le strutture dati
+ * 
+ * @return int Se l'operazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int stop_uploads ();
+
+/**
+ * @brief Conta una sessione aperta dall'utente, da chiamare alla registrazione
+ * 
+ * @param username Utente della sessione
+ * @return int Se la sessione è stata contata restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int open_upload_session (char* username);
+
+/**
+ * @brief Conta la chiusura di una sessione dell'utente. Se era l'ultima scarta i suoi caricamenti non completati,
+ * che nessuna connessione può più proseguire.
+ * 
+ * @param username Utente della sessione
+ */
+void close_upload_session (char* username);
+
+/**
+ * @brief Avvia un caricamento creandone il file temporaneo della dimensione finale
+ * 
+ * @param username Utente che carica l'oggetto
+ * @param name Nome dell'oggetto
+ * @param size Dimensione finale dell'oggetto
+ * @param id_ptr Puntatore in cui scrivere l'identificativo del caricamento
+ * @return int Se il caricamento è stato avviato restituisce 0. Se c'è un errore restituisce -1 e setta errno
+ * (ENOTCONN se l'utente non ha sessioni aperte, EFBIG se la dimensione supera UPLOAD_MAX_SIZE, EMFILE se l'utente
+ * ha già UPLOAD_MAX_PER_USER caricamenti aperti).
+ */
+int create_upload (char* username, char* name, size_t size, unsigned long* id_ptr);
+
+/**
+ * @brief Controlla che una parte possa essere scritta in un caricamento, prima di riceverne i dati
+ * 
+ * @param username Utente che carica l'oggetto
+ * @param id Identificativo del caricamento
+ * @param offset Posizione della parte nell'oggetto
+ * @param length Lunghezza della parte
+ * @return int Se la parte può essere scritta restituisce 0. Se c'è un errore restituisce -1 e setta errno
+ * (ENOENT se il caricamento non esiste, EINVAL se la parte esce dall'oggetto, EEXIST se si sovrappone a una parte
+ * già ricevuta o in scrittura).
+ */
+int check_upload_part (char* username, unsigned long id, size_t offset, size_t length);
+
+/**
+ * @brief Scrive una parte di un caricamento alla sua posizione. Parti diverse possono essere scritte in parallelo.
+ * 
+ * @param username Utente che carica l'oggetto
+ * @param id Identificativo del caricamento
+ * @param offset Posizione della parte nell'oggetto
+ * @param data Dati della parte
+ * @param length Lunghezza della parte
+ * @return int Se la parte è stata scritta restituisce 0. Se c'è un errore restituisce -1 e setta errno
+ * (ENOENT se il caricamento non esiste, EINVAL se la parte esce dall'oggetto, EEXIST se si sovrappone a una parte
+ * già ricevuta o in scrittura).
+ */
+int write_upload_part (char* username, unsigned long id, size_t offset, void* data, size_t length);
+
+/**
+ * @brief Toglie un caricamento da quelli in corso, così che nessuna parte possa più essere scritta
+ * 
+ * @param username Utente che carica l'oggetto
+ * @param id Identificativo del caricamento
+ * @param complete 1 se il caricamento deve aver ricevuto tutti i byte dell'oggetto, 0 per scartarlo
+ * @return upload_t* Caricamento da liberare con release_upload. Se c'è un errore restituisce NULL e setta errno
+ * (ENOENT se il caricamento non esiste, EBUSY se delle parti sono in scrittura, ENODATA se le parti ricevute
+ * non coprono tutti i byte dell'oggetto).
+ */
+upload_t* detach_upload (char* username, unsigned long id, int complete);
+
+/**
+ * @brief Sposta il file temporaneo di un caricamento staccato nel percorso dell'oggetto, sostituendone atomicamente
+ * la versione precedente. Va chiamata con il lock dell'oggetto in scrittura.
+ * 
+ * @param upload Caricamento ottenuto con detach_upload
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @return int Se il file è stato spostato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int commit_upload (upload_t* upload, int dir_fd);
+
+/**
+ * @brief Libera un caricamento staccato, rimuovendo il file temporaneo se non è stato spostato. Non modifica errno.
+ * 
+ * @param upload Caricamento ottenuto con detach_upload
+ */
+void release_upload (upload_t* upload);
+
+#endif // _MULTIPART
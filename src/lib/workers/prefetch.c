@@ -0,0 +1,125 @@
+/**
+ * @file prefetch.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Implementazione della libreria che riconosce gli accessi sequenziali di una sessione e chiede al kernel
+ * di portare in anticipo nella page cache gli oggetti che verranno letti dopo.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <assertmacros.h>
+#include <shared.h>
+
+#include <workers/direct_io.h>
+#include <workers/layout.h>
+#include <workers/prefetch.h>
+
+// Oggetti per cui è stata chiesta la lettura anticipata, dall'avvio del server
+static unsigned long prefetched = 0;
+
+/**
+ * @brief Calcola il nome che segue quello passato in una lettura sequenziale.
+ * 
+ * @param name Nome di partenza
+ * @param next Buffer di almeno 256 caratteri in cui scrivere il nome successivo
+ * @return int Se il nome successivo esiste restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int next_sequential_name (char* name, char* next) {
+    ASSERT_ERRNO_RETURN((name != NULL) && (next != NULL), EINVAL, -1);
+    size_t length = strlen(name);
+    ASSERT_ERRNO_RETURN((length > 0) && (length < 255), EINVAL, -1);
+    strcpy(next, name);
+    // Se il nome finisce con un numero lo incrementa, propagando il riporto ed allungando il nome se serve ("9" -> "10")
+    size_t digits = length;
+    while ((digits > 0) && isdigit((unsigned char) name[digits - 1])) digits--;
+    if (digits < length) {
+        size_t i = length;
+        while ((i > digits) && (next[i - 1] == '9'))
+            next[--i] = '0';
+        if (i > digits) next[i - 1]++;
+        else {
+            memmove(next + digits + 1, next + digits, length - digits + 1);
+            next[digits] = '1';
+        }
+        return 0;
+    }
+    // Altrimenti incrementa l'ultimo carattere, purché resti un carattere stampabile diverso dal separatore
+    unsigned char last = (unsigned char) name[length - 1];
+    ASSERT_ERRNO_RETURN((last >= 0x20) && (last < 0x7e) && (last + 1 != '/'), ERANGE, -1);
+    next[length - 1] = (char) (last + 1);
+    return 0;
+}
+
+/**
+ * @brief Chiede al kernel di leggere in anticipo un oggetto, se esiste. Gli oggetti grandi vengono letti
+ * aggirando la page cache, quindi sono ignorati.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se la richiesta è stata inoltrata restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int prefetch_object (int dir_fd, char* name) {
+    int fd = open_object(dir_fd, name, O_RDONLY, 0);
+    ASSERT_RETURN(fd != -1, -1);
+    struct stat sb;
+    int success = fstat(fd, &sb);
+    // La lettura viene avviata dal kernel in modo asincrono, quindi il file può essere chiuso subito
+    if ((success != -1) && (sb.st_size > 0) && !is_large_object(sb.st_size)) {
+        success = ((errno = posix_fadvise(fd, 0, sb.st_size, POSIX_FADV_WILLNEED)) == 0) ? 0 : -1;
+        if (success == 0) __atomic_add_fetch(&prefetched, 1, __ATOMIC_RELAXED);
+    }
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return success;
+}
+
+/**
+ * @brief Registra la lettura di un oggetto. Se la lettura prosegue una sequenza lunga almeno PREFETCH_TRIGGER
+ * chiede di leggere in anticipo i PREFETCH_DEPTH oggetti successivi, inoltrando solo quelli non ancora richiesti.
+ * 
+ * @param pattern Stato del riconoscitore della sessione
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto appena letto
+ */
+void record_access (access_pattern_t* pattern, int dir_fd, char* name) {
+    if ((pattern == NULL) || (name == NULL)) return;
+    // Verifica se il nome è quello previsto dalla lettura precedente
+    char expected[256];
+    int follows = (pattern->last_name[0] != '\0') && (next_sequential_name(pattern->last_name, expected) == 0) && EQUALS(expected, name);
+    pattern->sequential = follows ? pattern->sequential + 1 : 1;
+    strncpy(pattern->last_name, name, sizeof(pattern->last_name) - 1);
+    pattern->last_name[sizeof(pattern->last_name) - 1] = '\0';
+    if (pattern->sequential < PREFETCH_TRIGGER) return;
+    // Appena la sequenza viene riconosciuta riempie la finestra, poi aggiunge solo l'oggetto che vi entra
+    int first = (pattern->sequential == PREFETCH_TRIGGER) ? 1 : PREFETCH_DEPTH;
+    char current[256];
+    char next[256];
+    strcpy(current, pattern->last_name);
+    for (int i = 1; i <= PREFETCH_DEPTH; i++, strcpy(current, next)) {
+        if (next_sequential_name(current, next) == -1) return;
+        // Gli oggetti che non esistono vengono ignorati
+        if (i >= first) prefetch_object(dir_fd, next);
+    }
+}
+
+/**
+ * @brief Restituisce il numero di oggetti di cui è stata chiesta la lettura anticipata dall'avvio del server
+ * 
+ * @return unsigned long Numero di richieste inoltrate al kernel
+ */
+unsigned long prefetch_count () {
+    return __atomic_load_n(&prefetched, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file prefetch.h
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Header della libreria che riconosce gli accessi sequenziali di una sessione e chiede al kernel di portare
+ * in anticipo nella page cache gli oggetti che verranno letti dopo.
+ * Due nomi sono consecutivi se differiscono nell'ultimo carattere di uno ("A" -> "B"), oppure se terminano
+ * con un numero che cresce di uno ("chunk9" -> "chunk10").
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#if !defined(_PREFETCH)
+#define _PREFETCH
+
+// Numero di oggetti successivi tenuti nella page cache durante una lettura sequenziale
+#define PREFETCH_DEPTH 4
+
+// Numero di letture consecutive dopo il quale l'accesso viene considerato sequenziale
+#define PREFETCH_TRIGGER 2
+
+/**
+ * @brief Stato del riconoscitore di accessi di una sessione: ultimo nome letto e lunghezza della sequenza in corso.
+ */
+typedef struct access_pattern {
+    char last_name[256];
+    int sequential;
+} access_pattern_t;
+
+/**
+ * @brief Calcola il nome che segue quello passato in una lettura sequenziale.
+ * 
+ * @param name Nome di partenza
+ * @param next Buffer di almeno 256 caratteri in cui scrivere il nome successivo
+ * @return int Se il nome successivo esiste restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int next_sequential_name (char* name, char* next);
+
+/**
+ * @brief Chiede al kernel di leggere in anticipo un oggetto, se esiste. Gli oggetti grandi vengono letti
+ * aggirando la page cache, quindi sono ignorati.
+ * 
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se la richiesta è stata inoltrata restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int prefetch_object (int dir_fd, char* name);
+
+/**
+ * @brief Registra la lettura di un oggetto. Se la lettura prosegue una sequenza lunga almeno PREFETCH_TRIGGER
+ * chiede di leggere in anticipo i PREFETCH_DEPTH oggetti successivi, inoltrando solo quelli non ancora richiesti.
+ * 
+ * @param pattern Stato del riconoscitore della sessione
+ * @param dir_fd File descriptor della cartella dell'utente
+ * @param name Nome dell'oggetto appena letto
+ */
+void record_access (access_pattern_t* pattern, int dir_fd, char* name);
+
+/**
+ * @brief Restituisce il numero di oggetti di cui è stata chiesta la lettura anticipata dall'avvio del server
+ * 
+ * @return unsigned long Numero di richieste inoltrate al kernel
+ */
+unsigned long prefetch_count ();
+
+#endif // _PREFETCH
@@ -7,14 +7,16 @@
  * 
  */
 
+#define _XOPEN_SOURCE 700
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
-#include <ftw.h>
 
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -25,29 +27,157 @@
 
 #include <socket/safeio.h>
 
+#include <arena/arena.h>
 #include <hashtable/hashtable.h>
+#include <index/index.h>
+#include <workers/direct_io.h>
+#include <workers/layout.h>
+#include <workers/multipart.h>
+#include <workers/prefetch.h>
 #include <workers/workers.h>
 
 // Tabella hash in cui memorizzare le coppie (username, file descriptor)
 static hashtable_t* table;
-// Numero totale di oggetti nello store
-static int objects_count;
-// Dimensione totale dello store
-static size_t total_size;
+// File descriptor della cartella dati, rispetto al quale vengono aperte le cartelle degli utenti
+static int data_fd = -1;
+// Lock degli oggetti: le letture prendono il lock in lettura, le modifiche in scrittura
+static pthread_rwlock_t object_locks[OBJECT_LOCK_STRIPES];
+
+/**
+ * @brief Verifica che il nome passato sia un nome di file valido all'interno di una cartella, ovvero che non sia vuoto,
+ * non contenga separatori e non sia uno tra "." e "..".
+ * 
+ * @param name Nome da verificare
+ * @return int 1 se il nome è valido, 0 altrimenti.
+ */
+static int is_valid_name (char* name) {
+    if (name == NULL || name[0] == '\0') return 0;
+    if (EQUALS(name, ".") || EQUALS(name, "..")) return 0;
+    return strchr(name, '/') == NULL;
+}
 
 /**
- * @brief Restituisce la dimensione del file dal nome passato
+ * @brief Restituisce la dimensione del file aperto
  * 
- * @param file_name Nome del file di cui controllare la dimensione
+ * @param file_fd File descriptor del file di cui controllare la dimensione
  * @return size_t Se la dimensione è stata ottenuta con successo la restituisce. Se c'è un errore restituisce -1 e setta errno.
  */
-static size_t get_file_size (char* file_name) {
+static size_t get_file_size (int file_fd) {
     struct stat sb = {0};
-    int success = stat(file_name, &sb);
-    ASSERT_ERRNO_RETURN(success != -1, ENOENT, -1);
+    int success = fstat(file_fd, &sb);
+    ASSERT_RETURN(success != -1, -1);
     return sb.st_size;
 }
 
+/**
+ * @brief Legge l'intero contenuto di un file aperto in un buffer grande quanto il file
+ * 
+ * @param file_fd File descriptor del file da leggere
+ * @param buffer Buffer di almeno size byte
+ * @param size Dimensione del file
+ * @return int Se la lettura è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int read_file (int file_fd, void* buffer, size_t size) {
+    // Legge il contenuto del file
+    size_t bytes_read = readn(file_fd, buffer, size);
+    ASSERT_RETURN(bytes_read != -1, -1);
+    // Il file è più corto del previsto
+    ASSERT_ERRNO_RETURN(bytes_read == size, EIO, -1);
+    return 0;
+}
+
+/**
+ * @brief Alloca il buffer in cui leggere un oggetto, dall'arena della sessione se presente
+ * 
+ * @param session Sessione del client
+ * @param size Dimensione dell'oggetto
+ * @param direct 1 se l'oggetto verrà letto con O_DIRECT, quindi con buffer allineato e arrotondato
+ * @return void* Buffer allocato. Se c'è un errore restituisce NULL e setta errno.
+ */
+static void* alloc_block (session_t* session, size_t size, int direct) {
+    size_t capacity = direct ? DIRECT_IO_BUFFER_SIZE(size) : size;
+    size_t alignment = direct ? DIRECT_IO_ALIGNMENT : ARENA_ALIGNMENT;
+    // Un oggetto vuoto occupa comunque un byte, così il buffer è sempre valido
+    if (capacity == 0) capacity = 1;
+    if (session->arena) return arena_alloc_aligned(session->arena, capacity, alignment);
+    void* buffer = NULL;
+    errno = posix_memalign(&buffer, alignment, capacity);
+    return (errno == 0) ? buffer : NULL;
+}
+
+/**
+ * @brief Libera un buffer allocato con alloc_block. La memoria dell'arena viene liberata all'azzeramento.
+ * 
+ * @param session Sessione del client
+ * @param buffer Buffer da liberare
+ */
+static void release_block (session_t* session, void* buffer) {
+    if (session->arena == NULL) free(buffer);
+}
+
+/**
+ * @brief Restituisce il lock della partizione a cui appartiene un oggetto dell'utente
+ * 
+ * @param session Sessione dell'utente
+ * @param name Nome dell'oggetto
+ * @return pthread_rwlock_t* Lock che protegge l'oggetto
+ */
+static pthread_rwlock_t* object_lock (session_t* session, char* name) {
+    unsigned int hash = name_hash(session->username) * 31 + name_hash(name);
+    return &object_locks[hash % OBJECT_LOCK_STRIPES];
+}
+
+/**
+ * @brief Recupera i metadati di un oggetto dall'indice. Se l'oggetto esiste sul disco ma manca dall'indice,
+ * perché il server si è interrotto tra la scrittura del file e quella del journal, lo aggiunge all'indice.
+ * Può essere chiamata con il lock dell'oggetto in lettura: se più lettori riparano lo stesso oggetto lo inserisce
+ * solo il primo, e tutti ne vedono la stessa versione.
+ * 
+ * @param session Sessione dell'utente
+ * @param name Nome dell'oggetto
+ * @param info_ptr Puntatore in cui copiare i metadati
+ * @return int Se l'oggetto esiste restituisce 0. Se c'è un errore restituisce -1 e setta errno (ENOENT se l'oggetto non esiste).
+ */
+static int lookup_object (session_t* session, char* name, object_info_t* info_ptr) {
+    if (index_lookup(session->index, name, info_ptr) == 0) return 0;
+    ASSERT_RETURN(errno == ENOENT, -1);
+    // Controlla se l'oggetto esiste sul disco
+    int file_fd = open_object(session->dir_fd, name, O_RDONLY, 0);
+    ASSERT_RETURN(file_fd != -1, -1);
+    size_t size = get_file_size(file_fd);
+    close(file_fd);
+    ASSERT_RETURN(size != -1, -1);
+    return index_insert(session->index, name, size, info_ptr);
+}
+
+/**
+ * @brief Verifica che la versione attuale di un oggetto sia quella attesa
+ * 
+ * @param session Sessione dell'utente
+ * @param name Nome dell'oggetto
+ * @param if_match Versione attesa, 0 se l'oggetto non deve esistere. Se è NULL la verifica ha sempre successo.
+ * @return int Se la versione coincide restituisce 0. Se c'è un errore restituisce -1 e setta errno (ECANCELED se la versione non coincide).
+ */
+static int check_version (session_t* session, char* name, unsigned long* if_match) {
+    if (if_match == NULL) return 0;
+    object_info_t info = {0};
+    int success = lookup_object(session, name, &info);
+    ASSERT_RETURN((success != -1) || (errno == ENOENT), -1);
+    ASSERT_ERRNO_RETURN(info.version == *if_match, ECANCELED, -1);
+    return 0;
+}
+
+/**
+ * @brief Rilascia un lock senza modificare errno
+ * 
+ * @param lock Lock da rilasciare
+ */
+static void unlock_object (pthread_rwlock_t* lock) {
+    int saved_errno = errno;
+    pthread_rwlock_unlock(lock);
+    errno = saved_errno;
+}
+
 /**
  * @brief Se non esiste una cartella dal nome passato, la crea.
  * 
@@ -62,28 +192,6 @@ static int create_directory_if_not_exists (char* name) {
     return 0;
 }
 
-/**
- * @brief Crea un percorso composto da DATA_DIRECTORY/directory[/filename].
- * 
- * @param directory Nome della directory
- * @param filename Opzionale nome del file
- * @return char* Percorso UNIX creato come specificato. Se c'è un errore restituisce NULL e setta errno.
- */
-static char* create_path (char* directory, char* filename) {
-    // Alloca il percorso della dimensione adatta
-    size_t length = strlen(DATA_DIRECTORY) + strlen(directory) + 2;
-    if (filename) length += strlen(filename) + 1;
-    char* path = (char*) malloc(sizeof(char) * length);
-    ASSERT_ERRNO_RETURN(path != NULL, ENOMEM, NULL);
-    // Costruisce il percorso
-    if (filename)
-        sprintf(path, "%s/%s/%s", DATA_DIRECTORY, directory, filename);
-    else
-        sprintf(path, "%s/%s", DATA_DIRECTORY, directory);
-    // Restituisce il percorso
-    return path;
-}
-
 /**
  * @brief Inizializza le strutture dati necessarie alle funziioni.
  * 
@@ -91,12 +199,27 @@ static char* create_path (char* directory, char* filename) {
  */
 int init_worker_functions () {
     // Crea la cartella dati se non esiste
-    int success = create_directory_if_not_exists("data");
+    int success = create_directory_if_not_exists(DATA_DIRECTORY);
     ASSERT_RETURN(success == 0, -1);
+    // Apre la cartella dati una volta per tutte
+    data_fd = open(DATA_DIRECTORY, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT_RETURN(data_fd != -1, -1);
+    // Carica l'indice degli oggetti
+    success = init_index(data_fd);
+    ASSERT(success != -1, close(data_fd); return -1);
+    // Inizializza il pool di buffer per gli oggetti grandi
+    success = init_direct_io();
+    ASSERT(success != -1, stop_index(); close(data_fd); return -1);
+    // Prepara la cartella dei caricamenti in più parti
+    success = init_uploads(data_fd);
+    ASSERT(success != -1, stop_direct_io(); stop_index(); close(data_fd); return -1);
     // Inizializza la tabella hash
     table = create_hashtable();
-    ASSERT_RETURN(table != NULL, -1);
-    // Restituisce il successohashtable
+    ASSERT(table != NULL, stop_uploads(); stop_direct_io(); stop_index(); close(data_fd); return -1);
+    // Inizializza i lock degli oggetti
+    for (int i = 0; i < OBJECT_LOCK_STRIPES; i++)
+        pthread_rwlock_init(&object_locks[i], NULL);
+    // Restituisce il successo
     return 0;
 }
 
@@ -106,143 +229,398 @@ int init_worker_functions () {
  * @return int Se l'eliminazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
  */
 int stop_worker_functions () {
+    // Scarta i caricamenti non completati, salva l'indice, chiude la cartella dati e libera il pool di buffer
+    ASSERT_RETURN(stop_uploads() != -1, -1);
+    ASSERT_RETURN(stop_index() != -1, -1);
+    ASSERT_RETURN(close(data_fd) != -1, -1);
+    ASSERT_RETURN(stop_direct_io() != -1, -1);
+    // Distrugge i lock degli oggetti
+    for (int i = 0; i < OBJECT_LOCK_STRIPES; i++)
+        pthread_rwlock_destroy(&object_locks[i]);
     // Elimina la tabella hash
     return destroy_hashtable(table);
 }
 
 /**
- * @brief Registra un nuovo utente creando la sua cartella su disco
+ * @brief Registra un nuovo utente creando la sua cartella su disco e aprendo la sessione associata
  * 
  * @param client_fd File descriptor del client
  * @param name Nome utente del client
- * @return int Se il client è stato registrato correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ * @param arena Arena della connessione da cui allocare i blocchi letti, NULL per allocarli con malloc
+ * @return session_t* Sessione del client registrato. Se c'è un errore restituisce NULL e setta errno.
  */
-int register_user (int client_fd, char* name) {
+session_t* register_user (int client_fd, char* name, arena_t* arena) {
+    // Controlla la correttezza dei parametri. La cartella dei caricamenti non può essere quella di un utente.
+    ASSERT_ERRNO_RETURN((client_fd > 0) && is_valid_name(name) && !EQUALS(name, UPLOAD_DIRECTORY), EINVAL, NULL);
     // Crea la cartella dell'utente se questa non esiste già
-    char* path = create_path(name, NULL);
-    ASSERT_RETURN(path != NULL, -1);
-    int success = create_directory_if_not_exists(path);
-    free(path);
-    // Controlla che la creazione sia avvenuta con successo
-    ASSERT_RETURN(success != -1, -1);
+    int success = mkdirat(data_fd, name, 0777);
+    ASSERT_RETURN((success != -1) || (errno == EEXIST), NULL);
+    // Alloca la sessione, azzerando lo stato del riconoscitore di letture sequenziali
+    session_t* session = (session_t*) calloc(1, sizeof(session_t));
+    ASSERT_ERRNO_RETURN(session != NULL, ENOMEM, NULL);
+    session->client_fd = client_fd;
+    session->arena = arena;
+    session->username = strdup(name);
+    ASSERT_ERRNO(session->username != NULL, ENOMEM, free(session); return NULL);
+    // Apre la cartella dell'utente, che rimane aperta per tutta la sessione
+    session->dir_fd = openat(data_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT(session->dir_fd != -1, free(session->username); free(session); return NULL);
+    // Recupera l'indice degli oggetti dell'utente
+    session->index = get_user_index(name);
+    ASSERT(session->index != NULL, close(session->dir_fd); free(session->username); free(session); return NULL);
     // Inserisce l'utente nella tabella
     success = insert_hashtable(table, client_fd, name);
     // Controlla che non ci siano errori
-    ASSERT_RETURN(success != -1, -1);
-    // Termina con successo
-    return 0;
+    ASSERT(success != -1, close(session->dir_fd); free(session->username); free(session); return NULL);
+    // Conta la sessione, così che i caricamenti dell'utente vengano scartati quando si chiude la sua ultima
+    success = open_upload_session(name);
+    ASSERT(success != -1, remove_hashtable(table, client_fd); close(session->dir_fd); free(session->username); free(session); return NULL);
+    // Restituisce la sessione
+    return session;
 }
 
 /**
- * @brief Scrive un nuovo blocco nel file con lo stesso nome.
+ * @brief Scrive il contenuto di un oggetto e lo registra nell'indice. Va chiamata con il lock dell'oggetto in scrittura.
  * 
- * @param client_fd File descriptor del client
+ * @param session Sessione del client
  * @param name Nome del blocco da scrivere
  * @param data Blocco di dati da scrivere
  * @param size Dimensione dei dati
  * @return int Se il blocco è stato scritto correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
  */
-int store_block (int client_fd, char* name, void* data, size_t size) {
-    // Prende lo username dell'utente
-    char* username = retrieve_hashtable(table, client_fd);
-    // Se lo username non esiste esce
-    ASSERT_RETURN(username != NULL, -1);
-    // Crea il percorso del file
-    char* path = create_path(username, name);
-    ASSERT_RETURN(path != NULL, -1);
-    // Apre il file da leggere
-    int file_fd = open(path, O_CREAT | O_WRONLY, 0777);
-    free(path);
+static int write_object (session_t* session, char* name, void* data, size_t size) {
+    // Apre il file da scrivere rispetto alla cartella dell'utente, scartando il contenuto precedente
+    int file_fd = open_object(session->dir_fd, name, O_CREAT | O_WRONLY | O_TRUNC, 0777);
     ASSERT_RETURN(file_fd != -1, -1);
-    // Scrive tutti i bytes sul file
-    int bytes_written = writen(file_fd, data, size);
+    // Scrive tutti i bytes sul file, bypassando la page cache se l'oggetto è grande
+    int bytes_written = is_large_object(size) ? direct_write_file(file_fd, data, size) : writen(file_fd, data, size);
     // Chiude il file da leggere
     int success = close(file_fd);
     ASSERT_RETURN(success != -1, -1);
     // Controlla che il file sia stato scritto correttamente
     ASSERT_RETURN(bytes_written != -1, -1);
-    // Resituisce il succeso
-    return 0;
+    // Scarta l'eventuale versione precedente non ancora migrata nel layout a fanout
+    discard_flat_object(session->dir_fd, name);
+    // Registra l'oggetto nell'indice
+    return index_store(session->index, name, size, NULL);
 }
 
 /**
- * @brief Recupera un blocco di dati
+ * @brief Scrive un nuovo blocco nel file con lo stesso nome.
  * 
- * @param client_fd File descriptor del client
+ * @param session Sessione del client
+ * @param name Nome del blocco da scrivere
+ * @param data Blocco di dati da scrivere
+ * @param size Dimensione dei dati
+ * @param if_match Se non è NULL il blocco viene scritto solo se la versione attuale dell'oggetto è quella puntata (0 se l'oggetto non deve esistere)
+ * @return int Se il blocco è stato scritto correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno (ECANCELED se la versione non coincide).
+ */
+int store_block (session_t* session, char* name, void* data, size_t size, unsigned long* if_match) {
+    // Controlla che il client sia registrato e che il nome sia valido
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    ASSERT_ERRNO_RETURN(is_valid_name(name), EINVAL, -1);
+    // Verifica la versione e scrive l'oggetto senza che altri lo modifichino nel frattempo
+    pthread_rwlock_t* lock = object_lock(session, name);
+    ASSERT_RETURN((errno = pthread_rwlock_wrlock(lock)) == 0, -1);
+    int success = check_version(session, name, if_match);
+    if (success != -1) success = write_object(session, name, data, size);
+    unlock_object(lock);
+    return success;
+}
+
+/**
+ * @brief Accoda dei dati in fondo a un blocco, creandolo se non esiste. Le aggiunte concorrenti allo stesso blocco
+ * vengono serializzate.
+ * 
+ * @param session Sessione del client
+ * @param name Nome del blocco da estendere
+ * @param data Dati da accodare
+ * @param size Dimensione dei dati
+ * @return int Se i dati sono stati accodati correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int append_block (session_t* session, char* name, void* data, size_t size) {
+    // Controlla che il client sia registrato e che i parametri siano validi
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    ASSERT_ERRNO_RETURN(is_valid_name(name) && (data != NULL) && (size > 0), EINVAL, -1);
+    // Le aggiunte allo stesso oggetto avvengono una alla volta, così la dimensione registrata nell'indice è quella finale
+    pthread_rwlock_t* lock = object_lock(session, name);
+    ASSERT_RETURN((errno = pthread_rwlock_wrlock(lock)) == 0, -1);
+    // Apre l'oggetto in qualunque layout si trovi, creandolo nel layout corrente se non esiste
+    int file_fd = open_object(session->dir_fd, name, O_WRONLY | O_APPEND, 0);
+    if ((file_fd == -1) && (errno == ENOENT))
+        file_fd = open_object(session->dir_fd, name, O_CREAT | O_WRONLY | O_APPEND, 0777);
+    ASSERT(file_fd != -1, unlock_object(lock); return -1);
+    // Scrive solo i nuovi bytes in fondo al file e ne legge la nuova dimensione
+    int success = writen(file_fd, data, size);
+    size_t new_size = (success != -1) ? get_file_size(file_fd) : -1;
+    ASSERT(close(file_fd) != -1, success = -1);
+    // Registra la nuova dimensione nell'indice
+    if ((success != -1) && (new_size != -1)) success = index_store(session->index, name, new_size, NULL);
+    else success = -1;
+    unlock_object(lock);
+    return success;
+}
+
+/**
+ * @brief Legge il contenuto di un oggetto. Va chiamata con il lock dell'oggetto in lettura.
+ * 
+ * @param session Sessione del client
  * @param name Nome del blocco da recuperare
  * @param size_ptr Puntatore alla dimensione del blocco, il cui valore puntato viene settato al termine della funzione
- * @return void* Blocco di dati identificato dal nome. Se c'è un errore restituisce NULL e setta errno.
+ * @param info_ptr Puntatore in cui copiare i metadati del blocco
+ * @param if_none_match Se non è NULL e la versione attuale dell'oggetto è quella puntata il blocco non viene letto
+ * @return void* Blocco di dati identificato dal nome. Se c'è un errore restituisce NULL e setta errno (EALREADY se la versione coincide con if_none_match).
  */
-void* retrieve_block (int client_fd, char* name, size_t* size_ptr) {
-    // Controlla la correttezza dei parametri
-    ASSERT_ERRNO_RETURN((client_fd > 0) && (name != NULL), EINVAL, NULL);
-    // Prende lo username dell'utente
-    char* username = retrieve_hashtable(table, client_fd);
-    // Se lo username non esiste esce
-    ASSERT_RETURN(username != NULL, NULL);
-    // Costruisce il percorso del file
-    char* path = create_path(username, name);
-    ASSERT_RETURN(path != NULL, NULL);
-    // Crea un buffer grande quanto il file
-    size_t size = get_file_size(path);
-    ASSERT(size != -1, free(path); return NULL);
-    void* buffer = malloc(size);
-    ASSERT_ERRNO_RETURN(buffer != NULL, ENOMEM, NULL);
-    // Apre il file puntato
-    int file_fd = open(path, O_RDONLY);
-    free(path);
+static void* read_object (session_t* session, char* name, size_t* size_ptr, object_info_t* info_ptr, unsigned long* if_none_match) {
+    // Recupera i metadati dall'indice, e se il client ha già questa versione non legge il disco
+    ASSERT_RETURN(lookup_object(session, name, info_ptr) != -1, NULL);
+    ASSERT_ERRNO_RETURN((if_none_match == NULL) || (info_ptr->version != *if_none_match), EALREADY, NULL);
+    // Apre il file puntato rispetto alla cartella dell'utente, cercandolo in entrambi i layout. La lettura non modifica
+    // l'indice: se il file non si trova in nessuno dei due restituisce ENOENT
+    int file_fd = open_object(session->dir_fd, name, O_RDONLY, 0);
     ASSERT_RETURN(file_fd != -1, NULL);
-    // Legge il contenuto del file
-    int bytes_read = readn(file_fd, buffer, size);
+    // Recupera la dimensione del file
+    size_t size = get_file_size(file_fd);
+    ASSERT(size != -1, close(file_fd); return NULL);
+    // Alloca il buffer e legge il contenuto del file, bypassando la page cache se l'oggetto è grande
+    int direct = is_large_object(size);
+    void* buffer = alloc_block(session, size, direct);
+    ASSERT(buffer != NULL, close(file_fd); return NULL);
+    int success = 0;
+    if (size > 0) success = direct ? direct_read_file(file_fd, buffer, size) : read_file(file_fd, buffer, size);
     // Chiude il file
-    int success = close(file_fd);
+    ASSERT(close(file_fd) != -1, success = -1);
     // Verifica che lettura e chiusura siano andate a buon fine
-    ASSERT((bytes_read != -1) && (success != -1), free(buffer); return NULL);
+    ASSERT(success != -1, release_block(session, buffer); return NULL);
     // Setta il valore del puntatore alla dimensione
     *size_ptr = size;
     // Restituisce il buffer
     return buffer;
 }
 
+/**
+ * @brief Recupera un blocco di dati
+ * 
+ * @param session Sessione del client
+ * @param name Nome del blocco da recuperare
+ * @param size_ptr Puntatore alla dimensione del blocco, il cui valore puntato viene settato al termine della funzione
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati del blocco
+ * @param if_none_match Se non è NULL e la versione attuale dell'oggetto è quella puntata il blocco non viene letto
+ * @return void* Blocco di dati identificato dal nome, allocato nell'arena della sessione oppure, se la sessione non ne ha una,
+ * da liberare con free. Se c'è un errore restituisce NULL e setta errno (EALREADY se la versione coincide con if_none_match).
+ */
+void* retrieve_block (session_t* session, char* name, size_t* size_ptr, object_info_t* info_ptr, unsigned long* if_none_match) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, NULL);
+    ASSERT_ERRNO_RETURN(is_valid_name(name) && (size_ptr != NULL), EINVAL, NULL);
+    object_info_t info;
+    if (info_ptr == NULL) info_ptr = &info;
+    // Legge l'oggetto impedendo che venga modificato durante la lettura
+    pthread_rwlock_t* lock = object_lock(session, name);
+    ASSERT_RETURN((errno = pthread_rwlock_rdlock(lock)) == 0, NULL);
+    void* buffer = read_object(session, name, size_ptr, info_ptr, if_none_match);
+    unlock_object(lock);
+    ASSERT_RETURN(buffer != NULL, NULL);
+    // Se la lettura prosegue una sequenza avvia la lettura anticipata degli oggetti successivi
+    record_access(&session->access, session->dir_fd, name);
+    return buffer;
+}
+
+/**
+ * @brief Avvia il caricamento in più parti di un blocco
+ * 
+ * @param session Sessione del client
+ * @param name Nome del blocco da creare
+ * @param size Dimensione finale del blocco
+ * @param id_ptr Puntatore in cui scrivere l'identificativo del caricamento
+ * @return int Se il caricamento è stato avviato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int initiate_upload (session_t* session, char* name, size_t size, unsigned long* id_ptr) {
+    // Controlla che il client sia registrato e che i parametri siano validi
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    ASSERT_ERRNO_RETURN(is_valid_name(name) && !EQUALS(name, FANOUT_ROOT) && (size > 0) && (id_ptr != NULL), EINVAL, -1);
+    return create_upload(session->username, name, size, id_ptr);
+}
+
+/**
+ * @brief Controlla che una parte possa essere scritta in un caricamento, così che i suoi dati vengano ricevuti
+ * solo se verranno scritti
+ * 
+ * @param session Sessione del client
+ * @param id Identificativo del caricamento
+ * @param offset Posizione della parte nel blocco
+ * @param length Lunghezza della parte
+ * @return int Se la parte può essere scritta restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int check_part (session_t* session, unsigned long id, size_t offset, size_t length) {
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    return check_upload_part(session->username, id, offset, length);
+}
+
+/**
+ * @brief Scrive una parte di un caricamento alla sua posizione nel blocco. Le parti possono arrivare in qualunque
+ * ordine e da qualunque connessione dello stesso utente.
+ * 
+ * @param session Sessione del client
+ * @param id Identificativo del caricamento
+ * @param offset Posizione della parte nel blocco
+ * @param data Dati della parte
+ * @param length Lunghezza della parte
+ * @return int Se la parte è stata scritta restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int upload_part (session_t* session, unsigned long id, size_t offset, void* data, size_t length) {
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    return write_upload_part(session->username, id, offset, data, length);
+}
+
+/**
+ * @brief Completa un caricamento: il file che contiene le parti diventa il blocco, sostituendone la versione precedente.
+ * 
+ * @param session Sessione del client
+ * @param id Identificativo del caricamento
+ * @return int Se il blocco è stato creato restituisce 0. Se c'è un errore restituisce -1 e setta errno
+ * (ENODATA se non sono arrivati tutti i byte del blocco, nel qual caso il caricamento resta aperto).
+ */
+int complete_upload (session_t* session, unsigned long id) {
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    upload_t* upload = detach_upload(session->username, id, 1);
+    ASSERT_RETURN(upload != NULL, -1);
+    // Sposta il file e aggiorna l'indice senza che altri modifichino l'oggetto nel frattempo
+    pthread_rwlock_t* lock = object_lock(session, upload->name);
+    ASSERT((errno = pthread_rwlock_wrlock(lock)) == 0, release_upload(upload); return -1);
+    int success = commit_upload(upload, session->dir_fd);
+    if (success != -1) {
+        // Scarta l'eventuale versione precedente non ancora migrata nel layout a fanout
+        discard_flat_object(session->dir_fd, upload->name);
+        success = index_store(session->index, upload->name, upload->size, NULL);
+    }
+    unlock_object(lock);
+    release_upload(upload);
+    return success;
+}
+
+/**
+ * @brief Interrompe un caricamento scartando le parti ricevute
+ * 
+ * @param session Sessione del client
+ * @param id Identificativo del caricamento
+ * @return int Se il caricamento è stato scartato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int abort_upload (session_t* session, unsigned long id) {
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    upload_t* upload = detach_upload(session->username, id, 0);
+    ASSERT_RETURN(upload != NULL, -1);
+    release_upload(upload);
+    return 0;
+}
+
+/**
+ * @brief Recupera i metadati di un blocco senza leggerne il contenuto
+ * 
+ * @param session Sessione del client
+ * @param name Nome del blocco
+ * @param info_ptr Puntatore in cui copiare dimensione, istante dell'ultima modifica e versione del blocco
+ * @return int Se il blocco esiste restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int stat_block (session_t* session, char* name, object_info_t* info_ptr) {
+    // Controlla la correttezza dei parametri
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    ASSERT_ERRNO_RETURN(is_valid_name(name) && (info_ptr != NULL), EINVAL, -1);
+    // Legge i metadati dall'indice, senza accedere al disco
+    pthread_rwlock_t* lock = object_lock(session, name);
+    ASSERT_RETURN((errno = pthread_rwlock_rdlock(lock)) == 0, -1);
+    int success = lookup_object(session, name, info_ptr);
+    unlock_object(lock);
+    return success;
+}
+
 /**
  * @brief Rimuove dal disco un blocco di dati dell'utente
  * 
- * @param client_fd File descriptor dell'utente
+ * @param session Sessione dell'utente
  * @param name Nome del blocco da rimuovere
  * @return int Se il blocco è stato rimosso con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
  */
-int delete_block (int client_fd, char* name) {
-    // Recupera lo username dell'utente
-    char* username = retrieve_hashtable(table, client_fd);
-    ASSERT_RETURN(username != NULL, -1);
-    // Costruisce il path del file
-    char* path = create_path(username, name);
-    // Rimuove il file identificato dal path
-    int success = unlink(path);
-    // Libera la memoria occupata dal percorso
-    free(path);
-    // L'operazione ha avuto successo se l'eliminazione ha avuto successo
+int delete_block (session_t* session, char* name) {
+    // Controlla che il client sia registrato e che il nome sia valido
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    ASSERT_ERRNO_RETURN(is_valid_name(name), EINVAL, -1);
+    // Rimuove il file rispetto alla cartella dell'utente e dall'indice, senza che altri lo modifichino nel frattempo
+    pthread_rwlock_t* lock = object_lock(session, name);
+    ASSERT_RETURN((errno = pthread_rwlock_wrlock(lock)) == 0, -1);
+    int success = unlink_object(session->dir_fd, name);
+    if (success != -1) success = index_delete(session->index, name);
+    else if (errno == ENOENT) {
+        // Un oggetto nell'indice il cui file non esiste più (perso in un crash o rimosso dall'esterno) viene comunque
+        // tolto dall'indice, altrimenti LIST e STAT continuerebbero a riportarlo; la risposta resta ENOENT
+        object_info_t info;
+        if (index_lookup(session->index, name, &info) != -1) index_delete(session->index, name);
+        errno = ENOENT;
+    }
+    unlock_object(lock);
     return success;
 }
 
 /**
- * @brief Cancella il client dal sistema
+ * @brief Elenca in ordine i nomi degli oggetti dell'utente che iniziano con un prefisso, leggendoli dall'indice
  * 
- * @param client_fd File descriptor di client
+ * @param session Sessione dell'utente
+ * @param prefix Prefisso dei nomi da elencare, stringa vuota per tutti gli oggetti
+ * @param start_after Ultimo nome della pagina precedente, stringa vuota per partire dall'inizio
+ * @param limit Numero massimo di nomi da elencare, limitato a LIST_MAX_LIMIT
+ * @param size_ptr Puntatore alla dimensione dell'elenco, il cui valore puntato viene settato dalla funzione
+ * @return char* Nomi degli oggetti separati da '\n'. Se c'è un errore restituisce NULL e setta errno.
  */
-void leave_client (int client_fd) {
-    // Rimuove se esiste il descrittore dalla tabella hash
-    remove_hashtable(table, client_fd);
+char* list_blocks (session_t* session, char* prefix, char* start_after, int limit, size_t* size_ptr) {
+    // Controlla che il client sia registrato e che i parametri siano validi
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, NULL);
+    ASSERT_ERRNO_RETURN((prefix != NULL) && (start_after != NULL) && (limit > 0) && (size_ptr != NULL), EINVAL, NULL);
+    // Limita la dimensione di una pagina
+    if (limit > LIST_MAX_LIMIT) limit = LIST_MAX_LIMIT;
+    // Legge l'elenco dall'indice, senza consultare il disco
+    return index_list(session->index, prefix, start_after, limit, size_ptr);
 }
 
-static int count_file_number_size (const char* filename, const struct stat* sb, int typeflag) {
-    // Se l'elemento corrente è un file incrementa il numero di file
-    if (typeflag == FTW_F)
-        objects_count++;
-    // Incrementa la dimensione totale
-    total_size += sb->st_size;
-    // Restituisce il successo
-    return 0;
+/**
+ * @brief Chiede di leggere in anticipo un insieme di oggetti dell'utente. I nomi non validi o di oggetti
+ * che non esistono vengono ignorati.
+ * 
+ * @param session Sessione dell'utente
+ * @param names Nomi degli oggetti separati da '\n', in un buffer di almeno length + 1 caratteri che viene modificato dalla funzione
+ * @param length Lunghezza della stringa dei nomi
+ * @return int Numero di oggetti di cui è stata avviata la lettura. Se c'è un errore restituisce -1 e setta errno.
+ */
+int prefetch_blocks (session_t* session, char* names, size_t length) {
+    // Controlla che il client sia registrato e che i parametri siano validi
+    ASSERT_ERRNO_RETURN(session != NULL, ENOTCONN, -1);
+    ASSERT_ERRNO_RETURN(names != NULL, EINVAL, -1);
+    int prefetched = 0;
+    // Scorre i nomi terminandoli uno alla volta
+    char* name = names;
+    for (size_t i = 0; i <= length; i++) {
+        if ((i < length) && (names[i] != '\n') && (names[i] != '\0')) continue;
+        names[i] = '\0';
+        if (is_valid_name(name) && (prefetch_object(session->dir_fd, name) == 0)) prefetched++;
+        name = names + i + 1;
+    }
+    return prefetched;
+}
+
+/**
+ * @brief Cancella il client dal sistema, chiudendo e liberando la sua sessione
+ * 
+ * @param session Sessione del client
+ */
+void leave_client (session_t* session) {
+    if (session == NULL) return;
+    // Rimuove se esiste il descrittore dalla tabella hash
+    remove_hashtable(table, session->client_fd);
+    // Se era l'ultima sessione dell'utente ne scarta i caricamenti non completati
+    close_upload_session(session->username);
+    // Chiude la cartella dell'utente e libera la sessione
+    close(session->dir_fd);
+    free(session->username);
+    free(session);
 }
 
 /**
@@ -254,15 +632,29 @@ static int count_file_number_size (const char* filename, const struct stat* sb,
  * @return int Se le informazioni sono state estratte con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno. 
  */
 int get_report (int* clients_ptr, int* objects_ptr, int* size_ptr) {
-    // Conta il numero di files e dimensione totale
-    total_size = 0;
-    objects_count = 0;
-    int success = ftw("./data", count_file_number_size, 0);
+    // Legge numero di oggetti e dimensione totale dall'indice, senza scandire il disco
+    int users;
+    size_t total_size;
+    int success = index_totals(&users, objects_ptr, &total_size);
     ASSERT_RETURN(success != -1, -1);
     *size_ptr = total_size;
-    *objects_ptr = objects_count;
     // Conta il numero di client connessi
-    *clients_ptr = table->elements;
+    *clients_ptr = size_hashtable(table);
     // Restituisce il successo
     return 0;
+}
+
+/**
+ * @brief Scrive le informazioni di get_report con i tipi completi, più il numero di utenti presenti nell'indice
+ * 
+ * @param clients_ptr Puntatore al numero di client registrati
+ * @param users_ptr Puntatore al numero di utenti nell'indice
+ * @param objects_ptr Puntatore al numero di oggetti salvati
+ * @param size_ptr Puntatore alla dimensione totale dello store
+ * @return int Se le informazioni sono state estratte con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int get_totals (int* clients_ptr, int* users_ptr, int* objects_ptr, size_t* size_ptr) {
+    ASSERT_RETURN(index_totals(users_ptr, objects_ptr, size_ptr) != -1, -1);
+    *clients_ptr = size_hashtable(table);
+    return 0;
 }
\ No newline at end of file
@@ -10,6 +10,30 @@
 #if !defined(_WORKERS)
 #define _WORKERS
 
+#include <stddef.h>
+
+#include <arena/arena.h>
+#include <index/index.h>
+#include <workers/prefetch.h>
+
+// Numero di lock in lettura/scrittura tra cui sono ripartiti gli oggetti, per serializzare le modifiche di uno stesso oggetto
+#define OBJECT_LOCK_STRIPES 256
+
+/**
+ * @brief Sessione di un client registrato. Contiene il nome utente, il file descriptor della sua cartella dati,
+ * aperta una volta per tutte alla registrazione, rispetto alla quale vengono risolti i nomi degli oggetti,
+ * l'indice dei suoi oggetti, lo stato del riconoscitore di letture sequenziali e l'arena della connessione
+ * da cui vengono allocati i blocchi letti.
+ */
+typedef struct session {
+    int client_fd;
+    char* username;
+    int dir_fd;
+    user_index_t* index;
+    access_pattern_t access;
+    arena_t* arena;
+} session_t;
+
 /**
  * @brief Inizializza le strutture dati necessarie alle funziioni.
  * 
@@ -25,50 +49,155 @@ int init_worker_functions ();
 int stop_worker_functions ();
 
 /**
- * @brief Registra un nuovo utente creando la sua cartella su disco
+ * @brief Registra un nuovo utente creando la sua cartella su disco e aprendo la sessione associata
  * 
  * @param client_fd File descriptor del client
  * @param name Nome utente del client
- * @return int Se il client è stato registrato correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ * @param arena Arena della connessione da cui allocare i blocchi letti, NULL per allocarli con malloc
+ * @return session_t* Sessione del client registrato. Se c'è un errore restituisce NULL e setta errno.
  */
-int register_user (int client_fd, char* name);
+session_t* register_user (int client_fd, char* name, arena_t* arena);
 
 /**
  * @brief Scrive un nuovo blocco nel file con lo stesso nome.
  * 
- * @param client_fd File descriptor del client
+ * @param session Sessione del client
  * @param name Nome del blocco da scrivere
  * @param data Blocco di dati da scrivere
  * @param size Dimensione dei dati
- * @return int Se il blocco è stato scritto correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ * @param if_match Se non è NULL il blocco viene scritto solo se la versione attuale dell'oggetto è quella puntata (0 se l'oggetto non deve esistere)
+ * @return int Se il blocco è stato scritto correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno (ECANCELED se la versione non coincide).
  */
-int store_block (int client_fd, char* name, void* data, size_t size);
+int store_block (session_t* session, char* name, void* data, size_t size, unsigned long* if_match);
+
+/**
+ * @brief Accoda dei dati in fondo a un blocco, creandolo se non esiste. Le aggiunte concorrenti allo stesso blocco
+ * vengono serializzate.
+ * 
+ * @param session Sessione del client
+ * @param name Nome del blocco da estendere
+ * @param data Dati da accodare
+ * @param size Dimensione dei dati
+ * @return int Se i dati sono stati accodati correttamente restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int append_block (session_t* session, char* name, void* data, size_t size);
 
 /**
  * @brief Recupera un blocco di dati del client dal disco
  * 
- * @param client_fd File descriptor del client
+ * @param session Sessione del client
  * @param name Nome del blocco da recuperare
  * @param size_ptr Puntatore alla dimensione del blocco, il cui valore puntato viene settato dalla funzione
- * @return void* Blocco di dati identificato dal nome. Se c'è un errore restituisce NULL e setta errno.
+ * @param info_ptr Se non è NULL vi vengono copiati i metadati del blocco
+ * @param if_none_match Se non è NULL e la versione attuale dell'oggetto è quella puntata il blocco non viene letto
+ * @return void* Blocco di dati identificato dal nome, allocato nell'arena della sessione oppure, se la sessione non ne ha una,
+ * da liberare con free. Se c'è un errore restituisce NULL e setta errno (EALREADY se la versione coincide con if_none_match).
  */
-void* retrieve_block (int client_fd, char* name, size_t* size_ptr);
+void* retrieve_block (session_t* session, char* name, size_t* size_ptr, object_info_t* info_ptr, unsigned long* if_none_match);
+
+/**
+ * @brief Avvia il caricamento in più parti di un blocco
+ * 
+ * @param session Sessione del client
+ * @param name Nome del blocco da creare
+ * @param size Dimensione finale del blocco
+ * @param id_ptr Puntatore in cui scrivere l'identificativo del caricamento
+ * @return int Se il caricamento è stato avviato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int initiate_upload (session_t* session, char* name, size_t size, unsigned long* id_ptr);
+
+/**
+ * @brief Controlla che una parte possa essere scritta in un caricamento, così che i suoi dati vengano ricevuti
+ * solo se verranno scritti
+ * 
+ * @param session Sessione del client
+ * @param id Identificativo del caricamento
+ * @param offset Posizione della parte nel blocco
+ * @param length Lunghezza della parte
+ * @return int Se la parte può essere scritta restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int check_part (session_t* session, unsigned long id, size_t offset, size_t length);
+
+/**
+ * @brief Scrive una parte di un caricamento alla sua posizione nel blocco. Le parti possono arrivare in qualunque
+ * ordine e da qualunque connessione dello stesso utente.
+ * 
+ * @param session Sessione del client
+ * @param id Identificativo del caricamento
+ * @param offset Posizione della parte nel blocco
+ * @param data Dati della parte
+ * @param length Lunghezza della parte
+ * @return int Se la parte è stata scritta restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int upload_part (session_t* session, unsigned long id, size_t offset, void* data, size_t length);
+
+/**
+ * @brief Completa un caricamento: il file che contiene le parti diventa il blocco, sostituendone la versione precedente.
+ * 
+ * @param session Sessione del client
+ * @param id Identificativo del caricamento
+ * @return int Se il blocco è stato creato restituisce 0. Se c'è un errore restituisce -1 e setta errno
+ * (ENODATA se non sono arrivati tutti i byte del blocco, nel qual caso il caricamento resta aperto).
+ */
+int complete_upload (session_t* session, unsigned long id);
+
+/**
+ * @brief Interrompe un caricamento scartando le parti ricevute
+ * 
+ * @param session Sessione del client
+ * @param id Identificativo del caricamento
+ * @return int Se il caricamento è stato scartato restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int abort_upload (session_t* session, unsigned long id);
+
+/**
+ * @brief Recupera i metadati di un blocco senza leggerne il contenuto
+ * 
+ * @param session Sessione del client
+ * @param name Nome del blocco
+ * @param info_ptr Puntatore in cui copiare dimensione, istante dell'ultima modifica e versione del blocco
+ * @return int Se il blocco esiste restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int stat_block (session_t* session, char* name, object_info_t* info_ptr);
 
 /**
  * @brief Rimuove dal disco un blocco di dati dell'utente
  * 
- * @param client_fd File descriptor dell'utente
+ * @param session Sessione dell'utente
  * @param name Nome del blocco da rimuovere
  * @return int Se il blocco è stato rimosso con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
  */
-int delete_block (int client_fd, char* name);
+int delete_block (session_t* session, char* name);
 
 /**
- * @brief Cancella il client dal sistema
+ * @brief Elenca in ordine i nomi degli oggetti dell'utente che iniziano con un prefisso, leggendoli dall'indice
  * 
- * @param client_fd File descriptor di client
+ * @param session Sessione dell'utente
+ * @param prefix Prefisso dei nomi da elencare, stringa vuota per tutti gli oggetti
+ * @param start_after Ultimo nome della pagina precedente, stringa vuota per partire dall'inizio
+ * @param limit Numero massimo di nomi da elencare, limitato a LIST_MAX_LIMIT
+ * @param size_ptr Puntatore alla dimensione dell'elenco, il cui valore puntato viene settato dalla funzione
+ * @return char* Nomi degli oggetti separati da '\n'. Se c'è un errore restituisce NULL e setta errno.
  */
-void leave_client (int client_fd);
+char* list_blocks (session_t* session, char* prefix, char* start_after, int limit, size_t* size_ptr);
+
+/**
+ * @brief Chiede di leggere in anticipo un insieme di oggetti dell'utente. I nomi non validi o di oggetti
+ * che non esistono vengono ignorati.
+ * 
+ * @param session Sessione dell'utente
+ * @param names Nomi degli oggetti separati da '\n', in un buffer di almeno length + 1 caratteri che viene modificato dalla funzione
+ * @param length Lunghezza della stringa dei nomi
+ * @return int Numero di oggetti di cui è stata avviata la lettura. Se c'è un errore restituisce -1 e setta errno.
+ */
+int prefetch_blocks (session_t* session, char* names, size_t length);
+
+/**
+ * @brief Cancella il client dal sistema, chiudendo e liberando la sua sessione
+ * 
+ * @param session Sessione del client
+ */
+void leave_client (session_t* session);
 
 /**
  * @brief Scrive le informazioni di report sui puntatori passati
@@ -80,4 +209,15 @@ void leave_client (int client_fd);
  */
 int get_report (int* clients_ptr, int* objects_ptr, int* size_ptr);
 
+/**
+ * @brief Scrive le informazioni di get_report con i tipi completi, più il numero di utenti presenti nell'indice
+ * 
+ * @param clients_ptr Puntatore al numero di client registrati
+ * @param users_ptr Puntatore al numero di utenti nell'indice
+ * @param objects_ptr Puntatore al numero di oggetti salvati
+ * @param size_ptr Puntatore alla dimensione totale dello store
+ * @return int Se le informazioni sono state estratte con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int get_totals (int* clients_ptr, int* users_ptr, int* objects_ptr, size_t* size_ptr);
+
 #endif // _WORKERS
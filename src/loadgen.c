@@ -0,0 +1,453 @@
+/**
+ * @file loadgen.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Generatore di carico per l'object store. Più thread, che condividono un client con un pool di connessioni,
+ * eseguono per una durata fissata operazioni scelte secondo un mix configurabile, su oggetti di dimensione e chiave
+ * estratte dalle distribuzioni indicate. Alla fine stampa per ogni tipo di operazione le operazioni e i megabyte al secondo
+ * e i percentili di latenza, come tabella o come JSON, così che una modifica del server possa essere confrontata con una
+ * misura precedente.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <assertmacros.h>
+
+#include <histogram/histogram.h>
+#include <histogram/workload.h>
+#include <os_client/os_client.h>
+
+// Valori di default dei parametri
+#define DEFAULT_USER "loadgen"
+#define DEFAULT_CONNECTIONS 8
+#define DEFAULT_THREADS 8
+#define DEFAULT_MIX "store=20,retrieve=75,delete=5"
+#define DEFAULT_SIZES "uniform:100:100000"
+#define DEFAULT_KEYS 1000
+#define DEFAULT_SKEW "uniform"
+#define DEFAULT_DURATION 10
+
+// Lunghezza massima del nome di un oggetto generato
+#define KEY_LENGTH 32
+
+/**
+ * @brief Tipo di operazione
+ */
+typedef enum { OP_STORE, OP_RETRIEVE, OP_DELETE, OP_STAT, OP_COUNT } operation_t;
+
+static const char* operation_names[] = { "store", "retrieve", "delete", "stat" };
+
+/**
+ * @brief Distribuzione delle dimensioni: fissa, uniforme fra minimo e massimo, oppure log-uniforme, in cui ogni ordine di
+ * grandezza fra minimo e massimo è ugualmente probabile (molti oggetti piccoli e pochi grandi).
+ */
+typedef enum { SIZE_FIXED, SIZE_UNIFORM, SIZE_LOG } size_distribution_t;
+
+static const char* size_names[] = { "fixed", "uniform", "log" };
+
+/**
+ * @brief Distribuzione delle chiavi: uniforme, oppure concentrata su poche chiavi secondo una zipf
+ */
+typedef enum { SKEW_UNIFORM, SKEW_ZIPF } skew_t;
+
+static const char* skew_names[] = { "uniform", "zipf" };
+
+/**
+ * @brief Parametri del carico
+ */
+typedef struct config {
+    char* user;
+    int connections;
+    int threads;
+    // Peso di ogni operazione nel mix e loro somma
+    long weights[OP_COUNT];
+    long total_weight;
+    size_distribution_t size_distribution;
+    size_t min_size;
+    size_t max_size;
+    long keys;
+    skew_t skew;
+    long duration;
+    int preload;
+    int retain;
+    int json;
+} config_t;
+
+/**
+ * @brief Risultati di un tipo di operazione
+ */
+typedef struct operation_stats {
+    // Latenze in nanosecondi
+    histogram_t latency;
+    // Byte inviati o ricevuti
+    unsigned long bytes;
+    unsigned long errors;
+    // Operazioni su un oggetto che non esisteva, non contate come errori perché il mix può cancellare oggetti
+    unsigned long misses;
+} operation_stats_t;
+
+/**
+ * @brief Stato di un thread del carico
+ */
+typedef struct worker {
+    int id;
+    unsigned long state;
+    // Buffer in cui ricevere gli oggetti recuperati
+    char* buffer;
+    operation_stats_t operations[OP_COUNT];
+} worker_t;
+
+// Stato condiviso dai thread, in sola lettura durante la misura tranne stop
+static config_t config;
+static os_client_t* client;
+static char* payload;
+static zipf_t zipf;
+static int stop = 0;
+static pthread_barrier_t start_barrier;
+
+/**
+ * @brief Scrive in name il nome dell'oggetto di indice index
+ */
+static inline void key_name (long index, char* name) {
+    snprintf(name, KEY_LENGTH, "key%08ld", index);
+}
+
+/**
+ * @brief Estrae la chiave della prossima operazione
+ */
+static inline long next_key (unsigned long* state) {
+    if (config.skew == SKEW_ZIPF) return next_zipf(&zipf, state);
+    return (long) (next_random(state) % config.keys);
+}
+
+/**
+ * @brief Estrae la dimensione del prossimo oggetto da memorizzare
+ */
+static inline size_t next_size (unsigned long* state) {
+    switch (config.size_distribution) {
+        case SIZE_FIXED:
+            return config.min_size;
+        case SIZE_UNIFORM:
+            return config.min_size + next_random(state) % (config.max_size - config.min_size + 1);
+        case SIZE_LOG: {
+            double low = log((double) config.min_size);
+            double size = exp(low + next_double(state) * (log((double) config.max_size) - low));
+            return (size < config.max_size) ? (size_t) size : config.max_size;
+        }
+    }
+    return config.min_size;
+}
+
+/**
+ * @brief Estrae la prossima operazione secondo i pesi del mix
+ */
+static inline operation_t next_operation (unsigned long* state) {
+    long value = (long) (next_random(state) % config.total_weight);
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (value < config.weights[op]) return (operation_t) op;
+        value -= config.weights[op];
+    }
+    return OP_RETRIEVE;
+}
+
+/**
+ * @brief Esegue un'operazione su un oggetto
+ * 
+ * @param bytes_ptr Puntatore in cui scrivere i byte inviati o ricevuti
+ * @return int 1 se l'operazione è riuscita. Se c'è un errore restituisce 0 e setta errno.
+ */
+static int run_operation (worker_t* worker, operation_t op, char* name, size_t* bytes_ptr) {
+    os_stat_t stat;
+    *bytes_ptr = 0;
+    switch (op) {
+        case OP_STORE:
+            *bytes_ptr = next_size(&worker->state);
+            return os_client_store(client, name, payload, *bytes_ptr);
+        case OP_RETRIEVE:
+            return os_client_retrieve_into(client, name, worker->buffer, config.max_size, bytes_ptr);
+        case OP_DELETE:
+            return os_client_delete(client, name);
+        case OP_STAT:
+            return os_client_stat(client, name, &stat);
+        default:
+            errno = EINVAL;
+            return 0;
+    }
+}
+
+/**
+ * @brief Corpo di un thread: memorizza la sua parte delle chiavi, aspetta gli altri ed esegue operazioni finché non viene fermato
+ */
+static void* worker_thread (void* arg) {
+    worker_t* worker = (worker_t*) arg;
+    char name[KEY_LENGTH];
+    // Le chiavi sono divise fra i thread a turno, così che all'inizio della misura esistano tutte
+    if (config.preload) {
+        for (long i = worker->id; i < config.keys; i += config.threads) {
+            key_name(i, name);
+            if (os_client_store(client, name, payload, next_size(&worker->state)) != 1) worker->operations[OP_STORE].errors++;
+        }
+    }
+    pthread_barrier_wait(&start_barrier);
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        operation_t op = next_operation(&worker->state);
+        key_name(next_key(&worker->state), name);
+        operation_stats_t* stats = &worker->operations[op];
+        size_t bytes;
+        unsigned long start = now_ns();
+        int success = run_operation(worker, op, name, &bytes);
+        histogram_record(&stats->latency, now_ns() - start);
+        if (success == 1) stats->bytes += bytes;
+        else if (errno == ENOENT) stats->misses++;
+        else stats->errors++;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Cancella tutti gli oggetti che il carico può aver creato
+ */
+static void remove_keys () {
+    char name[KEY_LENGTH];
+    for (long i = 0; i < config.keys; i++) {
+        key_name(i, name);
+        os_client_delete(client, name);
+    }
+}
+
+/**
+ * @brief Somma i risultati di un tipo di operazione a quelli di destination
+ */
+static void add_stats (operation_stats_t* destination, operation_stats_t* stats) {
+    histogram_merge(&destination->latency, &stats->latency);
+    destination->bytes += stats->bytes;
+    destination->errors += stats->errors;
+    destination->misses += stats->misses;
+}
+
+/**
+ * @brief Stampa i risultati di un tipo di operazione come riga della tabella
+ */
+static void print_row (const char* name, operation_stats_t* stats, double seconds) {
+    histogram_t* latency = &stats->latency;
+    printf("%-9s %10lu %10.1f %9.2f %9.1f %9.1f %9.1f %9.1f %9.1f %7lu %7lu\n", name, latency->count,
+        latency->count / seconds, stats->bytes / seconds / 1e6, histogram_mean(latency) / 1e3,
+        histogram_percentile(latency, 50) / 1e3, histogram_percentile(latency, 99) / 1e3,
+        histogram_percentile(latency, 99.9) / 1e3, latency->max / 1e3, stats->errors, stats->misses);
+}
+
+/**
+ * @brief Stampa i risultati di un tipo di operazione come oggetto JSON
+ */
+static void print_json_operation (const char* name, operation_stats_t* stats, double seconds, int last) {
+    histogram_t* latency = &stats->latency;
+    printf("    \"%s\": {\"ops\": %lu, \"ops_per_s\": %.1f, \"bytes\": %lu, \"mb_per_s\": %.3f, \"errors\": %lu, \"misses\": %lu, "
+        "\"latency_us\": {\"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}}%s\n",
+        name, latency->count, latency->count / seconds, stats->bytes, stats->bytes / seconds / 1e6, stats->errors,
+        stats->misses, histogram_mean(latency) / 1e3, histogram_percentile(latency, 50) / 1e3,
+        histogram_percentile(latency, 99) / 1e3, histogram_percentile(latency, 99.9) / 1e3, latency->max / 1e3,
+        last ? "" : ",");
+}
+
+/**
+ * @brief Stampa i risultati uniti di tutti i thread, per tipo di operazione e in totale
+ */
+static void print_results (operation_stats_t* operations, operation_stats_t* total, double seconds) {
+    if (config.json) {
+        printf("{\n  \"config\": {\"user\": \"%s\", \"connections\": %d, \"threads\": %d, \"mix\": {", config.user,
+            config.connections, config.threads);
+        for (int op = 0; op < OP_COUNT; op++)
+            printf("\"%s\": %ld%s", operation_names[op], config.weights[op], (op < OP_COUNT - 1) ? ", " : "");
+        printf("}, \"sizes\": {\"distribution\": \"%s\", \"min\": %zu, \"max\": %zu}, \"keys\": %ld, \"skew\": \"%s\", "
+            "\"duration_s\": %ld},\n", size_names[config.size_distribution], config.min_size, config.max_size, config.keys,
+            skew_names[config.skew], config.duration);
+        printf("  \"elapsed_s\": %.3f,\n  \"operations\": {\n", seconds);
+        for (int op = 0; op < OP_COUNT; op++)
+            if (config.weights[op] > 0) print_json_operation(operation_names[op], &operations[op], seconds, 0);
+        print_json_operation("total", total, seconds, 1);
+        printf("  }\n}\n");
+        return;
+    }
+    printf("[loadgen] %d threads, %d connections, %.1f s, %ld keys (%s), sizes %s %zu-%zu\n", config.threads,
+        config.connections, seconds, config.keys, skew_names[config.skew], size_names[config.size_distribution],
+        config.min_size, config.max_size);
+    printf("%-9s %10s %10s %9s %9s %9s %9s %9s %9s %7s %7s\n",
+        "operation", "ops", "ops/s", "MB/s", "mean_us", "p50_us", "p99_us", "p99.9_us", "max_us", "errors", "misses");
+    for (int op = 0; op < OP_COUNT; op++)
+        if (config.weights[op] > 0) print_row(operation_names[op], &operations[op], seconds);
+    print_row("total", total, seconds);
+}
+
+/**
+ * @brief Esegue il carico con tutti i thread e ne stampa i risultati
+ * 
+ * @return int Se il carico è stato eseguito restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int run_load () {
+    worker_t* workers = (worker_t*) calloc(config.threads, sizeof(worker_t));
+    operation_stats_t* operations = (operation_stats_t*) calloc(OP_COUNT + 1, sizeof(operation_stats_t));
+    pthread_t tids[config.threads];
+    int created = 0;
+    int success = -1;
+    ASSERT((workers != NULL) && (operations != NULL), errno = ENOMEM; goto cleanup);
+    for (int t = 0; t < config.threads; t++) {
+        workers[t].id = t;
+        workers[t].state = 0x9E3779B97F4A7C15UL * (t + 1);
+        workers[t].buffer = (char*) malloc(config.max_size);
+        ASSERT(workers[t].buffer != NULL, errno = ENOMEM; goto cleanup);
+    }
+    ASSERT_ERRNO(pthread_barrier_init(&start_barrier, NULL, config.threads + 1) == 0, ENOMEM, goto cleanup);
+    for (; created < config.threads; created++)
+        if (pthread_create(&tids[created], NULL, worker_thread, &workers[created]) != 0) break;
+    // Senza tutti i thread la barriera non si aprirebbe mai
+    ASSERT(created == config.threads, fprintf(stderr, "[loadgen] Could not create %d threads\n", config.threads); exit(1));
+    pthread_barrier_wait(&start_barrier);
+    unsigned long start = now_ns();
+    struct timespec duration = { config.duration, 0 };
+    while (nanosleep(&duration, &duration) == -1 && errno == EINTR);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (int t = 0; t < config.threads; t++)
+        pthread_join(tids[t], NULL);
+    double seconds = (now_ns() - start) / 1e9;
+    pthread_barrier_destroy(&start_barrier);
+    // Unisce i risultati dei thread, l'ultimo elemento è il totale
+    operation_stats_t* total = &operations[OP_COUNT];
+    for (int t = 0; t < config.threads; t++)
+        for (int op = 0; op < OP_COUNT; op++) {
+            add_stats(&operations[op], &workers[t].operations[op]);
+            add_stats(total, &workers[t].operations[op]);
+        }
+    print_results(operations, total, seconds);
+    success = 0;
+cleanup:
+    if (workers != NULL)
+        for (int t = 0; t < config.threads; t++)
+            free(workers[t].buffer);
+    free(workers);
+    free(operations);
+    return success;
+}
+
+/**
+ * @brief Legge il mix di operazioni, della forma "store=20,retrieve=75,delete=5"
+ * 
+ * @return int Se il mix è valido restituisce 0, altrimenti -1.
+ */
+static int parse_mix (char* string) {
+    char* save;
+    memset(config.weights, 0, sizeof(config.weights));
+    config.total_weight = 0;
+    for (char* token = strtok_r(string, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+        char* value = strchr(token, '=');
+        ASSERT_RETURN(value != NULL, -1);
+        *(value++) = '\0';
+        int found = 0;
+        for (int op = 0; op < OP_COUNT; op++)
+            if (strcmp(token, operation_names[op]) == 0) {
+                char* end;
+                config.weights[op] = strtol(value, &end, 10);
+                ASSERT_RETURN((*end == '\0') && (config.weights[op] >= 0), -1);
+                found = 1;
+            }
+        ASSERT_RETURN(found, -1);
+    }
+    for (int op = 0; op < OP_COUNT; op++)
+        config.total_weight += config.weights[op];
+    return (config.total_weight > 0) ? 0 : -1;
+}
+
+/**
+ * @brief Legge la distribuzione delle dimensioni, della forma "fixed:SIZE", "uniform:MIN:MAX" o "log:MIN:MAX"
+ * 
+ * @return int Se la distribuzione è valida restituisce 0, altrimenti -1.
+ */
+static int parse_sizes (char* string) {
+    char kind[16];
+    long min = 0, max = 0;
+    int fields = sscanf(string, "%15[a-z]:%ld:%ld", kind, &min, &max);
+    ASSERT_RETURN(fields >= 2, -1);
+    int found = 0;
+    for (int d = SIZE_FIXED; d <= SIZE_LOG; d++)
+        if (strcmp(kind, size_names[d]) == 0) { config.size_distribution = (size_distribution_t) d; found = 1; }
+    ASSERT_RETURN(found, -1);
+    if (config.size_distribution == SIZE_FIXED) max = min;
+    else ASSERT_RETURN(fields == 3, -1);
+    ASSERT_RETURN((min > 0) && (max >= min), -1);
+    config.min_size = (size_t) min;
+    config.max_size = (size_t) max;
+    return 0;
+}
+
+static void usage (char* name) {
+    fprintf(stderr, "Usage: %s [-u USER] [-c CONNECTIONS] [-t THREADS] [-m MIX] [-s SIZES] [-k KEYS] [-z SKEW] [-d SECONDS] [-P] [-r] [-j]\n"
+        "  -u  user name (default " DEFAULT_USER ")\n"
+        "  -c  connections of the client pool (default %d)\n"
+        "  -t  threads issuing operations (default %d)\n"
+        "  -m  operation weights among store, retrieve, delete, stat (default " DEFAULT_MIX ")\n"
+        "  -s  object sizes as fixed:SIZE, uniform:MIN:MAX or log:MIN:MAX (default " DEFAULT_SIZES ")\n"
+        "  -k  number of distinct objects (default %d)\n"
+        "  -z  key skew, uniform or zipf (default " DEFAULT_SKEW ")\n"
+        "  -d  duration in seconds (default %d)\n"
+        "  -P  do not store every object before the measurement\n"
+        "  -r  retain the objects at the end instead of deleting them\n"
+        "  -j  print JSON instead of a table\n", name, DEFAULT_CONNECTIONS, DEFAULT_THREADS, DEFAULT_KEYS, DEFAULT_DURATION);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    char mix_string[256] = DEFAULT_MIX;
+    char sizes_string[256] = DEFAULT_SIZES;
+    char skew_string[16] = DEFAULT_SKEW;
+    config.user = DEFAULT_USER;
+    config.connections = DEFAULT_CONNECTIONS;
+    config.threads = DEFAULT_THREADS;
+    config.keys = DEFAULT_KEYS;
+    config.duration = DEFAULT_DURATION;
+    config.preload = 1;
+    int option;
+    while ((option = getopt(argc, argv, "u:c:t:m:s:k:z:d:Prjh")) != -1) {
+        switch (option) {
+            case 'u': config.user = optarg; break;
+            case 'c': config.connections = (int) strtol(optarg, NULL, 10); break;
+            case 't': config.threads = (int) strtol(optarg, NULL, 10); break;
+            case 'm': snprintf(mix_string, sizeof(mix_string), "%s", optarg); break;
+            case 's': snprintf(sizes_string, sizeof(sizes_string), "%s", optarg); break;
+            case 'k': config.keys = strtol(optarg, NULL, 10); break;
+            case 'z': snprintf(skew_string, sizeof(skew_string), "%s", optarg); break;
+            case 'd': config.duration = strtol(optarg, NULL, 10); break;
+            case 'P': config.preload = 0; break;
+            case 'r': config.retain = 1; break;
+            case 'j': config.json = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if ((config.connections <= 0) || (config.threads <= 0) || (config.keys <= 0) || (config.duration <= 0)) usage(argv[0]);
+    if ((parse_mix(mix_string) == -1) || (parse_sizes(sizes_string) == -1)) usage(argv[0]);
+    if (strcmp(skew_string, skew_names[SKEW_ZIPF]) == 0) config.skew = SKEW_ZIPF;
+    else if (strcmp(skew_string, skew_names[SKEW_UNIFORM]) == 0) config.skew = SKEW_UNIFORM;
+    else usage(argv[0]);
+    if (config.skew == SKEW_ZIPF) init_zipf(&zipf, config.keys, ZIPF_THETA);
+    // Tutti gli oggetti memorizzati sono prefissi dello stesso blocco di dati
+    payload = (char*) malloc(config.max_size);
+    ASSERT(payload != NULL, perror("[loadgen] Allocating payload"); return 1);
+    for (size_t i = 0; i < config.max_size; i++) payload[i] = (char) i;
+    client = os_client_create(config.user, config.connections);
+    ASSERT(client != NULL, perror("[loadgen] Connecting to server"); free(payload); return 1);
+    int error = 0;
+    ASSERT(run_load() == 0, perror("[loadgen] Running load"); error = 1);
+    if (!config.retain) remove_keys();
+    ASSERT(os_client_destroy(client) == 1, perror("[loadgen] Disconnecting"); error = 1);
+    free(payload);
+    return error;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file migrate.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Strumento che migra le cartelle degli utenti dal layout piatto al layout a fanout.
+ * Può essere eseguito mentre il server è in funzione.
+ * 
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ * 
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <assertmacros.h>
+#include <shared.h>
+
+#include <workers/layout.h>
+
+/**
+ * @brief Migra la cartella di un utente, ripetendo la scansione finché non restano oggetti da spostare
+ * (una scansione concorrente alle modifiche del server potrebbe saltare qualche elemento).
+ * 
+ * @param data_fd File descriptor della cartella dati
+ * @param user Nome dell'utente
+ * @return int Se la migrazione è andata a buon fine restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int migrate_user (int data_fd, char* user) {
+    int dir_fd = openat(data_fd, user, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT_RETURN(dir_fd != -1, -1);
+    int total = 0;
+    int moved;
+    while ((moved = migrate_directory(dir_fd)) > 0)
+        total += moved;
+    close(dir_fd);
+    ASSERT_RETURN(moved != -1, -1);
+    printf("[migrate] %s: %d objects moved\n", user, total);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if ((argc > 1) && (EQUALS(argv[1], "-h") || EQUALS(argv[1], "--help"))) {
+        fprintf(stderr, "Usage: %s [<USER_NAME> ...]\n", argv[0]);
+        exit(1);
+    }
+    // Apre la cartella dati
+    int data_fd = open(DATA_DIRECTORY, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT_MESSAGE(data_fd != -1, "[migrate] Opening data directory", exit(1));
+    int errors = 0;
+    // Se sono stati passati degli utenti migra solo quelli
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++)
+            ASSERT(migrate_user(data_fd, argv[i]) != -1, fprintf(stderr, "[migrate] %s: %s\n", argv[i], strerror(errno)); errors++);
+    }
+    // Altrimenti migra tutte le cartelle contenute nella cartella dati
+    else {
+        DIR* dir = opendir(DATA_DIRECTORY);
+        ASSERT_MESSAGE(dir != NULL, "[migrate] Listing data directory", exit(1));
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            struct stat sb;
+            if (entry->d_name[0] == '.') continue;
+            if ((fstatat(data_fd, entry->d_name, &sb, 0) == -1) || !S_ISDIR(sb.st_mode)) continue;
+            ASSERT(migrate_user(data_fd, entry->d_name) != -1, fprintf(stderr, "[migrate] %s: %s\n", entry->d_name, strerror(errno)); errors++);
+        }
+        closedir(dir);
+    }
+    close(data_fd);
+    return (errors > 0);
+}
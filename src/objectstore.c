@@ -7,13 +7,15 @@
  * 
  */
 
-#define _POSIX_C_SOURCE 199506L
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include <pthread.h>
 #include <sys/select.h>
@@ -23,7 +25,11 @@
 #include <shared.h>
 
 #include <socket/socket.h>
+#include <arena/arena.h>
+#include <pool/pool.h>
+#include <metrics/metrics.h>
 #include <workers/workers.h>
+#include <workers/direct_io.h>
 #include <pthread_list/pthread_list.h>
 
 #include <shared.h>
@@ -31,6 +37,39 @@
 // Variabile globale che indica la terminazione
 static int terminated = 0;
 
+// Connessioni aperte e istante di avvio del server, riportati da STATS
+static int open_connections = 0;
+static unsigned long start_time = 0;
+
+// Coda in cui i thread di connessione si inseriscono quando terminano, svuotata dal loop di accettazione
+static pthread_queue_t thread_queue;
+
+/**
+ * @brief Argomento di un thread di connessione
+ */
+typedef struct connection {
+    // File descriptor del client
+    int client_fd;
+    // Nodo con cui il thread si inserisce nella coda di completamento, allocato prima di crearlo
+    pthread_list_t* node;
+} connection_t;
+
+/**
+ * @brief Invia una risposta al client, contandone il tempo e i byte nella fase di rete della richiesta corrente
+ * 
+ * @param client_fd File descriptor del client
+ * @param message Messaggio da inviare
+ * @param size Dimensione del messaggio
+ * @return int Se l'invio è avvenuto con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int send_response (int client_fd, void* message, size_t size) {
+    unsigned long start = metrics_clock();
+    int success = send_message(client_fd, message, size);
+    metrics_phase(METRICS_NETWORK, start);
+    metrics_bytes(0, size);
+    return success;
+}
+
 /**
  * @brief Invia al client il messaggio 'KO <errno>'
  * 
@@ -42,15 +81,20 @@ void send_error (int client_fd) {
     memset(err_buffer, 0, MAX_RESPONSE_LENGTH);
     // Costruisce la stringa formattata
     sprintf(err_buffer, "KO %d \n", errno);
+    metrics_error();
     // Scrive la stringa sul buffer
-    int success = send_message(client_fd, err_buffer, MAX_RESPONSE_LENGTH);
+    int success = send_response(client_fd, err_buffer, MAX_RESPONSE_LENGTH);
     ASSERT_MESSAGE(success != -1, "Writing error message to client", return);
     // Stampa il messaggio anche sullo standard error
     fprintf(stderr, "[objectstore] Client %d: %s\n", client_fd, strerror(errno));
 }
 
+// Nomi delle fasi delle richieste nel report
+static const char* phase_names[] = { "Total", "Queueing", "Disk", "Network" };
+
 /**
- * @brief Stampa un report sullo standard output contenente client connessi, numero di oggetti e dimensione totale dello store
+ * @brief Stampa un report sullo standard output contenente client connessi, numero di oggetti e dimensione totale dello store,
+ * occupazione del pool di buffer e, per ogni verbo usato, contatori e percentili di latenza delle richieste
  */
 void print_report () {
     // Numero di client connessi
@@ -64,6 +108,28 @@ void print_report () {
     ASSERT_MESSAGE(success != -1, "Retrieving client", return);
     // Stampa le informazioni
     printf("[objectstore] Connected clients: %d Object number: %d Total size: %d bytes\n", clients, objects, size);
+    // Stampa l'occupazione del pool di buffer e la percentuale di richieste servite senza allocare
+    pool_stats_t stats;
+    pool_stats(&stats);
+    unsigned long requests = stats.hits + stats.misses;
+    printf("[objectstore] Buffer pool: Hit rate: %lu%% Retained: %zu bytes In use: %zu bytes Dropped: %lu\n",
+        requests ? (stats.hits * 100) / requests : 0, stats.retained, stats.outstanding, stats.dropped);
+    // Stampa le misure dei verbi usati, sommando i record dei thread
+    verb_metrics_t* verbs = metrics_collect();
+    ASSERT_MESSAGE(verbs != NULL, "Collecting metrics", return);
+    for (int verb = 0; verb < METRICS_VERBS; verb++) {
+        if (verbs[verb].requests == 0) continue;
+        printf("[objectstore] %s: Requests: %lu Errors: %lu Received: %lu bytes Sent: %lu bytes\n", metrics_verb_name(verb),
+            verbs[verb].requests, verbs[verb].errors, verbs[verb].bytes_in, verbs[verb].bytes_out);
+        printf("[objectstore] %s: Latency p50/p99/p99.9/max (us):", metrics_verb_name(verb));
+        for (int phase = 0; phase < METRICS_PHASES; phase++) {
+            histogram_t* latency = &verbs[verb].latency[phase];
+            printf(" %s %.1f/%.1f/%.1f/%.1f", phase_names[phase], histogram_percentile(latency, 50) / 1e3,
+                histogram_percentile(latency, 99) / 1e3, histogram_percentile(latency, 99.9) / 1e3, latency->max / 1e3);
+        }
+        printf("\n");
+    }
+    free(verbs);
 }
 
 /**
@@ -74,7 +140,7 @@ void print_report () {
 void send_ok (int client_fd) {
     // Crea la stringa con scritto ok
     char ok_string[MAX_RESPONSE_LENGTH] = "OK \n";
-    int success = send_message(client_fd, ok_string, MAX_RESPONSE_LENGTH);
+    int success = send_response(client_fd, ok_string, MAX_RESPONSE_LENGTH);
     ASSERT(success != -1, send_error(client_fd));
 }
 
@@ -82,14 +148,20 @@ void send_ok (int client_fd) {
  * @brief Registra un utente sul server
  * 
  * @param client_fd File descriptor del server
+ * @param session_ptr Puntatore alla sessione della connessione, settata se la registrazione ha successo
  * @param name Nome con cui registrarsi
+ * @param arena Arena della connessione
  * @return int Se la registrazione è avvenuta con successo invia OK all'utente e restitusice 0. Se c'è un errore restituisce -1 e setta errno.
  */
-int handle_registration (int client_fd, char* name) {
+int handle_registration (int client_fd, session_t** session_ptr, char* name, arena_t* arena) {
+    // Un client può registrarsi una sola volta per connessione
+    ASSERT_ERRNO_RETURN(*session_ptr == NULL, EALREADY, -1);
     // Registra l'utente nel sistema
-    int success = register_user(client_fd, name);
+    unsigned long start = metrics_clock();
+    *session_ptr = register_user(client_fd, name, arena);
+    metrics_phase(METRICS_DISK, start);
     // Controlla che sia andato tutto bene
-    ASSERT_RETURN(success == 0, -1);
+    ASSERT_RETURN(*session_ptr != NULL, -1);
     // Restituisce il successo
     send_ok(client_fd);
     return 0;
@@ -99,12 +171,15 @@ int handle_registration (int client_fd, char* name) {
  * @brief Rimuove dallo store un blocco
  * 
  * @param client_fd File descriptor del client
+ * @param session Sessione del client
  * @param name Nome del blocco da rimuovere
  * @return int Se l'eliminazione è avvenuta con successo restituisce OK all'utente e restituisce 0. Se c'è un errore restituisce -1 e setta errno.
  */
-int handle_deletion (int client_fd, char* name) {
-    // Rimuove l'utente dal sistema
-    int success = delete_block(client_fd, name);
+int handle_deletion (int client_fd, session_t* session, char* name) {
+    // Rimuove il blocco dal sistema
+    unsigned long start = metrics_clock();
+    int success = delete_block(session, name);
+    metrics_phase(METRICS_DISK, start);
     // Controlla che l'operazione sia avvenuta con successo
     ASSERT_RETURN(success == 0, -1);
     // Restituisce il successo
@@ -112,73 +187,460 @@ int handle_deletion (int client_fd, char* name) {
     return 0;
 }
 
+/**
+ * @brief Riceve dal client i dati che seguono un header, allocandoli nell'arena della connessione
+ * 
+ * @param reader Lettore bufferizzato della connessione
+ * @param arena Arena della connessione
+ * @param length Numero di byte da ricevere
+ * @param extra Numero di byte da lasciare liberi in fondo al buffer
+ * @return void* Dati ricevuti, validi fino alla fine della richiesta. Se c'è un errore restituisce NULL e setta errno
+ * (EMSGSIZE se length supera MAX_PAYLOAD_LENGTH, nel qual caso i dati non vengono letti).
+ */
+static void* receive_payload (socket_reader_t* reader, arena_t* arena, size_t length, size_t extra) {
+    ASSERT_ERRNO_RETURN(length > 0, EINVAL, NULL);
+    ASSERT_ERRNO_RETURN(length <= MAX_PAYLOAD_LENGTH, EMSGSIZE, NULL);
+    void* data = arena_alloc(arena, length + extra);
+    ASSERT_RETURN(data != NULL, NULL);
+    unsigned long start = metrics_clock();
+    int success = receive_buffered_into(reader, data, length);
+    metrics_phase(METRICS_NETWORK, start);
+    ASSERT_RETURN(success != -1, NULL);
+    metrics_bytes(length, 0);
+    return data;
+}
+
+/**
+ * @brief Consuma e scarta i dati che seguono un header rifiutato, a blocchi in un buffer di dimensione fissa, così
+ * che la connessione resti allineata al messaggio successivo
+ * 
+ * @param reader Lettore bufferizzato della connessione
+ * @param length Numero di byte da scartare
+ * @return int Se i dati sono stati scartati restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int discard_payload (socket_reader_t* reader, size_t length) {
+    char buffer[4096];
+    while (length > 0) {
+        size_t chunk = (length < sizeof(buffer)) ? length : sizeof(buffer);
+        ASSERT_RETURN(receive_buffered_into(reader, buffer, chunk) != -1, -1);
+        length -= chunk;
+    }
+    return 0;
+}
+
+/**
+ * @brief Legge una condizione "<keyword> <tag>" in un header, dove tag è la versione di un oggetto in TAG_LENGTH cifre esadecimali
+ * 
+ * @param condition Parte dell'header che segue gli argomenti del comando
+ * @param keyword Parola chiave che introduce la condizione
+ * @param version_ptr Puntatore in cui scrivere la versione letta dal tag
+ * @return int 1 se la condizione è presente, 0 se l'header non contiene condizioni. Se la condizione non è valida restituisce -1 e setta errno.
+ */
+static int parse_condition (char* condition, char* keyword, unsigned long* version_ptr) {
+    char found[16] = "";
+    char tag[TAG_LENGTH + 2] = "";
+    if (sscanf(condition, "%15s %17s", found, tag) < 1) return 0;
+    ASSERT_ERRNO_RETURN(EQUALS(found, keyword) && (strlen(tag) == TAG_LENGTH), EINVAL, -1);
+    // Il tag deve essere composto solo da cifre esadecimali minuscole, come quelle inviate dal server: strtoul da sola
+    // accetterebbe anche spazi iniziali, un segno o un prefisso "0x"
+    ASSERT_ERRNO_RETURN(strspn(tag, "0123456789abcdef") == TAG_LENGTH, EINVAL, -1);
+    *version_ptr = strtoul(tag, NULL, 16);
+    return 1;
+}
+
+/**
+ * @brief Restituisce il puntatore alla parte dell'header che segue i primi count campi separati da spazi
+ * 
+ * @param header Header inviato dal client
+ * @param count Numero di campi da saltare
+ * @return char* Resto dell'header
+ */
+static char* skip_fields (char* header, int count) {
+    for (int i = 0; i < count; i++) {
+        while (*header == ' ') header++;
+        while (*header && (*header != ' ') && (*header != '\n')) header++;
+    }
+    return header;
+}
+
 /**
  * @brief Memorizza un oggetto nello spazio dell'utente
  * 
  * @param client_fd File descriptor del client
+ * @param reader Lettore bufferizzato della connessione
+ * @param session Sessione del client
  * @param name Nome dell'oggetto da memorizzare
  * @param length Dimensione dell'oggetto
+ * @param header Header inviato dal client, che può terminare con la condizione "IF-MATCH <tag>"
+ * @param arena Arena della connessione, in cui ricevere i dati
  * @return int Se la memorizzazione è avvenuta con successo manda OK al client e restituisce 0. Se c'è un errore restituisce -1 e setta errno.
  */
-int handle_storing (int client_fd, char* name, size_t length) {
-    // Legge i dati
-    void* data = receive_message(client_fd, length);
+int handle_storing (int client_fd, socket_reader_t* reader, session_t* session, char* name, size_t length, char* header, arena_t* arena) {
+    // Legge i dati, che vanno consumati anche se la condizione non è valida
+    void* data = receive_payload(reader, arena, length, 0);
     ASSERT_RETURN(data != NULL, -1);
+    // Legge l'eventuale versione attesa
+    unsigned long version;
+    int conditional = parse_condition(skip_fields(header, 3), "IF-MATCH", &version);
+    ASSERT_RETURN(conditional != -1, -1);
     // Scrive i dati sul disco
-    int success = store_block(client_fd, name, data, length);
+    unsigned long start = metrics_clock();
+    int success = store_block(session, name, data, length, conditional ? &version : NULL);
+    metrics_phase(METRICS_DISK, start);
     ASSERT_RETURN(success != -1, -1);
-    free(data);
     // Invia l'ok
     send_ok(client_fd);
     return 0;
 }
 
 /**
- * @brief Recupera un blocco di dati dell'utente identificato dal nome
+ * @brief Accoda dei dati in fondo a un oggetto dell'utente
  * 
- * @param client_fd File descriptor dell'utente
- * @param name Nome del blocco da reperire
- * @return int Se l'oggetto è stato ritrovato con successo invia OK al client e restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ * @param client_fd File descriptor del client
+ * @param reader Lettore bufferizzato della connessione
+ * @param session Sessione del client
+ * @param name Nome dell'oggetto da estendere
+ * @param length Dimensione dei dati da accodare
+ * @param arena Arena della connessione, in cui ricevere i dati
+ * @return int Se l'aggiunta è avvenuta con successo manda OK al client e restituisce 0. Se c'è un errore restituisce -1 e setta errno.
  */
-int handle_retrieving (int client_fd, char* name) {
+int handle_appending (int client_fd, socket_reader_t* reader, session_t* session, char* name, size_t length, arena_t* arena) {
+    // Legge i dati
+    void* data = receive_payload(reader, arena, length, 0);
+    ASSERT_RETURN(data != NULL, -1);
+    // Accoda i dati sul disco
+    unsigned long start = metrics_clock();
+    int success = append_block(session, name, data, length);
+    metrics_phase(METRICS_DISK, start);
+    ASSERT_RETURN(success != -1, -1);
+    // Invia l'ok
+    send_ok(client_fd);
+    return 0;
+}
+
+/**
+ * @brief Invia al client una risposta con dati: l'header "DATA <size> [<tag>] \n " seguito dal blocco,
+ * oppure l'header "KO <errno> \n " se il blocco è NULL.
+ * 
+ * @param client_fd File descriptor del client
+ * @param block Blocco da inviare, NULL se l'operazione che doveva produrlo è fallita
+ * @param size Dimensione del blocco
+ * @param info Se non è NULL l'header contiene il tag della versione del blocco
+ * @return int Se l'invio è avvenuto con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int send_data (int client_fd, void* block, size_t size, object_info_t* info) {
     // Alloca l'header del messaggio
     char response[MAX_DATA_LENGTH];
     memset(response, 0, MAX_DATA_LENGTH);
-    // Successo dell'invio
-    int success = 0;
-    // Recupera il blocco
-    size_t size;
-    void* block = retrieve_block(client_fd, name, &size);
     // Se c'è un errore costruisce la stringa apposita
     if (block == NULL) {
         sprintf(response, "KO %d \n", errno);
+        metrics_error();
         printf("[objectstore] Client %d: %s\n", client_fd, strerror(errno));
     }
     // Altrimenti costruisce l'header della risposta
+    else if (info) sprintf(response, "DATA %zu %0*lx \n ", size, TAG_LENGTH, info->version);
     else sprintf(response, "DATA %zu \n ", size);
     // Invia l'header
-    success = send_message(client_fd, response, sizeof(char) * MAX_DATA_LENGTH);
+    int success = send_response(client_fd, response, sizeof(char) * MAX_DATA_LENGTH);
     ASSERT_RETURN(success != -1, -1);
-    // Invia il blocco se esiste
-    if (block) {
-        success = send_message(client_fd, block, size);
+    // Invia il blocco se esiste e non è vuoto
+    if (block && (size > 0)) {
+        success = send_response(client_fd, block, size);
         ASSERT_RETURN(success != -1, -1);
     }
-    // Libera la memoria occupata dal blocco
-    free(block);
-    // Restituisce il flag del successo
     return 0;
 }
 
 /**
- * @brief Termina la connessione con un client
+ * @brief Recupera un blocco di dati dell'utente identificato dal nome
+ * 
+ * @param client_fd File descriptor dell'utente
+ * @param session Sessione dell'utente
+ * @param name Nome del blocco da reperire
+ * @param header Header inviato dal client, che può terminare con la condizione "IF-NONE-MATCH <tag>"
+ * @return int Se l'oggetto è stato ritrovato con successo invia OK al client e restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int handle_retrieving (int client_fd, session_t* session, char* name, char* header) {
+    // Legge l'eventuale versione già posseduta dal client
+    unsigned long version;
+    int conditional = parse_condition(skip_fields(header, 2), "IF-NONE-MATCH", &version);
+    // Recupera il blocco
+    size_t size = 0;
+    object_info_t info;
+    unsigned long start = metrics_clock();
+    void* block = (conditional != -1) ? retrieve_block(session, name, &size, &info, conditional ? &version : NULL) : NULL;
+    metrics_phase(METRICS_DISK, start);
+    // Se il client ha già la versione attuale risponde senza inviare i dati
+    if ((block == NULL) && conditional && (errno == EALREADY)) {
+        char response[MAX_DATA_LENGTH];
+        memset(response, 0, MAX_DATA_LENGTH);
+        sprintf(response, "NOT-MODIFIED %0*lx \n", TAG_LENGTH, version);
+        return send_response(client_fd, response, sizeof(char) * MAX_DATA_LENGTH);
+    }
+    // Invia il blocco o l'errore. Il blocco è nell'arena della connessione, che viene azzerata alla fine della richiesta
+    return send_data(client_fd, block, size, &info);
+}
+
+/**
+ * @brief Invia al client i metadati di un oggetto nella forma "STAT <size> <mtime> <tag> \n",
+ * oppure "KO <errno> \n" nello stesso spazio se l'oggetto non esiste.
+ * 
+ * @param client_fd File descriptor dell'utente
+ * @param session Sessione dell'utente
+ * @param name Nome dell'oggetto
+ * @return int Se la risposta è stata inviata con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int handle_stat (int client_fd, session_t* session, char* name) {
+    char response[MAX_STAT_LENGTH];
+    memset(response, 0, MAX_STAT_LENGTH);
+    // Legge i metadati dall'indice
+    object_info_t info;
+    unsigned long start = metrics_clock();
+    int success = stat_block(session, name, &info);
+    metrics_phase(METRICS_DISK, start);
+    if (success == 0)
+        sprintf(response, "STAT %zu %ld %0*lx \n", info.size, info.mtime, TAG_LENGTH, info.version);
+    else {
+        sprintf(response, "KO %d \n", errno);
+        metrics_error();
+        printf("[objectstore] Client %d: %s\n", client_fd, strerror(errno));
+    }
+    return send_response(client_fd, response, sizeof(char) * MAX_STAT_LENGTH);
+}
+
+/**
+ * @brief Elenca i nomi degli oggetti dell'utente, a partire da un header "LIST <prefix> [<start_after>] [<limit>] \n"
+ * in cui un nome vuoto è indicato da EMPTY_NAME.
+ * 
+ * @param client_fd File descriptor dell'utente
+ * @param session Sessione dell'utente
+ * @param header Header inviato dal client
+ * @return int Se l'elenco è stato inviato con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int handle_listing (int client_fd, session_t* session, char* header) {
+    // Prefisso, nome da cui riprendere e numero massimo di nomi
+    char prefix[256] = "";
+    char start_after[256] = "";
+    int limit = LIST_DEFAULT_LIMIT;
+    // I parametri dopo il prefisso sono opzionali
+    sscanf(header, "%*s %255s %255s %d", prefix, start_after, &limit);
+    if (EQUALS(prefix, EMPTY_NAME)) prefix[0] = '\0';
+    if (EQUALS(start_after, EMPTY_NAME)) start_after[0] = '\0';
+    // Legge l'elenco dall'indice
+    size_t size = 0;
+    unsigned long start = metrics_clock();
+    char* list = list_blocks(session, prefix, start_after, limit, &size);
+    metrics_phase(METRICS_DISK, start);
+    // Invia l'elenco o l'errore
+    int success = send_data(client_fd, list, size, NULL);
+    free(list);
+    return success;
+}
+
+/**
+ * @brief Avvia la lettura anticipata di un insieme di oggetti, a partire da un header "PREFETCH <length> \n"
+ * seguito da length byte di nomi separati da '\n'.
+ * 
+ * @param client_fd File descriptor dell'utente
+ * @param reader Lettore bufferizzato della connessione
+ * @param session Sessione dell'utente
+ * @param header Header inviato dal client
+ * @param arena Arena della connessione, in cui ricevere i nomi
+ * @return int Se la richiesta è stata accettata manda OK al client e restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int handle_prefetching (int client_fd, socket_reader_t* reader, session_t* session, char* header, arena_t* arena) {
+    // Legge la lunghezza dell'elenco di nomi
+    size_t length = 0;
+    sscanf(header, "%*s %zu", &length);
+    // Un elenco più lungo di PREFETCH_MAX_LENGTH viene rifiutato senza allocarlo, consumandone i dati
+    if (length > PREFETCH_MAX_LENGTH) {
+        ASSERT_ERRNO_RETURN(length <= MAX_PAYLOAD_LENGTH, EMSGSIZE, -1);
+        ASSERT_RETURN(discard_payload(reader, length) != -1, -1);
+        errno = EINVAL;
+        return -1;
+    }
+    // Riceve i nomi lasciando spazio per il terminatore
+    char* names = receive_payload(reader, arena, length, 1);
+    ASSERT_RETURN(names != NULL, -1);
+    // Avvia la lettura anticipata, che non attende il disco
+    unsigned long start = metrics_clock();
+    int success = prefetch_blocks(session, names, length);
+    metrics_phase(METRICS_DISK, start);
+    ASSERT_RETURN(success != -1, -1);
+    // Invia l'ok
+    send_ok(client_fd);
+    return 0;
+}
+
+/**
+ * @brief Avvia un caricamento in più parti, a partire da un header "INITIATE <name> <size> \n". Risponde con
+ * "UPLOAD <id> \n", dove id è l'identificativo del caricamento in TAG_LENGTH cifre esadecimali, oppure con
+ * "KO <errno> \n" nello stesso spazio.
+ * 
+ * @param client_fd File descriptor dell'utente
+ * @param session Sessione dell'utente
+ * @param name Nome dell'oggetto da caricare
+ * @param size Dimensione finale dell'oggetto
+ * @return int Se la risposta è stata inviata con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int handle_initiating (int client_fd, session_t* session, char* name, size_t size) {
+    char response[MAX_DATA_LENGTH];
+    memset(response, 0, MAX_DATA_LENGTH);
+    unsigned long id;
+    unsigned long start = metrics_clock();
+    int success = initiate_upload(session, name, size, &id);
+    metrics_phase(METRICS_DISK, start);
+    if (success == 0)
+        sprintf(response, "UPLOAD %0*lx \n", TAG_LENGTH, id);
+    else {
+        sprintf(response, "KO %d \n", errno);
+        metrics_error();
+        printf("[objectstore] Client %d: %s\n", client_fd, strerror(errno));
+    }
+    return send_response(client_fd, response, sizeof(char) * MAX_DATA_LENGTH);
+}
+
+/**
+ * @brief Riceve una parte di un caricamento, a partire da un header "PART <id> <offset> <length> \n" seguito da
+ * length byte di dati, e la scrive alla sua posizione nell'oggetto.
+ * 
+ * @param client_fd File descriptor dell'utente
+ * @param reader Lettore bufferizzato della connessione
+ * @param session Sessione dell'utente
+ * @param header Header inviato dal client
+ * @param arena Arena della connessione, in cui ricevere i dati
+ * @return int Se la parte è stata scritta manda OK al client e restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int handle_part (int client_fd, socket_reader_t* reader, session_t* session, char* header, arena_t* arena) {
+    unsigned long id = 0;
+    size_t offset = 0;
+    size_t length = 0;
+    sscanf(header, "%*s %lx %zu %zu", &id, &offset, &length);
+    // I dati di una parte troppo lunga non vengono letti, e la connessione viene chiusa
+    ASSERT_ERRNO_RETURN(length <= MAX_PART_LENGTH, EMSGSIZE, -1);
+    // Controlla la parte prima di allocarne i dati: se non può essere scritta vengono consumati e scartati
+    if (check_part(session, id, offset, length) == -1) {
+        int error = errno;
+        ASSERT_RETURN(discard_payload(reader, length) != -1, -1);
+        errno = error;
+        return -1;
+    }
+    void* data = receive_payload(reader, arena, length, 0);
+    ASSERT_RETURN(data != NULL, -1);
+    // Scrive la parte alla sua posizione
+    unsigned long start = metrics_clock();
+    int success = upload_part(session, id, offset, data, length);
+    metrics_phase(METRICS_DISK, start);
+    ASSERT_RETURN(success != -1, -1);
+    send_ok(client_fd);
+    return 0;
+}
+
+/**
+ * @brief Completa o interrompe un caricamento, a partire da un header "COMPLETE <id> \n" o "ABORT <id> \n"
+ * 
+ * @param client_fd File descriptor dell'utente
+ * @param session Sessione dell'utente
+ * @param header Header inviato dal client
+ * @param complete 1 per completare il caricamento, 0 per interromperlo
+ * @return int Se l'operazione è avvenuta con successo manda OK al client e restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int handle_finishing (int client_fd, session_t* session, char* header, int complete) {
+    unsigned long id = 0;
+    ASSERT_ERRNO_RETURN(sscanf(header, "%*s %lx", &id) == 1, EINVAL, -1);
+    unsigned long start = metrics_clock();
+    int success = complete ? complete_upload(session, id) : abort_upload(session, id);
+    metrics_phase(METRICS_DISK, start);
+    ASSERT_RETURN(success != -1, -1);
+    send_ok(client_fd);
+    return 0;
+}
+
+/**
+ * @brief Scrive le misure del server in un testo di righe "<nome> <valore>\n", con valori interi e latenze in nanosecondi.
+ * Un nome non cambia significato senza che cambi stats_version, e ne possono essere aggiunti di nuovi. I valori vengono
+ * letti senza fermare le richieste in corso: contatori e istogrammi dei thread vengono sommati mentre sono scritti,
+ * e l'indice viene letto con una lock in lettura per utente.
+ * 
+ * @param size_ptr Puntatore in cui scrivere la lunghezza del testo
+ * @return char* Testo da liberare con free. Se c'è un errore restituisce NULL e setta errno.
+ */
+static char* format_statistics (size_t* size_ptr) {
+    int clients = 0, users = 0, objects = 0;
+    size_t bytes = 0;
+    ASSERT_RETURN(get_totals(&clients, &users, &objects, &bytes) != -1, NULL);
+    pool_stats_t pool;
+    pool_stats(&pool);
+    verb_metrics_t* verbs = metrics_collect();
+    ASSERT_RETURN(verbs != NULL, NULL);
+    char* text = NULL;
+    FILE* stream = open_memstream(&text, size_ptr);
+    ASSERT(stream != NULL, free(verbs); return NULL);
+    fprintf(stream, "stats_version 1\n");
+    fprintf(stream, "uptime_seconds %lu\n", (metrics_clock() - start_time) / 1000000000UL);
+    fprintf(stream, "connections %d\n", __atomic_load_n(&open_connections, __ATOMIC_RELAXED));
+    fprintf(stream, "sessions %d\n", clients);
+    fprintf(stream, "requests_in_flight %d\n", metrics_in_flight());
+    fprintf(stream, "index_users %d\nindex_objects %d\nindex_bytes %zu\n", users, objects, bytes);
+    fprintf(stream, "prefetch_requests %lu\n", prefetch_count());
+    fprintf(stream, "pool_hits %lu\npool_misses %lu\npool_dropped %lu\npool_retained_bytes %zu\npool_in_use_bytes %zu\n",
+        pool.hits, pool.misses, pool.dropped, pool.retained, pool.outstanding);
+    // Tutti i verbi compaiono sempre, anche senza richieste, così che l'insieme dei nomi non dipenda dal carico
+    for (int verb = 0; verb < METRICS_VERBS; verb++) {
+        char name[16];
+        const char* upper = metrics_verb_name(verb);
+        size_t length = 0;
+        for (; (upper[length] != '\0') && (length < sizeof(name) - 1); length++)
+            name[length] = (char) tolower((unsigned char) upper[length]);
+        name[length] = '\0';
+        fprintf(stream, "verb_%s_requests %lu\nverb_%s_errors %lu\nverb_%s_bytes_in %lu\nverb_%s_bytes_out %lu\n", name,
+            verbs[verb].requests, name, verbs[verb].errors, name, verbs[verb].bytes_in, name, verbs[verb].bytes_out);
+        for (int phase = 0; phase < METRICS_PHASES; phase++) {
+            histogram_t* latency = &verbs[verb].latency[phase];
+            const char* phase_name = metrics_phase_name(phase);
+            fprintf(stream, "verb_%s_%s_mean_ns %lu\n", name, phase_name, (unsigned long) histogram_mean(latency));
+            fprintf(stream, "verb_%s_%s_p50_ns %lu\n", name, phase_name, histogram_percentile(latency, 50));
+            fprintf(stream, "verb_%s_%s_p99_ns %lu\n", name, phase_name, histogram_percentile(latency, 99));
+            fprintf(stream, "verb_%s_%s_p999_ns %lu\n", name, phase_name, histogram_percentile(latency, 99.9));
+            fprintf(stream, "verb_%s_%s_max_ns %lu\n", name, phase_name, latency->max);
+        }
+    }
+    free(verbs);
+    ASSERT_ERRNO(fclose(stream) == 0, ENOMEM, free(text); return NULL);
+    return text;
+}
+
+/**
+ * @brief Invia al client le misure del server, a partire da un header "STATS \n". La risposta è "DATA <size> \n "
+ * seguita dal testo di format_statistics. Non richiede la registrazione, così che un agente di monitoraggio possa
+ * leggere le misure senza creare un utente.
  * 
  * @param client_fd File descriptor del client
+ * @return int Se la risposta è stata inviata con successo restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+int handle_statistics (int client_fd) {
+    // Costruisce il testo delle misure
+    size_t size = 0;
+    char* text = format_statistics(&size);
+    // Invia il testo o l'errore
+    int success = send_data(client_fd, text, size, NULL);
+    free(text);
+    return success;
+}
+
+/**
+ * @brief Termina la connessione con un client
+ * 
+ * @param session_ptr Puntatore alla sessione del client, che viene invalidata
  * @return int 1.
  */
-int handle_leaving (int client_fd) {
+int handle_leaving (session_t** session_ptr) {
     // Elimina l'utente dal sistema
-    leave_client(client_fd);
+    unsigned long start = metrics_clock();
+    leave_client(*session_ptr);
+    metrics_phase(METRICS_DISK, start);
+    *session_ptr = NULL;
     // Restituisce il flag 1 che indica la terminazione della connessione
     return 1;
 }
@@ -213,36 +675,55 @@ void* signal_handler (void* ptr) {
  * @brief Gestisce una richiesta riconoscendo l'header come una concatenazione <verb> <name> [<length>]
  * 
  * @param client_fd File descriptor del client
+ * @param reader Lettore bufferizzato della connessione
+ * @param session_ptr Puntatore alla sessione della connessione
  * @param header Header inviato dal client
+ * @param arena Arena della connessione, da cui allocare la memoria che serve solo per la durata della richiesta
  * @return int 0 se la richiesta è stata gestita con successo, 1 se la richiesta è di terminazione. Se c'è un errore restituisce -1 e setta errno.
  */
-int parse_request (int client_fd, char* header) {
+int parse_request (int client_fd, socket_reader_t* reader, session_t** session_ptr, char* header, arena_t* arena) {
     // Verbo nell'header
-    char* verb = (char*) calloc(9, sizeof(char));
+    char verb[9] = "";
     // Nome nell'header
-    char* name = (char*) calloc(255, sizeof(char));
+    char name[256] = "";
     // Dimensione nell'header
     size_t length = 0;
     // Analizza la stringa di header estraendo le informazioni
-    sscanf(header, "%s %s %zu \n", verb, name, &length);
+    sscanf(header, "%8s %255s %zu \n", verb, name, &length);
     // Risultato della computazione
     int success;
     // Prima tenta di riconoscere i verbi che non necessitano di ulteriori letture o scritture
     if (EQUALS(verb, "REGISTER"))
-        success = handle_registration(client_fd, name);
+        success = handle_registration(client_fd, session_ptr, name, arena);
     else if (EQUALS(verb, "DELETE"))
-        success = handle_deletion(client_fd, name);
+        success = handle_deletion(client_fd, *session_ptr, name);
     // Dopodiché passa il controllo ai metodi che richiedono di leggere o scrivere ancora dal client
     else if (EQUALS(verb, "STORE"))
-        success = handle_storing(client_fd, name, length);
+        success = handle_storing(client_fd, reader, *session_ptr, name, length, header, arena);
+    else if (EQUALS(verb, "APPEND"))
+        success = handle_appending(client_fd, reader, *session_ptr, name, length, arena);
     else if (EQUALS(verb, "RETRIEVE"))
-        success = handle_retrieving(client_fd, name);
+        success = handle_retrieving(client_fd, *session_ptr, name, header);
+    else if (EQUALS(verb, "STAT"))
+        success = handle_stat(client_fd, *session_ptr, name);
+    else if (EQUALS(verb, "LIST"))
+        success = handle_listing(client_fd, *session_ptr, header);
+    else if (EQUALS(verb, "PREFETCH"))
+        success = handle_prefetching(client_fd, reader, *session_ptr, header, arena);
+    else if (EQUALS(verb, "INITIATE"))
+        success = handle_initiating(client_fd, *session_ptr, name, length);
+    else if (EQUALS(verb, "PART"))
+        success = handle_part(client_fd, reader, *session_ptr, header, arena);
+    else if (EQUALS(verb, "COMPLETE"))
+        success = handle_finishing(client_fd, *session_ptr, header, 1);
+    else if (EQUALS(verb, "ABORT"))
+        success = handle_finishing(client_fd, *session_ptr, header, 0);
+    else if (EQUALS(verb, "STATS"))
+        success = handle_statistics(client_fd);
     else if (EQUALS(verb, "LEAVE"))
-        success = handle_leaving(client_fd);
+        success = handle_leaving(session_ptr);
     // Se non ha trovato un verbo riconosciuto invia un errore
     else success = -1;
-    // Libera la memoria occupata dalle stringhe
-    free(verb); free(name);
     // Restituisce il flag restituito dai controller
     return success;
 }
@@ -250,41 +731,100 @@ int parse_request (int client_fd, char* header) {
 /**
  * @brief Legge un header dal client ed avvia la procedura associata. Se una delle procedure restituisce un errore lo invia al client.
  * 
- * @param ptr Puntatore != -1al file descriptor del client
- * @return void* Sempre NULL dato che la funzione non restituisce nulla
+ * @param client_fd File descriptor del client, chiuso alla fine della connessione
  */
-void* connection_handler (void* ptr) {
-    // File descriptor del client
-    int* client_ptr = (int*) ptr;
-    int client_fd = *(client_ptr);
+static void serve_connection (int client_fd) {
+    // Sessione del client, creata alla registrazione
+    session_t* session = NULL;
+    // Arena da cui vengono allocati header, dati ricevuti e blocchi letti, azzerata ad ogni richiesta
+    arena_t* arena = create_arena(ARENA_CHUNK_SIZE);
+    ASSERT_MESSAGE(arena != NULL, "[objectstore] Creating connection arena", close_socket(client_fd); return);
+    // Lettore da cui vengono ricevuti header e dati, così che una read possa riceverne più di uno
+    socket_reader_t* reader = create_socket_reader(client_fd);
+    ASSERT_MESSAGE(reader != NULL, "[objectstore] Creating connection reader", destroy_arena(arena); close_socket(client_fd); return);
+    __atomic_add_fetch(&open_connections, 1, __ATOMIC_RELAXED);
     // Loop di gestione delle comunicazioni
     while (!terminated) {
+        // Libera in un colpo solo la memoria della richiesta precedente
+        reset_arena(arena);
         // Header del messaggio
-        char* header = receive_message(client_fd, sizeof(char) * MAX_HEADER_LENGTH);
+        char* header = arena_alloc(arena, sizeof(char) * MAX_HEADER_LENGTH);
         // Se non ci riesce la pipe è stata interrotta, quindi esce
-        if (!header) break;
+        if (!header || (receive_buffered_into(reader, header, sizeof(char) * MAX_HEADER_LENGTH) == -1)) break;
+        header[MAX_HEADER_LENGTH - 1] = '\0';
+        // Misura la richiesta a partire dall'arrivo dell'header nel buffer della connessione
+        metrics_request_begin(socket_reader_fill_time(reader));
+        metrics_bytes(MAX_HEADER_LENGTH, 0);
         // Altrimenti stampa un messaggio di log
         printf("[objectstore] Client %d: %s", client_fd, header);
         // Avvia la gestione della richiesta
-        int result = parse_request(client_fd, header);
-        // Libera la memoria occupata dall'header
-        free(header);
+        int result = parse_request(client_fd, reader, &session, header, arena);
         // Se la richiesta non è andata a buon stampa un errore
+        int error = errno;
         ASSERT(result != -1, send_error(client_fd));
+        metrics_request_end(metrics_verb(header));
         // Se parse_request restituisce 1 il messaggio è di terminazione
         if (result == 1) break;
+        // Dei dati troppo grandi per essere ricevuti non sono stati letti, quindi il prossimo header non si può trovare
+        if ((result == -1) && (error == EMSGSIZE)) break;
     }
-    // Libera la memoria occupata dal file descriptor
-    free(client_ptr);
+    // Se il client non ha inviato LEAVE chiude comunque la sua sessione
+    leave_client(session);
+    // Libera l'arena e il lettore della connessione
+    destroy_arena(arena);
+    destroy_socket_reader(reader);
+    __atomic_sub_fetch(&open_connections, 1, __ATOMIC_RELAXED);
     // Chiude la connessione
-    ASSERT_MESSAGE_RETURN(close_socket(client_fd) == 0, "[objectstore] Closing socket", NULL);
+    ASSERT_MESSAGE_RETURN(close_socket(client_fd) == 0, "[objectstore] Closing socket", );
     // Stampa un messaggio di uscita
     printf("[objectstore] Client %d: Connection terminated\n", client_fd);
+}
+
+/**
+ * @brief Corpo di un thread di connessione: serve il client e, prima di uscire, si inserisce nella coda di completamento
+ * così che il loop di accettazione lo attenda e ne liberi lo stack.
+ * 
+ * @param ptr Puntatore alla connection_t del thread, liberata dal thread stesso
+ * @return void* Sempre NULL dato che la funzione non restituisce nulla
+ */
+void* connection_handler (void* ptr) {
+    connection_t* connection = (connection_t*) ptr;
+    pthread_list_t* node = connection->node;
+    serve_connection(connection->client_fd);
+    free(connection);
     // Chiude il thread
+    ASSERT_MESSAGE(push_pthread_queue(&thread_queue, node) == 0, "[objectstore] Queueing finished thread", );
     return NULL;
 }
 
-int main(int argc, char const *argv[]) {
+/**
+ * @brief Stampa le opzioni del server e termina.
+ * 
+ * @param name Nome dell'eseguibile
+ */
+static void usage (char* name) {
+    fprintf(stderr, "Usage: %s [-l BYTES]\n"
+        "  -l  size from which objects bypass the page cache (default %lu)\n", name, (unsigned long) LARGE_OBJECT_THRESHOLD);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    start_time = metrics_clock();
+    // Legge le opzioni
+    int option;
+    while ((option = getopt(argc, argv, "l:h")) != -1) {
+        switch (option) {
+            case 'l': {
+                char* end;
+                errno = 0;
+                unsigned long long threshold = strtoull(optarg, &end, 10);
+                if ((errno != 0) || !isdigit((unsigned char) optarg[0]) || (*end != '\0') || (set_large_object_threshold(threshold) == -1)) usage(argv[0]);
+                break;
+            }
+            default: usage(argv[0]);
+        }
+    }
+    if (optind < argc) usage(argv[0]);
     // Crea una maschera per mascherare i segnali che intende gestire
     sigset_t set;
     ASSERT_MESSAGE(sigemptyset(&set) != -1, "[objectstore] Emptying signal mask", exit(1));
@@ -298,8 +838,8 @@ int main(int argc, char const *argv[]) {
     // Avvia il thread gestore dei segnali in modalità detached
     pthread_t sig_handler_id;
     ASSERT_MESSAGE(pthread_create(&sig_handler_id, NULL, signal_handler, (void*) &set) == 0, "[objectstore] Creating signal handling thread", exit(1));
-    // Crea la lista dei thread attivi
-    pthread_list_t* thread_list = NULL;
+    // Crea la coda dei thread terminati
+    ASSERT_MESSAGE(init_pthread_queue(&thread_queue) == 0, "[objectstore] Creating thread queue", exit(1));
     // Crea il server socket su cui attendere connessioni
     int server_fd = create_server_socket(SOCKET_NAME);
     // Controlla che la creazione sia andata a buon fine oppure esce
@@ -320,24 +860,36 @@ int main(int argc, char const *argv[]) {
         ASSERT_MESSAGE(client_fd != -1, "[objectstore] Accepting client", exit(1));
         // Se è arrivato un nuovo client lo gestisce
         if (client_fd > 0) {
-            // Copia il file descriptor in una variabile da passare
-            int* client_ptr = malloc(sizeof(int));
-            *client_ptr = client_fd;
-            // Crea un nuovo thread a cui passa la connessione
+            // Prepara l'argomento del thread con il nodo della coda di completamento
+            connection_t* connection = (connection_t*) malloc(sizeof(connection_t));
+            pthread_list_t* node = (pthread_list_t*) malloc(sizeof(pthread_list_t));
+            ASSERT((connection != NULL) && (node != NULL), errno = ENOMEM; perror("[objectstore] Allocating connection");
+                free(connection); free(node); close_socket(client_fd); continue);
+            connection->client_fd = client_fd;
+            connection->node = node;
+            // Conta il thread prima di crearlo, così che il conto non possa mancare un thread già partito
+            ASSERT_MESSAGE(add_pthread_queue(&thread_queue) == 0, "[objectstore] Counting thread",
+                free(connection); free(node); close_socket(client_fd); break);
+            // Crea un nuovo thread a cui passa la connessione, togliendolo dal conto se non parte
             pthread_t thread_id;
-            ASSERT_MESSAGE(pthread_create(&thread_id, NULL, connection_handler, (void*) client_ptr) == 0, "[objectstore] Creating thread", break);
-            // Mette il thread nella coda
-            ASSERT_MESSAGE(insert_pthread_list(&thread_list, thread_id) == 0, "[objectstore] Inserting thread in waiting list", break);
+            ASSERT_MESSAGE((errno = pthread_create(&thread_id, NULL, connection_handler, (void*) connection)) == 0, "[objectstore] Creating thread",
+                remove_pthread_queue(&thread_queue); free(connection); free(node); close_socket(client_fd); break);
         }
+        // Attende i thread delle connessioni già terminate, senza bloccarsi
+        ASSERT_MESSAGE(reap_pthread_queue(&thread_queue, 0) != -1, "[objectstore] Joining finished threads", );
     }
     // Attende la terminazione di tutti i thread
-    while (thread_list != NULL) {
-        pthread_t thread_id = remove_pthread_list_head(&thread_list);
-        ASSERT_MESSAGE(pthread_join(thread_id, NULL) == 0, "[objectstore] Joining thread", exit(1));
-        printf("[objectstore] Thread %ld terminated\n", thread_id);
-    }
+    int reaped;
+    while ((reaped = reap_pthread_queue(&thread_queue, 1)) > 0)
+        printf("[objectstore] %d threads terminated\n", reaped);
+    ASSERT_MESSAGE(reaped == 0, "[objectstore] Joining thread", exit(1));
+    destroy_pthread_queue(&thread_queue);
     // Libera la memoria occupata dalle funzioni worker
     ASSERT_MESSAGE(stop_worker_functions() != -1, "[objectstore] Stopping worker function", exit(1));
+    // Restituisce al sistema i buffer trattenuti dal pool
+    destroy_pool();
+    // Libera le misure dei thread di connessione
+    metrics_destroy();
     // Chiude il socket del server, altrimenti stampa un messaggio
     ASSERT_MESSAGE(pthread_join(sig_handler_id, NULL) == 0, "[objectstore] Joining signal handling socket", exit(1));
     ASSERT_MESSAGE(close_server_socket(server_fd, SOCKET_NAME) != -1, "[objectstore] Closing socket", exit(1));
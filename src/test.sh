@@ -18,4 +18,42 @@ done
 for ((i = 30; i < 50; i++)); do
     ./client user$i 3 &
 done
-wait
\ No newline at end of file
+wait
+
+# Test 4-6: aggiunte in coda a un blocco, prima in sequenza e poi da due client contemporaneamente
+./client appender 4
+./client appender 5 &
+./client appender 5 &
+wait
+./client appender 6
+
+# Test 7: scrive dei blocchi nel layout piatto, come una versione precedente del server, li legge, li migra al layout
+# a fanout con il server in funzione e li rilegge
+pattern=$(mktemp)
+for ((b = 0; b < 256; b++)); do printf "\\$(printf %03o $b)"; done > $pattern.byte
+for ((k = 0; k < 40; k++)); do cat $pattern.byte; done > $pattern
+mkdir -p data/flat
+for ((i = 0; i < 10; i++)); do
+    head -c $((1000 * (i + 1))) $pattern > data/flat/F$i
+done
+rm -f $pattern $pattern.byte
+./client flat 7
+./migrate flat > /dev/null
+if [ -e data/flat/F0 ] || [ ! -d data/flat/.fanout ]; then
+    echo "[flat] Test 7: Objects left in the flat layout"
+fi
+./client flat 7
+
+# Test 8: richieste condizionali
+./client conditional 8
+
+# Test 9: termina il server senza dargli modo di compattare l'indice, lo riavvia e verifica che oggetti, elenchi e tag
+# siano stati ricostruiti dal journal
+kill -KILL $obj_pid
+while kill -0 $obj_pid 2> /dev/null; do sleep 0.1; done
+rm -f objstore.sock
+./objectstore > /dev/null 2>&1 &
+while [ ! -S objstore.sock ]; do sleep 0.1; done
+./client conditional 9
+./client appender 6
+./client user0 2
@@ -0,0 +1,359 @@
+/**
+ * @file testhash.c
+ * @author Giacomo Mariani, Matricola 545519, Corso B
+ * @brief Benchmark della tabella hash di lib/hashtable. Per ogni combinazione di dimensione della tabella, distribuzione
+ * delle chiavi e numero di thread misura la velocità e i percentili di latenza di inserimento, ricerca, carico misto e
+ * rimozione, così che una modifica della tabella o della sua sincronizzazione possa essere confrontata con una misura
+ * precedente (compilando con e senza "FLATHASH=1", o prima e dopo la modifica).
+ *
+ * Si dichiara che tutto il codice è stato realizzato dallo studente.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <assertmacros.h>
+
+#include <hashtable/hashtable.h>
+#include <histogram/workload.h>
+
+// Una operazione ogni SAMPLE_EVERY viene cronometrata singolarmente per i percentili di latenza
+#define SAMPLE_EVERY 8
+
+// Nel carico misto una operazione ogni MIXED_WRITE_EVERY è una scrittura
+#define MIXED_WRITE_EVERY 10
+
+// Chiavi aggiuntive di ogni thread, inserite e rimosse a turno nel carico misto
+#define MIXED_EXTRA_KEYS 64
+
+// Valore associato alle chiavi, della lunghezza tipica di un nome utente
+#define VALUE "benchmark_user01"
+
+// Valori di default dei parametri
+#define DEFAULT_SIZES "1000,100000,1000000"
+#define DEFAULT_DISTRIBUTIONS "seq,sparse,zipf"
+#define DEFAULT_THREADS "1,2,4"
+#define DEFAULT_OPS 1000000
+
+#define MAX_LIST 16
+
+/**
+ * @brief Distribuzione delle chiavi: consecutive (come i file descriptor), sparse su 31 bit con accessi uniformi,
+ * oppure sparse con accessi concentrati su poche chiavi secondo una zipf.
+ */
+typedef enum { DIST_SEQ, DIST_SPARSE, DIST_ZIPF } distribution_t;
+
+static const char* distribution_names[] = { "seq", "sparse", "zipf" };
+
+/**
+ * @brief Fase del benchmark
+ */
+typedef enum { PHASE_INSERT, PHASE_LOOKUP, PHASE_MIXED, PHASE_REMOVE } phase_t;
+
+static const char* phase_names[] = { "insert", "lookup", "mixed", "remove" };
+
+/**
+ * @brief Stato di un thread del benchmark
+ */
+typedef struct worker {
+    int id;
+    phase_t phase;
+    // Chiavi di cui il thread è responsabile in inserimento e rimozione
+    int* own_keys;
+    long own_count;
+    // Chiavi cercate nella ricerca e nel carico misto, generate prima della misura
+    int* lookup_keys;
+    long lookup_count;
+    // Chiavi aggiuntive del carico misto
+    int extra_keys[MIXED_EXTRA_KEYS];
+    // Latenze campionate in nanosecondi
+    unsigned long* samples;
+    long sample_count;
+    long errors;
+} worker_t;
+
+// Parametri della misura corrente, condivisi dai thread
+static hashtable_t* table;
+static pthread_barrier_t start_barrier;
+static pthread_barrier_t end_barrier;
+
+/**
+ * @brief Restituisce la chiave di indice i. Con chiavi sparse l'indice viene moltiplicato per una costante dispari
+ * modulo 2^31: la mappa è biunivoca, quindi indici diversi danno chiavi diverse, tutte non negative.
+ */
+static inline int key_of (distribution_t distribution, long i) {
+    if (distribution == DIST_SEQ) return (int) i;
+    return (int) (((unsigned long) i * 2654435761UL) & 0x7fffffffUL);
+}
+
+/**
+ * @brief Cerca una chiave, contando come errore una chiave che dovrebbe esserci e non c'è
+ */
+static inline void lookup (worker_t* worker, int key) {
+    char buffer[64];
+    if (retrieve_hashtable(table, key, buffer, sizeof(buffer)) == -1) worker->errors++;
+}
+
+/**
+ * @brief Esegue una operazione della fase corrente. Nel carico misto ogni MIXED_WRITE_EVERY operazioni una è una scrittura,
+ * che inserisce o rimuove a turno una delle chiavi aggiuntive del thread.
+ */
+static inline void run_operation (worker_t* worker, long i) {
+    switch (worker->phase) {
+        case PHASE_INSERT:
+            if (insert_hashtable(table, worker->own_keys[i], VALUE) == -1) worker->errors++;
+            break;
+        case PHASE_LOOKUP:
+            lookup(worker, worker->lookup_keys[i]);
+            break;
+        case PHASE_MIXED:
+            if (i % MIXED_WRITE_EVERY == 0) {
+                long write = i / MIXED_WRITE_EVERY;
+                int key = worker->extra_keys[write % MIXED_EXTRA_KEYS];
+                if ((write / MIXED_EXTRA_KEYS) % 2 == 0) {
+                    if (insert_hashtable(table, key, VALUE) == -1) worker->errors++;
+                }
+                else if (remove_hashtable(table, key) == -1) worker->errors++;
+            }
+            else lookup(worker, worker->lookup_keys[i]);
+            break;
+        case PHASE_REMOVE:
+            if (remove_hashtable(table, worker->own_keys[i]) == -1) worker->errors++;
+            break;
+    }
+}
+
+/**
+ * @brief Corpo di un thread: aspetta gli altri, esegue le operazioni della fase cronometrandone una ogni SAMPLE_EVERY
+ */
+static void* worker_thread (void* arg) {
+    worker_t* worker = (worker_t*) arg;
+    long count = ((worker->phase == PHASE_INSERT) || (worker->phase == PHASE_REMOVE)) ? worker->own_count : worker->lookup_count;
+    worker->sample_count = 0;
+    worker->errors = 0;
+    pthread_barrier_wait(&start_barrier);
+    for (long i = 0; i < count; i++) {
+        if (i % SAMPLE_EVERY == 0) {
+            unsigned long start = now_ns();
+            run_operation(worker, i);
+            worker->samples[worker->sample_count++] = now_ns() - start;
+        }
+        else run_operation(worker, i);
+    }
+    pthread_barrier_wait(&end_barrier);
+    return NULL;
+}
+
+static int compare_samples (const void* a, const void* b) {
+    unsigned long x = *(const unsigned long*) a;
+    unsigned long y = *(const unsigned long*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Restituisce il percentile p (tra 0 e 100) di un array ordinato
+ */
+static unsigned long percentile (unsigned long* sorted, long count, double p) {
+    if (count == 0) return 0;
+    long index = (long) (p / 100.0 * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+/**
+ * @brief Esegue una fase con tutti i thread e ne stampa il risultato
+ *
+ * @return int Se la fase è stata eseguita restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int run_phase (worker_t* workers, int threads, phase_t phase, long size, distribution_t distribution, int csv) {
+    pthread_t tids[threads];
+    int created = 0;
+    ASSERT_ERRNO_RETURN(pthread_barrier_init(&start_barrier, NULL, threads + 1) == 0, ENOMEM, -1);
+    ASSERT(pthread_barrier_init(&end_barrier, NULL, threads + 1) == 0, pthread_barrier_destroy(&start_barrier); errno = ENOMEM; return -1);
+    for (; created < threads; created++) {
+        workers[created].phase = phase;
+        if (pthread_create(&tids[created], NULL, worker_thread, &workers[created]) != 0) break;
+    }
+    // Senza tutti i thread le barriere non si aprirebbero mai
+    ASSERT(created == threads, fprintf(stderr, "[testhash] Could not create %d threads\n", threads); exit(1));
+    pthread_barrier_wait(&start_barrier);
+    unsigned long start = now_ns();
+    pthread_barrier_wait(&end_barrier);
+    unsigned long elapsed = now_ns() - start;
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    pthread_barrier_destroy(&start_barrier);
+    pthread_barrier_destroy(&end_barrier);
+    // Unisce i campioni dei thread
+    long operations = 0, samples = 0, errors = 0;
+    for (int i = 0; i < threads; i++) {
+        operations += ((phase == PHASE_INSERT) || (phase == PHASE_REMOVE)) ? workers[i].own_count : workers[i].lookup_count;
+        samples += workers[i].sample_count;
+        errors += workers[i].errors;
+    }
+    unsigned long* all = (unsigned long*) malloc((samples + 1) * sizeof(unsigned long));
+    ASSERT_ERRNO_RETURN(all != NULL, ENOMEM, -1);
+    long offset = 0;
+    for (int i = 0; i < threads; i++) {
+        memcpy(all + offset, workers[i].samples, workers[i].sample_count * sizeof(unsigned long));
+        offset += workers[i].sample_count;
+    }
+    qsort(all, samples, sizeof(unsigned long), compare_samples);
+    double mops = (elapsed > 0) ? (double) operations * 1000.0 / elapsed : 0;
+    const char* format = csv ? "%ld,%s,%d,%s,%ld,%.3f,%lu,%lu,%lu,%lu,%lu,%ld\n"
+                             : "%9ld %-7s %3d  %-7s %9ld %9.3f %7lu %7lu %7lu %8lu %8lu %6ld\n";
+    printf(format, size, distribution_names[distribution], threads, phase_names[phase], operations, mops,
+        percentile(all, samples, 50), percentile(all, samples, 90), percentile(all, samples, 99),
+        percentile(all, samples, 99.9), (samples > 0) ? all[samples - 1] : 0, errors);
+    fflush(stdout);
+    free(all);
+    return 0;
+}
+
+/**
+ * @brief Esegue tutte le fasi su una tabella nuova
+ *
+ * @return int Se la misura è stata eseguita restituisce 0. Se c'è un errore restituisce -1 e setta errno.
+ */
+static int run_benchmark (long size, distribution_t distribution, int threads, long ops, int csv) {
+    worker_t workers[threads];
+    zipf_t zipf = { 0 };
+    int success = -1;
+    if (distribution == DIST_ZIPF) init_zipf(&zipf, size, ZIPF_THETA);
+    memset(workers, 0, sizeof(workers));
+    // Prepara le chiavi di ogni thread prima della misura, così che la generazione non venga cronometrata
+    for (int t = 0; t < threads; t++) {
+        worker_t* worker = &workers[t];
+        unsigned long state = 0x9E3779B97F4A7C15UL * (t + 1);
+        worker->id = t;
+        worker->own_count = size / threads + (t < size % threads);
+        worker->lookup_count = ops;
+        long samples = ((worker->own_count > ops) ? worker->own_count : ops) / SAMPLE_EVERY + 1;
+        worker->own_keys = (int*) malloc(worker->own_count * sizeof(int));
+        worker->lookup_keys = (int*) malloc(ops * sizeof(int));
+        worker->samples = (unsigned long*) malloc(samples * sizeof(unsigned long));
+        ASSERT((worker->own_keys != NULL) && (worker->lookup_keys != NULL) && (worker->samples != NULL), errno = ENOMEM; goto cleanup);
+        // Le chiavi da inserire sono divise fra i thread a turno
+        for (long i = 0; i < worker->own_count; i++)
+            worker->own_keys[i] = key_of(distribution, i * threads + t);
+        for (long i = 0; i < ops; i++) {
+            long index = (distribution == DIST_ZIPF) ? next_zipf(&zipf, &state) : (long) (next_random(&state) % size);
+            worker->lookup_keys[i] = key_of(distribution, index);
+        }
+        // Le chiavi aggiuntive seguono quelle della tabella, quindi non sono mai già presenti
+        for (int i = 0; i < MIXED_EXTRA_KEYS; i++)
+            worker->extra_keys[i] = key_of(distribution, size + (long) t * MIXED_EXTRA_KEYS + i);
+    }
+    table = create_hashtable();
+    ASSERT(table != NULL, goto cleanup);
+    ASSERT(run_phase(workers, threads, PHASE_INSERT, size, distribution, csv) == 0, goto cleanup);
+    ASSERT(run_phase(workers, threads, PHASE_LOOKUP, size, distribution, csv) == 0, goto cleanup);
+    ASSERT(run_phase(workers, threads, PHASE_MIXED, size, distribution, csv) == 0, goto cleanup);
+    ASSERT(run_phase(workers, threads, PHASE_REMOVE, size, distribution, csv) == 0, goto cleanup);
+    success = 0;
+cleanup:
+    if (table != NULL) destroy_hashtable(table);
+    table = NULL;
+    for (int t = 0; t < threads; t++) {
+        free(workers[t].own_keys);
+        free(workers[t].lookup_keys);
+        free(workers[t].samples);
+    }
+    return success;
+}
+
+/**
+ * @brief Legge una lista di interi positivi separati da virgole
+ *
+ * @return int Numero di elementi letti. Se la lista non è valida restituisce -1.
+ */
+static int parse_list (char* string, long* values) {
+    int count = 0;
+    char* save;
+    for (char* token = strtok_r(string, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+        char* end;
+        ASSERT_RETURN(count < MAX_LIST, -1);
+        values[count] = strtol(token, &end, 10);
+        ASSERT_RETURN((*end == '\0') && (values[count] > 0), -1);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Legge una lista di distribuzioni separate da virgole
+ *
+ * @return int Numero di elementi letti. Se la lista non è valida restituisce -1.
+ */
+static int parse_distributions (char* string, distribution_t* values) {
+    int count = 0;
+    char* save;
+    for (char* token = strtok_r(string, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+        int found = 0;
+        ASSERT_RETURN(count < MAX_LIST, -1);
+        for (int d = DIST_SEQ; d <= DIST_ZIPF; d++)
+            if (strcmp(token, distribution_names[d]) == 0) { values[count++] = (distribution_t) d; found = 1; }
+        ASSERT_RETURN(found, -1);
+    }
+    return count;
+}
+
+static void usage (char* name) {
+    fprintf(stderr, "Usage: %s [-n SIZES] [-d DISTRIBUTIONS] [-t THREADS] [-o OPS] [-c]\n"
+        "  -n  comma separated table sizes (default " DEFAULT_SIZES ")\n"
+        "  -d  comma separated key distributions among seq, sparse, zipf (default " DEFAULT_DISTRIBUTIONS ")\n"
+        "  -t  comma separated thread counts (default " DEFAULT_THREADS ")\n"
+        "  -o  lookup and mixed operations per thread (default %d)\n"
+        "  -c  print CSV instead of a table\n", name, DEFAULT_OPS);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    char sizes_string[256] = DEFAULT_SIZES;
+    char distributions_string[256] = DEFAULT_DISTRIBUTIONS;
+    char threads_string[256] = DEFAULT_THREADS;
+    long ops = DEFAULT_OPS;
+    int csv = 0;
+    int option;
+    while ((option = getopt(argc, argv, "n:d:t:o:ch")) != -1) {
+        switch (option) {
+            case 'n': snprintf(sizes_string, sizeof(sizes_string), "%s", optarg); break;
+            case 'd': snprintf(distributions_string, sizeof(distributions_string), "%s", optarg); break;
+            case 't': snprintf(threads_string, sizeof(threads_string), "%s", optarg); break;
+            case 'o': ops = strtol(optarg, NULL, 10); break;
+            case 'c': csv = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    long sizes[MAX_LIST], threads[MAX_LIST];
+    distribution_t distributions[MAX_LIST];
+    int n_sizes = parse_list(sizes_string, sizes);
+    int n_threads = parse_list(threads_string, threads);
+    int n_distributions = parse_distributions(distributions_string, distributions);
+    if ((n_sizes <= 0) || (n_threads <= 0) || (n_distributions <= 0) || (ops <= 0)) usage(argv[0]);
+    // La latenza misurata comprende il costo della lettura del tempo, stimato qui
+    unsigned long start = now_ns();
+    for (int i = 0; i < 1000; i++) now_ns();
+    unsigned long clock_cost = (now_ns() - start) / 1000;
+    if (csv) printf("size,distribution,threads,phase,operations,mops,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,errors\n");
+    else {
+        printf("[testhash] Clock overhead included in latencies: ~%lu ns, one operation every %d sampled\n", clock_cost, SAMPLE_EVERY);
+        printf("%9s %-7s %3s  %-7s %9s %9s %7s %7s %7s %8s %8s %6s\n",
+            "size", "dist", "thr", "phase", "ops", "Mops/s", "p50ns", "p90ns", "p99ns", "p99.9ns", "maxns", "errors");
+    }
+    int failures = 0;
+    for (int s = 0; s < n_sizes; s++)
+        for (int d = 0; d < n_distributions; d++)
+            for (int t = 0; t < n_threads; t++)
+                ASSERT(run_benchmark(sizes[s], distributions[d], (int) threads[t], ops, csv) == 0,
+                    fprintf(stderr, "[testhash] size %ld, %s, %ld threads: %s\n", sizes[s], distribution_names[distributions[d]], threads[t], strerror(errno)); failures++);
+    return (failures > 0);
+}
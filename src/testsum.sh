@@ -2,7 +2,7 @@
 
 function print_report () {
     # Numero totale di test per la batteria
-    total=$(grep -c "Test $1" testout.log)
+    total=$(grep -c "Test $1:" testout.log)
     # Numero di test passati
     let passed=$(grep -c "Test $1: Success" testout.log)
     # Numero di test falliti
@@ -19,7 +19,7 @@ total=$(cat testout.log | wc -l)
 
 # Stampa il report per ogni batteria
 echo "Test lanciati: $total"
-for ((i = 1; i <= 3; i++)); do
+for ((i = 1; i <= 9; i++)); do
     print_report $i
 done
 